@@ -24,109 +24,71 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/inetdevice.h>
+#include <linux/ipv6.h>
+#include <linux/rcupdate.h>
 
 #include <pf_q-module.h>
+#include <pf_q-group.h>
+#include <pf_q-bloom.h>
 
-#include "bloom.h"
+
+#define BLOOM_SRC	1
+#define BLOOM_DST	2
 
 
 static bool
-bloom_src(arguments_t args, SkBuff b)
+bloom_match(struct pfq_bloom *bloom, SkBuff b, int which)
 {
-	if (eth_hdr(b.skb)->h_proto == __constant_htons(ETH_P_IP))
-	{
+	if (bloom->ipv == 4) {
+
 		struct iphdr _iph;
 		const struct iphdr *ip;
-		uint32_t fold, mask, addr;
-		char *mem;
+
+		if (eth_hdr(b.skb)->h_proto != __constant_htons(ETH_P_IP))
+			return false;
 
 		ip = skb_header_pointer(b.skb, b.skb->mac_len, sizeof(_iph), &_iph);
 		if (ip == NULL)
 			return false;
 
-		fold = GET_ARG_0(uint32_t, args);
-		mem  = GET_ARG_1(char *, args);
-		mask = GET_ARG_2(uint32_t, args);
-
-		addr = ip->saddr & mask;
-
-		if ( BF_TEST(mem, hfun1(addr) & fold ) &&
-		     BF_TEST(mem, hfun2(addr) & fold ) &&
-		     BF_TEST(mem, hfun3(addr) & fold ) &&
-		     BF_TEST(mem, hfun4(addr) & fold ) )
-			return true;
+		return ((which & BLOOM_SRC) && pfq_bloom_match(bloom, ip->saddr)) ||
+		       ((which & BLOOM_DST) && pfq_bloom_match(bloom, ip->daddr));
 	}
+	else {
+		struct ipv6hdr _ip6h;
+		const struct ipv6hdr *ip6;
 
-	return false;
-}
-
-
-static bool
-bloom_dst(arguments_t args, SkBuff b)
-{
-	if (eth_hdr(b.skb)->h_proto == __constant_htons(ETH_P_IP))
-	{
-		struct iphdr _iph;
-		const struct iphdr *ip;
-		uint32_t fold, mask, addr;
-		char *mem;
-
-		ip = skb_header_pointer(b.skb, b.skb->mac_len, sizeof(_iph), &_iph);
-		if (ip == NULL)
+		if (eth_hdr(b.skb)->h_proto != __constant_htons(ETH_P_IPV6))
 			return false;
 
-		fold = GET_ARG_0(uint32_t, args);
-		mem  = GET_ARG_1(char *, args);
-		mask = GET_ARG_2(uint32_t, args);
-
-		addr = ip->daddr & mask;
+		ip6 = skb_header_pointer(b.skb, b.skb->mac_len, sizeof(_ip6h), &_ip6h);
+		if (ip6 == NULL)
+			return false;
 
-		if ( BF_TEST(mem, hfun1(addr) & fold ) &&
-		     BF_TEST(mem, hfun2(addr) & fold ) &&
-		     BF_TEST(mem, hfun3(addr) & fold ) &&
-		     BF_TEST(mem, hfun4(addr) & fold ) )
-			return true;
+		return ((which & BLOOM_SRC) && pfq_bloom_match6(bloom, &ip6->saddr)) ||
+		       ((which & BLOOM_DST) && pfq_bloom_match6(bloom, &ip6->daddr));
 	}
-
-	return false;
 }
 
+
+/* filters built from the arguments of the computation */
+
 static bool
 bloom(arguments_t args, SkBuff b)
 {
-	if (eth_hdr(b.skb)->h_proto == __constant_htons(ETH_P_IP))
-	{
-		struct iphdr _iph;
-		const struct iphdr *ip;
-		uint32_t fold, mask, addr;
-		char *mem;
-
-		ip = skb_header_pointer(b.skb, b.skb->mac_len, sizeof(_iph), &_iph);
-		if (ip == NULL)
-			return false;
-
-		fold = GET_ARG_0(uint32_t, args);
-		mem  = GET_ARG_1(char *, args);
-		mask = GET_ARG_2(uint32_t, args);
-
-		addr = ip->daddr & mask;
-
-		if ( BF_TEST(mem, hfun1(addr) & fold ) &&
-		     BF_TEST(mem, hfun2(addr) & fold ) &&
-		     BF_TEST(mem, hfun3(addr) & fold ) &&
-		     BF_TEST(mem, hfun4(addr) & fold ) )
-			return true;
-
-		addr = ip->saddr & mask;
+	return bloom_match(GET_ARG_1(struct pfq_bloom *, args), b, BLOOM_SRC|BLOOM_DST);
+}
 
-		if ( BF_TEST(mem, hfun1(addr) & fold ) &&
-		     BF_TEST(mem, hfun2(addr) & fold ) &&
-		     BF_TEST(mem, hfun3(addr) & fold ) &&
-		     BF_TEST(mem, hfun4(addr) & fold ) )
-			return true;
-	}
+static bool
+bloom_src(arguments_t args, SkBuff b)
+{
+	return bloom_match(GET_ARG_1(struct pfq_bloom *, args), b, BLOOM_SRC);
+}
 
-	return false;
+static bool
+bloom_dst(arguments_t args, SkBuff b)
+{
+	return bloom_match(GET_ARG_1(struct pfq_bloom *, args), b, BLOOM_DST);
 }
 
 
@@ -138,7 +100,6 @@ bloom_filter(arguments_t args, SkBuff b)
 	return Drop(b);
 }
 
-
 static Action_SkBuff
 bloom_src_filter(arguments_t args, SkBuff b)
 {
@@ -156,67 +117,120 @@ bloom_dst_filter(arguments_t args, SkBuff b)
 }
 
 
-static int bloom_init(arguments_t args)
+/* filters loaded from user-space (Q_SO_GROUP_BLOOM) and swapped at run-time */
+
+static bool
+group_bloom_match(arguments_t args, SkBuff b, int which)
 {
-	unsigned int m = GET_ARG_0(int, args);
-	unsigned int n = LEN_ARRAY_1(args);
-	uint32_t *ips  = GET_ARRAY_1(uint32_t, args);
-	uint32_t mask;
-	size_t i, size;
+	const int n = GET_ARG_0(int, args);
+	struct pfq_group *g = PFQ_CB(b.skb)->monad->group;
+	struct pfq_bloom *bloom;
+	bool ret = false;
 
-	char *mem;
+	rcu_read_lock();
 
-	m = clp2(m);
+	bloom = rcu_dereference(g->bloom[n]);
+	if (bloom)
+		ret = bloom_match(bloom, b, which);
 
-	SET_ARG_0(args, m-1);	/* bloom filter fold mask */
+	rcu_read_unlock();
+	return ret;
+}
 
-	if (m > (1UL << 24)) {
-		printk(KERN_INFO "[PFQ|init] bloom filter: maximum number of bins exceeded (2^24)!\n");
-		return -EPERM;
-	}
+static bool
+in_bloom(arguments_t args, SkBuff b)
+{
+	return group_bloom_match(args, b, BLOOM_SRC|BLOOM_DST);
+}
 
-	size = (m >> 3);
+static bool
+in_bloom_src(arguments_t args, SkBuff b)
+{
+	return group_bloom_match(args, b, BLOOM_SRC);
+}
 
-	mem = kzalloc(size, GFP_KERNEL);
-	if (!mem) {
-		printk(KERN_INFO "[PFQ|init] bloom filter: out of memory!\n");
-		return -ENOMEM;
-	}
+static bool
+in_bloom_dst(arguments_t args, SkBuff b)
+{
+	return group_bloom_match(args, b, BLOOM_DST);
+}
 
-	SET_ARG_1(args, mem);
 
-	mask = inet_make_mask(GET_ARG_2(int, args));
+static int
+bloom_init(arguments_t args, int ipv)
+{
+	const int words = ipv == 4 ? 1 : 4;
+	unsigned int m = GET_ARG_0(int, args);
+	unsigned int n = LEN_ARRAY_1(args) / words;
+	uint32_t *ips  = GET_ARRAY_1(uint32_t, args);
+	int prefix = GET_ARG_2(int, args);
+	struct pfq_bloom *bloom;
+	size_t i;
+
+	bloom = pfq_bloom_alloc(max_t(size_t, DIV_ROUND_UP(m, Q_BLOOM_BLOCK_BITS), 1), ipv, prefix);
+	if (!bloom) {
+		printk(KERN_INFO "[PFQ|init] bloom filter: invalid parameters or out of memory (m=%u, max %d bins, prefix=%d)!\n",
+		       m, Q_BLOOM_MAX_BLOCKS * Q_BLOOM_BLOCK_BITS, prefix);
+		return -EPERM;
+	}
 
-	SET_ARG_2(args, mask);
+	SET_ARG_1(args, bloom);
 
-	pr_devel("[PFQ|init] bloom filter@%p: k=4, n=%d, m=%d size=%zu netmask=%pI4 bytes.\n", mem, n, m, size, &mask);
+	pr_devel("[PFQ|init] bloom filter@%p: IPv%d k=%d, n=%u, blocks=%zu prefix=%d.\n",
+		 bloom, ipv, Q_BLOOM_K, n, bloom->nblocks, prefix);
 
 	for(i = 0; i < n; i++)
 	{
-		uint32_t h1 = hfun1(ips[i] & mask) & (m-1);
-		uint32_t h2 = hfun2(ips[i] & mask) & (m-1);
-		uint32_t h3 = hfun3(ips[i] & mask) & (m-1);
-		uint32_t h4 = hfun4(ips[i] & mask) & (m-1);
+		__be32 addr[4];
+		int w;
+
+		/* IPv4 addresses are in network byte order, IPv6 words in host byte order (MSW first) */
 
-		BF_SET(mem, h1);
-		BF_SET(mem, h2);
-		BF_SET(mem, h3);
-		BF_SET(mem, h4);
+		for(w = 0; w < words; w++)
+			addr[w] = ipv == 4 ? (__force __be32)ips[i] : htonl(ips[i * words + w]);
 
-		pr_devel("[PFQ|init] bloom filter: -> address %pI4\n", ips+i);
+		pfq_bloom_insert(bloom, addr);
 	}
 
 	return 0;
 }
 
 
-static int bloom_fini(arguments_t args)
+static int
+bloom_init4(arguments_t args)
 {
-	char *mem = GET_ARG_1(char *, args);
+	return bloom_init(args, 4);
+}
 
-	kfree(mem);
+static int
+bloom_init6(arguments_t args)
+{
+	return bloom_init(args, 6);
+}
+
+
+static int
+bloom_fini(arguments_t args)
+{
+	struct pfq_bloom *bloom = GET_ARG_1(struct pfq_bloom *, args);
 
-	pr_devel("[PFQ|init] bloom filter: memory freed@%p!\n", mem);
+	pfq_bloom_free(bloom);
+
+	pr_devel("[PFQ|fini] bloom filter: memory freed@%p!\n", bloom);
+
+	return 0;
+}
+
+
+static int
+in_bloom_init(arguments_t args)
+{
+	const int n = GET_ARG_0(int, args);
+
+	if (n < 0 || n >= Q_MAX_GROUP_BLOOMS) {
+		printk(KERN_INFO "[PFQ|init] bloom filter: invalid index %d!\n", n);
+		return -EPERM;
+	}
 
 	return 0;
 }
@@ -224,11 +238,22 @@ static int bloom_fini(arguments_t args)
 
 struct pfq_function_descr bloom_functions[] = {
 
-	{"bloom",		"CInt -> [Word32] -> CInt -> SkBuff -> Bool",		bloom,			bloom_init,	bloom_fini},
-	{"bloom_src",		"CInt -> [Word32] -> CInt -> SkBuff -> Bool",		bloom_src,		bloom_init,	bloom_fini},
-	{"bloom_dst",		"CInt -> [Word32] -> CInt -> SkBuff -> Bool",		bloom_dst,		bloom_init,	bloom_fini},
-	{"bloom_filter",	"CInt -> [Word32] -> CInt -> SkBuff -> Action SkBuff",	bloom_filter,		bloom_init,	bloom_fini},
-	{"bloom_src_filter",	"CInt -> [Word32] -> CInt -> SkBuff -> Action SkBuff",	bloom_src_filter,	bloom_init,	bloom_fini},
-	{"bloom_dst_filter",	"CInt -> [Word32] -> CInt -> SkBuff -> Action SkBuff",	bloom_dst_filter,	bloom_init,	bloom_fini},
+	{"bloom",		"CInt -> [Word32] -> CInt -> SkBuff -> Bool",		bloom,			bloom_init4,	bloom_fini},
+	{"bloom_src",		"CInt -> [Word32] -> CInt -> SkBuff -> Bool",		bloom_src,		bloom_init4,	bloom_fini},
+	{"bloom_dst",		"CInt -> [Word32] -> CInt -> SkBuff -> Bool",		bloom_dst,		bloom_init4,	bloom_fini},
+	{"bloom_filter",	"CInt -> [Word32] -> CInt -> SkBuff -> Action SkBuff",	bloom_filter,		bloom_init4,	bloom_fini},
+	{"bloom_src_filter",	"CInt -> [Word32] -> CInt -> SkBuff -> Action SkBuff",	bloom_src_filter,	bloom_init4,	bloom_fini},
+	{"bloom_dst_filter",	"CInt -> [Word32] -> CInt -> SkBuff -> Action SkBuff",	bloom_dst_filter,	bloom_init4,	bloom_fini},
+
+	{"bloom6",		"CInt -> [Word32] -> CInt -> SkBuff -> Bool",		bloom,			bloom_init6,	bloom_fini},
+	{"bloom6_src",		"CInt -> [Word32] -> CInt -> SkBuff -> Bool",		bloom_src,		bloom_init6,	bloom_fini},
+	{"bloom6_dst",		"CInt -> [Word32] -> CInt -> SkBuff -> Bool",		bloom_dst,		bloom_init6,	bloom_fini},
+	{"bloom6_filter",	"CInt -> [Word32] -> CInt -> SkBuff -> Action SkBuff",	bloom_filter,		bloom_init6,	bloom_fini},
+	{"bloom6_src_filter",	"CInt -> [Word32] -> CInt -> SkBuff -> Action SkBuff",	bloom_src_filter,	bloom_init6,	bloom_fini},
+	{"bloom6_dst_filter",	"CInt -> [Word32] -> CInt -> SkBuff -> Action SkBuff",	bloom_dst_filter,	bloom_init6,	bloom_fini},
+
+	{"in_bloom",		"CInt -> SkBuff -> Bool",				in_bloom,		in_bloom_init },
+	{"in_bloom_src",	"CInt -> SkBuff -> Bool",				in_bloom_src,		in_bloom_init },
+	{"in_bloom_dst",	"CInt -> SkBuff -> Bool",				in_bloom_dst,		in_bloom_init },
 	{ NULL }};
 
@@ -23,15 +23,205 @@
 
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/log2.h>
+#include <linux/timex.h>
 
 #include <pf_q-module.h>
+#include <pf_q-global.h>
 
 #include "combinator.h"
 
+
+/****************************************************************
+ *	profile-guided and/or: when lang_profile is set, a window of
+ *	Q_PROFILE_WINDOW evaluations every lang_profile is timed, and
+ *	the operand with the lower cost per decisive result (false for
+ *	and, true for or) is moved first. Predicates have no side
+ *	effects, hence the short-circuit order does not change the result.
+ ****************************************************************/
+
+#define Q_PROFILE_WINDOW	256
+
+struct combinator_stats
+{
+	unsigned long	tick;
+	unsigned int	samples;
+	uint64_t	eval[2];
+	uint64_t	decisive[2];
+	uint64_t	cycles[2];
+};
+
+struct combinator_profile
+{
+	int		order;		/* operand evaluated first */
+	unsigned long	mask;
+	atomic_t	swaps;
+	struct combinator_stats __percpu *stats;
+};
+
+
+static void
+combinator_reorder(struct combinator_profile *prof, struct combinator_stats *st)
+{
+	int first = READ_ONCE(prof->order), second = !first;
+
+	/* the second operand has been short-circuited for the whole window: keep the order */
+
+	if (st->eval[second] && st->decisive[second]) {
+
+		/* cycles/decisive: rank(second) < rank(first) */
+
+		if (st->cycles[second] * st->decisive[first] < st->cycles[first] * st->decisive[second]) {
+			WRITE_ONCE(prof->order, second);
+			atomic_inc(&prof->swaps);
+		}
+	}
+
+	memset(st->eval, 0, sizeof(st->eval));
+	memset(st->decisive, 0, sizeof(st->decisive));
+	memset(st->cycles, 0, sizeof(st->cycles));
+	st->samples = 0;
+}
+
+
+static bool
+profiled_eval(struct combinator_profile *prof, predicate_t const *p, bool decisive, SkBuff b)
+{
+	struct combinator_stats *st = this_cpu_ptr(prof->stats);
+	int n, first = READ_ONCE(prof->order);
+	bool ret = !decisive;
+
+	if ((st->tick++ & prof->mask) >= Q_PROFILE_WINDOW) {
+		if (EVAL_PREDICATE(p[first], b) == decisive)
+			return decisive;
+		return EVAL_PREDICATE(p[!first], b);
+	}
+
+	for(n = 0; n < 2; n++)
+	{
+		int i = n ? !first : first;
+		cycles_t start = get_cycles();
+
+		ret = EVAL_PREDICATE(p[i], b);
+
+		st->cycles[i] += get_cycles() - start;
+		st->eval[i]++;
+
+		if (ret == decisive) {
+			st->decisive[i]++;
+			break;
+		}
+	}
+
+	if (++st->samples == Q_PROFILE_WINDOW)
+		combinator_reorder(prof, st);
+
+	return ret;
+}
+
+
+static bool
+pred_or(arguments_t args, SkBuff b)
+{
+	struct combinator_profile *prof = GET_ARG_2(struct combinator_profile *, args);
+	predicate_t p[2];
+
+	if (likely(prof == NULL))
+		return or(args, b);
+
+	p[0] = GET_ARG_0(predicate_t, args);
+	p[1] = GET_ARG_1(predicate_t, args);
+
+	return profiled_eval(prof, p, true, b);
+}
+
+
+static bool
+pred_and(arguments_t args, SkBuff b)
+{
+	struct combinator_profile *prof = GET_ARG_2(struct combinator_profile *, args);
+	predicate_t p[2];
+
+	if (likely(prof == NULL))
+		return and(args, b);
+
+	p[0] = GET_ARG_0(predicate_t, args);
+	p[1] = GET_ARG_1(predicate_t, args);
+
+	return profiled_eval(prof, p, false, b);
+}
+
+
+static int
+combinator_init(arguments_t args)
+{
+	struct combinator_profile *prof;
+	int period = lang_profile;
+
+	if (period <= 0)
+		return 0;
+
+	prof = kzalloc(sizeof(*prof), GFP_KERNEL);
+	if (!prof) {
+		printk(KERN_INFO "[PFQ|init] combinator: out of memory!\n");
+		return -ENOMEM;
+	}
+
+	prof->stats = alloc_percpu(struct combinator_stats);
+	if (!prof->stats) {
+		printk(KERN_INFO "[PFQ|init] combinator: out of memory!\n");
+		kfree(prof);
+		return -ENOMEM;
+	}
+
+	prof->mask = roundup_pow_of_two(max(period, 2 * Q_PROFILE_WINDOW)) - 1;
+
+	SET_ARG_2(args, prof);
+
+	pr_devel("[PFQ|init] combinator: profiling every %lu evaluations\n", prof->mask + 1);
+	return 0;
+}
+
+
+static int
+combinator_fini(arguments_t args)
+{
+	struct combinator_profile *prof = GET_ARG_2(struct combinator_profile *, args);
+
+	if (prof) {
+		free_percpu(prof->stats);
+		kfree(prof);
+		pr_devel("[PFQ|fini] combinator: profile freed@%p\n", prof);
+	}
+
+	return 0;
+}
+
+
+int
+pfq_combinator_snprintf(char *buffer, size_t size, struct pfq_functional const *fun)
+{
+	struct combinator_profile *prof;
+	int first;
+
+	if (fun->ptr != pred_and && fun->ptr != pred_or)
+		return 0;
+
+	prof = (struct combinator_profile *)fun->arg[2].value;
+	if (prof == NULL)
+		return 0;
+
+	first = READ_ONCE(prof->order);
+
+	return snprintf(buffer, size, "order:[%d,%d] swaps:%d ", first, !first, atomic_read(&prof->swaps));
+}
+
+
 struct pfq_function_descr combinator_functions[] = {
 
-        { "or",    "(SkBuff -> Bool) -> (SkBuff -> Bool) -> SkBuff -> Bool",    or  },
-        { "and",   "(SkBuff -> Bool) -> (SkBuff -> Bool) -> SkBuff -> Bool",    and },
+        { "or",    "(SkBuff -> Bool) -> (SkBuff -> Bool) -> SkBuff -> Bool",    pred_or,  combinator_init, combinator_fini },
+        { "and",   "(SkBuff -> Bool) -> (SkBuff -> Bool) -> SkBuff -> Bool",    pred_and, combinator_init, combinator_fini },
         { "xor",   "(SkBuff -> Bool) -> (SkBuff -> Bool) -> SkBuff -> Bool",    xor },
         { "not",   "(SkBuff -> Bool) -> SkBuff -> Bool",			not },
 
@@ -26,6 +26,10 @@
 
 #include "predicate.h"
 
+/* profiled and/or: prints the evaluation order, if any */
+
+extern int pfq_combinator_snprintf(char *buffer, size_t size, struct pfq_functional const *fun);
+
 static inline
 bool not(arguments_t args, SkBuff b)
 {
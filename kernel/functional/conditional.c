@@ -21,13 +21,154 @@
  *
  ****************************************************************/
 
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/slab.h>
+
 #include "conditional.h"
 
+
+/* switch: the property is evaluated once, and the case is selected by means
+ * of a jump table (dense keys) or an open-addressing hash table (sparse keys).
+ */
+
+#define Q_SWITCH_DENSE_MAX	1024
+
+struct switch_entry
+{
+	uint64_t		key;
+	struct pfq_functional	*fun;
+};
+
+struct switch_table
+{
+	uint64_t		base;
+	size_t			size;		/* dense: span of keys, sparse: power of 2 */
+	bool			dense;
+	struct pfq_functional	*fallback;
+	struct switch_entry	slot[];
+};
+
+
+static inline struct pfq_functional *
+switch_lookup(struct switch_table const *tab, uint64_t key)
+{
+	size_t n;
+
+	if (tab->dense) {
+		if (key - tab->base < tab->size && tab->slot[key - tab->base].fun)
+			return tab->slot[key - tab->base].fun;
+		return tab->fallback;
+	}
+
+	for(n = hash_64(key, ilog2(tab->size)); tab->slot[n].fun; n = (n + 1) & (tab->size - 1))
+	{
+		if (tab->slot[n].key == key)
+			return tab->slot[n].fun;
+	}
+
+	return tab->fallback;
+}
+
+
+static int
+switch_init(arguments_t args)
+{
+	uint64_t *key = GET_ARRAY_1(uint64_t, args);
+	function_t *fun = GET_ARRAY_2(function_t, args);
+	function_t fallback = GET_ARG_3(function_t, args);
+	size_t nkey = LEN_ARRAY_1(args), n;
+	struct switch_table *tab;
+	uint64_t lo = ~0ULL, hi = 0;
+	size_t size;
+	bool dense;
+
+	if (nkey != LEN_ARRAY_2(args)) {
+		printk(KERN_INFO "[PFQ|init] switch: %zu keys for %zu functions!\n", nkey, LEN_ARRAY_2(args));
+		return -EINVAL;
+	}
+
+	for(n = 0; n < nkey; n++)
+	{
+		lo = min(lo, key[n]);
+		hi = max(hi, key[n]);
+	}
+
+	dense = nkey && (hi - lo) < Q_SWITCH_DENSE_MAX;
+	size  = dense ? (size_t)(hi - lo) + 1 : roundup_pow_of_two(max_t(size_t, nkey * 2, 2));
+
+	tab = kzalloc(sizeof(struct switch_table) + size * sizeof(struct switch_entry), GFP_KERNEL);
+	if (tab == NULL) {
+		printk(KERN_INFO "[PFQ|init] switch: out of memory!\n");
+		return -ENOMEM;
+	}
+
+	tab->base = dense ? lo : 0;
+	tab->size = size;
+	tab->dense = dense;
+	tab->fallback = fallback.fun;
+
+	/* in case of duplicate keys, the first one wins */
+
+	for(n = 0; n < nkey; n++)
+	{
+		struct switch_entry *e;
+
+		if (dense)
+			e = &tab->slot[key[n] - lo];
+		else {
+			size_t h = hash_64(key[n], ilog2(size));
+			while (tab->slot[h].fun && tab->slot[h].key != key[n])
+				h = (h + 1) & (size - 1);
+			e = &tab->slot[h];
+		}
+
+		if (e->fun == NULL) {
+			e->key = key[n];
+			e->fun = fun[n].fun;
+		}
+	}
+
+	SET_ARG_4(args, tab);
+
+	pr_devel("[PFQ|init] switch: %zu cases, %s table of %zu entries\n", nkey, dense ? "dense" : "hashed", size);
+	return 0;
+}
+
+
+static int
+switch_fini(arguments_t args)
+{
+	struct switch_table *tab = GET_ARG_4(struct switch_table *, args);
+
+	kfree(tab);
+
+	pr_devel("[PFQ|fini] switch: table freed@%p\n", tab);
+	return 0;
+}
+
+
+static Action_SkBuff
+switch_on(arguments_t args, SkBuff b)
+{
+	property_t prop = GET_ARG_0(property_t, args);
+	struct switch_table *tab = GET_ARG_4(struct switch_table *, args);
+	uint64_t ret = EVAL_PROPERTY(prop, b);
+	function_t fun;
+
+	fun.fun = IS_JUST(ret) ? switch_lookup(tab, FROM_JUST(ret)) : tab->fallback;
+
+	return EVAL_FUNCTION(fun, b);
+}
+
+
 struct pfq_function_descr high_order_functions[] = {
 
         { "conditional", "(SkBuff -> Bool) -> (SkBuff -> Action SkBuff) -> (SkBuff -> Action SkBuff) -> SkBuff -> Action SkBuff ",  conditional  },
         { "when",        "(SkBuff -> Bool) -> (SkBuff -> Action SkBuff) -> SkBuff -> Action SkBuff",	when	},
         { "unless",      "(SkBuff -> Bool) -> (SkBuff -> Action SkBuff) -> SkBuff -> Action SkBuff",	unless	},
+        { "switch",      "(SkBuff -> Word64) -> [Word64] -> [SkBuff -> Action SkBuff] -> (SkBuff -> Action SkBuff) -> SkBuff -> Action SkBuff",
+								switch_on, switch_init, switch_fini },
 
         { NULL }};
 
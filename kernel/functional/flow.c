@@ -0,0 +1,391 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/jiffies.h>
+#include <linux/jhash.h>
+#include <linux/vmalloc.h>
+
+#include <pf_q-module.h>
+#include <pf_q-global.h>
+#include <pf_q-group.h>
+#include <pf_q-table.h>
+
+#include "headers.h"
+
+
+/****************************************************************
+ *	per-cpu flow tables (set-associative, bounded memory)
+ ****************************************************************/
+
+#define CUTOFF_BUCKETS		1024
+#define CUTOFF_WAYS		4
+#define CUTOFF_IDLE_TIMEOUT	(30 * HZ)
+
+
+struct cutoff_entry
+{
+	__be32		saddr;
+	__be32		daddr;
+	__be16		sport;
+	__be16		dport;
+	uint32_t	proto;
+	uint32_t	bytes;
+	unsigned long	last;		/* jiffies of the last packet, 0 = free */
+};
+
+
+struct cutoff_table
+{
+	struct cutoff_entry bucket[CUTOFF_BUCKETS][CUTOFF_WAYS];
+};
+
+
+/* the tables (128K) exceed the alloc_percpu limit: they are vmalloc'd on the
+ * node of each cpu, and reached through a per-cpu pointer */
+
+static void
+cutoff_free(struct cutoff_table * __percpu *table)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		vfree(*per_cpu_ptr(table, cpu));
+
+	free_percpu(table);
+}
+
+
+static struct cutoff_table * __percpu *
+cutoff_alloc(void)
+{
+	struct cutoff_table * __percpu *table;
+	int cpu;
+
+	table = alloc_percpu(struct cutoff_table *);
+	if (!table)
+		return NULL;
+
+	for_each_possible_cpu(cpu)
+	{
+		struct cutoff_table *t = vzalloc_node(sizeof(struct cutoff_table), cpu_to_node(cpu));
+		if (!t) {
+			cutoff_free(table);
+			return NULL;
+		}
+		*per_cpu_ptr(table, cpu) = t;
+	}
+
+	return table;
+}
+
+
+/* flow key in canonical form (lower endpoint first), so that both directions share the entry */
+
+static inline bool
+flow_key(SkBuff b, struct cutoff_entry *key)
+{
+	struct iphdr _iph;
+	const struct iphdr *ip;
+
+	struct udphdr _udp;
+	const struct udphdr *udp;
+
+	if (eth_hdr(b.skb)->h_proto != __constant_htons(ETH_P_IP))
+		return false;
+
+	ip = skb_header_pointer(b.skb, b.skb->mac_len, sizeof(_iph), &_iph);
+	if (ip == NULL)
+		return false;
+
+	if (ip->protocol != IPPROTO_UDP &&
+	    ip->protocol != IPPROTO_TCP)
+		return false;
+
+	if (ip->frag_off & __constant_htons(IP_OFFSET))
+		return false;
+
+	udp = skb_header_pointer(b.skb, b.skb->mac_len + (ip->ihl<<2), sizeof(_udp), &_udp);
+	if (udp == NULL)
+		return false;
+
+	if (ip->saddr < ip->daddr || (ip->saddr == ip->daddr && udp->source <= udp->dest)) {
+		key->saddr = ip->saddr; key->sport = udp->source;
+		key->daddr = ip->daddr; key->dport = udp->dest;
+	}
+	else {
+		key->saddr = ip->daddr; key->sport = udp->dest;
+		key->daddr = ip->saddr; key->dport = udp->source;
+	}
+
+	key->proto = ip->protocol;
+	return true;
+}
+
+
+static inline bool
+flow_key_equal(struct cutoff_entry const *a, struct cutoff_entry const *b)
+{
+	return  a->saddr == b->saddr && a->daddr == b->daddr &&
+		a->sport == b->sport && a->dport == b->dport &&
+		a->proto == b->proto;
+}
+
+
+static inline struct cutoff_entry *
+cutoff_lookup(struct cutoff_table *table, struct cutoff_entry const *key, unsigned long now, int cpu)
+{
+	struct cutoff_entry *bucket, *victim;
+	uint32_t h;
+	int n;
+
+	h = jhash_3words((__force u32)key->saddr, (__force u32)key->daddr,
+			 ((__force u32)key->sport << 16) | (__force u32)key->dport, key->proto);
+
+	bucket = table->bucket[h & (CUTOFF_BUCKETS-1)];
+	victim = &bucket[0];
+
+	for(n = 0; n < CUTOFF_WAYS; n++)
+	{
+		struct cutoff_entry *e = &bucket[n];
+
+		if (e->last && flow_key_equal(e, key)) {
+
+			if (time_after(now, e->last + CUTOFF_IDLE_TIMEOUT)) {
+				__sparse_inc(&memory_stats.flow_expire, cpu);
+				e->bytes = 0;
+			}
+			return e;
+		}
+
+		if (victim->last && (!e->last || time_before(e->last, victim->last)))
+			victim = e;
+	}
+
+	/* replace a free, an idle or (under pressure) the least recently used entry */
+
+	if (victim->last) {
+		if (time_after(now, victim->last + CUTOFF_IDLE_TIMEOUT))
+			__sparse_inc(&memory_stats.flow_expire, cpu);
+		else
+			__sparse_inc(&memory_stats.flow_evict, cpu);
+	}
+
+	__sparse_inc(&memory_stats.flow_insert, cpu);
+
+	*victim = *key;
+	victim->bytes = 0;
+	return victim;
+}
+
+
+static int
+cutoff_init(arguments_t args)
+{
+	const int limit = GET_ARG_0(int, args);
+	struct cutoff_table * __percpu *table;
+
+	if (limit < 0) {
+		printk(KERN_INFO "[PFQ|init] cutoff: invalid threshold (%d bytes)!\n", limit);
+		return -EPERM;
+	}
+
+	table = cutoff_alloc();
+	if (!table) {
+		printk(KERN_INFO "[PFQ|init] cutoff: out of memory!\n");
+		return -ENOMEM;
+	}
+
+	SET_ARG_1(args, table);
+
+	pr_devel("[PFQ|init] cutoff: %d bytes, per-cpu table@%p (%d entries, %zu bytes)\n",
+		 limit, table, CUTOFF_BUCKETS * CUTOFF_WAYS, sizeof(struct cutoff_table));
+	return 0;
+}
+
+
+static int
+cutoff_fini(arguments_t args)
+{
+	struct cutoff_table * __percpu *table = GET_ARG_1(struct cutoff_table * __percpu *, args);
+
+	cutoff_free(table);
+
+	pr_devel("[PFQ|fini] cutoff: per-cpu table freed@%p\n", table);
+	return 0;
+}
+
+
+static Action_SkBuff
+cutoff(arguments_t args, SkBuff b)
+{
+	const uint32_t limit = GET_ARG_0(int, args);
+	struct cutoff_table *table = *this_cpu_ptr(GET_ARG_1(struct cutoff_table * __percpu *, args));
+	unsigned long now = jiffies | 1;
+	struct cutoff_entry key, *e;
+
+	if (!flow_key(b, &key))
+		return Pass(b);
+
+	e = cutoff_lookup(table, &key, now, smp_processor_id());
+
+	e->last = now;
+
+	if (e->bytes >= limit)
+		return Drop(b);
+
+	e->bytes += b.skb->len;
+	return Pass(b);
+}
+
+
+
+/****************************************************************
+ *	exact-match tables (per-group, updated via Q_SO_GROUP_TABLE)
+ ****************************************************************/
+
+static int
+table_init(arguments_t args)
+{
+	const int idx = GET_ARG_0(int, args);
+
+	if (idx < 0 || idx >= Q_MAX_GROUP_TABLES) {
+		printk(KERN_INFO "[PFQ|init] table: invalid index %d!\n", idx);
+		return -EPERM;
+	}
+
+	return 0;
+}
+
+
+/* lookup the packet in the table: addresses (source first) or 5-tuple in both directions */
+
+static struct pfq_table_entry *
+table_lookup(struct pfq_table *table, SkBuff b)
+{
+	struct pfq_table_entry key, *e;
+
+	struct iphdr _iph;
+	const struct iphdr *ip;
+
+	struct udphdr _udp;
+	const struct udphdr *udp;
+
+	if (eth_hdr(b.skb)->h_proto != __constant_htons(ETH_P_IP))
+		return NULL;
+
+	ip = skb_header_pointer(b.skb, b.skb->mac_len, sizeof(_iph), &_iph);
+	if (ip == NULL)
+		return NULL;
+
+	memset(&key, 0, sizeof(key));
+
+	if (table->type == Q_TABLE_KEY_ADDR) {
+
+		key.saddr = (__force uint32_t)ip->saddr;
+		if ((e = pfq_table_lookup(table, &key)))
+			return e;
+
+		key.saddr = (__force uint32_t)ip->daddr;
+		return pfq_table_lookup(table, &key);
+	}
+
+	if (ip->protocol != IPPROTO_UDP &&
+	    ip->protocol != IPPROTO_TCP)
+		return NULL;
+
+	if (ip->frag_off & __constant_htons(IP_OFFSET))
+		return NULL;
+
+	udp = skb_header_pointer(b.skb, b.skb->mac_len + (ip->ihl<<2), sizeof(_udp), &_udp);
+	if (udp == NULL)
+		return NULL;
+
+	key.proto = ip->protocol;
+
+	key.saddr = (__force uint32_t)ip->saddr; key.sport = (__force uint16_t)udp->source;
+	key.daddr = (__force uint32_t)ip->daddr; key.dport = (__force uint16_t)udp->dest;
+
+	if ((e = pfq_table_lookup(table, &key)))
+		return e;
+
+	key.saddr = (__force uint32_t)ip->daddr; key.sport = (__force uint16_t)udp->dest;
+	key.daddr = (__force uint32_t)ip->saddr; key.dport = (__force uint16_t)udp->source;
+
+	return pfq_table_lookup(table, &key);
+}
+
+
+static bool
+in_table(arguments_t args, SkBuff b)
+{
+	const int idx = GET_ARG_0(int, args);
+	struct pfq_group *g = PFQ_CB(b.skb)->monad->group;
+	struct pfq_table *table;
+	bool ret = false;
+
+	rcu_read_lock();
+
+	table = rcu_dereference(g->table[idx]);
+	if (table)
+		ret = table_lookup(table, b) != NULL;
+
+	rcu_read_unlock();
+	return ret;
+}
+
+
+static Action_SkBuff
+steer_table(arguments_t args, SkBuff b)
+{
+	const int idx = GET_ARG_0(int, args);
+	struct pfq_group *g = PFQ_CB(b.skb)->monad->group;
+	struct pfq_table_entry *e;
+	struct pfq_table *table;
+	uint32_t value;
+
+	rcu_read_lock();
+
+	table = rcu_dereference(g->table[idx]);
+	if (table == NULL || (e = table_lookup(table, b)) == NULL) {
+		rcu_read_unlock();
+		return Drop(b);
+	}
+
+	value = e->value;
+
+	rcu_read_unlock();
+	return Steering(b, value);
+}
+
+
+struct pfq_function_descr flow_functions[] = {
+
+	{ "cutoff",	 "CInt -> SkBuff -> Action SkBuff",	cutoff,	     cutoff_init, cutoff_fini },
+	{ "in_table",	 "CInt -> SkBuff -> Bool",		in_table,    table_init  },
+	{ "steer_table", "CInt -> SkBuff -> Action SkBuff",	steer_table, table_init  },
+	{ NULL }};
+
@@ -27,6 +27,7 @@
 
 #include <pf_q-module.h>
 #include <pf_q-sparse.h>
+#include <pf_q-sketch.h>
 
 #include "headers.h"
 #include "misc.h"
@@ -73,6 +74,117 @@ dec_counter(arguments_t args, SkBuff b)
 }
 
 
+static inline void
+sketch_account(struct pfq_sketch *sk, SkBuff b, uint64_t key, uint64_t aux)
+{
+	/* the first instance evaluated by the group is the one exported through getsockopt:
+	 * the others (e.g. the sketch of a new computation, until the old one is released)
+	 * retry to attach on the next packets */
+
+	if (unlikely(sk->group == NULL)) {
+		struct pfq_group *g = PFQ_CB(b.skb)->monad->group;
+		if (atomic_long_read(&g->sketch) == 0L &&
+		    atomic_long_cmpxchg(&g->sketch, 0L, (long)sk) == 0L)
+			sk->group = g;
+	}
+
+	pfq_sketch_update(pfq_sketch_this_cpu(sk), key, aux);
+}
+
+
+static Action_SkBuff
+heavy_hitter(arguments_t args, SkBuff b)
+{
+	const int type = GET_ARG_0(int, args);
+	struct pfq_sketch *sk = GET_ARG_1(struct pfq_sketch *, args);
+	uint64_t key, aux = 0;
+
+	struct iphdr _iph;
+	const struct iphdr *ip;
+
+	if (eth_hdr(b.skb)->h_proto != __constant_htons(ETH_P_IP))
+		return Pass(b);
+
+	ip = skb_header_pointer(b.skb, b.skb->mac_len, sizeof(_iph), &_iph);
+	if (ip == NULL)
+		return Pass(b);
+
+	switch(type)
+	{
+	case Q_HH_KEY_SRC: {
+		key = ip->saddr;
+	} break;
+	case Q_HH_KEY_DST: {
+		key = ip->daddr;
+	} break;
+	default: {
+		key = ((uint64_t)ip->saddr << 32) | ip->daddr;
+		aux = (uint64_t)ip->protocol << 32;
+
+		if ((ip->protocol == IPPROTO_UDP || ip->protocol == IPPROTO_TCP) &&
+		    !(ip->frag_off & __constant_htons(IP_OFFSET))) {
+
+			struct udphdr _udph; const struct udphdr *udp;
+			udp = skb_header_pointer(b.skb, b.skb->mac_len + (ip->ihl<<2), sizeof(struct udphdr), &_udph);
+			if (udp)
+				aux |= ((uint64_t)ntohs(udp->source) << 16) | ntohs(udp->dest);
+		}
+	}
+	}
+
+	sketch_account(sk, b, key, aux);
+	return Pass(b);
+}
+
+
+static Action_SkBuff
+heavy_hitter_by(arguments_t args, SkBuff b)
+{
+	property_t p = GET_ARG_0(property_t, args);
+	struct pfq_sketch *sk = GET_ARG_1(struct pfq_sketch *, args);
+	uint64_t ret;
+
+	ret = EVAL_PROPERTY(p, b);
+	if (IS_JUST(ret))
+		sketch_account(sk, b, FROM_JUST(ret), 0);
+
+	return Pass(b);
+}
+
+
+static int
+heavy_hitter_init(arguments_t args)
+{
+	struct pfq_sketch *sk = pfq_sketch_alloc();
+	if (!sk) {
+		printk(KERN_INFO "[PFQ|init] heavy_hitter: out of memory!\n");
+		return -ENOMEM;
+	}
+
+	SET_ARG_1(args, sk);
+
+	pr_devel("[PFQ|init] heavy_hitter@%p: count-min %dx%d, top-%d.\n", sk, Q_SKETCH_DEPTH, Q_SKETCH_WIDTH, Q_MAX_HEAVY_HITTERS);
+	return 0;
+}
+
+
+static int
+heavy_hitter_fini(arguments_t args)
+{
+	struct pfq_sketch *sk = GET_ARG_1(struct pfq_sketch *, args);
+
+	/* called after the grace period, with the group semaphore held */
+
+	if (sk->group)
+		atomic_long_cmpxchg(&sk->group->sketch, (long)sk, 0L);
+
+	pfq_sketch_free(sk);
+
+	pr_devel("[PFQ|fini] heavy_hitter@%p: memory freed!\n", sk);
+	return 0;
+}
+
+
 static Action_SkBuff
 crc16_sum(arguments_t args, SkBuff b)
 {
@@ -470,6 +582,9 @@ struct pfq_function_descr misc_functions[] = {
         { "dec",	"CInt    -> SkBuff -> Action SkBuff",	dec_counter	},
 	{ "mark",	"Word32  -> SkBuff -> Action SkBuff",	mark		},
 
+	{ "heavy_hitter",    "CInt -> SkBuff -> Action SkBuff",			heavy_hitter,	 heavy_hitter_init, heavy_hitter_fini },
+	{ "heavy_hitter_by", "(SkBuff -> Word64) -> SkBuff -> Action SkBuff",	heavy_hitter_by, heavy_hitter_init, heavy_hitter_fini },
+
         { "crc16",	"SkBuff -> Action SkBuff",		crc16_sum	},
         { "log_msg",	"String -> SkBuff -> Action SkBuff",	log_msg		},
         { "log_buff",   "SkBuff -> Action SkBuff",		log_buff	},
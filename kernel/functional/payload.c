@@ -0,0 +1,401 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/string.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+
+#include <pf_q-module.h>
+
+
+/*
+ * Multi-pattern payload matcher: Aho-Corasick automaton built at init time and
+ * compiled into a DFA (failure transitions resolved), with the alphabet reduced to
+ * the bytes that appear in the patterns. The scan is a table lookup per byte.
+ */
+
+#define Q_PAYLOAD_MAX_PATTERNS		256
+#define Q_PAYLOAD_MAX_STATES		65535
+#define Q_PAYLOAD_CHUNK			256
+
+struct payload_dfa
+{
+	u8		cls[256];	/* byte -> class (0 = byte not in any pattern) */
+	int		ncls;
+	int		nstates;
+	int16_t		*out;		/* state -> index of the first pattern recognized, -1 if none */
+	u16		*delta;		/* state * ncls + class -> next state */
+};
+
+
+static void
+payload_dfa_free(struct payload_dfa *dfa)
+{
+	if (dfa) {
+		vfree(dfa->delta);
+		kfree(dfa->out);
+		kfree(dfa);
+	}
+}
+
+
+static struct payload_dfa *
+payload_dfa_build(const char **pattern, size_t npat)
+{
+	struct payload_dfa *dfa;
+	u16 *fail = NULL, *queue = NULL;
+	size_t i, total = 1;
+	int s, c, head, tail;
+
+	if (npat == 0 || npat > Q_PAYLOAD_MAX_PATTERNS) {
+		printk(KERN_INFO "[PFQ|init] payload: %zu patterns (max %d)!\n", npat, Q_PAYLOAD_MAX_PATTERNS);
+		return NULL;
+	}
+
+	dfa = kzalloc(sizeof(struct payload_dfa), GFP_KERNEL);
+	if (dfa == NULL)
+		return NULL;
+
+	/* alphabet reduction */
+
+	dfa->ncls = 1;
+
+	for(i = 0; i < npat; i++)
+	{
+		const u8 *p = (const u8 *)pattern[i];
+
+		if (*p == '\0') {
+			printk(KERN_INFO "[PFQ|init] payload: empty pattern %zu!\n", i);
+			goto err;
+		}
+
+		for(; *p; p++, total++)
+		{
+			if (dfa->cls[*p] == 0)
+				dfa->cls[*p] = dfa->ncls++;
+		}
+	}
+
+	if (total > Q_PAYLOAD_MAX_STATES) {
+		printk(KERN_INFO "[PFQ|init] payload: patterns too long (%zu states)!\n", total);
+		goto err;
+	}
+
+	dfa->delta = vmalloc(total * dfa->ncls * sizeof(u16));
+	dfa->out   = kmalloc(total * sizeof(int16_t), GFP_KERNEL);
+	fail	   = kmalloc(total * sizeof(u16), GFP_KERNEL);
+	queue	   = kmalloc(total * sizeof(u16), GFP_KERNEL);
+
+	if (!dfa->delta || !dfa->out || !fail || !queue)
+		goto err;
+
+	/* trie: 0xffff marks a missing transition */
+
+	memset(dfa->delta, 0xff, total * dfa->ncls * sizeof(u16));
+	memset(dfa->out, 0xff, total * sizeof(int16_t));
+
+	dfa->nstates = 1;
+
+	for(i = 0; i < npat; i++)
+	{
+		const u8 *p = (const u8 *)pattern[i];
+
+		for(s = 0; *p; p++)
+		{
+			u16 *next = &dfa->delta[s * dfa->ncls + dfa->cls[*p]];
+			if (*next == 0xffff)
+				*next = dfa->nstates++;
+			s = *next;
+		}
+
+		if (dfa->out[s] < 0)
+			dfa->out[s] = i;
+	}
+
+	/* breadth-first: failure links, resolved into the transitions */
+
+	head = tail = 0;
+
+	for(c = 0; c < dfa->ncls; c++)
+	{
+		u16 *next = &dfa->delta[c];
+		if (*next == 0xffff)
+			*next = 0;
+		else {
+			fail[*next] = 0;
+			queue[tail++] = *next;
+		}
+	}
+
+	while (head < tail)
+	{
+		s = queue[head++];
+
+		/* a state recognizes the patterns of its failure state as well */
+
+		if (dfa->out[fail[s]] >= 0 && (dfa->out[s] < 0 || dfa->out[fail[s]] < dfa->out[s]))
+			dfa->out[s] = dfa->out[fail[s]];
+
+		for(c = 0; c < dfa->ncls; c++)
+		{
+			u16 *next = &dfa->delta[s * dfa->ncls + c];
+			u16 f = dfa->delta[fail[s] * dfa->ncls + c];
+
+			if (*next == 0xffff)
+				*next = f;
+			else {
+				fail[*next] = f;
+				queue[tail++] = *next;
+			}
+		}
+	}
+
+	kfree(fail);
+	kfree(queue);
+
+	pr_devel("[PFQ|init] payload: %zu patterns, %d states, %d classes.\n", npat, dfa->nstates, dfa->ncls);
+	return dfa;
+err:
+	kfree(fail);
+	kfree(queue);
+	payload_dfa_free(dfa);
+	return NULL;
+}
+
+
+/* offset of the L4 payload (L3 payload for non-first fragments and other protocols) */
+
+static int
+payload_offset(struct sk_buff *skb)
+{
+	int off = skb->mac_len;
+	u8 proto;
+
+	if (eth_hdr(skb)->h_proto == __constant_htons(ETH_P_IP)) {
+
+		struct iphdr _iph;
+		const struct iphdr *ip;
+
+		ip = skb_header_pointer(skb, off, sizeof(_iph), &_iph);
+		if (ip == NULL)
+			return -1;
+
+		off += ip->ihl<<2;
+
+		if (ip->frag_off & __constant_htons(IP_OFFSET))
+			return off;
+
+		proto = ip->protocol;
+	}
+	else if (eth_hdr(skb)->h_proto == __constant_htons(ETH_P_IPV6)) {
+
+		struct ipv6hdr _ip6h;
+		const struct ipv6hdr *ip6;
+
+		ip6 = skb_header_pointer(skb, off, sizeof(_ip6h), &_ip6h);
+		if (ip6 == NULL)
+			return -1;
+
+		off += sizeof(struct ipv6hdr);
+		proto = ip6->nexthdr;
+	}
+	else
+		return off;
+
+	if (proto == IPPROTO_TCP) {
+
+		struct tcphdr _tcp;
+		const struct tcphdr *tcp;
+
+		tcp = skb_header_pointer(skb, off, sizeof(_tcp), &_tcp);
+		if (tcp == NULL)
+			return -1;
+
+		return off + (tcp->doff<<2);
+	}
+
+	if (proto == IPPROTO_UDP)
+		return off + sizeof(struct udphdr);
+
+	return off;
+}
+
+
+/* return the index of the first pattern found in the payload, -1 if none */
+
+static int
+payload_scan(struct payload_dfa const *dfa, struct sk_buff *skb)
+{
+	u8 buffer[Q_PAYLOAD_CHUNK];
+	int off, s = 0;
+
+	off = payload_offset(skb);
+	if (off < 0)
+		return -1;
+
+	while (off < skb->len)
+	{
+		int i, len = min_t(int, skb->len - off, Q_PAYLOAD_CHUNK);
+		const u8 *p;
+
+		/* no copy for the linear part of the skb */
+
+		p = skb_header_pointer(skb, off, len, buffer);
+		if (p == NULL)
+			return -1;
+
+		for(i = 0; i < len; i++)
+		{
+			s = dfa->delta[s * dfa->ncls + dfa->cls[p[i]]];
+			if (unlikely(dfa->out[s] >= 0))
+				return dfa->out[s];
+		}
+
+		off += len;
+	}
+
+	return -1;
+}
+
+
+static int
+payload_init(arguments_t args)
+{
+	struct payload_dfa *dfa;
+
+	dfa = payload_dfa_build(GET_ARRAY_0(const char *, args), LEN_ARRAY_0(args));
+	if (dfa == NULL) {
+		printk(KERN_INFO "[PFQ|init] payload: could not build the automaton!\n");
+		return -ENOMEM;
+	}
+
+	SET_ARG_1(args, dfa);
+	return 0;
+}
+
+
+static int
+payload_fini(arguments_t args)
+{
+	struct payload_dfa *dfa = GET_ARG_1(struct payload_dfa *, args);
+
+	payload_dfa_free(dfa);
+
+	pr_devel("[PFQ|fini] payload: automaton freed@%p\n", dfa);
+	return 0;
+}
+
+
+static int
+payload_counter_init(arguments_t args)
+{
+	const int idx = GET_ARG_0(int, args);
+	struct payload_dfa *dfa;
+
+	if (idx < 0 || idx >= Q_MAX_COUNTERS) {
+		printk(KERN_INFO "[PFQ|init] payload_counter: bad counter index %d!\n", idx);
+		return -EINVAL;
+	}
+
+	dfa = payload_dfa_build(GET_ARRAY_1(const char *, args), LEN_ARRAY_1(args));
+	if (dfa == NULL) {
+		printk(KERN_INFO "[PFQ|init] payload_counter: could not build the automaton!\n");
+		return -ENOMEM;
+	}
+
+	SET_ARG_2(args, dfa);
+	return 0;
+}
+
+
+static int
+payload_counter_fini(arguments_t args)
+{
+	struct payload_dfa *dfa = GET_ARG_2(struct payload_dfa *, args);
+
+	payload_dfa_free(dfa);
+
+	pr_devel("[PFQ|fini] payload_counter: automaton freed@%p\n", dfa);
+	return 0;
+}
+
+
+static bool
+payload_match(arguments_t args, SkBuff b)
+{
+	struct payload_dfa *dfa = GET_ARG_1(struct payload_dfa *, args);
+	return payload_scan(dfa, b.skb) >= 0;
+}
+
+
+static Action_SkBuff
+steering_payload(arguments_t args, SkBuff b)
+{
+	struct payload_dfa *dfa = GET_ARG_1(struct payload_dfa *, args);
+	int n = payload_scan(dfa, b.skb);
+
+	/* the packets that match the same pattern go to the same socket */
+
+	if (n < 0)
+		return Drop(b);
+
+	return Steering(b, n);
+}
+
+
+static Action_SkBuff
+payload_counter(arguments_t args, SkBuff b)
+{
+	const int idx = GET_ARG_0(int, args);
+	struct payload_dfa *dfa = GET_ARG_2(struct payload_dfa *, args);
+	sparse_counter_t *ctr;
+	int n;
+
+	n = payload_scan(dfa, b.skb);
+	if (n < 0)
+		return Drop(b);
+
+	/* one counter per pattern, starting from idx */
+
+	ctr = get_counter(b, idx + n);
+	if (ctr)
+		sparse_inc(ctr);
+
+	return Pass(b);
+}
+
+
+struct pfq_function_descr payload_functions[] = {
+
+	{ "payload_match",	"[String] -> SkBuff -> Bool",			payload_match,	   payload_init,	 payload_fini },
+	{ "steer_payload",	"[String] -> SkBuff -> Action SkBuff",		steering_payload,  payload_init,	 payload_fini },
+	{ "payload_counter",	"CInt -> [String] -> SkBuff -> Action SkBuff",	payload_counter,   payload_counter_init, payload_counter_fini },
+
+	{ NULL }};
@@ -0,0 +1,449 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/vmalloc.h>
+#include <linux/sort.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+
+#include <pf_q-module.h>
+
+
+/****************************************************************
+ *	multibit trie (strides 16-8-8...), leaf-pushed:
+ *	a lookup takes at most 3 memory accesses for IPv4, 15 for IPv6,
+ *	independently of the number of prefixes.
+ ****************************************************************/
+
+#define LPM_ROOT_SIZE		65536
+#define LPM_GROUP_SIZE		256
+
+#define LPM_CHILD		0x80000000	/* entry is the index of a child group */
+
+/* entry: 0 = no match, LPM_CHILD|n = child group n, otherwise index of the prefix + 1 */
+
+struct lpm_trie
+{
+	uint32_t	*node;		/* root (64K entries) followed by groups of 256 entries */
+	size_t		groups;
+	size_t		max_groups;
+	size_t		nprefix;
+	int		len;		/* key length in bytes: 4 or 16 */
+};
+
+
+struct lpm_prefix
+{
+	uint8_t		addr[16];	/* network byte order */
+	int		plen;
+	uint32_t	value;
+};
+
+
+static inline uint32_t *
+lpm_group(struct lpm_trie *t, uint32_t e)
+{
+	return t->node + LPM_ROOT_SIZE + (size_t)(e & ~LPM_CHILD) * LPM_GROUP_SIZE;
+}
+
+
+static inline uint32_t
+lpm_lookup(struct lpm_trie *t, const uint8_t *key)
+{
+	uint32_t e = t->node[(key[0] << 8) | key[1]];
+	int i;
+
+	for(i = 2; (e & LPM_CHILD) && i < t->len; i++)
+		e = lpm_group(t, e)[key[i]];
+
+	return e;
+}
+
+
+static int
+lpm_new_group(struct lpm_trie *t, uint32_t fill)
+{
+	uint32_t *g;
+	size_t n;
+	int i;
+
+	if (t->groups == t->max_groups) {
+
+		size_t max = t->max_groups ? t->max_groups * 2 : 64;
+		uint32_t *node = vmalloc((LPM_ROOT_SIZE + max * LPM_GROUP_SIZE) * sizeof(uint32_t));
+		if (!node)
+			return -ENOMEM;
+
+		memcpy(node, t->node, (LPM_ROOT_SIZE + t->groups * LPM_GROUP_SIZE) * sizeof(uint32_t));
+		vfree(t->node);
+
+		t->node = node;
+		t->max_groups = max;
+	}
+
+	n = t->groups++;
+
+	g = t->node + LPM_ROOT_SIZE + n * LPM_GROUP_SIZE;
+	for(i = 0; i < LPM_GROUP_SIZE; i++)
+		g[i] = fill;
+
+	return (int)n;
+}
+
+
+/* set an entry: a covered child group is overwritten recursively (prefixes are inserted in ascending length) */
+
+static void
+lpm_set(struct lpm_trie *t, uint32_t *e, uint32_t value)
+{
+	if (*e & LPM_CHILD) {
+		uint32_t *g = lpm_group(t, *e);
+		int i;
+		for(i = 0; i < LPM_GROUP_SIZE; i++)
+			lpm_set(t, &g[i], value);
+	}
+	else
+		*e = value;
+}
+
+
+/* child group of entry (by offset, since the node array can be reallocated) */
+
+static int
+lpm_child(struct lpm_trie *t, size_t off, size_t *child)
+{
+	uint32_t e = t->node[off];
+
+	if (!(e & LPM_CHILD)) {
+		int n = lpm_new_group(t, e);
+		if (n < 0)
+			return n;
+		e = t->node[off] = LPM_CHILD | n;
+	}
+
+	*child = LPM_ROOT_SIZE + (size_t)(e & ~LPM_CHILD) * LPM_GROUP_SIZE;
+	return 0;
+}
+
+
+static int
+lpm_insert(struct lpm_trie *t, struct lpm_prefix const *p)
+{
+	size_t off, first, count, j;
+	int i, rem, err;
+
+	if (p->plen <= 16) {
+		first = ((p->addr[0] << 8) | p->addr[1]) & ~((1UL << (16 - p->plen)) - 1) & 0xffff;
+		count = 1UL << (16 - p->plen);
+		off = 0;
+	}
+	else {
+		if ((err = lpm_child(t, (p->addr[0] << 8) | p->addr[1], &off)) < 0)
+			return err;
+
+		for(i = 2, rem = p->plen - 16; rem > 8; i++, rem -= 8)
+		{
+			if ((err = lpm_child(t, off + p->addr[i], &off)) < 0)
+				return err;
+		}
+
+		first = p->addr[i] & (0xff << (8 - rem)) & 0xff;
+		count = 1UL << (8 - rem);
+	}
+
+	for(j = first; j < first + count; j++)
+		lpm_set(t, &t->node[off + j], p->value);
+
+	return 0;
+}
+
+
+static int
+lpm_prefix_cmp(const void *a, const void *b)
+{
+	return ((struct lpm_prefix const *)a)->plen - ((struct lpm_prefix const *)b)->plen;
+}
+
+
+static struct lpm_trie *
+lpm_build(struct lpm_prefix *prefix, size_t n, int len)
+{
+	struct lpm_trie *t;
+	size_t i;
+
+	t = kzalloc(sizeof(struct lpm_trie), GFP_KERNEL);
+	if (!t)
+		return NULL;
+
+	t->len = len;
+	t->nprefix = n;
+	t->node = vzalloc(LPM_ROOT_SIZE * sizeof(uint32_t));
+	if (!t->node) {
+		kfree(t);
+		return NULL;
+	}
+
+	sort(prefix, n, sizeof(struct lpm_prefix), lpm_prefix_cmp, NULL);
+
+	for(i = 0; i < n; i++)
+	{
+		if (lpm_insert(t, &prefix[i]) < 0) {
+			vfree(t->node);
+			kfree(t);
+			return NULL;
+		}
+	}
+
+	return t;
+}
+
+
+static void
+lpm_free(struct lpm_trie *t)
+{
+	if (t) {
+		vfree(t->node);
+		kfree(t);
+	}
+}
+
+
+/****************************************************************
+ *	functions
+ ****************************************************************/
+
+static int
+prefixes_init(arguments_t args, int len)
+{
+	const int words = len / sizeof(uint32_t);
+	size_t i, n = LEN_ARRAY_1(args);
+	uint32_t *addrs = GET_ARRAY_0(uint32_t, args);
+	int *plen = GET_ARRAY_1(int, args);
+	struct lpm_prefix *prefix;
+	struct lpm_trie *trie;
+
+	if (LEN_ARRAY_0(args) != n * words) {
+		printk(KERN_INFO "[PFQ|init] prefixes: %zu addresses vs %zu prefix lengths!\n",
+		       LEN_ARRAY_0(args) / words, n);
+		return -EPERM;
+	}
+
+	prefix = vmalloc(max_t(size_t, n, 1) * sizeof(struct lpm_prefix));
+	if (!prefix) {
+		printk(KERN_INFO "[PFQ|init] prefixes: out of memory!\n");
+		return -ENOMEM;
+	}
+
+	for(i = 0; i < n; i++)
+	{
+		int w;
+
+		if (plen[i] < 0 || plen[i] > len * 8) {
+			printk(KERN_INFO "[PFQ|init] prefixes: invalid prefix length /%d!\n", plen[i]);
+			vfree(prefix);
+			return -EPERM;
+		}
+
+		/* IPv4 addresses are in network byte order, IPv6 words in host byte order (MSW first) */
+
+		memset(prefix[i].addr, 0, sizeof(prefix[i].addr));
+		for(w = 0; w < words; w++)
+		{
+			__be32 x = len == 4 ? (__force __be32)addrs[i] : htonl(addrs[i * words + w]);
+			memcpy(prefix[i].addr + w * 4, &x, 4);
+		}
+
+		prefix[i].plen  = plen[i];
+		prefix[i].value = i + 1;
+	}
+
+	trie = lpm_build(prefix, n, len);
+
+	vfree(prefix);
+
+	if (!trie) {
+		printk(KERN_INFO "[PFQ|init] prefixes: out of memory!\n");
+		return -ENOMEM;
+	}
+
+	SET_ARG_2(args, trie);
+
+	pr_devel("[PFQ|init] prefixes: trie@%p IPv%d, %zu prefixes, %zu groups (%zu bytes)\n",
+		 trie, len == 4 ? 4 : 6, n, trie->groups,
+		 (LPM_ROOT_SIZE + trie->max_groups * LPM_GROUP_SIZE) * sizeof(uint32_t));
+	return 0;
+}
+
+
+static int
+prefixes_init4(arguments_t args)
+{
+	return prefixes_init(args, 4);
+}
+
+static int
+prefixes_init6(arguments_t args)
+{
+	return prefixes_init(args, 16);
+}
+
+
+static int
+prefixes_fini(arguments_t args)
+{
+	struct lpm_trie *trie = GET_ARG_2(struct lpm_trie *, args);
+
+	lpm_free(trie);
+
+	pr_devel("[PFQ|fini] prefixes: trie@%p freed\n", trie);
+	return 0;
+}
+
+
+/* lookup both addresses: the smallest matching index (0 = no match) is symmetric w.r.t. the direction */
+
+#define Q_PREFIX_SRC	1
+#define Q_PREFIX_DST	2
+
+static inline uint32_t
+lookup_ip(arguments_t args, SkBuff b, int which)
+{
+	struct lpm_trie *trie = GET_ARG_2(struct lpm_trie *, args);
+	uint32_t s = 0, d = 0;
+
+	if (eth_hdr(b.skb)->h_proto == __constant_htons(ETH_P_IP))
+	{
+		struct iphdr _iph;
+		const struct iphdr *ip;
+
+		ip = skb_header_pointer(b.skb, b.skb->mac_len, sizeof(_iph), &_iph);
+		if (ip == NULL)
+			return 0;
+
+		if (which & Q_PREFIX_SRC)
+			s = lpm_lookup(trie, (const uint8_t *)&ip->saddr);
+		if (which & Q_PREFIX_DST)
+			d = lpm_lookup(trie, (const uint8_t *)&ip->daddr);
+	}
+
+	return s && d ? min(s, d) : s | d;
+}
+
+
+static inline uint32_t
+lookup_ip6(arguments_t args, SkBuff b, int which)
+{
+	struct lpm_trie *trie = GET_ARG_2(struct lpm_trie *, args);
+	uint32_t s = 0, d = 0;
+
+	if (eth_hdr(b.skb)->h_proto == __constant_htons(ETH_P_IPV6))
+	{
+		struct ipv6hdr _ip6h;
+		const struct ipv6hdr *ip6;
+
+		ip6 = skb_header_pointer(b.skb, b.skb->mac_len, sizeof(_ip6h), &_ip6h);
+		if (ip6 == NULL)
+			return 0;
+
+		if (which & Q_PREFIX_SRC)
+			s = lpm_lookup(trie, ip6->saddr.in6_u.u6_addr8);
+		if (which & Q_PREFIX_DST)
+			d = lpm_lookup(trie, ip6->daddr.in6_u.u6_addr8);
+	}
+
+	return s && d ? min(s, d) : s | d;
+}
+
+
+static bool
+in_prefixes(arguments_t args, SkBuff b)
+{
+	return lookup_ip(args, b, Q_PREFIX_SRC|Q_PREFIX_DST) != 0;
+}
+
+static bool
+in_src_prefixes(arguments_t args, SkBuff b)
+{
+	return lookup_ip(args, b, Q_PREFIX_SRC) != 0;
+}
+
+static bool
+in_dst_prefixes(arguments_t args, SkBuff b)
+{
+	return lookup_ip(args, b, Q_PREFIX_DST) != 0;
+}
+
+static Action_SkBuff
+steer_prefixes(arguments_t args, SkBuff b)
+{
+	uint32_t n = lookup_ip(args, b, Q_PREFIX_SRC|Q_PREFIX_DST);
+	if (n)
+		return Steering(b, n);
+	return Drop(b);
+}
+
+
+static bool
+in_prefixes6(arguments_t args, SkBuff b)
+{
+	return lookup_ip6(args, b, Q_PREFIX_SRC|Q_PREFIX_DST) != 0;
+}
+
+static bool
+in_src_prefixes6(arguments_t args, SkBuff b)
+{
+	return lookup_ip6(args, b, Q_PREFIX_SRC) != 0;
+}
+
+static bool
+in_dst_prefixes6(arguments_t args, SkBuff b)
+{
+	return lookup_ip6(args, b, Q_PREFIX_DST) != 0;
+}
+
+static Action_SkBuff
+steer_prefixes6(arguments_t args, SkBuff b)
+{
+	uint32_t n = lookup_ip6(args, b, Q_PREFIX_SRC|Q_PREFIX_DST);
+	if (n)
+		return Steering(b, n);
+	return Drop(b);
+}
+
+
+struct pfq_function_descr prefix_functions[] = {
+
+	{ "in_prefixes",	"[Word32] -> [CInt] -> SkBuff -> Bool",			in_prefixes,	  prefixes_init4, prefixes_fini },
+	{ "in_src_prefixes",	"[Word32] -> [CInt] -> SkBuff -> Bool",			in_src_prefixes,  prefixes_init4, prefixes_fini },
+	{ "in_dst_prefixes",	"[Word32] -> [CInt] -> SkBuff -> Bool",			in_dst_prefixes,  prefixes_init4, prefixes_fini },
+	{ "steer_prefixes",	"[Word32] -> [CInt] -> SkBuff -> Action SkBuff",	steer_prefixes,	  prefixes_init4, prefixes_fini },
+
+	{ "in_prefixes6",	"[Word32] -> [CInt] -> SkBuff -> Bool",			in_prefixes6,	  prefixes_init6, prefixes_fini },
+	{ "in_src_prefixes6",	"[Word32] -> [CInt] -> SkBuff -> Bool",			in_src_prefixes6, prefixes_init6, prefixes_fini },
+	{ "in_dst_prefixes6",	"[Word32] -> [CInt] -> SkBuff -> Bool",			in_dst_prefixes6, prefixes_init6, prefixes_fini },
+	{ "steer_prefixes6",	"[Word32] -> [CInt] -> SkBuff -> Action SkBuff",	steer_prefixes6,  prefixes_init6, prefixes_fini },
+	{ NULL }};
+
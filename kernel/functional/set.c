@@ -0,0 +1,228 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/bitops.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+
+#include <pf_q-module.h>
+
+
+/****************************************************************
+ *	port and protocol sets: a bitmap is built in init, so that
+ *	the membership test costs a single bit test, regardless of
+ *	the size of the set (65536 ports = 8 KB, 256 protocols = 32 bytes).
+ ****************************************************************/
+
+#define Q_PORT_SRC	1
+#define Q_PORT_DST	2
+
+
+static inline bool
+skb_l4_proto(struct sk_buff *skb, uint8_t *proto, int *off)
+{
+	if (eth_hdr(skb)->h_proto == __constant_htons(ETH_P_IP))
+	{
+		struct iphdr _iph;
+		const struct iphdr *ip;
+
+		ip = skb_header_pointer(skb, skb->mac_len, sizeof(_iph), &_iph);
+		if (ip == NULL)
+			return false;
+
+		*proto = ip->protocol;
+
+		/* non-first fragments carry no transport header */
+
+		*off = (ip->frag_off & __constant_htons(IP_OFFSET)) ? -1 : skb->mac_len + (ip->ihl<<2);
+		return true;
+	}
+
+	if (eth_hdr(skb)->h_proto == __constant_htons(ETH_P_IPV6))
+	{
+		struct ipv6hdr _ip6h;
+		const struct ipv6hdr *ip6;
+
+		ip6 = skb_header_pointer(skb, skb->mac_len, sizeof(_ip6h), &_ip6h);
+		if (ip6 == NULL)
+			return false;
+
+		*proto = ip6->nexthdr;
+		*off = skb->mac_len + sizeof(struct ipv6hdr);
+		return true;
+	}
+
+	return false;
+}
+
+
+static inline bool
+port_in(arguments_t args, SkBuff b, int which)
+{
+	const unsigned long *map = GET_ARG_1(unsigned long *, args);
+	__be16 _ports[2]; const __be16 *ports;
+	uint8_t proto;
+	int off;
+
+	if (!skb_l4_proto(b.skb, &proto, &off) || off < 0)
+		return false;
+
+	if (proto != IPPROTO_UDP && proto != IPPROTO_TCP)
+		return false;
+
+	/* source and destination ports are at the same offset in UDP and TCP */
+
+	ports = skb_header_pointer(b.skb, off, sizeof(_ports), _ports);
+	if (ports == NULL)
+		return false;
+
+	return ((which & Q_PORT_SRC) && test_bit(ntohs(ports[0]), map)) ||
+	       ((which & Q_PORT_DST) && test_bit(ntohs(ports[1]), map));
+}
+
+
+static bool
+has_port_in(arguments_t args, SkBuff b)
+{
+	return port_in(args, b, Q_PORT_SRC | Q_PORT_DST);
+}
+
+static bool
+has_src_port_in(arguments_t args, SkBuff b)
+{
+	return port_in(args, b, Q_PORT_SRC);
+}
+
+static bool
+has_dst_port_in(arguments_t args, SkBuff b)
+{
+	return port_in(args, b, Q_PORT_DST);
+}
+
+
+static Action_SkBuff
+filter_port_in(arguments_t args, SkBuff b)
+{
+	return port_in(args, b, Q_PORT_SRC | Q_PORT_DST) ? Pass(b) : Drop(b);
+}
+
+static Action_SkBuff
+filter_src_port_in(arguments_t args, SkBuff b)
+{
+	return port_in(args, b, Q_PORT_SRC) ? Pass(b) : Drop(b);
+}
+
+static Action_SkBuff
+filter_dst_port_in(arguments_t args, SkBuff b)
+{
+	return port_in(args, b, Q_PORT_DST) ? Pass(b) : Drop(b);
+}
+
+
+static bool
+l4_proto_in(arguments_t args, SkBuff b)
+{
+	const unsigned long *map = GET_ARG_1(unsigned long *, args);
+	uint8_t proto;
+	int off;
+
+	if (!skb_l4_proto(b.skb, &proto, &off))
+		return false;
+
+	return test_bit(proto, map);
+}
+
+
+static int
+port_set_init(arguments_t args)
+{
+	const uint16_t *port = GET_ARRAY_0(uint16_t, args);
+	size_t n, len = LEN_ARRAY_0(args);
+	unsigned long *map;
+
+	map = kzalloc(BITS_TO_LONGS(65536) * sizeof(unsigned long), GFP_KERNEL);
+	if (!map) {
+		printk(KERN_INFO "[PFQ|init] port set: out of memory!\n");
+		return -ENOMEM;
+	}
+
+	for(n = 0; n < len; n++)
+		__set_bit(port[n], map);
+
+	SET_ARG_1(args, map);
+
+	pr_devel("[PFQ|init] port set: %zu ports\n", len);
+	return 0;
+}
+
+
+static int
+proto_set_init(arguments_t args)
+{
+	const uint8_t *proto = GET_ARRAY_0(uint8_t, args);
+	size_t n, len = LEN_ARRAY_0(args);
+	unsigned long *map;
+
+	map = kzalloc(BITS_TO_LONGS(256) * sizeof(unsigned long), GFP_KERNEL);
+	if (!map) {
+		printk(KERN_INFO "[PFQ|init] protocol set: out of memory!\n");
+		return -ENOMEM;
+	}
+
+	for(n = 0; n < len; n++)
+		__set_bit(proto[n], map);
+
+	SET_ARG_1(args, map);
+
+	pr_devel("[PFQ|init] protocol set: %zu protocols\n", len);
+	return 0;
+}
+
+
+static int
+set_fini(arguments_t args)
+{
+	unsigned long *map = GET_ARG_1(unsigned long *, args);
+
+	kfree(map);
+
+	pr_devel("[PFQ|fini] set: bitmap freed@%p\n", map);
+	return 0;
+}
+
+
+struct pfq_function_descr set_functions[] = {
+
+	{ "has_port_in",	"[Word16] -> SkBuff -> Bool",		has_port_in,		port_set_init,	set_fini },
+	{ "has_src_port_in",	"[Word16] -> SkBuff -> Bool",		has_src_port_in,	port_set_init,	set_fini },
+	{ "has_dst_port_in",	"[Word16] -> SkBuff -> Bool",		has_dst_port_in,	port_set_init,	set_fini },
+	{ "port_in",		"[Word16] -> SkBuff -> Action SkBuff",	filter_port_in,		port_set_init,	set_fini },
+	{ "src_port_in",	"[Word16] -> SkBuff -> Action SkBuff",	filter_src_port_in,	port_set_init,	set_fini },
+	{ "dst_port_in",	"[Word16] -> SkBuff -> Action SkBuff",	filter_dst_port_in,	port_set_init,	set_fini },
+	{ "l4_proto_in",	"[Word8] -> SkBuff -> Bool",		l4_proto_in,		proto_set_init,	set_fini },
+
+	{ NULL }};
+
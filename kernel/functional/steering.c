@@ -25,8 +25,13 @@
 #include <linux/module.h>
 #include <linux/swab.h>
 #include <linux/inetdevice.h>
+#include <linux/percpu.h>
+#include <linux/jhash.h>
+
+#include <linux/pf_q-hash.h>
 
 #include <pf_q-module.h>
+#include <pf_q-global.h>
 
 
 static Action_SkBuff
@@ -77,6 +82,16 @@ steering_vlan_id(arguments_t args, SkBuff b)
 }
 
 
+/* symmetric hash of the IPv4 addresses (the NIC hash is not used: it may include the ports) */
+
+static inline uint32_t
+ip_hash(const struct iphdr *ip)
+{
+	return pfq_sym_hash4(steer_hash == Q_HASH_SKB ? Q_HASH_TOEPLITZ : steer_hash,
+			     (__force uint32_t)ip->saddr, (__force uint32_t)ip->daddr, 0, 0);
+}
+
+
 static Action_SkBuff
 steering_ip(arguments_t args, SkBuff b)
 {
@@ -84,15 +99,12 @@ steering_ip(arguments_t args, SkBuff b)
 	{
 		struct iphdr _iph;
 		const struct iphdr *ip;
-		__be32 hash;
 
 		ip = skb_header_pointer(b.skb, b.skb->mac_len, sizeof(_iph), &_iph);
 		if (ip == NULL)
 			return Drop(b);
 
-		hash = ip->saddr ^ ip->daddr;
-
-		return Steering(b, *(uint32_t *)&hash);
+		return Steering(b, ip_hash(ip));
 	}
 
 	return Drop(b);
@@ -147,8 +159,30 @@ steering_net(arguments_t args, SkBuff b)
 }
 
 
-static Action_SkBuff
-steering_flow(arguments_t args, SkBuff b)
+/* the NIC L4 rx hash, if any (not symmetric, unless the NIC uses a symmetric key) */
+
+static inline bool
+skb_l4_rxhash(struct sk_buff *skb, uint32_t *hash)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0))
+	if (skb->l4_hash) {
+		*hash = skb->hash;
+		return true;
+	}
+#else
+	if (skb->l4_rxhash) {
+		*hash = skb->rxhash;
+		return true;
+	}
+#endif
+	return false;
+}
+
+
+/* hash of the 5-tuple: symmetric, unless type is Q_HASH_SKB (the NIC one, when present) */
+
+static inline bool
+flow_hash(SkBuff b, int type, uint32_t *hash)
 {
 	if (eth_hdr(b.skb)->h_proto == __constant_htons(ETH_P_IP))
 	{
@@ -157,26 +191,47 @@ steering_flow(arguments_t args, SkBuff b)
 
 		struct udphdr _udp;
 		const struct udphdr *udp;
-		__be32 hash;
 
 		ip = skb_header_pointer(b.skb, b.skb->mac_len, sizeof(_iph), &_iph);
 		if (ip == NULL)
-			return Drop(b);
+			return false;
 
 		if (ip->protocol != IPPROTO_UDP &&
 		    ip->protocol != IPPROTO_TCP)
-			return Drop(b);
+			return false;
+
+		/* non-first fragments carry no L4 header: hash on the addresses only */
+
+		if (ip->frag_off & __constant_htons(IP_OFFSET)) {
+			*hash = ip_hash(ip);
+			return true;
+		}
+
+		if (type == Q_HASH_SKB && skb_l4_rxhash(b.skb, hash))
+			return true;
 
 		udp = skb_header_pointer(b.skb, b.skb->mac_len + (ip->ihl<<2), sizeof(_udp), &_udp);
 		if (udp == NULL)
-			return Drop(b);  /* broken */
+			return false;  /* broken */
 
-		hash = ip->saddr ^ ip->daddr ^ (__force __be32)udp->source ^ (__force __be32)udp->dest;
-
-		return Steering(b, *(uint32_t *)&hash);
+		*hash = pfq_sym_hash4(type, (__force uint32_t)ip->saddr, (__force uint32_t)ip->daddr,
+				      (__force uint16_t)udp->source, (__force uint16_t)udp->dest);
+		return true;
 	}
 
-	return Drop(b);
+	return false;
+}
+
+
+static Action_SkBuff
+steering_flow(arguments_t args, SkBuff b)
+{
+	uint32_t hash;
+
+	if (!flow_hash(b, steer_hash, &hash))
+		return Drop(b);
+
+	return Steering(b, hash);
 }
 
 
@@ -187,24 +242,235 @@ steering_ip6(arguments_t args, SkBuff b)
 	{
 		struct ipv6hdr _ip6h;
 		const struct ipv6hdr *ip6;
-		__be32 hash;
 
 		ip6 = skb_header_pointer(b.skb, b.skb->mac_len, sizeof(_ip6h), &_ip6h);
 		if (ip6 == NULL)
 			return Drop(b);
 
-		hash = ip6->saddr.in6_u.u6_addr32[0] ^
-			ip6->saddr.in6_u.u6_addr32[1] ^
-			ip6->saddr.in6_u.u6_addr32[2] ^
-			ip6->saddr.in6_u.u6_addr32[3] ^
-			ip6->daddr.in6_u.u6_addr32[0] ^
-			ip6->daddr.in6_u.u6_addr32[1] ^
-			ip6->daddr.in6_u.u6_addr32[2] ^
-			ip6->daddr.in6_u.u6_addr32[3];
+		return Steering(b, pfq_sym_hash6(steer_hash == Q_HASH_SKB ? Q_HASH_TOEPLITZ : steer_hash,
+						 (__force uint32_t *)ip6->saddr.in6_u.u6_addr32,
+						 (__force uint32_t *)ip6->daddr.in6_u.u6_addr32, 0, 0));
+	}
 
-		return Steering(b, *(uint32_t *)&hash);
+	return Drop(b);
+}
+
+
+/*
+ * fragment-aware flow steering: the first fragment of a datagram is steered on the
+ * 5-tuple and its hash is saved in a per-cpu table keyed by (src, dst, id, proto);
+ * the following fragments are steered with the same hash, or on the addresses only
+ * when the first fragment was not seen (out of order, or evicted).
+ *
+ * NICs hash IPv4 fragments on the addresses (2-tuple RSS): all the fragments of a
+ * datagram are received by the same cpu, and the table needs no locking.
+ */
+
+#define Q_FRAG_TABLE_SIZE	256
+#define Q_FRAG_TIMEOUT		(HZ)
+
+struct frag_entry
+{
+	__be32		saddr;
+	__be32		daddr;
+	__be16		id;
+	u8		proto;
+	u8		valid;
+	uint32_t	hash;
+	unsigned long	stamp;
+};
+
+struct frag_table
+{
+	struct frag_entry entry[Q_FRAG_TABLE_SIZE];
+};
+
+
+static int
+steering_flow_frag_init(arguments_t args)
+{
+	struct frag_table __percpu *table;
+
+	table = alloc_percpu(struct frag_table);
+	if (!table) {
+		printk(KERN_INFO "[PFQ|init] steer_flow_frag: out of memory!\n");
+		return -ENOMEM;
 	}
 
+	SET_ARG_0(args, table);
+
+	pr_devel("[PFQ|init] steer_flow_frag: per-cpu table@%p\n", table);
+	return 0;
+}
+
+
+static int
+steering_flow_frag_fini(arguments_t args)
+{
+	struct frag_table __percpu *table = GET_ARG_0(struct frag_table __percpu *, args);
+
+	free_percpu(table);
+
+	pr_devel("[PFQ|fini] steer_flow_frag: per-cpu table freed@%p\n", table);
+	return 0;
+}
+
+
+static Action_SkBuff
+steering_flow_frag(arguments_t args, SkBuff b)
+{
+	struct frag_table *table = this_cpu_ptr(GET_ARG_0(struct frag_table __percpu *, args));
+	struct frag_entry *e;
+	struct iphdr _iph;
+	const struct iphdr *ip;
+	uint32_t hash;
+
+	if (eth_hdr(b.skb)->h_proto != __constant_htons(ETH_P_IP))
+		return Drop(b);
+
+	ip = skb_header_pointer(b.skb, b.skb->mac_len, sizeof(_iph), &_iph);
+	if (ip == NULL)
+		return Drop(b);
+
+	/* not a fragment (see is_frag) */
+
+	if (!(ip->frag_off & __constant_htons(IP_MF|IP_OFFSET))) {
+		if (!flow_hash(b, steer_hash, &hash))
+			return Drop(b);
+		return Steering(b, hash);
+	}
+
+	e = &table->entry[jhash_3words((__force u32)ip->saddr, (__force u32)ip->daddr,
+				       ((__force u32)ip->id << 8) | ip->protocol, 0) & (Q_FRAG_TABLE_SIZE-1)];
+
+	/* first fragment (see is_first_frag): steered as the flow, the hash is saved for the others */
+
+	if (!(ip->frag_off & __constant_htons(IP_OFFSET))) {
+
+		if (!flow_hash(b, steer_hash, &hash))
+			hash = ip_hash(ip);
+
+		e->saddr = ip->saddr;
+		e->daddr = ip->daddr;
+		e->id	 = ip->id;
+		e->proto = ip->protocol;
+		e->hash  = hash;
+		e->stamp = jiffies;
+		e->valid = 1;
+
+		return Steering(b, hash);
+	}
+
+	/* following fragments */
+
+	if (e->valid && e->saddr == ip->saddr && e->daddr == ip->daddr &&
+	    e->id == ip->id && e->proto == ip->protocol &&
+	    time_before(jiffies, e->stamp + Q_FRAG_TIMEOUT)) {
+
+		hash = e->hash;
+
+		/* last fragment: release the entry */
+
+		if (!(ip->frag_off & __constant_htons(IP_MF)))
+			e->valid = 0;
+
+		return Steering(b, hash);
+	}
+
+	return Steering(b, ip_hash(ip));
+}
+
+
+/*
+ * sampling: deterministic 1-in-N (per-cpu) and hash-based (flow consistent)
+ */
+
+static int
+sample_init(arguments_t args)
+{
+	const int n = GET_ARG_0(int, args);
+	unsigned int __percpu *count;
+
+	if (n < 1) {
+		printk(KERN_INFO "[PFQ|init] sample: invalid rate 1/%d!\n", n);
+		return -EPERM;
+	}
+
+	count = alloc_percpu(unsigned int);
+	if (!count) {
+		printk(KERN_INFO "[PFQ|init] sample: out of memory!\n");
+		return -ENOMEM;
+	}
+
+	SET_ARG_1(args, count);
+
+	pr_devel("[PFQ|init] sample: 1/%d per-cpu counter@%p\n", n, count);
+	return 0;
+}
+
+
+static int
+sample_fini(arguments_t args)
+{
+	unsigned int __percpu *count = GET_ARG_1(unsigned int __percpu *, args);
+
+	free_percpu(count);
+
+	pr_devel("[PFQ|fini] sample: per-cpu counter freed@%p\n", count);
+	return 0;
+}
+
+
+static Action_SkBuff
+sample(arguments_t args, SkBuff b)
+{
+	const unsigned int n = GET_ARG_0(int, args);
+	unsigned int *count = this_cpu_ptr(GET_ARG_1(unsigned int __percpu *, args));
+
+	if (++(*count) < n)
+		return Drop(b);
+
+	*count = 0;
+	return Pass(b);
+}
+
+
+static int
+sample_flow_init(arguments_t args)
+{
+	const int n = GET_ARG_0(int, args);
+
+	if (n < 1) {
+		printk(KERN_INFO "[PFQ|init] sample_flow: invalid rate 1/%d!\n", n);
+		return -EPERM;
+	}
+
+	pr_devel("[PFQ|init] sample_flow: 1/%d\n", n);
+	return 0;
+}
+
+
+static Action_SkBuff
+sample_flow(arguments_t args, SkBuff b)
+{
+	const unsigned int n = GET_ARG_0(int, args);
+	uint32_t h;
+
+	if (n <= 1)
+		return Pass(b);
+
+	/* the NIC hash is not symmetric, nor equal to the fallback: sample the connection as a whole */
+
+	if (!flow_hash(b, steer_hash == Q_HASH_SKB ? Q_HASH_TOEPLITZ : steer_hash, &h))
+		return Drop(b);
+
+	/* mix the hash before the scaling (the xor one is poorly distributed) */
+
+	h = jhash_1word(h, 0);
+
+	if ((uint32_t)(((uint64_t)h * n) >> 32) == 0)
+		return Pass(b);
+
 	return Drop(b);
 }
 
@@ -216,7 +482,11 @@ struct pfq_function_descr steering_functions[] = {
 	{ "steer_ip",    "SkBuff -> Action SkBuff", steering_ip      },
 	{ "steer_ip6",	 "SkBuff -> Action SkBuff", steering_ip6     },
 	{ "steer_flow",  "SkBuff -> Action SkBuff", steering_flow    },
+	{ "steer_flow_frag", "SkBuff -> Action SkBuff", steering_flow_frag, steering_flow_frag_init, steering_flow_frag_fini },
 	{ "steer_field", "Word32 -> Word32 -> SkBuff -> Action SkBuff", steering_field },
 	{ "steer_net",   "Word32 -> Word32 -> Word32 -> SkBuff -> Action SkBuff", steering_net, steering_net_init },
+
+	{ "sample",	 "CInt -> SkBuff -> Action SkBuff", sample, sample_init, sample_fini },
+	{ "sample_flow", "CInt -> SkBuff -> Action SkBuff", sample_flow, sample_flow_init },
 	{ NULL }};
 
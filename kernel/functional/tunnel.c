@@ -0,0 +1,662 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/skbuff.h>
+#include <linux/if_vlan.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <linux/udp.h>
+#include <linux/jhash.h>
+#include <net/ip.h>
+
+#include <linux/pf_q-hash.h>
+
+#include <pf_q-module.h>
+#include <pf_q-global.h>
+
+
+#define VXLAN_PORT		4789
+#define GTP_U_PORT		2152
+#define GTP_C_PORT		2123
+
+#define GTP_MSG_GPDU		0xff
+
+#define Q_TUNNEL_MAX_TAGS	4
+#define Q_TUNNEL_MAX_LABELS	8
+#define Q_TUNNEL_MAX_GTP_EXT	4
+
+
+/* skip VLAN tags (802.1Q/802.1ad): return the number of tags, -1 if truncated */
+
+static int
+tunnel_skip_vlan(struct sk_buff *skb, __be16 *proto, int *off, tunnel_t *t)
+{
+	int n;
+
+	for(n = 0; *proto == __constant_htons(ETH_P_8021Q) || *proto == __constant_htons(ETH_P_8021AD); n++)
+	{
+		struct vlan_hdr _vh;
+		const struct vlan_hdr *vh;
+
+		if (n == Q_TUNNEL_MAX_TAGS)
+			return -1;
+
+		vh = skb_header_pointer(skb, *off, sizeof(_vh), &_vh);
+		if (vh == NULL)
+			return -1;
+
+		if (*proto == __constant_htons(ETH_P_8021AD))
+			t->type |= Q_TUNNEL_QINQ;
+
+		*proto = vh->h_vlan_encapsulated_proto;
+		*off  += VLAN_HLEN;
+	}
+
+	return n;
+}
+
+
+/* skip an inner Ethernet header (VXLAN, GRE/TEB) */
+
+static bool
+tunnel_skip_ether(struct sk_buff *skb, __be16 *proto, int *off, tunnel_t *t)
+{
+	struct ethhdr _eh;
+	const struct ethhdr *eh;
+
+	eh = skb_header_pointer(skb, *off, sizeof(_eh), &_eh);
+	if (eh == NULL)
+		return false;
+
+	*proto = eh->h_proto;
+	*off  += ETH_HLEN;
+
+	return tunnel_skip_vlan(skb, proto, off, t) >= 0;
+}
+
+
+/* IP version from the first nibble (MPLS and GTP-U payloads) */
+
+static __be16
+tunnel_ip_version(struct sk_buff *skb, int off)
+{
+	u8 _v;
+	const u8 *v;
+
+	v = skb_header_pointer(skb, off, sizeof(_v), &_v);
+	if (v == NULL)
+		return 0;
+
+	switch(*v >> 4)
+	{
+	case 4: return __constant_htons(ETH_P_IP);
+	case 6: return __constant_htons(ETH_P_IPV6);
+	}
+	return 0;
+}
+
+
+static bool
+tunnel_gre(struct sk_buff *skb, __be16 *proto, int *off, tunnel_t *t)
+{
+	struct { __be16 flags; __be16 proto; } _gh;
+	const typeof(_gh) *gh;
+	u16 flags;
+
+	gh = skb_header_pointer(skb, *off, sizeof(_gh), &_gh);
+	if (gh == NULL)
+		return false;
+
+	flags = ntohs(gh->flags);
+	if (flags & 0x0007) /* version 0 only (no PPTP) */
+		return false;
+
+	*proto = gh->proto;
+	*off  += sizeof(_gh);
+
+	if (flags & 0x8000)	/* checksum */
+		*off += 4;
+
+	if (flags & 0x2000) {	/* key */
+		__be32 _key;
+		const __be32 *key = skb_header_pointer(skb, *off, sizeof(_key), &_key);
+		if (key == NULL)
+			return false;
+		t->id = ntohl(*key);
+		*off += 4;
+	}
+
+	if (flags & 0x1000)	/* sequence number */
+		*off += 4;
+
+	t->type |= Q_TUNNEL_GRE;
+
+	if (*proto == __constant_htons(ETH_P_TEB))
+		return tunnel_skip_ether(skb, proto, off, t);
+
+	return true;
+}
+
+
+static bool
+tunnel_vxlan(struct sk_buff *skb, __be16 *proto, int *off, tunnel_t *t)
+{
+	__be32 _vh[2];
+	const __be32 *vh;
+
+	vh = skb_header_pointer(skb, *off, sizeof(_vh), &_vh);
+	if (vh == NULL)
+		return false;
+
+	if (!(ntohl(vh[0]) & 0x08000000))	/* VNI flag */
+		return false;
+
+	t->id    = ntohl(vh[1]) >> 8;
+	t->type |= Q_TUNNEL_VXLAN;
+	*off    += sizeof(_vh);
+
+	return tunnel_skip_ether(skb, proto, off, t);
+}
+
+
+static bool
+tunnel_gtp(struct sk_buff *skb, __be16 *proto, int *off, tunnel_t *t, bool user_plane)
+{
+	struct { u8 flags; u8 type; __be16 len; __be32 teid; } _gh;
+	const typeof(_gh) *gh;
+	int n, version;
+
+	gh = skb_header_pointer(skb, *off, sizeof(_gh), &_gh);
+	if (gh == NULL)
+		return false;
+
+	version = gh->flags >> 5;
+
+	if (!user_plane) {
+
+		/* GTPv1-C, or GTPv2-C (TEID present only with the T flag) */
+
+		if (version != 1 && version != 2)
+			return false;
+
+		t->type   |= Q_TUNNEL_GTP_C;
+		t->gtp_msg = gh->type;
+
+		if (version == 1 || (gh->flags & 0x08))
+			t->id = ntohl(gh->teid);
+
+		return false;
+	}
+
+	if (version != 1 || !(gh->flags & 0x10))	/* GTPv1-U, protocol type GTP */
+		return false;
+
+	t->type   |= Q_TUNNEL_GTP_U;
+	t->gtp_msg = gh->type;
+	t->id      = ntohl(gh->teid);
+
+	if (gh->type != GTP_MSG_GPDU)
+		return false;
+
+	*off += sizeof(_gh);
+
+	/* optional fields: sequence number, N-PDU number and next extension header type */
+
+	if (gh->flags & 0x07) {
+
+		u8 _next;
+		const u8 *next;
+
+		*off += 4;
+
+		next = skb_header_pointer(skb, *off - 1, sizeof(_next), &_next);
+		if (next == NULL)
+			return false;
+
+		for(n = 0; (gh->flags & 0x04) && *next; n++)
+		{
+			u8 _len;
+			const u8 *len;
+
+			if (n == Q_TUNNEL_MAX_GTP_EXT)
+				return false;
+
+			len = skb_header_pointer(skb, *off, sizeof(_len), &_len);
+			if (len == NULL || *len == 0)
+				return false;
+
+			*off += *len * 4;
+
+			next = skb_header_pointer(skb, *off - 1, sizeof(_next), &_next);
+			if (next == NULL)
+				return false;
+		}
+	}
+
+	*proto = tunnel_ip_version(skb, *off);
+	return true;
+}
+
+
+/* parse the packet once: the result is cached in the monad */
+
+static const tunnel_t *
+tunnel_parse(SkBuff b)
+{
+	tunnel_t *t = &PFQ_CB(b.skb)->monad->tunnel;
+	struct sk_buff *skb = b.skb;
+	__be16 proto;
+	int off, tags, n;
+	u8 l4proto;
+
+	if (t->parsed)
+		return t;
+
+	t->parsed    = 1;
+	t->type      = 0;
+	t->inner     = 0;
+	t->gtp_msg   = 0;
+	t->inner_off = 0;
+	t->id	     = 0;
+
+	proto = eth_hdr(skb)->h_proto;
+	off   = skb->mac_len;
+
+	/* stacked VLANs (the outer tag may have been stripped by the NIC) */
+
+	tags = tunnel_skip_vlan(skb, &proto, &off, t);
+	if (tags < 0)
+		return t;
+
+	if (tags + ((skb->vlan_tci & VLAN_TAG_PRESENT) ? 1 : 0) > 1)
+		t->type |= Q_TUNNEL_QINQ;
+
+	/* MPLS: the payload follows the bottom of the stack */
+
+	if (proto == __constant_htons(ETH_P_MPLS_UC) || proto == __constant_htons(ETH_P_MPLS_MC)) {
+
+		for(n = 0; n < Q_TUNNEL_MAX_LABELS; n++)
+		{
+			__be32 _lse;
+			const __be32 *lse;
+
+			lse = skb_header_pointer(skb, off, sizeof(_lse), &_lse);
+			if (lse == NULL)
+				return t;
+
+			if (n == 0)
+				t->id = ntohl(*lse) >> 12;
+
+			off += sizeof(_lse);
+
+			if (ntohl(*lse) & 0x100)
+				break;
+		}
+
+		if (n == Q_TUNNEL_MAX_LABELS)
+			return t;
+
+		t->type |= Q_TUNNEL_MPLS;
+		proto = tunnel_ip_version(skb, off);
+		goto inner;
+	}
+
+	/* outer IP header */
+
+	if (proto == __constant_htons(ETH_P_IP)) {
+
+		struct iphdr _iph;
+		const struct iphdr *ip;
+
+		ip = skb_header_pointer(skb, off, sizeof(_iph), &_iph);
+		if (ip == NULL)
+			return t;
+
+		if (ip->frag_off & __constant_htons(IP_OFFSET))
+			goto inner;
+
+		l4proto = ip->protocol;
+		n = off + (ip->ihl<<2);
+	}
+	else if (proto == __constant_htons(ETH_P_IPV6)) {
+
+		struct ipv6hdr _ip6h;
+		const struct ipv6hdr *ip6;
+
+		ip6 = skb_header_pointer(skb, off, sizeof(_ip6h), &_ip6h);
+		if (ip6 == NULL)
+			return t;
+
+		l4proto = ip6->nexthdr;
+		n = off + sizeof(struct ipv6hdr);
+	}
+	else
+		return t;
+
+	/* encapsulations over IP: GRE and UDP (VXLAN, GTP) */
+
+	if (l4proto == IPPROTO_GRE) {
+
+		__be16 p;
+
+		if (tunnel_gre(skb, &p, &n, t)) {
+			proto = p;
+			off = n;
+		}
+	}
+	else if (l4proto == IPPROTO_UDP) {
+
+		struct udphdr _udp;
+		const struct udphdr *udp;
+		bool ok = false;
+		__be16 p;
+
+		udp = skb_header_pointer(skb, n, sizeof(_udp), &_udp);
+		if (udp == NULL)
+			goto inner;
+
+		n += sizeof(_udp);
+
+		if (udp->dest == __constant_htons(VXLAN_PORT))
+			ok = tunnel_vxlan(skb, &p, &n, t);
+		else if (udp->dest == __constant_htons(GTP_U_PORT) || udp->source == __constant_htons(GTP_U_PORT))
+			ok = tunnel_gtp(skb, &p, &n, t, true);
+		else if (udp->dest == __constant_htons(GTP_C_PORT) || udp->source == __constant_htons(GTP_C_PORT))
+			ok = tunnel_gtp(skb, &p, &n, t, false);
+
+		if (ok) {
+			proto = p;
+			off = n;
+		}
+	}
+
+inner:
+	/* the innermost IP header (the outer one, if no tunnel is found) */
+
+	if (proto == __constant_htons(ETH_P_IP))
+		t->inner = 4;
+	else if (proto == __constant_htons(ETH_P_IPV6))
+		t->inner = 6;
+	else
+		return t;
+
+	t->inner_off = off;
+	return t;
+}
+
+
+/* symmetric hash of the inner 5-tuple (fragments are hashed on the addresses only) */
+
+static bool
+tunnel_inner_hash(SkBuff b, const tunnel_t *t, uint32_t *hash)
+{
+	const int type = steer_hash == Q_HASH_SKB ? Q_HASH_TOEPLITZ : steer_hash;
+	struct udphdr _udp;
+	const struct udphdr *udp = NULL;
+
+	if (t->inner == 4) {
+
+		struct iphdr _iph;
+		const struct iphdr *ip;
+
+		ip = skb_header_pointer(b.skb, t->inner_off, sizeof(_iph), &_iph);
+		if (ip == NULL)
+			return false;
+
+		if ((ip->protocol == IPPROTO_TCP || ip->protocol == IPPROTO_UDP) &&
+		    !(ip->frag_off & __constant_htons(IP_MF|IP_OFFSET)))
+			udp = skb_header_pointer(b.skb, t->inner_off + (ip->ihl<<2), sizeof(_udp), &_udp);
+
+		*hash = pfq_sym_hash4(type, (__force uint32_t)ip->saddr, (__force uint32_t)ip->daddr,
+				      udp ? (__force uint16_t)udp->source : 0,
+				      udp ? (__force uint16_t)udp->dest : 0);
+		return true;
+	}
+
+	if (t->inner == 6) {
+
+		struct ipv6hdr _ip6h;
+		const struct ipv6hdr *ip6;
+
+		ip6 = skb_header_pointer(b.skb, t->inner_off, sizeof(_ip6h), &_ip6h);
+		if (ip6 == NULL)
+			return false;
+
+		if (ip6->nexthdr == IPPROTO_TCP || ip6->nexthdr == IPPROTO_UDP)
+			udp = skb_header_pointer(b.skb, t->inner_off + sizeof(struct ipv6hdr), sizeof(_udp), &_udp);
+
+		*hash = pfq_sym_hash6(type, (__force uint32_t *)ip6->saddr.in6_u.u6_addr32,
+				      (__force uint32_t *)ip6->daddr.in6_u.u6_addr32,
+				      udp ? (__force uint16_t)udp->source : 0,
+				      udp ? (__force uint16_t)udp->dest : 0);
+		return true;
+	}
+
+	return false;
+}
+
+
+/* predicates */
+
+static bool
+is_tunnel(arguments_t args, SkBuff b)
+{
+	return tunnel_parse(b)->type & (Q_TUNNEL_MPLS|Q_TUNNEL_GRE|Q_TUNNEL_VXLAN|Q_TUNNEL_GTP_U|Q_TUNNEL_GTP_C);
+}
+
+static bool
+is_gtp(arguments_t args, SkBuff b)
+{
+	return tunnel_parse(b)->type & (Q_TUNNEL_GTP_U|Q_TUNNEL_GTP_C);
+}
+
+static bool
+is_gtp_up(arguments_t args, SkBuff b)
+{
+	return tunnel_parse(b)->type & Q_TUNNEL_GTP_U;
+}
+
+static bool
+is_gtp_cp(arguments_t args, SkBuff b)
+{
+	return tunnel_parse(b)->type & Q_TUNNEL_GTP_C;
+}
+
+static bool
+is_vxlan(arguments_t args, SkBuff b)
+{
+	return tunnel_parse(b)->type & Q_TUNNEL_VXLAN;
+}
+
+static bool
+is_gre(arguments_t args, SkBuff b)
+{
+	return tunnel_parse(b)->type & Q_TUNNEL_GRE;
+}
+
+static bool
+is_mpls(arguments_t args, SkBuff b)
+{
+	return tunnel_parse(b)->type & Q_TUNNEL_MPLS;
+}
+
+static bool
+is_qinq(arguments_t args, SkBuff b)
+{
+	return tunnel_parse(b)->type & Q_TUNNEL_QINQ;
+}
+
+
+/* filters */
+
+static Action_SkBuff
+filter_tunnel(arguments_t args, SkBuff b)
+{
+	return is_tunnel(args, b) ? Pass(b) : Drop(b);
+}
+
+static Action_SkBuff
+filter_gtp(arguments_t args, SkBuff b)
+{
+	return is_gtp(args, b) ? Pass(b) : Drop(b);
+}
+
+static Action_SkBuff
+filter_gtp_up(arguments_t args, SkBuff b)
+{
+	return is_gtp_up(args, b) ? Pass(b) : Drop(b);
+}
+
+static Action_SkBuff
+filter_gtp_cp(arguments_t args, SkBuff b)
+{
+	return is_gtp_cp(args, b) ? Pass(b) : Drop(b);
+}
+
+static Action_SkBuff
+filter_vxlan(arguments_t args, SkBuff b)
+{
+	return is_vxlan(args, b) ? Pass(b) : Drop(b);
+}
+
+static Action_SkBuff
+filter_gre(arguments_t args, SkBuff b)
+{
+	return is_gre(args, b) ? Pass(b) : Drop(b);
+}
+
+static Action_SkBuff
+filter_mpls(arguments_t args, SkBuff b)
+{
+	return is_mpls(args, b) ? Pass(b) : Drop(b);
+}
+
+static Action_SkBuff
+filter_qinq(arguments_t args, SkBuff b)
+{
+	return is_qinq(args, b) ? Pass(b) : Drop(b);
+}
+
+
+/* steering */
+
+static Action_SkBuff
+steering_inner(arguments_t args, SkBuff b)
+{
+	uint32_t hash;
+
+	if (!tunnel_inner_hash(b, tunnel_parse(b), &hash))
+		return Drop(b);
+
+	return Steering(b, hash);
+}
+
+
+static Action_SkBuff
+steering_tunnel_id(arguments_t args, SkBuff b)
+{
+	const tunnel_t *t = tunnel_parse(b);
+
+	if (!(t->type & (Q_TUNNEL_MPLS|Q_TUNNEL_GRE|Q_TUNNEL_VXLAN|Q_TUNNEL_GTP_U)))
+		return Drop(b);
+
+	return Steering(b, jhash_2words(t->id, t->type, 0));
+}
+
+
+static int steering_gtp_usr_init(arguments_t args)
+{
+	__be32 mask, ipv4 = GET_ARG_0(__be32, args);
+	int prefix  = GET_ARG_1(int, args);
+
+	mask = inet_make_mask(prefix);
+
+	SET_ARG_0(args, ipv4 & mask);
+	SET_ARG_1(args, mask);
+
+	pr_devel("[PFQ|init] steer_gtp_usr: addr:%pI4 mask:%pI4\n", &ipv4, &mask);
+	return 0;
+}
+
+
+static Action_SkBuff
+steering_gtp_usr(arguments_t args, SkBuff b)
+{
+	__be32 addr = GET_ARG_0(__be32, args);
+	__be32 mask = GET_ARG_1(__be32, args);
+	const tunnel_t *t = tunnel_parse(b);
+	struct iphdr _iph;
+	const struct iphdr *ip;
+
+	/* control plane is broadcast to all the sockets */
+
+	if (t->type & Q_TUNNEL_GTP_C)
+		return Broadcast(b);
+
+	if (!(t->type & Q_TUNNEL_GTP_U) || t->inner != 4)
+		return Drop(b);
+
+	/* user plane: the flows of a user (the address in the given network) are kept together */
+
+	ip = skb_header_pointer(b.skb, t->inner_off, sizeof(_iph), &_iph);
+	if (ip == NULL)
+		return Drop(b);
+
+	if ((ip->saddr & mask) == addr)
+		return Steering(b, jhash_1word((__force u32)ip->saddr, 0));
+
+	if ((ip->daddr & mask) == addr)
+		return Steering(b, jhash_1word((__force u32)ip->daddr, 0));
+
+	return Drop(b);
+}
+
+
+struct pfq_function_descr tunnel_functions[] = {
+
+	{ "is_tunnel",		"SkBuff -> Bool",		is_tunnel	},
+	{ "is_gtp",		"SkBuff -> Bool",		is_gtp		},
+	{ "is_gtp_up",		"SkBuff -> Bool",		is_gtp_up	},
+	{ "is_gtp_cp",		"SkBuff -> Bool",		is_gtp_cp	},
+	{ "is_vxlan",		"SkBuff -> Bool",		is_vxlan	},
+	{ "is_gre",		"SkBuff -> Bool",		is_gre		},
+	{ "is_mpls",		"SkBuff -> Bool",		is_mpls		},
+	{ "is_qinq",		"SkBuff -> Bool",		is_qinq		},
+
+	{ "tunnel",		"SkBuff -> Action SkBuff",	filter_tunnel	},
+	{ "gtp",		"SkBuff -> Action SkBuff",	filter_gtp	},
+	{ "gtp_up",		"SkBuff -> Action SkBuff",	filter_gtp_up	},
+	{ "gtp_cp",		"SkBuff -> Action SkBuff",	filter_gtp_cp	},
+	{ "vxlan",		"SkBuff -> Action SkBuff",	filter_vxlan	},
+	{ "gre",		"SkBuff -> Action SkBuff",	filter_gre	},
+	{ "mpls",		"SkBuff -> Action SkBuff",	filter_mpls	},
+	{ "qinq",		"SkBuff -> Action SkBuff",	filter_qinq	},
+
+	{ "steer_inner",	"SkBuff -> Action SkBuff",	steering_inner		},
+	{ "steer_tunnel_id",	"SkBuff -> Action SkBuff",	steering_tunnel_id	},
+	{ "steer_gtp_usr",	"Word32 -> CInt -> SkBuff -> Action SkBuff", steering_gtp_usr, steering_gtp_usr_init },
+
+	{ NULL }};
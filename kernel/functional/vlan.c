@@ -23,6 +23,7 @@
 
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/bitops.h>
 
 #include <pf_q-module.h>
 
@@ -30,8 +31,8 @@
 static bool
 vlan_id(arguments_t args, SkBuff b)
 {
-	char *mem = GET_ARG_1(char *, args);
-	return mem[ b.skb->vlan_tci & VLAN_VID_MASK ];
+	const unsigned long *map = GET_ARG_1(unsigned long *, args);
+	return test_bit(b.skb->vlan_tci & VLAN_VID_MASK, map);
 }
 
 
@@ -48,28 +49,27 @@ static int vlan_init(arguments_t args)
 {
 	unsigned int n = LEN_ARRAY_0(args);
 	int32_t * vids = GET_ARRAY_0(int32_t, args);
-	char *mem; int i;
+	unsigned long *map; int i;
 
-	mem = kzalloc(4096, GFP_KERNEL);
-	if (!mem) {
+	/* one bit per vid: 512 bytes */
+
+	map = kzalloc(BITS_TO_LONGS(VLAN_N_VID) * sizeof(unsigned long), GFP_KERNEL);
+	if (!map) {
 		printk(KERN_INFO "[PFQ|init] vlan_id filter: out of memory!\n");
 		return -ENOMEM;
 	}
 
-	SET_ARG_1(args, mem);
+	SET_ARG_1(args, map);
 
 	for(i = 0; i < n; i++)
 	{
 		int vid = vids[i];
 		if (vid == -1) {
-			int n;
-			for(n = 1; n < 4096; n++)
-			{
-				mem[n] = 1;
-			}
+			bitmap_fill(map, VLAN_N_VID);
+			__clear_bit(0, map);
 		}
 		else
-			mem[vid & VLAN_VID_MASK] = 1;
+			__set_bit(vid & VLAN_VID_MASK, map);
 
 		pr_devel("[PFQ|init] vlan_id filter: -> vid %d\n", vid);
 	}
@@ -80,11 +80,11 @@ static int vlan_init(arguments_t args)
 
 static int vlan_fini(arguments_t args)
 {
-	char *mem = GET_ARG_1(char *, args);
+	unsigned long *map = GET_ARG_1(unsigned long *, args);
 
-	kfree(mem);
+	kfree(map);
 
-	pr_devel("[PFQ|init] vlan_id filter: memory freed@%p!\n", mem);
+	pr_devel("[PFQ|init] vlan_id filter: memory freed@%p!\n", map);
 	return 0;
 }
 
@@ -93,6 +93,7 @@ struct pfq_function_descr vlan_functions[] = {
 
 	{ "vlan_id",		"[CInt] -> SkBuff -> Bool",		vlan_id,	vlan_init,	vlan_fini },
 	{ "vlan_id_filter",	"[CInt] -> SkBuff -> Action SkBuff",	vlan_id_filter, vlan_init,	vlan_fini },
+	{ "vlan_in",		"[CInt] -> SkBuff -> Bool",		vlan_id,	vlan_init,	vlan_fini },
 
 	{ NULL }};
 
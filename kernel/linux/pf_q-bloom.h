@@ -0,0 +1,109 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PF_Q_BLOOM_LINUX_H
+#define PF_Q_BLOOM_LINUX_H
+
+#include <linux/pf_q.h>
+
+/*
+ * Cache-line blocked bloom filter, shared by the kernel and user-space (that
+ * can build the bit array and load it with Q_SO_GROUP_BLOOM).
+ *
+ * The filter is an array of 512-bit blocks: the key is hashed once (64 bits),
+ * the upper half selects the block, Q_BLOOM_K fields of 9 bits select the bits
+ * within the block. A lookup touches a single cache line.
+ *
+ * Addresses are hashed in network byte order, as found in the packet.
+ */
+
+#define Q_BLOOM_BLOCK_BITS		512
+#define Q_BLOOM_BLOCK_WORDS		(Q_BLOOM_BLOCK_BITS/64)
+#define Q_BLOOM_K			4
+#define Q_BLOOM_MAX_BLOCKS		(1 << 16)	/* 4 MB */
+
+
+static inline uint64_t
+pfq_bloom_mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+
+static inline uint64_t
+pfq_bloom_hash4(uint32_t addr)
+{
+	return pfq_bloom_mix(addr);
+}
+
+
+static inline uint64_t
+pfq_bloom_hash6(uint32_t const addr[4])
+{
+	uint64_t hi = ((uint64_t)addr[0] << 32) | addr[1];
+	uint64_t lo = ((uint64_t)addr[2] << 32) | addr[3];
+	return pfq_bloom_mix(hi ^ pfq_bloom_mix(lo ^ 0x9e3779b97f4a7c15ULL));
+}
+
+
+static inline uint64_t *
+pfq_bloom_block(uint64_t *bits, size_t nblocks, uint64_t h)
+{
+	return bits + (size_t)(((h >> 32) * nblocks) >> 32) * Q_BLOOM_BLOCK_WORDS;
+}
+
+
+static inline void
+pfq_bloom_set(uint64_t *bits, size_t nblocks, uint64_t h)
+{
+	uint64_t *block = pfq_bloom_block(bits, nblocks, h);
+	int i;
+
+	for(i = 0; i < Q_BLOOM_K; i++, h >>= 9)
+		block[(h & 511) >> 6] |= 1ULL << (h & 63);
+}
+
+
+static inline int
+pfq_bloom_test(uint64_t *bits, size_t nblocks, uint64_t h)
+{
+	uint64_t *block = pfq_bloom_block(bits, nblocks, h);
+	int i;
+
+	for(i = 0; i < Q_BLOOM_K; i++, h >>= 9)
+	{
+		if (!(block[(h & 511) >> 6] & (1ULL << (h & 63))))
+			return 0;
+	}
+
+	return 1;
+}
+
+
+#endif /* PF_Q_BLOOM_LINUX_H */
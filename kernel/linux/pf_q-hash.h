@@ -0,0 +1,211 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PF_Q_HASH_LINUX_H
+#define PF_Q_HASH_LINUX_H
+
+#include <linux/pf_q.h>
+
+#ifdef __KERNEL__
+#include <asm/byteorder.h>
+#if defined(CONFIG_X86)
+#include <asm/cpufeature.h>
+#endif
+#else
+#include <arpa/inet.h>
+#endif
+
+/*
+ * Symmetric flow hashes, shared by the kernel (steering functions) and
+ * user-space (Tx queue selection). Addresses and ports are in network
+ * byte order, as found in the packet.
+ *
+ * Q_HASH_XOR:      legacy xor of addresses and ports (biased).
+ * Q_HASH_TOEPLITZ: Toeplitz with the default RSS key of NICs, over the canonical
+ *                  tuple (lower endpoint first): the hash of a NIC for the
+ *                  direction from the lower endpoint.
+ * Q_HASH_CRC32C:   crc32c (SSE4.2 when available) of the canonical tuple.
+ * Q_HASH_SKB:      the L4 hash computed by the NIC (skb->hash), when present.
+ *                  It is symmetric only if the NIC uses a symmetric key: the
+ *                  fallback (and the user-space counterpart) is Q_HASH_TOEPLITZ.
+ */
+
+#define Q_HASH_XOR			0
+#define Q_HASH_TOEPLITZ			1
+#define Q_HASH_CRC32C			2
+#define Q_HASH_SKB			3
+
+#define Q_HASH_TOEPLITZ_WORDS		10	/* 40-byte key: up to 9 words (IPv6 tuple) */
+
+
+/* Toeplitz of n words (host byte order) with the default RSS key */
+
+static inline uint32_t
+pfq_toeplitz_words(uint32_t const *w, int n)
+{
+	static const uint32_t key[Q_HASH_TOEPLITZ_WORDS] =
+	{
+		0x6d5a56daU, 0x255b0ec2U, 0x4167253dU, 0x43a38fb0U, 0xd0ca2bcbU,
+		0xae7b30b4U, 0x77cb2da3U, 0x8030f20cU, 0x6a42b73bU, 0xbeac01faU
+	};
+
+	uint32_t h = 0;
+	int i, j;
+
+	for(i = 0; i < n; i++)
+	{
+		/* the 32-bit window of the key slides by one bit per input bit */
+
+		uint64_t k = ((uint64_t)key[i] << 32) | key[i+1];
+
+		for(j = 0; j < 32; j++)
+			h ^= (uint32_t)(k >> (32 - j)) & (0U - ((w[i] >> (31 - j)) & 1));
+	}
+
+	return h;
+}
+
+
+/* crc32c (Castagnoli), one 32-bit word, no pre/post inversion */
+
+static inline uint32_t
+__pfq_crc32c_sw(uint32_t crc, uint32_t v)
+{
+	int n;
+
+	crc ^= v;
+	for(n = 0; n < 32; n++)
+		crc = (crc >> 1) ^ (0x82f63b78U & (0U - (crc & 1)));
+
+	return crc;
+}
+
+
+#if defined(__x86_64__) || defined(__i386__)
+
+static inline uint32_t
+__pfq_crc32c_hw(uint32_t crc, uint32_t v)
+{
+	__asm__ ("crc32l %1, %0" : "+r" (crc) : "rm" (v));
+	return crc;
+}
+
+#ifdef __KERNEL__
+#define pfq_crc32c_hw_available()	boot_cpu_has(X86_FEATURE_XMM4_2)
+#else
+#define pfq_crc32c_hw_available()	__builtin_cpu_supports("sse4.2")
+#endif
+
+#else
+
+#define __pfq_crc32c_hw(crc, v)		__pfq_crc32c_sw(crc, v)
+#define pfq_crc32c_hw_available()	0
+
+#endif
+
+
+static inline uint32_t
+pfq_crc32c_words(uint32_t const *w, int n)
+{
+	uint32_t crc = 0xffffffff;
+	int i;
+
+	if (pfq_crc32c_hw_available()) {
+		for(i = 0; i < n; i++)
+			crc = __pfq_crc32c_hw(crc, w[i]);
+	}
+	else {
+		for(i = 0; i < n; i++)
+			crc = __pfq_crc32c_sw(crc, w[i]);
+	}
+
+	return crc;
+}
+
+
+static inline uint32_t
+pfq_sym_hash4(int type, uint32_t saddr, uint32_t daddr, uint16_t sport, uint16_t dport)
+{
+	uint32_t s, d, w[3];
+	uint16_t sp, dp;
+
+	if (type == Q_HASH_XOR)
+		return saddr ^ daddr ^ sport ^ dport;
+
+	s = ntohl(saddr); sp = ntohs(sport);
+	d = ntohl(daddr); dp = ntohs(dport);
+
+	/* canonical order: lower endpoint first */
+
+	if (s < d || (s == d && sp <= dp)) {
+		w[0] = s; w[1] = d; w[2] = ((uint32_t)sp << 16) | dp;
+	}
+	else {
+		w[0] = d; w[1] = s; w[2] = ((uint32_t)dp << 16) | sp;
+	}
+
+	return type == Q_HASH_CRC32C ? pfq_crc32c_words(w, 3) : pfq_toeplitz_words(w, 3);
+}
+
+
+static inline uint32_t
+pfq_sym_hash6(int type, uint32_t const *saddr, uint32_t const *daddr, uint16_t sport, uint16_t dport)
+{
+	uint32_t w[9], x = 0;
+	uint16_t sp, dp;
+	int i, lt = 0;
+
+	if (type == Q_HASH_XOR) {
+		for(i = 0; i < 4; i++)
+			x ^= saddr[i] ^ daddr[i];
+		return x ^ sport ^ dport;
+	}
+
+	sp = ntohs(sport);
+	dp = ntohs(dport);
+
+	for(i = 0; i < 4; i++)
+	{
+		if (saddr[i] != daddr[i]) {
+			lt = ntohl(saddr[i]) < ntohl(daddr[i]) ? 1 : -1;
+			break;
+		}
+	}
+
+	if (lt == 0)
+		lt = sp <= dp ? 1 : -1;
+
+	for(i = 0; i < 4; i++)
+	{
+		w[i]   = ntohl(lt > 0 ? saddr[i] : daddr[i]);
+		w[i+4] = ntohl(lt > 0 ? daddr[i] : saddr[i]);
+	}
+
+	w[8] = lt > 0 ? ((uint32_t)sp << 16) | dp : ((uint32_t)dp << 16) | sp;
+
+	return type == Q_HASH_CRC32C ? pfq_crc32c_words(w, 9) : pfq_toeplitz_words(w, 9);
+}
+
+
+#endif /* PF_Q_HASH_LINUX_H */
@@ -101,6 +101,8 @@ static inline void smp_wmb() { barrier(); }
 
 #define Q_SO_EGRESS_BIND		16
 #define Q_SO_EGRESS_UNBIND		17
+#define Q_SO_GROUP_TABLE		18      /* exact-match tables: create/insert/delete */
+#define Q_SO_GROUP_BLOOM		19      /* load (swap) a bloom filter built in user-space */
 
 #define Q_SO_GET_ID			20
 #define Q_SO_GET_STATUS			21      /* 1 = enabled, 0 = disabled */
@@ -121,6 +123,27 @@ static inline void smp_wmb() { barrier(); }
 #define Q_SO_TX_FLUSH			35
 #define Q_SO_TX_ASYNC			36
 
+#define Q_SO_GET_GROUP_HEAVY_HITTERS	37
+
+#define Q_SO_GROUP_STEERING		38      /* adaptive steering of elephant flows */
+#define Q_SO_GET_GROUP_STEERING		39
+
+#define Q_SO_GET_GROUP_COMPUTATION_STATS 40     /* per-node counters of the group computation */
+
+#define Q_SO_TX_ZEROCOPY		41      /* 1 = Tx from the (hugepage) shared memory without copy */
+#define Q_SO_TX_RING			42      /* 1 = streaming Tx ring of fixed-size slots */
+#define Q_SO_TX_REPLAY			43      /* replay the trace stored in a Tx queue (struct pfq_tx_replay) */
+#define Q_SO_TX_TEMPLATE		44      /* in-kernel generator from packet templates (struct pfq_tx_template) */
+
+#define Q_SO_SET_TX_QUEUES		45      /* max number of Tx queues of the socket (before enable) */
+#define Q_SO_GET_TX_QUEUES		46
+
+
+/* steering modes (Q_SO_GROUP_STEERING) */
+
+#define Q_STEER_FLOW			0	/* strict flow affinity (default) */
+#define Q_STEER_SPRAY			1	/* elephant flows sprayed round-robin (the group tolerates reordering) */
+#define Q_STEER_FLOWLET			2	/* elephant flows moved at flowlet boundaries */
 
 /* general placeholders */
 
@@ -129,7 +152,7 @@ static inline void smp_wmb() { barrier(); }
 #define Q_ANY_GROUP			-1
 
 #define Q_NO_KTHREAD			-1
-#define Q_ANY_CPU			65535
+#define Q_ANY_CPU			65535	/* Tx kernel thread on a cpu of the NUMA node of the device */
 
 /*timestamp*/
 
@@ -168,7 +191,33 @@ static inline void smp_wmb() { barrier(); }
 /*additionalconstants*/
 
 #define Q_MAX_COUNTERS			64
-#define Q_MAX_TX_QUEUES			4
+#define Q_MAX_TX_QUEUES			32
+#define Q_TX_QUEUES_DEFAULT		4	/* Tx queues of a socket, unless Q_SO_SET_TX_QUEUES */
+#define Q_MAX_HEAVY_HITTERS		16
+#define Q_MAX_NODE_STATS		64
+
+/* heavy-hitter keys */
+
+#define Q_HH_KEY_SRC			0	/* IPv4 source address */
+#define Q_HH_KEY_DST			1	/* IPv4 destination address */
+#define Q_HH_KEY_FLOW			2	/* IPv4 5-tuple */
+
+/* exact-match tables */
+
+#define Q_MAX_GROUP_TABLES		8
+
+#define Q_TABLE_KEY_ADDR		0	/* IPv4 address (source or destination) */
+#define Q_TABLE_KEY_FLOW		1	/* IPv4 5-tuple (either direction) */
+
+#define Q_TABLE_CREATE			0
+#define Q_TABLE_DESTROY			1
+#define Q_TABLE_INSERT			2
+#define Q_TABLE_DELETE			3
+#define Q_TABLE_FLUSH			4
+
+/* group bloom filters (see linux/pf_q-bloom.h) */
+
+#define Q_MAX_GROUP_BLOOMS		8
 
 
 /* PFQ socket queue */
@@ -185,8 +234,11 @@ struct pfq_rx_queue
 
 struct pfq_tx_queue
 {
-        unsigned int		prod;
-        unsigned int            cons;
+        unsigned int		prod;       /* Tx ring: slots produced (head) */
+        unsigned int            cons;       /* Tx ring: slots consumed (tail) */
+        unsigned int            done;       /* last half (index) whose packets are released by the driver,
+                                               Tx ring: number of slots released */
+        unsigned int            parked;     /* the kernel thread sleeps: ring the doorbell (Q_SO_TX_FLUSH) */
         size_t			size;	    /* queue length in bytes */
 
 	void __user *		ptr;	    /* reserved for user-space */
@@ -249,6 +301,81 @@ struct pfq_pkthdr_tx
 };
 
 
+/* Tx replay (Q_SO_TX_REPLAY): the trace fills the Tx queue region (both halves),
+ * timestamps are relative to the beginning of the trace; done counts the loops.
+ */
+
+#define Q_REPLAY_REWRITE_IP		1	/* add the loop number to the IPv4 addresses */
+#define Q_REPLAY_REWRITE_MAC		2	/* ... and to the low 24 bits of the MAC addresses */
+
+struct pfq_tx_replay
+{
+	int		queue;
+	int		loops;		/* 0 = forever, -1 = stop */
+	unsigned int	speed;		/* timing multiplier x1000 (1000 = original), 0 = line rate */
+	unsigned int	flags;
+	uint64_t	gap;		/* fixed inter-packet gap (nsec), overrides the original timing */
+};
+
+
+/* Tx template generator (Q_SO_TX_TEMPLATE): the kernel thread of the queue synthesizes
+ * packets from the templates, picked in proportion to their weight (e.g. IMIX), and applies
+ * the mutation rules to each packet; done counts the packets generated.
+ */
+
+#define Q_TX_TEMPLATE_MAX		8
+#define Q_TX_TEMPLATE_MAX_RULES		8
+#define Q_TX_TEMPLATE_MAX_WEIGHT	(1 << 24)	/* weights are capped */
+
+#define Q_TEMPLATE_FIELD_IP_SRC		0	/* IPv4 source address */
+#define Q_TEMPLATE_FIELD_IP_DST		1	/* IPv4 destination address */
+#define Q_TEMPLATE_FIELD_PORT_SRC	2	/* UDP/TCP source port */
+#define Q_TEMPLATE_FIELD_PORT_DST	3	/* UDP/TCP destination port */
+
+#define Q_TEMPLATE_MODE_COUNTER		0	/* min, min+1, ... max, min, ... */
+#define Q_TEMPLATE_MODE_RANDOM		1	/* uniform in [min, max] */
+
+#define Q_TEMPLATE_CSUM			1	/* fix-up IPv4/UDP/TCP checksums (and lengths) */
+
+struct pfq_tx_template_rule
+{
+	uint16_t	field;
+	uint16_t	mode;
+	uint32_t	min;		/* host byte order */
+	uint32_t	max;
+};
+
+struct pfq_tx_template_pkt
+{
+	const void __user *data;
+	size_t		len;
+	unsigned int	weight;		/* relative frequency (0 = 1) */
+};
+
+struct pfq_tx_template
+{
+	int		queue;
+	int		num_pkts;	/* 0 = stop the generator */
+	int		num_rules;
+	unsigned int	flags;
+	uint64_t	count;		/* packets to generate, 0 = forever */
+	uint64_t	gap;		/* inter-packet gap (nsec), 0 = line rate */
+
+	struct pfq_tx_template_pkt  pkt[Q_TX_TEMPLATE_MAX];
+	struct pfq_tx_template_rule rule[Q_TX_TEMPLATE_MAX_RULES];
+};
+
+
+/* Tx forward descriptor (len | Q_TX_FWD): the packet is transmitted from the Rx queue */
+
+#define Q_TX_FWD	(1ULL << 63)
+
+struct pfq_tx_fwd
+{
+	uint64_t offset; /* of the packet, from the beginning of the Rx queue */
+};
+
+
 /*
    +------------------+---------------------+                  +---------------------+          +---------------------+
    | pfq_queue_hdr    | pfq_pkthdr | packet | ...              | pfq_pkthdr | packet |...       | pfq_pkthdr | packet | ...
@@ -267,6 +394,7 @@ struct pfq_pkthdr_tx
  * pod array    -> (ptr,       sizeof,  len)
  * string 	-> (ptr,       0     ,  -1 )
  * expression 	-> (0,         index ,  -1 )
+ * expr. array	-> (ptr,       -1    ,  len)   ptr to len indexes (size_t)
  *
  */
 
@@ -341,6 +469,51 @@ struct pfq_group_context
         int level;
 };
 
+/* exact-match table entry (addresses and ports in network byte order) */
+
+struct pfq_table_entry
+{
+        uint32_t saddr;         /* Q_TABLE_KEY_ADDR: the address */
+        uint32_t daddr;
+        uint16_t sport;
+        uint16_t dport;
+        uint8_t  proto;
+        uint8_t  pad[3];
+        uint32_t value;         /* steering hash used by steer_table */
+};
+
+struct pfq_group_table
+{
+        int gid;
+        int table;              /* table index, < Q_MAX_GROUP_TABLES */
+        int op;                 /* Q_TABLE_CREATE, Q_TABLE_INSERT... */
+        int type;               /* Q_TABLE_CREATE: key type */
+        size_t size;            /* Q_TABLE_CREATE: expected entries, otherwise number of entries */
+        struct pfq_table_entry __user *entries;
+};
+
+struct pfq_group_bloom
+{
+        int gid;
+        int filter;             /* filter index, < Q_MAX_GROUP_BLOOMS */
+        int ipv;                /* 4 or 6 */
+        int prefix;             /* network prefix applied to addresses */
+        size_t size;            /* bytes, multiple of 64 (0 = remove the filter) */
+        const void __user *bits;
+};
+
+/* adaptive steering: mice keep the flow affinity, elephants are spread across the sockets */
+
+struct pfq_group_steering
+{
+        int gid;
+        int mode;               /* Q_STEER_FLOW, Q_STEER_SPRAY or Q_STEER_FLOWLET */
+        unsigned int rate;      /* elephant threshold in Mbit/s (0 = default) */
+        unsigned int flowlet;   /* flowlet gap in usec (0 = default) */
+        unsigned long promoted; /* get: flows promoted to elephant */
+        unsigned long sprayed;  /* get: packets of elephant flows steered adaptively */
+};
+
 /* pfq_fprog: per-group sock_fprog */
 
 struct pfq_fprog
@@ -373,4 +546,40 @@ struct pfq_counters
         unsigned long int counter[Q_MAX_COUNTERS];
 };
 
+
+/* pfq heavy hitters for groups (merged count-min sketch + top-K) */
+
+struct pfq_heavy_hitter
+{
+        uint64_t key;           /* IPv4 address(es) or property value */
+        uint64_t aux;           /* 5-tuple: protocol << 32 | sport << 16 | dport */
+        uint64_t count;         /* estimated number of packets */
+};
+
+struct pfq_heavy_hitters
+{
+        int      gid;
+        int      size;          /* number of valid entries */
+        uint64_t total;         /* packets accounted by the sketch */
+        struct pfq_heavy_hitter entry[Q_MAX_HEAVY_HITTERS];
+};
+
+
+/* pfq per-node counters of the group computation (enabled with lang_stats) */
+
+struct pfq_node_stats
+{
+        uint64_t calls;         /* evaluations of the node */
+        uint64_t pass;          /* packets passed to the next node */
+        uint64_t drop;          /* packets dropped by the node */
+        uint64_t cycles;        /* cumulative cycles (get_cycles) */
+};
+
+struct pfq_computation_stats
+{
+        int      gid;
+        int      size;          /* number of nodes (at most Q_MAX_NODE_STATS) */
+        struct pfq_node_stats node[Q_MAX_NODE_STATS];
+};
+
 #endif /* PF_Q_LINUX_H */
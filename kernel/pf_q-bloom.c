@@ -0,0 +1,91 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/inetdevice.h>
+
+#include <pf_q-bloom.h>
+
+
+struct pfq_bloom *
+pfq_bloom_alloc(size_t nblocks, int ipv, int prefix)
+{
+	struct pfq_bloom *bloom;
+	int i;
+
+	if (nblocks == 0 || nblocks > Q_BLOOM_MAX_BLOCKS)
+		return NULL;
+
+	if (ipv != 4 && ipv != 6)
+		return NULL;
+
+	if (prefix < 0 || prefix > (ipv == 4 ? 32 : 128))
+		return NULL;
+
+	bloom = kzalloc(sizeof(struct pfq_bloom), GFP_KERNEL);
+	if (!bloom)
+		return NULL;
+
+	bloom->bits = vzalloc(nblocks * Q_BLOOM_BLOCK_BITS/8);
+	if (!bloom->bits) {
+		kfree(bloom);
+		return NULL;
+	}
+
+	bloom->nblocks = nblocks;
+	bloom->ipv = ipv;
+
+	for(i = 0; i < 4; i++, prefix -= 32)
+		bloom->mask[i] = inet_make_mask(clamp(prefix, 0, 32));
+
+	pr_devel("[PFQ] bloom@%p: IPv%d, %zu blocks (%zu bytes)\n", bloom, ipv, nblocks, nblocks * Q_BLOOM_BLOCK_BITS/8);
+	return bloom;
+}
+
+
+void
+pfq_bloom_free(struct pfq_bloom *bloom)
+{
+	if (bloom) {
+		vfree(bloom->bits);
+		kfree(bloom);
+	}
+}
+
+
+void
+pfq_bloom_insert(struct pfq_bloom *bloom, __be32 const *addr)
+{
+	uint32_t a[4];
+	int i;
+
+	for(i = 0; i < (bloom->ipv == 4 ? 1 : 4); i++)
+		a[i] = (__force uint32_t)(addr[i] & bloom->mask[i]);
+
+	pfq_bloom_set(bloom->bits, bloom->nblocks, bloom->ipv == 4 ? pfq_bloom_hash4(a[0]) : pfq_bloom_hash6(a));
+}
+
@@ -0,0 +1,71 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PF_Q_BLOOM_H
+#define PF_Q_BLOOM_H
+
+#include <linux/kernel.h>
+#include <linux/in6.h>
+
+#include <linux/pf_q.h>
+#include <linux/pf_q-bloom.h>
+
+
+struct pfq_bloom
+{
+	size_t		nblocks;
+	int		ipv;		/* 4 or 6 */
+	__be32		mask[4];	/* network mask (IPv4: mask[0]) */
+	uint64_t	*bits;		/* page aligned: blocks are cache-line aligned */
+};
+
+
+extern struct pfq_bloom * pfq_bloom_alloc(size_t nblocks, int ipv, int prefix);
+extern void pfq_bloom_free(struct pfq_bloom *bloom);
+
+extern void pfq_bloom_insert(struct pfq_bloom *bloom, __be32 const *addr);
+
+
+static inline bool
+pfq_bloom_match(struct pfq_bloom *bloom, __be32 addr)
+{
+	return pfq_bloom_test(bloom->bits, bloom->nblocks, pfq_bloom_hash4((__force uint32_t)(addr & bloom->mask[0])));
+}
+
+
+static inline bool
+pfq_bloom_match6(struct pfq_bloom *bloom, struct in6_addr const *addr)
+{
+	uint32_t a[4];
+
+	a[0] = (__force uint32_t)(addr->s6_addr32[0] & bloom->mask[0]);
+	a[1] = (__force uint32_t)(addr->s6_addr32[1] & bloom->mask[1]);
+	a[2] = (__force uint32_t)(addr->s6_addr32[2] & bloom->mask[2]);
+	a[3] = (__force uint32_t)(addr->s6_addr32[3] & bloom->mask[3]);
+
+	return pfq_bloom_test(bloom->bits, bloom->nblocks, pfq_bloom_hash6(a));
+}
+
+
+#endif /* PF_Q_BLOOM_H */
@@ -0,0 +1,154 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+
+#ifndef PF_Q_ELEPHANT_H
+#define PF_Q_ELEPHANT_H
+
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/pf_q.h>
+
+/*
+ * Elephant flow detector for the adaptive steering (per-cpu).
+ *
+ * A small direct-mapped table of byte counters, indexed by the steering hash.
+ * A flow that exceeds the threshold in a window of Q_ELEPHANT_WINDOW_NS is
+ * promoted to elephant, and demoted when it falls below half of it.
+ * With RSS a flow is received by a single cpu, so per-cpu counters see it whole.
+ */
+
+#define Q_ELEPHANT_FLOWS		256
+#define Q_ELEPHANT_FLOWS_MASK		(Q_ELEPHANT_FLOWS-1)
+
+#define Q_ELEPHANT_WINDOW_NS		NSEC_PER_MSEC
+#define Q_ELEPHANT_DEFAULT_RATE		1000		/* Mbit/s */
+#define Q_ELEPHANT_DEFAULT_FLOWLET	500		/* usec */
+#define Q_ELEPHANT_NO_SOCK		0xffff		/* flowlet: still on the affinity socket */
+
+
+struct pfq_elephant_flow
+{
+	uint32_t	hash;
+	uint32_t	bytes;		/* bytes in the current window */
+	uint64_t	window;		/* start of the current window (nsec) */
+	uint64_t	last;		/* last packet (nsec) */
+	uint16_t	sock;		/* flowlet: index of the current socket, or Q_ELEPHANT_NO_SOCK */
+	uint8_t		elephant;
+	uint8_t		valid;
+};
+
+
+struct pfq_elephant_cpu
+{
+	struct pfq_elephant_flow flow[Q_ELEPHANT_FLOWS];
+	unsigned int		 rr;	/* round-robin index */
+
+} ____cacheline_aligned;
+
+
+extern struct pfq_elephant_cpu __percpu * pfq_elephant_alloc(void);
+extern void pfq_elephant_free(struct pfq_elephant_cpu __percpu *el);
+
+
+/*
+ * Hot path (per-cpu data, soft-irq disabled): return the index of the socket
+ * for an elephant flow, or -1 to keep the flow affinity. *promoted is set when the
+ * flow has just been promoted.
+ *
+ * Q_STEER_SPRAY picks a socket per packet: the packets of an elephant are
+ * reordered by design. Q_STEER_FLOWLET keeps a promoted flow on its affinity
+ * socket and moves it only when idle for more than gap, so that a burst in
+ * flight is never split.
+ */
+
+static inline int
+pfq_elephant_steer(struct pfq_elephant_cpu *ec, int mode, uint32_t threshold, uint64_t gap,
+		   uint32_t hash, unsigned int len, int sock_cnt, bool *promoted)
+{
+	struct pfq_elephant_flow *f = &ec->flow[(hash ^ (hash >> 16)) & Q_ELEPHANT_FLOWS_MASK];
+	uint64_t now = local_clock();
+
+	*promoted = false;
+
+	if (unlikely(!f->valid || f->hash != hash)) {
+
+		/* do not evict an active elephant: the colliding flow keeps the affinity */
+
+		if (f->valid && f->elephant && (now - f->last) < Q_ELEPHANT_WINDOW_NS)
+			return -1;
+
+		f->hash	    = hash;
+		f->bytes    = 0;
+		f->window   = now;
+		f->last	    = now;
+		f->elephant = 0;
+		f->valid    = 1;
+	}
+
+	if (now - f->window >= Q_ELEPHANT_WINDOW_NS) {
+
+		if (f->elephant && f->bytes < threshold/2)
+			f->elephant = 0;
+
+		f->bytes  = 0;
+		f->window = now;
+	}
+
+	f->bytes += len;
+
+	if (!f->elephant) {
+
+		if (f->bytes < threshold) {
+			f->last = now;
+			return -1;
+		}
+
+		f->elephant = 1;
+		f->sock = Q_ELEPHANT_NO_SOCK;
+		*promoted = true;
+	}
+
+	if (mode == Q_STEER_FLOWLET) {
+
+		/* a new flowlet can be moved without reordering the previous one */
+
+		if (now - f->last > gap)
+			f->sock = ec->rr++ % Q_ELEPHANT_NO_SOCK;
+
+		if (f->sock == Q_ELEPHANT_NO_SOCK) {
+			f->last = now;
+			return -1;
+		}
+	}
+	else
+		f->sock = ec->rr++;
+
+	f->last = now;
+	return f->sock % sock_cnt;
+}
+
+
+#endif /* PF_Q_ELEPHANT_H */
@@ -25,8 +25,12 @@
 #include <linux/printk.h>
 #include <linux/pf_q.h>
 
+#include <linux/percpu.h>
+#include <linux/timex.h>
+
 #include <asm/uaccess.h>
 
+#include <pf_q-global.h>
 #include <pf_q-group.h>
 #include <pf_q-engine.h>
 #include <pf_q-module.h>
@@ -155,48 +159,113 @@ pfq_bind(SkBuff b, struct pfq_computation_tree *prg)
 }
 
 
-Action_SkBuff
-pfq_run(struct pfq_computation_tree *prg, SkBuff b)
+/* pfq_bind with per-node counters (lang_stats) */
+
+static Action_SkBuff
+pfq_bind_stats(SkBuff b, struct pfq_computation_tree *prg)
 {
-#ifdef PFQ_LANG_PROFILE
-	static uint64_t nrun, total;
-	uint64_t stop, start;
-#endif
+        struct pfq_functional_node *node = prg->entry_point;
+
+        while (node)
+        {
+		struct pfq_node_stats *st = this_cpu_ptr(node->stats);
+		cycles_t start = get_cycles();
+                fanout_t *a;
+
+                b = pfq_apply(&node->fun, b).value;
+
+		st->cycles += get_cycles() - start;
+		st->calls++;
+
+                if (b.skb == NULL) {
+			st->drop++;
+                        return Pass(b);
+		}
+
+                a = &PFQ_CB(b.skb)->monad->fanout;
+
+                if (is_drop(*a)) {
+			st->drop++;
+                        return Pass(b);
+		}
+
+		st->pass++;
+                node = node->next;
+        }
+
+        return Pass(b);
+}
 
-#ifdef PFQ_LANG_PROFILE
-	start = get_cycles();
 
-	b =
-#else
-	return
-#endif
+Action_SkBuff
+pfq_run(struct pfq_computation_tree *prg, SkBuff b)
+{
+	if (unlikely(lang_stats))
+		return pfq_bind_stats(b, prg);
 
-	pfq_bind(b, prg);
+	return pfq_bind(b, prg);
+}
 
-#ifdef PFQ_LANG_PROFILE
 
-	stop = get_cycles();
-	total += (stop-start);
+void
+pfq_computation_node_stats(struct pfq_functional_node const *node, struct pfq_node_stats *ret)
+{
+	int cpu;
 
-	if ((nrun++ % 1048576) == 0)
-		printk(KERN_INFO "[PFQ] PFQ/lang run: %llu_tsc.\n", total/nrun);
+	memset(ret, 0, sizeof(*ret));
 
-	return b;
-#endif
+	for_each_possible_cpu(cpu)
+	{
+		struct pfq_node_stats const *st = per_cpu_ptr(node->stats, cpu);
 
+		ret->calls  += st->calls;
+		ret->pass   += st->pass;
+		ret->drop   += st->drop;
+		ret->cycles += st->cycles;
+	}
 }
 
 
 struct pfq_computation_tree *
 pfq_computation_alloc (struct pfq_computation_descr const *descr)
 {
-        struct pfq_computation_tree * c = kzalloc(sizeof(size_t) + descr->size * sizeof(struct pfq_functional_node),
+        struct pfq_computation_tree * c = kzalloc(sizeof(struct pfq_computation_tree) + descr->size * sizeof(struct pfq_functional_node),
 						  GFP_KERNEL);
+	size_t n;
+
+	if (c == NULL)
+		return NULL;
+
         c->size = descr->size;
+
+	for(n = 0; n < c->size; n++)
+	{
+		c->node[n].stats = alloc_percpu(struct pfq_node_stats);
+		if (c->node[n].stats == NULL) {
+			pfq_computation_free(c);
+			return NULL;
+		}
+	}
+
         return c;
 }
 
 
+void
+pfq_computation_free(struct pfq_computation_tree *comp)
+{
+	size_t n;
+
+	if (comp == NULL)
+		return;
+
+	for(n = 0; n < comp->size; n++)
+		free_percpu(comp->node[n].stats);
+
+	kfree(comp);
+}
+
+
 void *
 pfq_context_alloc(struct pfq_computation_descr const *descr)
 {
@@ -213,6 +282,7 @@ pfq_context_alloc(struct pfq_computation_descr const *descr)
 			if (fun->arg[i].addr) {
 
 				size_t s = is_arg_string(&fun->arg[i])     ?  strlen_user(fun->arg[i].addr) :
+					   is_arg_vector_fun(&fun->arg[i]) ?  fun->arg[i].nelem * sizeof(size_t) :
 					   is_arg_vector(&fun->arg[i])	   ?  fun->arg[i].size * fun->arg[i].nelem :
 					   is_arg_vector_str(&fun->arg[i]) ?  fun->arg[i].nelem * sizeof(char *) + strlen_user(fun->arg[i].addr) :
 					   is_arg_data  (&fun->arg[i])	   ?  (fun->arg[i].size > 8 ? fun->arg[i].size : 0 ) : 0;
@@ -339,6 +409,42 @@ check_argument_descr(struct pfq_functional_arg_descr const *arg, string_view_t e
 }
 
 
+static int
+check_argument_vector_fun(struct pfq_computation_descr const *descr,
+			  struct pfq_functional_arg_descr const *arg, string_view_t expected, size_t index)
+{
+	const size_t __user *idx = arg->addr;
+	string_view_t type;
+	size_t n;
+
+	if (string_view_at(expected, 0) != '[') {
+		pr_devel("[PFQ] %zu: invalid argument: expected " SVIEW_FMT ", got a list of functions!\n",
+			 index, SVIEW_ARG(expected));
+		return -EPERM;
+	}
+
+	type = pfq_signature_remove_extent(expected);
+
+	for(n = 0; n < arg->nelem; n++)
+	{
+		size_t x;
+
+		if (get_user(x, idx + n))
+			return -EFAULT;
+
+		if (x >= descr->size || x == index) {
+			pr_devel("[PFQ] %zu: invalid function index %zu in list!\n", index, x);
+			return -EPERM;
+		}
+
+		if (!function_signature_match(&descr->fun[x], type, x))
+			return -EPERM;
+	}
+
+	return 0;
+}
+
+
 int
 pfq_check_computation_descr(struct pfq_computation_descr const *descr)
 {
@@ -415,6 +521,15 @@ pfq_check_computation_descr(struct pfq_computation_descr const *descr)
 				continue;
 			}
 
+			if (is_arg_vector_fun(&fun->arg[i])) {
+				if (check_argument_vector_fun(descr, &fun->arg[i], sarg, n) < 0) {
+					printk(KERN_INFO "[PFQ] %zu: %s: invalid argument(%d): expected "
+					       SVIEW_FMT "!\n", n, signature, i, SVIEW_ARG(sarg));
+					return -EPERM;
+				}
+				continue;
+			}
+
 			if (check_argument_descr(&fun->arg[i], sarg) != 0) {
 				printk(KERN_INFO "[PFQ] %zu: invalid argument %d!\n", n, i);
 				return -EPERM;
@@ -625,6 +740,41 @@ pfq_computation_rtlink(struct pfq_computation_descr const *descr, struct pfq_com
 				}
 
 			}
+			else if (is_arg_vector_fun(&fun->arg[i])) {
+
+				struct pfq_functional_node **node = NULL;
+				string_view_t type;
+				size_t j;
+
+				if (fun->arg[i].nelem > 0) {
+
+					size_t *idx = pod_user(&context, fun->arg[i].addr,
+							       sizeof(size_t) * fun->arg[i].nelem);
+					if (idx == NULL) {
+						printk(KERN_INFO "[PFQ] %zu: pod_user(5): internal error!\n", n);
+						return -EPERM;
+					}
+
+					/* user memory is read again here: validate the indexes once more,
+					 * then replace them in place by the linked nodes */
+
+					type = pfq_signature_remove_extent(pfq_signature_arg(make_string_view(signature), i));
+
+					node = (struct pfq_functional_node **)idx;
+					for(j = 0; j < fun->arg[i].nelem; j++)
+					{
+						if (idx[j] >= descr->size ||
+						    !function_signature_match(&descr->fun[idx[j]], type, idx[j])) {
+							printk(KERN_INFO "[PFQ] %zu: rtlink: bad function list!\n", n);
+							return -EPERM;
+						}
+						node[j] = get_functional_by_index(descr, comp, idx[j]);
+					}
+				}
+
+				comp->node[n].fun.arg[i].value = (ptrdiff_t)node;
+				comp->node[n].fun.arg[i].nelem = fun->arg[i].nelem;
+			}
 			else if (is_arg_vector(&fun->arg[i])) {
 
 				if (fun->arg[i].nelem > 0) {
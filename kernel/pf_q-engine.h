@@ -42,7 +42,7 @@ static inline bool is_arg_data(struct pfq_functional_arg_descr const *arg)
 
 static inline bool is_arg_vector(struct pfq_functional_arg_descr const *arg)
 {
-	return arg->size != 0 && arg->nelem != -1;
+	return arg->size != 0 && arg->size != -1 && arg->nelem != -1;
 }
 
 static inline bool is_arg_string(struct pfq_functional_arg_descr const *arg)
@@ -60,6 +60,11 @@ static inline bool is_arg_function(struct pfq_functional_arg_descr const *arg)
 	return !arg->addr && arg->size != 0 && arg->nelem == -1;
 }
 
+static inline bool is_arg_vector_fun(struct pfq_functional_arg_descr const *arg)
+{
+	return arg->size == -1 && arg->nelem != -1;
+}
+
 
 extern int pfq_check_computation_descr(struct pfq_computation_descr const *
 				       descr);
@@ -72,6 +77,8 @@ extern int pfq_computation_init(struct pfq_computation_tree *comp);
 extern int pfq_computation_fini(struct pfq_computation_tree *comp);
 
 extern struct pfq_computation_tree * pfq_computation_alloc(struct pfq_computation_descr const *);
+extern void pfq_computation_free(struct pfq_computation_tree *comp);
+extern void pfq_computation_node_stats(struct pfq_functional_node const *node, struct pfq_node_stats *ret);
 extern void * pfq_context_alloc(struct pfq_computation_descr const *);
 extern const char *pfq_signature_by_user_symbol(const char __user *symb);
 extern size_t pfq_number_of_arguments(struct pfq_functional_descr const *fun);
@@ -25,6 +25,8 @@
 #include <linux/module.h>
 #include <linux/types.h>
 
+#include <linux/pf_q-hash.h>
+
 #include <pf_q-global.h>
 
 
@@ -42,10 +44,24 @@ int max_len		= 1514;
 int batch_len		= 1;
 int vl_untag		= 0;
 
+int steer_hash		= Q_HASH_CRC32C;	/* hash family of the steering functions */
+int lang_profile	= 0;			/* predicate profiling period (evaluations), 0 = disabled */
+int lang_stats		= 0;			/* per-node counters of computations */
+
 int skb_pool_size	= 1024;
 int tx_max_retry	= 1024;
 
+int tx_pacing_window	= 0;			/* launch packets up to N nsec ahead of time, in the same batch */
+int tx_pacing_sleep	= 100;			/* sleep on a hrtimer for gaps longer than N usec, 0 = spin */
+
+int tx_idle_spin	= 1000;			/* usec a kernel thread polls an idle queue before sleeping */
+int tx_idle_sleep	= 200;			/* usec an idle kernel thread sleeps, 0 = never sleep */
+int tx_park_timeout	= 10000;		/* usec a parked kernel thread sleeps without doorbell, 0 = never park */
+
+int tx_aggr		= 1024;			/* skbs handed over to the owner of a hw queue, 0 = no aggregation */
+
 struct pfq_global_stats global_stats;
 struct pfq_memory_stats memory_stats;
+struct pfq_pacing_stats pacing_stats;
 
 
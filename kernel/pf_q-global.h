@@ -45,11 +45,25 @@ extern int batch_len;
 
 extern int vl_untag;
 
+extern int steer_hash;
+extern int lang_profile;
+extern int lang_stats;
+
 extern int skb_pool_size;
 extern int tx_max_retry;
 
+extern int tx_pacing_window;
+extern int tx_pacing_sleep;
+
+extern int tx_idle_spin;
+extern int tx_idle_sleep;
+extern int tx_park_timeout;
+
+extern int tx_aggr;
+
 extern struct pfq_global_stats global_stats;
 extern struct pfq_memory_stats memory_stats;
+extern struct pfq_pacing_stats pacing_stats;
 
 
 #endif /* PF_Q_GLOBAL_H */
@@ -32,6 +32,9 @@
 #include <pf_q-devmap.h>
 #include <pf_q-bitops.h>
 #include <pf_q-engine.h>
+#include <pf_q-table.h>
+#include <pf_q-bloom.h>
+#include <pf_q-elephant.h>
 
 
 DEFINE_SEMAPHORE(group_sem);
@@ -136,6 +139,22 @@ __pfq_group_init(pfq_gid_t gid)
         atomic_long_set(&g->bp_filter,0L);
         atomic_long_set(&g->comp,     0L);
         atomic_long_set(&g->comp_ctx, 0L);
+        atomic_long_set(&g->sketch,   0L);
+        atomic_long_set(&g->elephant, 0L);
+
+        g->steer_mode = Q_STEER_FLOW;
+        g->elephant_bytes = 0;
+        g->flowlet_gap = 0;
+
+        for(i = 0; i < Q_MAX_GROUP_TABLES; i++)
+        {
+                RCU_INIT_POINTER(g->table[i], NULL);
+        }
+
+        for(i = 0; i < Q_MAX_GROUP_BLOOMS; i++)
+        {
+                RCU_INIT_POINTER(g->bloom[i], NULL);
+        }
 
 	pfq_group_stats_reset(&g->stats);
 
@@ -158,7 +177,9 @@ __pfq_group_free(pfq_gid_t gid)
         struct pfq_group * g;
         struct sk_filter *filter;
         struct pfq_computation_tree *old_comp;
+        struct pfq_elephant_cpu __percpu *old_el;
         void *old_ctx;
+        int i;
 
 	g = pfq_get_group(gid);
         if (g == NULL)
@@ -176,6 +197,9 @@ __pfq_group_free(pfq_gid_t gid)
         old_comp = (struct pfq_computation_tree *)atomic_long_xchg(&g->comp, 0L);
         old_ctx  = (void *)atomic_long_xchg(&g->comp_ctx, 0L);
 
+        g->steer_mode = Q_STEER_FLOW;
+        old_el = (struct pfq_elephant_cpu __percpu *)atomic_long_xchg(&g->elephant, 0L);
+
         msleep(Q_GRACE_PERIOD);   /* sleeping is possible here: user-context */
 
 	/* call fini on old computation */
@@ -183,12 +207,38 @@ __pfq_group_free(pfq_gid_t gid)
 	if (old_comp)
 		pfq_computation_fini(old_comp);
 
-	kfree(old_comp);
+	pfq_computation_free(old_comp);
 	kfree(old_ctx);
 
 	if (filter)
 		pfq_free_sk_filter(filter);
 
+	pfq_elephant_free(old_el);
+
+	/* release exact-match tables */
+
+	for(i = 0; i < Q_MAX_GROUP_TABLES; i++)
+	{
+		struct pfq_table *table = rcu_dereference_protected(g->table[i], 1);
+		if (table) {
+			RCU_INIT_POINTER(g->table[i], NULL);
+			synchronize_rcu();
+			pfq_table_free(table);
+		}
+	}
+
+	/* release bloom filters */
+
+	for(i = 0; i < Q_MAX_GROUP_BLOOMS; i++)
+	{
+		struct pfq_bloom *bloom = rcu_dereference_protected(g->bloom[i], 1);
+		if (bloom) {
+			RCU_INIT_POINTER(g->bloom[i], NULL);
+			synchronize_rcu();
+			pfq_bloom_free(bloom);
+		}
+	}
+
         g->vlan_filt = false;
 
         pr_devel("[PFQ] group %d destroyed.\n", gid.value);
@@ -327,7 +377,7 @@ pfq_set_group_prog(pfq_gid_t gid, struct pfq_computation_tree *comp, void *ctx)
 
         /* free the old computation/context */
 
-        kfree(old_comp);
+        pfq_computation_free(old_comp);
         kfree(old_ctx);
 
         up(&group_sem);
@@ -335,6 +385,96 @@ pfq_set_group_prog(pfq_gid_t gid, struct pfq_computation_tree *comp, void *ctx)
 }
 
 
+int
+pfq_set_group_table(pfq_gid_t gid, int n, struct pfq_table *table)
+{
+        struct pfq_group * g;
+        struct pfq_table *old_table;
+
+	g = pfq_get_group(gid);
+        if (g == NULL || n < 0 || n >= Q_MAX_GROUP_TABLES)
+                return -EINVAL;
+
+        down(&group_sem);
+
+        old_table = rcu_dereference_protected(g->table[n], 1);
+        rcu_assign_pointer(g->table[n], table);
+
+        if (old_table) {
+                synchronize_rcu();
+                pfq_table_free(old_table);
+        }
+
+        up(&group_sem);
+        return 0;
+}
+
+
+int
+pfq_set_group_bloom(pfq_gid_t gid, int n, struct pfq_bloom *bloom)
+{
+        struct pfq_group * g;
+        struct pfq_bloom *old_bloom;
+
+	g = pfq_get_group(gid);
+        if (g == NULL || n < 0 || n >= Q_MAX_GROUP_BLOOMS)
+                return -EINVAL;
+
+        down(&group_sem);
+
+        old_bloom = rcu_dereference_protected(g->bloom[n], 1);
+        rcu_assign_pointer(g->bloom[n], bloom);
+
+        if (old_bloom) {
+                synchronize_rcu();
+                pfq_bloom_free(old_bloom);
+        }
+
+        up(&group_sem);
+        return 0;
+}
+
+
+int
+pfq_set_group_steering(pfq_gid_t gid, int mode, unsigned int rate, unsigned int flowlet)
+{
+        struct pfq_group * g;
+        struct pfq_elephant_cpu __percpu *el;
+
+	g = pfq_get_group(gid);
+        if (g == NULL || mode < Q_STEER_FLOW || mode > Q_STEER_FLOWLET)
+                return -EINVAL;
+
+        down(&group_sem);
+
+        /* the detector is allocated on first use and released with the group */
+
+        if (mode != Q_STEER_FLOW && atomic_long_read(&g->elephant) == 0) {
+
+                el = pfq_elephant_alloc();
+                if (el == NULL) {
+                        up(&group_sem);
+                        return -ENOMEM;
+                }
+
+                atomic_long_set(&g->elephant, (long)el);
+        }
+
+        /* Mbit/s -> bytes per window */
+
+        g->elephant_bytes = (uint32_t)min_t(uint64_t, UINT_MAX,
+                        div_u64((uint64_t)(rate ? rate : Q_ELEPHANT_DEFAULT_RATE) * 125000 * Q_ELEPHANT_WINDOW_NS, NSEC_PER_SEC));
+        g->flowlet_gap = (uint64_t)(flowlet ? flowlet : Q_ELEPHANT_DEFAULT_FLOWLET) * NSEC_PER_USEC;
+
+        smp_wmb();
+
+        g->steer_mode = mode;
+
+        up(&group_sem);
+        return 0;
+}
+
+
 int
 pfq_join_group(pfq_gid_t gid, pfq_id_t id, unsigned long class_mask, int policy)
 {
@@ -37,6 +37,9 @@
 #include <pf_q-stats.h>
 #include <pf_q-bpf.h>
 
+struct pfq_table;
+struct pfq_bloom;
+
 /* persistent state */
 
 typedef struct
@@ -74,6 +77,15 @@ struct pfq_group
 
         atomic_long_t comp;                             /* struct pfq_computation_tree *  (new functional program) */
         atomic_long_t comp_ctx;                         /* void *: storage context (new functional program) */
+        atomic_long_t sketch;                           /* struct pfq_sketch *: heavy-hitter sketch (owned by the computation) */
+
+        struct pfq_table __rcu *table[Q_MAX_GROUP_TABLES]; /* exact-match tables (RCU) */
+        struct pfq_bloom __rcu *bloom[Q_MAX_GROUP_BLOOMS]; /* bloom filters loaded from user-space (RCU) */
+
+        int steer_mode;                                 /* Q_STEER_FLOW, Q_STEER_SPRAY or Q_STEER_FLOWLET */
+        uint32_t elephant_bytes;                        /* elephant threshold (bytes per window) */
+        uint64_t flowlet_gap;                           /* flowlet gap (nsec) */
+        atomic_long_t elephant;                         /* struct pfq_elephant_cpu __percpu *: elephant flow detector */
 
 	struct pfq_group_stats stats;
 
@@ -89,6 +101,9 @@ extern int  pfq_join_free_group(pfq_id_t id, unsigned long class_mask, int polic
 extern int  pfq_join_group(pfq_gid_t gid, pfq_id_t id, unsigned long class_mask, int policy);
 extern int  pfq_leave_group(pfq_gid_t gid, pfq_id_t id);
 extern int  pfq_set_group_prog(pfq_gid_t gid, struct pfq_computation_tree *prog, void *ctx);
+extern int  pfq_set_group_table(pfq_gid_t gid, int n, struct pfq_table *table);
+extern int  pfq_set_group_bloom(pfq_gid_t gid, int n, struct pfq_bloom *bloom);
+extern int  pfq_set_group_steering(pfq_gid_t gid, int mode, unsigned int rate, unsigned int flowlet);
 extern void pfq_leave_all_groups(pfq_id_t id);
 
 extern unsigned long pfq_get_groups(pfq_id_t id);
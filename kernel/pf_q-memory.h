@@ -250,6 +250,9 @@ int pfq_skb_pool_init(void)
 		if (pfq_sk_buff_pool_init(&this_cpu->tx_pool, skb_pool_size) != 0)
 			return -ENOMEM;
 
+		if (pfq_sk_buff_pool_init(&this_cpu->tx_small_pool, skb_pool_size) != 0)
+			return -ENOMEM;
+
 		if (pfq_sk_buff_pool_init(&this_cpu->rx_pool, skb_pool_size) != 0)
 			return -ENOMEM;
 	}
@@ -285,6 +288,7 @@ int pfq_skb_pool_purge(void)
 
 		total += pfq_sk_buff_pool_free(&local->rx_pool);
 		total += pfq_sk_buff_pool_free(&local->tx_pool);
+		total += pfq_sk_buff_pool_free(&local->tx_small_pool);
 	}
 
 	return total;
@@ -325,6 +329,25 @@ struct sk_buff * pfq_tx_alloc_skb(unsigned int size, gfp_t priority, int node)
 }
 
 
+/* small skbs (zero-copy headers, copybreak) are recycled by a pool of their own */
+
+static inline
+struct sk_buff * pfq_tx_alloc_small_skb(unsigned int size, gfp_t priority, int node)
+{
+#ifdef PFQ_USE_SKB_POOL
+	struct local_data *this_cpu = this_cpu_ptr(cpu_data);
+
+	if (atomic_read(&this_cpu->enable_skb_pool))
+		return ____pfq_alloc_skb_pool(size, priority, 0, node, &this_cpu->tx_small_pool);
+
+#ifdef PFQ_USE_EXTENDED_PROC
+	sparse_inc(&memory_stats.os_alloc);
+#endif
+#endif
+	return __alloc_skb(size, priority, 0, NUMA_NO_NODE);
+}
+
+
 static inline
 struct sk_buff * pfq_alloc_skb_fclone(unsigned int size, gfp_t priority)
 {
@@ -168,6 +168,8 @@ struct pfq_functional_node
 
 	bool		      initialized;
 
+	struct pfq_node_stats __percpu *stats;	/* per-cpu counters (lang_stats) */
+
 	struct pfq_functional_node *next;
 };
 
@@ -232,6 +234,11 @@ extern struct pfq_function_descr  property_functions[];
 extern struct pfq_function_descr  high_order_functions[];
 extern struct pfq_function_descr  misc_functions[];
 extern struct pfq_function_descr  dummy_functions[];
+extern struct pfq_function_descr  flow_functions[];
+extern struct pfq_function_descr  prefix_functions[];
+extern struct pfq_function_descr  tunnel_functions[];
+extern struct pfq_function_descr  payload_functions[];
+extern struct pfq_function_descr  set_functions[];
 
 
 #endif /* PF_Q_MODULE_H */
@@ -61,6 +61,30 @@ typedef struct
 } fanout_t;
 
 
+/* encapsulations (bitmask) */
+
+#define Q_TUNNEL_QINQ		(1 << 0)
+#define Q_TUNNEL_MPLS		(1 << 1)
+#define Q_TUNNEL_GRE		(1 << 2)
+#define Q_TUNNEL_VXLAN		(1 << 3)
+#define Q_TUNNEL_GTP_U		(1 << 4)
+#define Q_TUNNEL_GTP_C		(1 << 5)
+
+
+/* parsed headers: the decapsulation is done once per packet, on first use (functional/tunnel.c) */
+
+typedef struct
+{
+	uint8_t		parsed;
+	uint8_t		type;		/* Q_TUNNEL_xxx bitmask */
+	uint8_t		inner;		/* version of the inner IP header (4 or 6), 0 if none */
+	uint8_t		gtp_msg;	/* GTP message type */
+	uint16_t	inner_off;	/* offset of the inner IP header */
+	uint32_t	id;		/* TEID, VNI, GRE key or MPLS label */
+
+} tunnel_t;
+
+
 /* Action monad */
 
 struct pfq_monad
@@ -68,6 +92,7 @@ struct pfq_monad
         struct pfq_group	*group;
         uint64_t		state;
         fanout_t		fanout;
+        tunnel_t		tunnel;
 };
 
 
@@ -52,6 +52,7 @@ struct local_data
 	struct timer_list	timer;
 
         struct pfq_sk_buff_pool tx_pool;
+	struct pfq_sk_buff_pool tx_small_pool;	/* zero-copy and copybreak skbs */
         struct pfq_sk_buff_pool rx_pool;
 
 } ____cacheline_aligned;
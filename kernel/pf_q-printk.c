@@ -30,6 +30,8 @@
 #include <pf_q-engine.h>
 #include <pf_q-printk.h>
 
+#include <functional/combinator.h>
+
 
 void
 pr_devel_group(pfq_gid_t gid)
@@ -88,6 +90,11 @@ snprintf_functional_node(char *buffer, size_t size, struct pfq_functional_node c
 		}
 	}
 
+	if (size <= len)
+		return len;
+
+	len += pfq_combinator_snprintf(buffer + len, size - len, &node->fun);
+
 	if (size <= len)
 		return len;
 
@@ -156,6 +163,10 @@ pr_devel_functional_descr(struct pfq_functional_descr const *descr, size_t index
 			if (descr->arg[n].size)
 				len += snprintf(buffer + len, size - len, "fun(%zu) ", descr->arg[n].size);
 		}
+		else if (is_arg_vector_fun(&descr->arg[n])) {
+
+			len += snprintf(buffer + len, size - len, "fun[%zu] ", descr->arg[n].nelem);
+		}
 		else if (is_arg_vector(&descr->arg[n])) {
 
 			len += snprintf(buffer + len, size - len, "pod_%zu[%zu] ",
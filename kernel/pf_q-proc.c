@@ -38,6 +38,7 @@
 #include <pf_q-proc.h>
 #include <pf_q-memory.h>
 #include <pf_q-printk.h>
+#include <pf_q-engine.h>
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,10,0)
 #define PDE_DATA(a) PDE(a)->data
@@ -48,6 +49,7 @@ struct proc_dir_entry *pfq_proc_dir = NULL;
 static const char proc_computations[] = "computations";
 static const char proc_groups[]       = "groups";
 static const char proc_stats[]        = "stats";
+static const char proc_pacing[]       = "tx_pacing";
 
 #ifdef PFQ_USE_EXTENDED_PROC
 static const char proc_memory[]       = "memory";
@@ -57,11 +59,20 @@ static const char proc_memory[]       = "memory";
 static void
 seq_printf_functional_node(struct seq_file *m, struct pfq_functional_node const *node, size_t index)
 {
+	struct pfq_node_stats st;
 	char buffer[256];
 
 	snprintf_functional_node(buffer, sizeof(buffer), node, index);
 
 	seq_printf(m, "%s\n", buffer);
+
+	if (node->stats == NULL)
+		return;
+
+	pfq_computation_node_stats(node, &st);
+	if (st.calls)
+		seq_printf(m, "      calls:%llu pass:%llu drop:%llu cycles:%llu (%llu_tsc/call)\n",
+			   st.calls, st.pass, st.drop, st.cycles, div64_u64(st.cycles, st.calls));
 }
 
 
@@ -113,7 +124,7 @@ static int pfq_proc_groups(struct seq_file *m, void *v)
 {
 	size_t n;
 
-	seq_printf(m, "group: recv      drop      forward   kernel    disc      aborted   pol pid   def.    uplane   cplane    ctrl\n");
+	seq_printf(m, "group: recv      drop      forward   kernel    disc      aborted   elephant  pol pid   def.    uplane   cplane    ctrl\n");
 
 	down(&group_sem);
 
@@ -125,13 +136,14 @@ static int pfq_proc_groups(struct seq_file *m, void *v)
 		if (!this_group->policy)
 			continue;
 
-		seq_printf(m, "%5zu: %-9lu %-9lu %-9lu %-9lu %-9lu %-9lu", n,
+		seq_printf(m, "%5zu: %-9lu %-9lu %-9lu %-9lu %-9lu %-9lu %-9lu", n,
 			   sparse_read(&this_group->stats.recv),
 			   sparse_read(&this_group->stats.drop),
 			   sparse_read(&this_group->stats.frwd),
 			   sparse_read(&this_group->stats.kern),
 			   sparse_read(&this_group->stats.disc),
-			   sparse_read(&this_group->stats.abrt));
+			   sparse_read(&this_group->stats.abrt),
+			   sparse_read(&this_group->stats.elph));
 
 		seq_printf(m, "%3d %3d ", this_group->policy, this_group->pid);
 
@@ -178,6 +190,9 @@ static int pfq_proc_memory(struct seq_file *m, void *v)
 	seq_printf(m, "error shared   : %ld\n", sparse_read(&memory_stats.err_shared));
 	seq_printf(m, "error cloned   : %ld\n", sparse_read(&memory_stats.err_cloned));
 	seq_printf(m, "error memory   : %ld\n", sparse_read(&memory_stats.err_memory));
+	seq_printf(m, "flow insert    : %ld\n", sparse_read(&memory_stats.flow_insert));
+	seq_printf(m, "flow expire    : %ld\n", sparse_read(&memory_stats.flow_expire));
+	seq_printf(m, "flow evict     : %ld\n", sparse_read(&memory_stats.flow_evict));
 	return 0;
 }
 
@@ -240,6 +255,54 @@ static const struct file_operations pfq_proc_stats_fops = {
 };
 
 
+static int pfq_proc_pacing(struct seq_file *m, void *v)
+{
+	int n;
+
+	seq_printf(m, "window    : %d nsec\n", tx_pacing_window);
+	seq_printf(m, "sleep     : %d usec\n", tx_pacing_sleep);
+	seq_printf(m, "hrtimer   : %ld\n", sparse_read(&pacing_stats.sleep));
+	seq_printf(m, "early     : %ld\n", sparse_read(&pacing_stats.early));
+	seq_printf(m, "parked    : %ld\n", sparse_read(&pacing_stats.park));
+	seq_printf(m, "aggregated: %ld\n", sparse_read(&pacing_stats.aggr));
+	seq_printf(m, "INTER-DEPARTURE ERROR:\n");
+
+	for(n = 0; n < Q_TX_PACING_HIST; n++)
+	{
+		unsigned long lo = n ? 64UL << (n-1) : 0;
+
+		if (n < Q_TX_PACING_HIST-1)
+			seq_printf(m, "%8lu - %-8lu ns: %ld\n", lo, (64UL << n) - 1, sparse_read(&pacing_stats.hist[n]));
+		else
+			seq_printf(m, "%8lu -          ns: %ld\n", lo, sparse_read(&pacing_stats.hist[n]));
+	}
+
+	return 0;
+}
+
+static int pfq_proc_pacing_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pfq_proc_pacing, PDE_DATA(inode));
+}
+
+static ssize_t
+pfq_proc_pacing_reset(struct file *file, const char __user *buf, size_t length, loff_t *ppos)
+{
+	pfq_pacing_stats_reset(&pacing_stats);
+	return 1;
+}
+
+
+static const struct file_operations pfq_proc_pacing_fops = {
+	.owner   = THIS_MODULE,
+	.open    = pfq_proc_pacing_open,
+	.read    = seq_read,
+	.write   = pfq_proc_pacing_reset,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+
 static const struct file_operations pfq_proc_groups_fops = {
 	.owner   = THIS_MODULE,
 	.open    = pfq_proc_groups_open,
@@ -267,6 +330,7 @@ int pfq_proc_init(void)
 	proc_create(proc_computations,	0644, pfq_proc_dir, &pfq_proc_comp_fops);
 	proc_create(proc_groups,	0644, pfq_proc_dir, &pfq_proc_groups_fops);
 	proc_create(proc_stats,		0644, pfq_proc_dir, &pfq_proc_stats_fops);
+	proc_create(proc_pacing,	0644, pfq_proc_dir, &pfq_proc_pacing_fops);
 #ifdef PFQ_USE_EXTENDED_PROC
 	proc_create(proc_memory,	0644, pfq_proc_dir, &pfq_proc_memory_fops);
 #endif
@@ -280,6 +344,7 @@ int pfq_proc_fini(void)
 	remove_proc_entry(proc_computations,	pfq_proc_dir);
 	remove_proc_entry(proc_groups,		pfq_proc_dir);
 	remove_proc_entry(proc_stats,		pfq_proc_dir);
+	remove_proc_entry(proc_pacing,		pfq_proc_dir);
 #ifdef PFQ_USE_EXTENDED_PROC
 	remove_proc_entry(proc_memory,		pfq_proc_dir);
 #endif
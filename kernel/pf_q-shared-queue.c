@@ -39,6 +39,7 @@
 #include <pf_q-sock.h>
 #include <pf_q-global.h>
 #include <pf_q-memory.h>
+#include <pf_q-transmit.h>
 #include <pf_q-GC.h>
 
 
@@ -213,18 +214,27 @@ pfq_shared_queue_enable(struct pfq_sock *so, unsigned long user_addr)
 				((struct pfq_pkthdr *)raw)->commit = rst;
 		}
 
-		/* initialize TX queues */
+		/* initialize TX queues (only max_queues are allocated) */
 
-		for(n = 0; n < Q_MAX_TX_QUEUES; n++)
+		for(n = 0; n < so->tx_opt.max_queues; n++)
 		{
 			queue->tx[n].prod      = 0;
 			queue->tx[n].cons      = 0;
+			queue->tx[n].done      = so->tx_opt.ring ? 0 : (unsigned int)-1;
+			queue->tx[n].parked    = 0;
 			queue->tx[n].size      = pfq_queue_spsc_mem(so)/2;
 			queue->tx[n].ptr       = NULL;
 			queue->tx[n].index     = -1;
 
 			so->tx_opt.queue[n].base_addr = so->shmem.addr + sizeof(struct pfq_shared_queue)
 				+ pfq_queue_mpsc_mem(so) + pfq_queue_spsc_mem(so) * n;
+
+			/* both the halves are empty (the kernel thread transmits the
+			 * second one before the first swap) */
+
+			for(i = 0; i < 2; i++)
+				((struct pfq_pkthdr_tx *)((char *)so->tx_opt.queue[n].base_addr
+							  + i * queue->tx[n].size))->len = 0;
 		}
 
 		/* update the queues base_addr */
@@ -237,7 +247,7 @@ pfq_shared_queue_enable(struct pfq_sock *so, unsigned long user_addr)
 
 		atomic_long_set(&so->rx_opt.queue_hdr, (long)&queue->rx);
 
-		for(n = 0; n < Q_MAX_TX_QUEUES; n++)
+		for(n = 0; n < so->tx_opt.max_queues; n++)
 		{
 			atomic_long_set(&so->tx_opt.queue[n].queue_hdr, (long)&queue->tx[n]);
 		}
@@ -249,12 +259,12 @@ pfq_shared_queue_enable(struct pfq_sock *so, unsigned long user_addr)
 			 so->rx_opt.caplen,
 			 pfq_queue_mpsc_mem(so));
 
-		pr_devel("[PFQ|%d] Tx queue: len=%zu slot_size=%zu maxlen=%d, mem=%zu bytes (%d queues)\n",
+		pr_devel("[PFQ|%d] Tx queue: len=%zu slot_size=%zu maxlen=%d, mem=%zu bytes (%zu queues)\n",
 			 so->id.value,
 			 so->tx_opt.queue_size,
 			 so->tx_opt.slot_size,
 			 max_len,
-			 pfq_queue_spsc_mem(so) * Q_MAX_TX_QUEUES, Q_MAX_TX_QUEUES);
+			 pfq_queue_spsc_mem(so) * so->tx_opt.max_queues, so->tx_opt.max_queues);
 	}
 
 	return 0;
@@ -277,6 +287,13 @@ pfq_shared_queue_disable(struct pfq_sock *so)
 
 		msleep(Q_GRACE_PERIOD);
 
+		for(n = 0; n < Q_MAX_TX_QUEUES; n++)
+		{
+			pfq_tx_zerocopy_free(&so->tx_opt.queue[n]);
+			pfq_tx_replay_free(&so->tx_opt.queue[n]);
+			pfq_tx_template_free(&so->tx_opt.queue[n]);
+		}
+
 		pfq_shared_memory_free(&so->shmem);
 
 		so->shmem.addr = NULL;
@@ -38,6 +38,12 @@ count_outmost_brackets(string_view_t str)
 	int bracket = 0;
         const char *p;
 
+	/* a list of functions, e.g. [(SkBuff -> Action SkBuff)], has no outmost brackets */
+
+	str = string_view_trim(str);
+	if (string_view_at(str, 0) == '[')
+		return 0;
+
 	for(p = str.begin; p != str.end; p++)
 	{
 		switch(*p) {
@@ -80,7 +86,7 @@ find_next_arrow(string_view_t str)
 				state = 1;
 				continue;
 			}
-			if (*p == '(') {
+			if (*p == '(' || *p == '[') {
 				bracket++;
 				state = 2;
 				continue;
@@ -92,11 +98,11 @@ find_next_arrow(string_view_t str)
 			return NULL;
 		} break;
 		case 2: {
-			if (*p == '(') {
+			if (*p == '(' || *p == '[') {
 				bracket++;
 				continue;
 			}
-			if (*p == ')') {
+			if (*p == ')' || *p == ']') {
 				if (--bracket == 0)
 					state = 0;
 			}
@@ -376,6 +382,9 @@ pfq_signature_type_check(string_view_t type)
 		if (pfq_signature_sizeof(type) != -1 || islower(string_view_at(type, 0)))
 			return true;
 
+		if (pfq_signature_is_function(type))
+			return pfq_signature_check(type);
+
 		type = pfq_signature_remove_extent(type);
 	}
 
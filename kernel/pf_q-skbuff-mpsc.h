@@ -28,10 +28,16 @@
 #include <linux/kernel.h>
 #include <linux/skbuff.h>
 
+
+/*
+ * multi-producer single-consumer queue of skbs, linked through skb->next:
+ * producers push whole batches with a single cmpxchg, the consumer takes
+ * all of them at once (the xchg of the head) and restores the FIFO order.
+ */
+
 typedef struct mpsc_queue
 {
         atomic_long_t       head;
-        struct sk_buff *    tail;
 
 } mpsc_queue_t;
 
@@ -39,70 +45,85 @@ typedef struct mpsc_queue
 static inline
 int mpsc_queue_ctor(mpsc_queue_t * self)
 {
-        struct sk_buff * stub = dev_alloc_skb(1);
-        if (stub != NULL) {
-                stub->next = 0;
-                atomic_long_set(&self->head, (long)stub);
-                self->tail = stub;
-        }
-        else {
-                printk(KERN_WARNING "[PFQ] mpsc_skbuff_queue_ctor: memory problem!\n");
-                return -ENOMEM;
-        }
+        atomic_long_set(&self->head, (long)0);
         return 0;
 };
 
 
 static inline
-void mpsc_queue_dtor(mpsc_queue_t *self)
+bool mpsc_queue_empty(mpsc_queue_t *self)
 {
-        struct sk_buff * skb = self->tail;
-        while(skb != NULL)
-        {
-                struct sk_buff * next = skb->next;
-                kfree_skb(skb);
-                skb = next;
-        }
-
-        atomic_long_set(&self->head, (long)0);
-        self->tail = (struct sk_buff *)0;
+        return atomic_long_read(&self->head) == 0;
 }
 
 
+/* push n skbs: linked in reverse order, so that the reversal of the whole
+ * list performed by the consumer keeps the order of the batch */
+
 static inline
-void mpsc_queue_push(mpsc_queue_t *self, struct sk_buff *skb)
+void mpsc_queue_push_batch(mpsc_queue_t *self, struct sk_buff **skbs, size_t n)
 {
-        struct sk_buff *prev;
+        struct sk_buff *first = skbs[n-1];
+        long old;
+        size_t i;
+
+        for(i = n-1; i > 0; i--)
+                skbs[i]->next = skbs[i-1];
+
+        do {
+                old = atomic_long_read(&self->head);
+                skbs[0]->next = (struct sk_buff *)old;
+        }
+        while (atomic_long_cmpxchg(&self->head, old, (long)first) != old);
+}
 
-        skb->next = 0;
-        prev = (struct sk_buff *) atomic_long_xchg(&self->head, (long)skb);
-        prev->next = skb;
 
+static inline
+void mpsc_queue_push(mpsc_queue_t *self, struct sk_buff *skb)
+{
+        mpsc_queue_push_batch(self, &skb, 1);
 }
 
 
+/* pop all the skbs in the queue (consumer only), in FIFO order */
+
 static inline
-struct sk_buff * mpsc_queue_pop(mpsc_queue_t *self)
+struct sk_buff * mpsc_queue_pop_all(mpsc_queue_t *self)
 {
-        struct sk_buff * tail = self->tail;
-        struct sk_buff * next = tail->next;
+        struct sk_buff *skb, *prev = NULL;
+
+        if (mpsc_queue_empty(self))
+                return NULL;
 
-        if (next) {
-                self->tail = next;
-                tail->prev = next;   /* data in this case is the skb itself: tail->data = next->data; */
-                return tail;
+        skb = (struct sk_buff *) atomic_long_xchg(&self->head, (long)0);
+        while (skb)
+        {
+                struct sk_buff *next = skb->next;
+                skb->next = prev;
+                prev = skb;
+                skb = next;
         }
 
-        return NULL;
+        return prev;
 }
 
 
 static inline
-const struct sk_buff * mpsc_queue_next(mpsc_queue_t *self)
+size_t mpsc_queue_dtor(mpsc_queue_t *self)
 {
-        if (self->tail)
-                return self->tail->next;
-        return NULL;
+        struct sk_buff * skb = mpsc_queue_pop_all(self);
+        size_t total = 0;
+
+        while(skb != NULL)
+        {
+                struct sk_buff * next = skb->next;
+                skb->next = NULL;
+                kfree_skb(skb);
+                skb = next;
+                total++;
+        }
+
+        return total;
 }
 
 #endif /* PF_Q_SKBUFF_MPSC_H */
@@ -0,0 +1,163 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
+
+#include <pf_q-sketch.h>
+
+
+struct pfq_sketch *
+pfq_sketch_alloc(void)
+{
+	struct pfq_sketch *sk;
+	int cpu;
+
+	sk = kzalloc(sizeof(struct pfq_sketch), GFP_KERNEL);
+	if (!sk)
+		return NULL;
+
+	sk->cpu = alloc_percpu(struct pfq_sketch_cpu *);
+	if (!sk->cpu) {
+		kfree(sk);
+		return NULL;
+	}
+
+	for_each_possible_cpu(cpu)
+	{
+		struct pfq_sketch_cpu *sc = kzalloc_node(sizeof(struct pfq_sketch_cpu), GFP_KERNEL, cpu_to_node(cpu));
+		if (!sc) {
+			pfq_sketch_free(sk);
+			return NULL;
+		}
+		pfq_sketch_cpu_ptr(sk, cpu) = sc;
+	}
+
+	return sk;
+}
+
+
+void
+pfq_sketch_free(struct pfq_sketch *sk)
+{
+	int cpu;
+
+	if (sk) {
+		for_each_possible_cpu(cpu)
+			kfree(pfq_sketch_cpu_ptr(sk, cpu));
+
+		free_percpu(sk->cpu);
+		kfree(sk);
+	}
+}
+
+
+static uint64_t
+pfq_sketch_merged_estimate(struct pfq_sketch *sk, uint64_t key, uint64_t aux)
+{
+	uint64_t est = ~0ULL;
+	uint32_t h1, h2;
+	int d, cpu;
+
+	pfq_sketch_hash(key, aux, &h1, &h2);
+
+	for(d = 0; d < Q_SKETCH_DEPTH; d++)
+	{
+		uint64_t sum = 0;
+
+		for_each_possible_cpu(cpu)
+		{
+			struct pfq_sketch_cpu *sc = pfq_sketch_cpu_ptr(sk, cpu);
+			sum += ACCESS_ONCE(sc->row[d][(h1 + d * h2) & Q_SKETCH_WIDTH_MASK]);
+		}
+
+		if (sum < est)
+			est = sum;
+	}
+
+	return est;
+}
+
+
+/*
+ * Merge the per-cpu sketches: the candidates are the union of the per-cpu top-K entries,
+ * each one estimated against the sum of the per-cpu rows. Entries are sorted by count.
+ */
+
+int
+pfq_sketch_read(struct pfq_sketch *sk, struct pfq_heavy_hitters *hh)
+{
+	int cpu, n, i, j;
+
+	hh->size  = 0;
+	hh->total = 0;
+
+	for_each_possible_cpu(cpu)
+	{
+		struct pfq_sketch_cpu *sc = pfq_sketch_cpu_ptr(sk, cpu);
+		int size = min_t(int, ACCESS_ONCE(sc->size), Q_MAX_HEAVY_HITTERS);
+
+		hh->total += ACCESS_ONCE(sc->total);
+
+		for(n = 0; n < size; n++)
+		{
+			struct pfq_heavy_hitter e = sc->top[n];
+
+			for(i = 0; i < hh->size; i++)
+			{
+				if (hh->entry[i].key == e.key && hh->entry[i].aux == e.aux)
+					break;
+			}
+
+			if (i < hh->size)
+				continue;
+
+			e.count = pfq_sketch_merged_estimate(sk, e.key, e.aux);
+
+			/* sorted insertion */
+
+			for(i = 0; i < hh->size; i++)
+			{
+				if (e.count > hh->entry[i].count)
+					break;
+			}
+
+			if (i == Q_MAX_HEAVY_HITTERS)
+				continue;
+
+			for(j = min(hh->size, Q_MAX_HEAVY_HITTERS-1); j > i; j--)
+				hh->entry[j] = hh->entry[j-1];
+
+			hh->entry[i] = e;
+
+			if (hh->size < Q_MAX_HEAVY_HITTERS)
+				hh->size++;
+		}
+	}
+
+	return hh->size;
+}
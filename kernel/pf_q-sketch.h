@@ -0,0 +1,141 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PF_Q_SKETCH_H
+#define PF_Q_SKETCH_H
+
+#include <linux/kernel.h>
+#include <linux/percpu.h>
+#include <linux/jhash.h>
+#include <linux/pf_q.h>
+
+/* count-min sketch: Q_SKETCH_DEPTH rows of Q_SKETCH_WIDTH counters (per-cpu) */
+
+#define Q_SKETCH_DEPTH		4
+#define Q_SKETCH_WIDTH		1024
+#define Q_SKETCH_WIDTH_MASK	(Q_SKETCH_WIDTH-1)
+
+#define pfq_sketch_cpu_ptr(sk, cpu)	(*per_cpu_ptr((sk)->cpu, cpu))
+#define pfq_sketch_this_cpu(sk)		(*this_cpu_ptr((sk)->cpu))
+
+
+struct pfq_group;
+
+
+struct pfq_sketch_cpu
+{
+	uint64_t		row[Q_SKETCH_DEPTH][Q_SKETCH_WIDTH];
+	struct pfq_heavy_hitter	top[Q_MAX_HEAVY_HITTERS];
+	uint64_t		total;
+	int			size;
+
+} ____cacheline_aligned;
+
+
+/* the per-cpu sketches (~33K) exceed the alloc_percpu limit: they are allocated
+ * on the node of each cpu, and reached through a per-cpu pointer */
+
+struct pfq_sketch
+{
+	struct pfq_sketch_cpu * __percpu *cpu;
+	struct pfq_group *group;	/* group the sketch is attached to */
+};
+
+
+extern struct pfq_sketch * pfq_sketch_alloc(void);
+extern void pfq_sketch_free(struct pfq_sketch *sk);
+extern int  pfq_sketch_read(struct pfq_sketch *sk, struct pfq_heavy_hitters *hh);
+
+
+/* double hashing: the index of the d-th row is h1 + d * h2 */
+
+static inline
+void pfq_sketch_hash(uint64_t key, uint64_t aux, uint32_t *h1, uint32_t *h2)
+{
+	*h1 = jhash_3words((uint32_t)key, (uint32_t)(key >> 32), (uint32_t)aux, (uint32_t)(aux >> 32));
+	*h2 = jhash_3words((uint32_t)key, (uint32_t)(key >> 32), (uint32_t)aux, 0x9e3779b9) | 1;
+}
+
+
+static inline
+uint64_t pfq_sketch_estimate(struct pfq_sketch_cpu *sc, uint32_t h1, uint32_t h2)
+{
+	uint64_t est = ~0ULL;
+	int d;
+
+	for(d = 0; d < Q_SKETCH_DEPTH; d++)
+	{
+		uint64_t c = sc->row[d][(h1 + d * h2) & Q_SKETCH_WIDTH_MASK];
+		if (c < est)
+			est = c;
+	}
+	return est;
+}
+
+
+/* hot path: to be called with preemption disabled (per-cpu data) */
+
+static inline
+void pfq_sketch_update(struct pfq_sketch_cpu *sc, uint64_t key, uint64_t aux)
+{
+	uint64_t est = ~0ULL;
+	uint32_t h1, h2;
+	int d, n, m = 0;
+
+	pfq_sketch_hash(key, aux, &h1, &h2);
+
+	for(d = 0; d < Q_SKETCH_DEPTH; d++)
+	{
+		uint64_t c = ++sc->row[d][(h1 + d * h2) & Q_SKETCH_WIDTH_MASK];
+		if (c < est)
+			est = c;
+	}
+
+	sc->total++;
+
+	/* top-K: update the entry if present, otherwise replace the smallest one */
+
+	for(n = 0; n < sc->size; n++)
+	{
+		if (sc->top[n].key == key && sc->top[n].aux == aux) {
+			sc->top[n].count = est;
+			return;
+		}
+		if (sc->top[n].count < sc->top[m].count)
+			m = n;
+	}
+
+	if (sc->size < Q_MAX_HEAVY_HITTERS) {
+		m = sc->size++;
+	}
+	else if (est <= sc->top[m].count)
+		return;
+
+	sc->top[m].key   = key;
+	sc->top[m].aux   = aux;
+	sc->top[m].count = est;
+}
+
+
+#endif /* PF_Q_SKETCH_H */
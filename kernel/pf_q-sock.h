@@ -101,16 +101,83 @@ void pfq_rx_opt_init(struct pfq_rx_opt *that, size_t caplen)
 }
 
 
+/* zero-copy Tx: skbs whose fragments point to the shared memory, in flight */
+
+struct pfq_tx_zerocopy
+{
+	struct page	      **pages;		/* pinned pages of the shared memory */
+	char		       *addr;
+
+	unsigned int		last;		/* completion once the ring is empty */
+
+	unsigned long		head;
+	unsigned long		tail;
+	unsigned long		mask;
+
+	struct {
+		struct sk_buff *skb;
+		unsigned int	seq;		/* completion blocked by this skb (+1) */
+	} ring[];
+};
+
+
+/* Tx replay: state of the trace being transmitted (Q_SO_TX_REPLAY) */
+
+struct pfq_tx_replay_state
+{
+	struct pfq_tx_replay	opt;
+
+	char		       *ptr;		/* next packet of the trace */
+	uint64_t		base;		/* beginning of the current loop (nsec) */
+	uint64_t		count;		/* packets of the current loop */
+	unsigned int		loop;
+	bool			stop;
+};
+
+
+/* Tx template generator: templates (pfq_pkthdr_tx + packet) and rules (Q_SO_TX_TEMPLATE) */
+
+struct pfq_tx_template_state
+{
+	struct pfq_pkthdr_tx   *pkt[Q_TX_TEMPLATE_MAX];
+	unsigned int		weight[Q_TX_TEMPLATE_MAX];	/* cumulative */
+	int			num_pkts;
+
+	struct pfq_tx_template_rule rule[Q_TX_TEMPLATE_MAX_RULES];
+	uint32_t		value[Q_TX_TEMPLATE_MAX_RULES];	/* counters */
+	int			num_rules;
+
+	unsigned int		flags;
+	uint64_t		count;
+	uint64_t		gap;
+
+	uint64_t		sent;		/* packets generated */
+	uint64_t		base;		/* beginning of the generation (nsec) */
+	uint32_t		seed;		/* xorshift state */
+	bool			stop;
+};
+
+
 struct pfq_tx_queue_info
 {
 	atomic_long_t		queue_hdr;
 	void		       *base_addr;
+	struct pfq_tx_zerocopy *zc;
+	struct pfq_tx_replay_state *replay;
+	struct pfq_tx_template_state *tmpl;
+
+	uint64_t		pace_ts;	/* timestamp and departure of the last timed packet */
+	uint64_t		pace_dep;
 
 	int			if_index;
 	int			hw_queue;
 	int			cpu;
 
 	struct task_struct     *task;
+
+	int			doorbell;	/* rung to wake up the idle kernel thread */
+	int			gen_stop;	/* stop the replay/template (released by the kernel thread) */
+	atomic_t		busy;		/* flushes/thread starts in progress, -1 while zero-copy is toggled */
 };
 
 
@@ -121,6 +188,8 @@ struct pfq_tx_opt
 	size_t			queue_size;
 	size_t			slot_size;
         size_t			num_queues;
+	size_t			max_queues;	/* Tx queues allocated (Q_SO_SET_TX_QUEUES) */
+	bool			ring;		/* streaming Tx ring (Q_SO_TX_RING) */
 
 	struct pfq_tx_queue_info queue[Q_MAX_TX_QUEUES];
 
@@ -137,6 +206,43 @@ pfq_get_tx_queue(struct pfq_tx_opt *that, int index)
 }
 
 
+/* a flush (or a thread start) and the zero-copy toggle exclude each other */
+
+static inline
+bool pfq_tx_busy_get(struct pfq_tx_queue_info *info)
+{
+	int n;
+	do {
+		n = atomic_read(&info->busy);
+		if (n < 0)
+			return false;
+	}
+	while (atomic_cmpxchg(&info->busy, n, n + 1) != n);
+	return true;
+}
+
+
+static inline
+void pfq_tx_busy_put(struct pfq_tx_queue_info *info)
+{
+	atomic_dec(&info->busy);
+}
+
+
+static inline
+bool pfq_tx_busy_lock(struct pfq_tx_queue_info *info)
+{
+	return atomic_cmpxchg(&info->busy, 0, -1) == 0;
+}
+
+
+static inline
+void pfq_tx_busy_unlock(struct pfq_tx_queue_info *info)
+{
+	atomic_set(&info->busy, 0);
+}
+
+
 static inline
 void pfq_tx_opt_init(struct pfq_tx_opt *that, size_t maxlen)
 {
@@ -148,12 +254,22 @@ void pfq_tx_opt_init(struct pfq_tx_opt *that, size_t maxlen)
         that->queue_size = 0;
         that->slot_size  = Q_SPSC_QUEUE_SLOT_SIZE(maxlen);
 	that->num_queues = 0;
+	that->max_queues = Q_TX_QUEUES_DEFAULT;
+	that->ring	 = false;
 
 	for(n = 0; n < Q_MAX_TX_QUEUES; ++n)
 	{
 		atomic_long_set(&that->queue[n].queue_hdr, 0);
 
 		that->queue[n].base_addr = NULL;
+		that->queue[n].zc        = NULL;
+		that->queue[n].replay    = NULL;
+		that->queue[n].tmpl      = NULL;
+		that->queue[n].pace_ts   = 0;
+		that->queue[n].pace_dep  = 0;
+		that->queue[n].doorbell  = 0;
+		that->queue[n].gen_stop  = 0;
+		atomic_set(&that->queue[n].busy, 0);
 		that->queue[n].if_index  = -1;
 		that->queue[n].hw_queue  = -1;
 		that->queue[n].cpu       = -1;
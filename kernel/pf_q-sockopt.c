@@ -41,6 +41,10 @@
 #include <pf_q-sockopt.h>
 #include <pf_q-endpoint.h>
 #include <pf_q-shared-queue.h>
+#include <pf_q-sketch.h>
+#include <pf_q-table.h>
+#include <pf_q-bloom.h>
+#include <pf_q-elephant.h>
 
 int pfq_getsockopt(struct socket *sock,
                 int level, int optname,
@@ -196,6 +200,14 @@ int pfq_getsockopt(struct socket *sock,
                         return -EFAULT;
         } break;
 
+        case Q_SO_GET_TX_QUEUES:
+        {
+                if (len != sizeof(so->tx_opt.max_queues))
+                        return -EINVAL;
+                if (copy_to_user(optval, &so->tx_opt.max_queues, sizeof(so->tx_opt.max_queues)))
+                        return -EFAULT;
+        } break;
+
         case Q_SO_GET_GROUPS:
         {
                 unsigned long grps;
@@ -290,6 +302,145 @@ int pfq_getsockopt(struct socket *sock,
                         return -EFAULT;
         } break;
 
+        case Q_SO_GET_GROUP_HEAVY_HITTERS:
+        {
+                struct pfq_heavy_hitters *hh;
+                struct pfq_sketch *sk;
+                struct pfq_group *g;
+                pfq_gid_t gid;
+                int err = 0;
+
+                if (len != sizeof(struct pfq_heavy_hitters))
+                        return -EINVAL;
+
+                if (copy_from_user(&gid.value, optval, sizeof(gid.value)))
+                        return -EFAULT;
+
+                g = pfq_get_group(gid);
+                if (g == NULL) {
+                        printk(KERN_INFO "[PFQ|%d] group error: invalid group id %d!\n", so->id.value, gid.value);
+                        return -EFAULT;
+                }
+
+                /* check whether the group is joinable.. */
+
+                if (!pfq_group_policy_access(gid, so->id, Q_POLICY_GROUP_UNDEFINED)) {
+                        printk(KERN_INFO "[PFQ|%d] group error: permission denied (gid=%d)!\n",
+                               so->id.value, gid.value);
+                        return -EACCES;
+                }
+
+                hh = kzalloc(sizeof(struct pfq_heavy_hitters), GFP_KERNEL);
+                if (hh == NULL)
+                        return -ENOMEM;
+
+                hh->gid = gid.value;
+
+                /* the sketch is released by the computation with the group semaphore held */
+
+                down(&group_sem);
+
+                sk = (struct pfq_sketch *)atomic_long_read(&g->sketch);
+                if (sk)
+                        pfq_sketch_read(sk, hh);
+
+                up(&group_sem);
+
+                if (copy_to_user(optval, hh, sizeof(struct pfq_heavy_hitters)))
+                        err = -EFAULT;
+
+                kfree(hh);
+                return err;
+        } break;
+
+        case Q_SO_GET_GROUP_STEERING:
+        {
+                struct pfq_group_steering st;
+                struct pfq_group *g;
+                pfq_gid_t gid;
+
+                if (len != sizeof(st))
+                        return -EINVAL;
+
+                if (copy_from_user(&st, optval, sizeof(st)))
+                        return -EFAULT;
+
+                gid.value = st.gid;
+
+                g = pfq_get_group(gid);
+                if (g == NULL) {
+                        printk(KERN_INFO "[PFQ|%d] group error: invalid group id %d!\n", so->id.value, gid.value);
+                        return -EFAULT;
+                }
+
+                if (!pfq_group_access(gid, so->id)) {
+                        printk(KERN_INFO "[PFQ|%d] group steering error: gid=%d permission denied!\n",
+                               so->id.value, gid.value);
+                        return -EACCES;
+                }
+
+                st.mode     = g->steer_mode;
+                st.rate     = (unsigned int)div_u64((uint64_t)g->elephant_bytes * 8 * (NSEC_PER_SEC / Q_ELEPHANT_WINDOW_NS), 1000000);
+                st.flowlet  = (unsigned int)div_u64(g->flowlet_gap, NSEC_PER_USEC);
+                st.promoted = sparse_read(&g->stats.elph);
+                st.sprayed  = sparse_read(&g->stats.sprd);
+
+                if (copy_to_user(optval, &st, sizeof(st)))
+                        return -EFAULT;
+        } break;
+
+        case Q_SO_GET_GROUP_COMPUTATION_STATS:
+        {
+                struct pfq_computation_stats *cs;
+                struct pfq_computation_tree *comp;
+                struct pfq_group *g;
+                pfq_gid_t gid;
+                int n, err = 0;
+
+                if (len != sizeof(struct pfq_computation_stats))
+                        return -EINVAL;
+
+                if (copy_from_user(&gid.value, optval, sizeof(gid.value)))
+                        return -EFAULT;
+
+                g = pfq_get_group(gid);
+                if (g == NULL) {
+                        printk(KERN_INFO "[PFQ|%d] group error: invalid group id %d!\n", so->id.value, gid.value);
+                        return -EFAULT;
+                }
+
+                if (!pfq_group_access(gid, so->id)) {
+                        printk(KERN_INFO "[PFQ|%d] computation stats error: gid=%d permission denied!\n",
+                               so->id.value, gid.value);
+                        return -EACCES;
+                }
+
+                cs = kzalloc(sizeof(struct pfq_computation_stats), GFP_KERNEL);
+                if (cs == NULL)
+                        return -ENOMEM;
+
+                cs->gid = gid.value;
+
+                /* the computation is replaced with the group semaphore held */
+
+                down(&group_sem);
+
+                comp = (struct pfq_computation_tree *)atomic_long_read(&g->comp);
+                if (comp) {
+                        cs->size = (int)min_t(size_t, comp->size, Q_MAX_NODE_STATS);
+                        for(n = 0; n < cs->size; n++)
+                                pfq_computation_node_stats(&comp->node[n], &cs->node[n]);
+                }
+
+                up(&group_sem);
+
+                if (copy_to_user(optval, cs, sizeof(struct pfq_computation_stats)))
+                        err = -EFAULT;
+
+                kfree(cs);
+                return err;
+        } break;
+
         default:
                 return -EFAULT;
         }
@@ -537,6 +688,33 @@ int pfq_setsockopt(struct socket *sock,
                 pr_devel("[PFQ|%d] tx_queue slots=%zu\n", so->id.value, so->tx_opt.queue_size);
         } break;
 
+        case Q_SO_SET_TX_QUEUES:
+        {
+                typeof (so->tx_opt.max_queues) queues;
+
+                if (optlen != sizeof(queues))
+                        return -EINVAL;
+                if (copy_from_user(&queues, optval, optlen))
+                        return -EFAULT;
+
+		/* the Tx queues are allocated in the shared memory, when the socket is enabled */
+
+		if (so->shmem.addr) {
+                        printk(KERN_INFO "[PFQ|%d] Tx queues: socket enabled!\n", so->id.value);
+			return -EBUSY;
+		}
+
+                if (queues == 0 || queues > Q_MAX_TX_QUEUES || queues < so->tx_opt.num_queues) {
+                        printk(KERN_INFO "[PFQ|%d] invalid Tx queues=%zu (max %d, bound %zu)\n",
+                               so->id.value, queues, Q_MAX_TX_QUEUES, so->tx_opt.num_queues);
+                        return -EPERM;
+                }
+
+                so->tx_opt.max_queues = queues;
+
+                pr_devel("[PFQ|%d] Tx queues=%zu\n", so->id.value, so->tx_opt.max_queues);
+        } break;
+
         case Q_SO_GROUP_LEAVE:
         {
                 pfq_gid_t gid;
@@ -683,8 +861,9 @@ int pfq_setsockopt(struct socket *sock,
                 if (copy_from_user(&info, optval, optlen))
                         return -EFAULT;
 
-		if (so->tx_opt.num_queues >= Q_MAX_TX_QUEUES) {
-                        printk(KERN_INFO "[PFQ|%d] Tx bind: max number of queues exceeded!\n", so->id.value);
+		if (so->tx_opt.num_queues >= so->tx_opt.max_queues) {
+                        printk(KERN_INFO "[PFQ|%d] Tx bind: max number of queues exceeded (%zu)!\n",
+			       so->id.value, so->tx_opt.max_queues);
 			return -EPERM;
 		}
 
@@ -797,7 +976,7 @@ int pfq_setsockopt(struct socket *sock,
 			for(n = 0; n < Q_MAX_TX_QUEUES; n++)
 			{
 				struct pfq_thread_data *data;
-				int node;
+				int cpu, node;
 
 				if (so->tx_opt.queue[n].if_index == -1)
 					break;
@@ -811,42 +990,56 @@ int pfq_setsockopt(struct socket *sock,
 					continue;
 				}
 
+				if (!pfq_tx_busy_get(&so->tx_opt.queue[n])) {
+					printk(KERN_INFO "[PFQ|%d] kernel_thread: Tx[%zu] zero-copy being toggled!\n",
+					       so->id.value, n);
+					err = -EBUSY;
+					continue;
+				}
+
 				data = kmalloc(sizeof(struct pfq_thread_data), GFP_KERNEL);
 				if (!data) {
 					printk(KERN_INFO "[PFQ|%d] kernel_thread: could not allocate thread_data! Failed starting thread on cpu %d!\n",
 							so->id.value, so->tx_opt.queue[n].cpu);
+					pfq_tx_busy_put(&so->tx_opt.queue[n]);
 					err = -EPERM;
 					continue;
 				}
 
+				/* Q_ANY_CPU: a cpu close to the device */
+
+				cpu = so->tx_opt.queue[n].cpu == Q_ANY_CPU ?
+					pfq_tx_thread_cpu(so, n) : so->tx_opt.queue[n].cpu;
+
 				data->so = so;
 				data->id = n;
-				node     = cpu_online(so->tx_opt.queue[n].cpu) ?
-						cpu_to_node(so->tx_opt.queue[n].cpu) : NUMA_NO_NODE;
+				node     = cpu_online(cpu) ? cpu_to_node(cpu) : NUMA_NO_NODE;
 
 				pr_devel("[PFQ|%d] creating Tx[%zu] thread on cpu %d: if_index=%d hw_queue=%d\n",
-						so->id.value, n, so->tx_opt.queue[n].cpu, so->tx_opt.queue[n].if_index,
+						so->id.value, n, cpu, so->tx_opt.queue[n].if_index,
 						so->tx_opt.queue[n].hw_queue);
 
 				so->tx_opt.queue[n].task = kthread_create_on_node(pfq_tx_thread, data, node, "pfq_tx_%d#%zu", so->id.value, n);
 
 				if (IS_ERR(so->tx_opt.queue[n].task)) {
 					printk(KERN_INFO "[PFQ|%d] kernel_thread: create failed on cpu %d!\n",
-					       so->id.value, so->tx_opt.queue[n].cpu);
+					       so->id.value, cpu);
 					err = PTR_ERR(so->tx_opt.queue[n].task);
 					so->tx_opt.queue[n].task = NULL;
+					pfq_tx_busy_put(&so->tx_opt.queue[n]);
 					kfree (data);
 					continue;
 				}
 
 				/* bind the thread */
 
-				kthread_bind(so->tx_opt.queue[n].task, so->tx_opt.queue[n].cpu);
+				kthread_bind(so->tx_opt.queue[n].task, cpu);
 
 				/* start it */
 
 				wake_up_process(so->tx_opt.queue[n].task);
 
+				pfq_tx_busy_put(&so->tx_opt.queue[n]);
 				started++;
 			}
 
@@ -866,6 +1059,11 @@ int pfq_setsockopt(struct socket *sock,
 					kthread_stop(so->tx_opt.queue[n].task);
 					so->tx_opt.queue[n].task = NULL;
 				}
+
+				/* replay/template stopped or completed meanwhile */
+
+				if (pfq_tx_gen_over(&so->tx_opt.queue[n]))
+					pfq_tx_gen_release(&so->tx_opt, n);
 			}
 		}
 
@@ -873,6 +1071,170 @@ int pfq_setsockopt(struct socket *sock,
 
         } break;
 
+        case Q_SO_TX_ZEROCOPY:
+        {
+                int toggle, err = 0;
+                size_t n;
+
+		if (optlen != sizeof(toggle))
+			return -EINVAL;
+
+		if (copy_from_user(&toggle, optval, optlen))
+			return -EFAULT;
+
+		/* no flush nor thread start while the zero-copy state changes */
+
+		for(n = 0; n < so->tx_opt.num_queues; n++)
+		{
+			if (!pfq_tx_busy_lock(&so->tx_opt.queue[n])) {
+				printk(KERN_INFO "[PFQ|%d] Tx[%zu] zero-copy: queue flush in progress!\n", so->id.value, n);
+				err = -EBUSY;
+				break;
+			}
+
+			if (so->tx_opt.queue[n].task) {
+				printk(KERN_INFO "[PFQ|%d] Tx[%zu] zero-copy: kernel thread running!\n", so->id.value, n);
+				pfq_tx_busy_unlock(&so->tx_opt.queue[n]);
+				err = -EBUSY;
+				break;
+			}
+		}
+
+		if (err < 0) {
+			while (n--)
+				pfq_tx_busy_unlock(&so->tx_opt.queue[n]);
+			return err;
+		}
+
+		for(n = 0; n < so->tx_opt.num_queues; n++)
+		{
+			if (toggle) {
+				err = pfq_tx_zerocopy_alloc(so, (int)n);
+				if (err < 0)
+					break;
+			}
+			else
+				pfq_tx_zerocopy_free(&so->tx_opt.queue[n]);
+		}
+
+		for(n = 0; n < so->tx_opt.num_queues; n++)
+			pfq_tx_busy_unlock(&so->tx_opt.queue[n]);
+
+		if (err < 0)
+			return err;
+
+		pr_devel("[PFQ|%d] Tx zero-copy %s.\n", so->id.value, toggle ? "enabled" : "disabled");
+        } break;
+
+        case Q_SO_TX_REPLAY:
+        {
+                struct pfq_tx_replay opt;
+
+		if (optlen != sizeof(opt))
+			return -EINVAL;
+
+		if (copy_from_user(&opt, optval, optlen))
+			return -EFAULT;
+
+		if (opt.queue < 0 || opt.queue >= Q_MAX_TX_QUEUES) {
+			printk(KERN_INFO "[PFQ|%d] Tx replay: bad queue %d!\n", so->id.value, opt.queue);
+			return -EINVAL;
+		}
+
+		/* stop: the trace is released (by the kernel thread, if running) */
+
+		if (opt.loops < 0)
+			return pfq_tx_gen_stop(so, opt.queue);
+
+		if (so->tx_opt.queue[opt.queue].task) {
+			printk(KERN_INFO "[PFQ|%d] Tx[%d] replay: kernel thread running!\n", so->id.value, opt.queue);
+			return -EBUSY;
+		}
+
+		return pfq_tx_replay_start(so, &opt);
+        }
+
+        case Q_SO_TX_TEMPLATE:
+        {
+                struct pfq_tx_template opt;
+
+		if (optlen != sizeof(opt))
+			return -EINVAL;
+
+		if (copy_from_user(&opt, optval, optlen))
+			return -EFAULT;
+
+		if (opt.queue < 0 || opt.queue >= Q_MAX_TX_QUEUES) {
+			printk(KERN_INFO "[PFQ|%d] Tx template: bad queue %d!\n", so->id.value, opt.queue);
+			return -EINVAL;
+		}
+
+		/* stop: the templates are released (by the kernel thread, if running) */
+
+		if (opt.num_pkts == 0)
+			return pfq_tx_gen_stop(so, opt.queue);
+
+		if (opt.num_pkts < 0 || opt.num_pkts > Q_TX_TEMPLATE_MAX ||
+		    opt.num_rules < 0 || opt.num_rules > Q_TX_TEMPLATE_MAX_RULES) {
+			printk(KERN_INFO "[PFQ|%d] Tx template: bad number of templates/rules!\n", so->id.value);
+			return -EINVAL;
+		}
+
+		if (so->tx_opt.queue[opt.queue].task) {
+			printk(KERN_INFO "[PFQ|%d] Tx[%d] template: kernel thread running!\n", so->id.value, opt.queue);
+			return -EBUSY;
+		}
+
+		return pfq_tx_template_start(so, &opt);
+        }
+
+        case Q_SO_TX_RING:
+        {
+                int toggle;
+                size_t n;
+
+		if (optlen != sizeof(toggle))
+			return -EINVAL;
+
+		if (copy_from_user(&toggle, optval, optlen))
+			return -EFAULT;
+
+		for(n = 0; n < so->tx_opt.num_queues; n++)
+		{
+			if (so->tx_opt.queue[n].task) {
+				printk(KERN_INFO "[PFQ|%d] Tx[%zu] ring: kernel thread running!\n", so->id.value, n);
+				return -EBUSY;
+			}
+		}
+
+		for(n = 0; n < Q_MAX_TX_QUEUES; n++)
+		{
+			if (so->tx_opt.queue[n].zc) {
+				printk(KERN_INFO "[PFQ|%d] Tx[%zu] ring: zero-copy enabled!\n", so->id.value, n);
+				return -EBUSY;
+			}
+		}
+
+		so->tx_opt.ring = toggle != 0;
+
+		/* the queues already enabled restart empty */
+
+		for(n = 0; n < Q_MAX_TX_QUEUES; n++)
+		{
+			struct pfq_tx_queue *txq = pfq_get_tx_queue(&so->tx_opt, n);
+			if (txq == NULL)
+				continue;
+
+			txq->prod = 0;
+			txq->cons = 0;
+			txq->done = so->tx_opt.ring ? 0 : (unsigned int)-1;
+			txq->ptr  = NULL;
+			txq->index = -1;
+		}
+
+		pr_devel("[PFQ|%d] Tx ring %s.\n", so->id.value, toggle ? "enabled" : "disabled");
+        } break;
+
         case Q_SO_GROUP_FUNCTION:
         {
                 struct pfq_computation_descr *descr = NULL;
@@ -977,13 +1339,217 @@ int pfq_setsockopt(struct socket *sock,
 		kfree(descr);
                 return 0;
 
-	error:  kfree(comp);
+	error:  pfq_computation_free(comp);
 		kfree(context);
 		kfree(descr);
 		return err;
 
         } break;
 
+        case Q_SO_GROUP_TABLE:
+        {
+                struct pfq_group_table tab;
+                struct pfq_table_entry *entries;
+                struct pfq_table *table;
+                struct pfq_group *g;
+                pfq_gid_t gid;
+                size_t n, chunk;
+                int err = 0;
+
+                if (optlen != sizeof(tab))
+                        return -EINVAL;
+
+                if (copy_from_user(&tab, optval, optlen))
+                        return -EFAULT;
+
+		gid.value = tab.gid;
+
+		if (!pfq_has_joined_group(gid, so->id)) {
+                        printk(KERN_INFO "[PFQ|%d] group table: gid=%d not joined!\n", so->id.value, tab.gid);
+			return -EACCES;
+		}
+
+                if (tab.table < 0 || tab.table >= Q_MAX_GROUP_TABLES) {
+                        printk(KERN_INFO "[PFQ|%d] group table: bad index %d!\n", so->id.value, tab.table);
+                        return -EINVAL;
+                }
+
+                switch(tab.op)
+                {
+                case Q_TABLE_CREATE: {
+
+                        table = pfq_table_create(tab.type, tab.size);
+                        if (table == NULL) {
+                                printk(KERN_INFO "[PFQ|%d] group table: create error (type=%d size=%zu)!\n",
+                                       so->id.value, tab.type, tab.size);
+                                return -ENOMEM;
+                        }
+
+                        pr_devel("[PFQ|%d] group table: gid=%d table[%d]@%p created.\n",
+                                 so->id.value, tab.gid, tab.table, table);
+
+                        return pfq_set_group_table(gid, tab.table, table);
+                }
+                case Q_TABLE_DESTROY: {
+
+                        pr_devel("[PFQ|%d] group table: gid=%d table[%d] destroyed.\n",
+                                 so->id.value, tab.gid, tab.table);
+
+                        return pfq_set_group_table(gid, tab.table, NULL);
+                }
+                case Q_TABLE_INSERT:
+                case Q_TABLE_DELETE:
+                case Q_TABLE_FLUSH:
+                        break;
+                default:
+                        return -EINVAL;
+                }
+
+                g = pfq_get_group(gid);
+
+                down(&group_sem);
+
+                table = rcu_dereference_protected(g->table[tab.table], 1);
+                if (table == NULL) {
+                        printk(KERN_INFO "[PFQ|%d] group table: gid=%d table[%d] not created!\n",
+                               so->id.value, tab.gid, tab.table);
+                        up(&group_sem);
+                        return -EINVAL;
+                }
+
+                if (tab.op == Q_TABLE_FLUSH) {
+                        pfq_table_flush(table);
+                        up(&group_sem);
+                        return 0;
+                }
+
+                /* entries are copied from user-space in chunks */
+
+                entries = kmalloc(sizeof(struct pfq_table_entry) * 256, GFP_KERNEL);
+                if (entries == NULL) {
+                        up(&group_sem);
+                        return -ENOMEM;
+                }
+
+                for(n = 0; n < tab.size && !err; n += chunk)
+                {
+                        chunk = min_t(size_t, tab.size - n, 256);
+
+                        if (copy_from_user(entries, tab.entries + n, sizeof(struct pfq_table_entry) * chunk)) {
+                                err = -EFAULT;
+                                break;
+                        }
+
+                        err = tab.op == Q_TABLE_INSERT ? pfq_table_insert(table, entries, chunk)
+                                                       : pfq_table_delete(table, entries, chunk);
+
+                        /* bulk updates of large tables */
+
+                        cond_resched();
+                }
+
+                up(&group_sem);
+
+                kfree(entries);
+
+                if (err)
+                        printk(KERN_INFO "[PFQ|%d] group table: gid=%d table[%d] update error (%d)!\n",
+                               so->id.value, tab.gid, tab.table, err);
+                return err;
+
+        } break;
+
+        case Q_SO_GROUP_BLOOM:
+        {
+                struct pfq_group_bloom bf;
+                struct pfq_bloom *bloom;
+                pfq_gid_t gid;
+                int err;
+
+                if (optlen != sizeof(bf))
+                        return -EINVAL;
+
+                if (copy_from_user(&bf, optval, optlen))
+                        return -EFAULT;
+
+		gid.value = bf.gid;
+
+		if (!pfq_has_joined_group(gid, so->id)) {
+                        printk(KERN_INFO "[PFQ|%d] group bloom: gid=%d not joined!\n", so->id.value, bf.gid);
+			return -EACCES;
+		}
+
+                if (bf.filter < 0 || bf.filter >= Q_MAX_GROUP_BLOOMS) {
+                        printk(KERN_INFO "[PFQ|%d] group bloom: bad index %d!\n", so->id.value, bf.filter);
+                        return -EINVAL;
+                }
+
+                if (bf.size == 0)
+                        return pfq_set_group_bloom(gid, bf.filter, NULL);
+
+                if (bf.size % (Q_BLOOM_BLOCK_BITS/8)) {
+                        printk(KERN_INFO "[PFQ|%d] group bloom: size %zu is not a multiple of %d bytes!\n",
+                               so->id.value, bf.size, Q_BLOOM_BLOCK_BITS/8);
+                        return -EINVAL;
+                }
+
+                bloom = pfq_bloom_alloc(bf.size / (Q_BLOOM_BLOCK_BITS/8), bf.ipv, bf.prefix);
+                if (bloom == NULL) {
+                        printk(KERN_INFO "[PFQ|%d] group bloom: could not allocate filter (IPv%d/%d, %zu bytes)!\n",
+                               so->id.value, bf.ipv, bf.prefix, bf.size);
+                        return -EINVAL;
+                }
+
+                if (copy_from_user(bloom->bits, bf.bits, bf.size)) {
+                        pfq_bloom_free(bloom);
+                        return -EFAULT;
+                }
+
+                /* the old filter is released after a grace period */
+
+                err = pfq_set_group_bloom(gid, bf.filter, bloom);
+                if (err < 0) {
+                        pfq_bloom_free(bloom);
+                        return err;
+                }
+
+                pr_devel("[PFQ|%d] group bloom: gid=%d bloom[%d]@%p loaded (%zu bytes).\n",
+                         so->id.value, bf.gid, bf.filter, bloom, bf.size);
+                return 0;
+
+        } break;
+
+        case Q_SO_GROUP_STEERING:
+        {
+                struct pfq_group_steering st;
+                pfq_gid_t gid;
+                int err;
+
+                if (optlen != sizeof(st))
+                        return -EINVAL;
+
+                if (copy_from_user(&st, optval, optlen))
+                        return -EFAULT;
+
+		gid.value = st.gid;
+
+		if (!pfq_has_joined_group(gid, so->id)) {
+                        printk(KERN_INFO "[PFQ|%d] group steering: gid=%d not joined!\n", so->id.value, st.gid);
+			return -EACCES;
+		}
+
+                err = pfq_set_group_steering(gid, st.mode, st.rate, st.flowlet);
+                if (err < 0) {
+                        printk(KERN_INFO "[PFQ|%d] group steering: gid=%d mode %d error!\n", so->id.value, st.gid, st.mode);
+                        return err;
+                }
+
+                pr_devel("[PFQ|%d] group steering: gid=%d mode=%d rate=%u Mbit/s flowlet=%u usec.\n",
+                         so->id.value, st.gid, st.mode, st.rate, st.flowlet);
+                return 0;
+
+        } break;
+
         default:
         {
                 found = false;
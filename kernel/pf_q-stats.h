@@ -56,6 +56,8 @@ struct pfq_group_stats
         sparse_counter_t kern;          /* passed to kernel */
         sparse_counter_t disc;          /* discarded due to driver congestion */
         sparse_counter_t abrt;          /* aborted (e.g. memory problems) */
+        sparse_counter_t elph;          /* flows promoted to elephant (adaptive steering) */
+        sparse_counter_t sprd;          /* packets of elephant flows steered adaptively */
 };
 
 static inline
@@ -67,6 +69,8 @@ void pfq_group_stats_reset(struct pfq_group_stats *stats)
         sparse_set(&stats->kern, 0);
         sparse_set(&stats->disc, 0);
         sparse_set(&stats->abrt, 0);
+        sparse_set(&stats->elph, 0);
+        sparse_set(&stats->sprd, 0);
 }
 
 struct pfq_global_stats
@@ -108,6 +112,10 @@ struct pfq_memory_stats
 	sparse_counter_t err_shared;
 	sparse_counter_t err_cloned;
 	sparse_counter_t err_memory;
+
+	sparse_counter_t flow_insert;	/* flow tables: new entries */
+	sparse_counter_t flow_expire;	/* flow tables: idle entries recycled */
+	sparse_counter_t flow_evict;	/* flow tables: live entries evicted (table pressure) */
 };
 
 
@@ -121,6 +129,37 @@ void pfq_memory_stats_reset(struct pfq_memory_stats *stats)
         sparse_set(&stats->err_shared, 0);
         sparse_set(&stats->err_cloned, 0);
         sparse_set(&stats->err_memory, 0);
+
+        sparse_set(&stats->flow_insert, 0);
+        sparse_set(&stats->flow_expire, 0);
+        sparse_set(&stats->flow_evict,  0);
+}
+
+
+/* Tx pacing: inter-departure error, bucket n >= 1 counts errors in [64 << (n-1), 64 << n) nsec */
+
+#define Q_TX_PACING_HIST	16
+
+struct pfq_pacing_stats
+{
+	sparse_counter_t hist[Q_TX_PACING_HIST];
+	sparse_counter_t sleep;		/* hrtimer sleeps */
+	sparse_counter_t early;		/* packets launched ahead of time (window) */
+	sparse_counter_t park;		/* idle Tx kernel threads parked */
+	sparse_counter_t aggr;		/* skbs handed over to the owner of the hw queue */
+};
+
+static inline
+void pfq_pacing_stats_reset(struct pfq_pacing_stats *stats)
+{
+	int n;
+	for(n = 0; n < Q_TX_PACING_HIST; n++)
+		sparse_set(&stats->hist[n], 0);
+
+	sparse_set(&stats->sleep, 0);
+	sparse_set(&stats->early, 0);
+	sparse_set(&stats->park, 0);
+	sparse_set(&stats->aggr, 0);
 }
 
 
@@ -206,6 +206,11 @@ pfq_symtable_init(void)
         pfq_symtable_register_functions(NULL, &pfq_lang_functions, (struct pfq_function_descr *)predicate_functions);
         pfq_symtable_register_functions(NULL, &pfq_lang_functions, (struct pfq_function_descr *)combinator_functions);
         pfq_symtable_register_functions(NULL, &pfq_lang_functions, (struct pfq_function_descr *)property_functions);
+        pfq_symtable_register_functions(NULL, &pfq_lang_functions, (struct pfq_function_descr *)flow_functions);
+        pfq_symtable_register_functions(NULL, &pfq_lang_functions, (struct pfq_function_descr *)prefix_functions);
+        pfq_symtable_register_functions(NULL, &pfq_lang_functions, (struct pfq_function_descr *)tunnel_functions);
+        pfq_symtable_register_functions(NULL, &pfq_lang_functions, (struct pfq_function_descr *)payload_functions);
+        pfq_symtable_register_functions(NULL, &pfq_lang_functions, (struct pfq_function_descr *)set_functions);
 
 	pfq_symtable_pr_devel("pfq-lang functions: ",   &pfq_lang_functions);
 
@@ -0,0 +1,194 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/sched.h>
+
+#include <pf_q-table.h>
+
+#define Q_TABLE_MIN_BUCKETS	1024
+#define Q_TABLE_MAX_BUCKETS	(1 << 24)
+#define Q_TABLE_LOAD_FACTOR	2	/* max entries per bucket, on average */
+#define Q_TABLE_FLUSH_CHUNK	1024	/* buckets flushed with the lock held */
+
+
+struct pfq_table *
+pfq_table_create(int type, size_t size)
+{
+	struct pfq_table *table;
+	size_t buckets;
+
+	if (type != Q_TABLE_KEY_ADDR && type != Q_TABLE_KEY_FLOW)
+		return NULL;
+
+	buckets = roundup_pow_of_two(clamp_t(size_t, size, Q_TABLE_MIN_BUCKETS, Q_TABLE_MAX_BUCKETS));
+
+	table = vzalloc(sizeof(struct pfq_table) + buckets * sizeof(struct hlist_head));
+	if (!table)
+		return NULL;
+
+	table->type = type;
+	table->mask = buckets - 1;
+	table->max  = buckets * Q_TABLE_LOAD_FACTOR;
+	atomic_set(&table->count, 0);
+	spin_lock_init(&table->lock);
+
+	pr_devel("[PFQ] table@%p: type=%d buckets=%zu\n", table, type, buckets);
+	return table;
+}
+
+
+/* process context: the lock is released every Q_TABLE_FLUSH_CHUNK buckets */
+
+static void
+__pfq_table_flush(struct pfq_table *table, bool rcu)
+{
+	struct pfq_table_node *n;
+	struct hlist_node *tmp;
+	size_t i;
+
+	spin_lock(&table->lock);
+
+	for(i = 0; i <= table->mask; i++)
+	{
+		hlist_for_each_entry_safe(n, tmp, &table->bucket[i], node)
+		{
+			hlist_del_rcu(&n->node);
+			atomic_dec(&table->count);
+			if (rcu)
+				kfree_rcu(n, rcu);
+			else
+				kfree(n);
+		}
+
+		if ((i + 1) % Q_TABLE_FLUSH_CHUNK == 0) {
+			spin_unlock(&table->lock);
+			cond_resched();
+			spin_lock(&table->lock);
+		}
+	}
+
+	spin_unlock(&table->lock);
+}
+
+
+void
+pfq_table_flush(struct pfq_table *table)
+{
+	__pfq_table_flush(table, true);
+}
+
+
+/* the table must be unreachable from the data-path (after a grace period) */
+
+void
+pfq_table_free(struct pfq_table *table)
+{
+	if (table == NULL)
+		return;
+
+	__pfq_table_flush(table, false);
+
+	pr_devel("[PFQ] table@%p: freed\n", table);
+	vfree(table);
+}
+
+
+int
+pfq_table_insert(struct pfq_table *table, struct pfq_table_entry const *entries, size_t n)
+{
+	size_t i;
+
+	for(i = 0; i < n; i++)
+	{
+		struct hlist_head *head = &table->bucket[pfq_table_hash(table->type, &entries[i]) & table->mask];
+		struct pfq_table_node *node, *this;
+
+		node = kmalloc(sizeof(struct pfq_table_node), GFP_KERNEL);
+		if (!node)
+			return -ENOMEM;
+
+		node->entry = entries[i];
+
+		spin_lock(&table->lock);
+
+		hlist_for_each_entry(this, head, node)
+		{
+			if (pfq_table_key_equal(table->type, &this->entry, &node->entry))
+				break;
+		}
+
+		if (this) {	/* already present: update the value */
+			ACCESS_ONCE(this->entry.value) = node->entry.value;
+			spin_unlock(&table->lock);
+			kfree(node);
+			continue;
+		}
+
+		if (atomic_read(&table->count) >= table->max) {	/* the table is full */
+			spin_unlock(&table->lock);
+			kfree(node);
+			return -ENOSPC;
+		}
+
+		hlist_add_head_rcu(&node->node, head);
+		atomic_inc(&table->count);
+
+		spin_unlock(&table->lock);
+	}
+
+	return 0;
+}
+
+
+int
+pfq_table_delete(struct pfq_table *table, struct pfq_table_entry const *entries, size_t n)
+{
+	size_t i;
+
+	spin_lock(&table->lock);
+
+	for(i = 0; i < n; i++)
+	{
+		struct hlist_head *head = &table->bucket[pfq_table_hash(table->type, &entries[i]) & table->mask];
+		struct pfq_table_node *this;
+
+		hlist_for_each_entry(this, head, node)
+		{
+			if (pfq_table_key_equal(table->type, &this->entry, &entries[i])) {
+				hlist_del_rcu(&this->node);
+				kfree_rcu(this, rcu);
+				atomic_dec(&table->count);
+				break;
+			}
+		}
+	}
+
+	spin_unlock(&table->lock);
+	return 0;
+}
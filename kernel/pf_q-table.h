@@ -0,0 +1,103 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+
+#ifndef PF_Q_TABLE_H
+#define PF_Q_TABLE_H
+
+#include <linux/kernel.h>
+#include <linux/rculist.h>
+#include <linux/spinlock.h>
+#include <linux/jhash.h>
+#include <linux/pf_q.h>
+
+
+/* exact-match table: RCU hash table, updated from user-space through Q_SO_GROUP_TABLE */
+
+struct pfq_table_node
+{
+	struct hlist_node	node;
+	struct rcu_head		rcu;
+	struct pfq_table_entry	entry;
+};
+
+
+struct pfq_table
+{
+	int			type;		/* Q_TABLE_KEY_ADDR, Q_TABLE_KEY_FLOW */
+	unsigned int		mask;		/* number of buckets - 1 */
+	unsigned int		max;		/* max number of entries */
+	atomic_t		count;		/* number of entries */
+	spinlock_t		lock;		/* writers only */
+	struct hlist_head	bucket[];
+};
+
+
+extern struct pfq_table * pfq_table_create(int type, size_t size);
+extern void pfq_table_free(struct pfq_table *table);
+
+extern int  pfq_table_insert(struct pfq_table *table, struct pfq_table_entry const *entries, size_t n);
+extern int  pfq_table_delete(struct pfq_table *table, struct pfq_table_entry const *entries, size_t n);
+extern void pfq_table_flush(struct pfq_table *table);
+
+
+static inline uint32_t
+pfq_table_hash(int type, struct pfq_table_entry const *key)
+{
+	if (type == Q_TABLE_KEY_ADDR)
+		return jhash_1word(key->saddr, 0);
+
+	return jhash_3words(key->saddr, key->daddr, ((uint32_t)key->sport << 16) | key->dport, key->proto);
+}
+
+
+static inline bool
+pfq_table_key_equal(int type, struct pfq_table_entry const *a, struct pfq_table_entry const *b)
+{
+	if (type == Q_TABLE_KEY_ADDR)
+		return a->saddr == b->saddr;
+
+	return  a->saddr == b->saddr && a->daddr == b->daddr &&
+		a->sport == b->sport && a->dport == b->dport &&
+		a->proto == b->proto;
+}
+
+
+/* to be called under rcu_read_lock */
+
+static inline struct pfq_table_entry *
+pfq_table_lookup(struct pfq_table *table, struct pfq_table_entry const *key)
+{
+	struct pfq_table_node *n;
+
+	hlist_for_each_entry_rcu(n, &table->bucket[pfq_table_hash(table->type, key) & table->mask], node)
+	{
+		if (pfq_table_key_equal(table->type, &n->entry, key))
+			return &n->entry;
+	}
+
+	return NULL;
+}
+
+
+#endif /* PF_Q_TABLE_H */
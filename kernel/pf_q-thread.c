@@ -30,17 +30,25 @@
 #include <linux/module.h>
 #include <linux/version.h>
 #include <linux/kthread.h>
+#include <linux/hrtimer.h>
+#include <linux/netdevice.h>
+#include <linux/cpumask.h>
+#include <linux/topology.h>
 
 #include <pf_q-macro.h>
 #include <pf_q-thread.h>
 #include <pf_q-memory.h>
 #include <pf_q-sock.h>
 #include <pf_q-transmit.h>
+#include <pf_q-global.h>
+
+/* the doorbell: wake up the kernel thread of the Tx queue, if idle */
 
 int
 pfq_tx_wakeup(struct pfq_sock *so, int index)
 {
 	if (so->tx_opt.queue[index].task) {
+		WRITE_ONCE(so->tx_opt.queue[index].doorbell, 1);
 		wake_up_process(so->tx_opt.queue[index].task);
 		return 0;
 	}
@@ -49,11 +57,95 @@ pfq_tx_wakeup(struct pfq_sock *so, int index)
 }
 
 
+/* Q_ANY_CPU: the Tx queues are spread over the cpus of the NUMA node of the device */
+
+int
+pfq_tx_thread_cpu(struct pfq_sock *so, size_t index)
+{
+	const struct cpumask *mask = cpu_online_mask;
+	struct net_device *dev;
+	int cpu, node = NUMA_NO_NODE;
+	unsigned int n = 0;
+
+	dev = dev_get_by_index(sock_net(&so->sk), so->tx_opt.queue[index].if_index);
+	if (dev) {
+		if (dev->dev.parent)
+			node = dev_to_node(dev->dev.parent);
+		dev_put(dev);
+	}
+
+	if (node != NUMA_NO_NODE && cpumask_intersects(cpumask_of_node(node), cpu_online_mask))
+		mask = cpumask_of_node(node);
+
+	for_each_cpu_and(cpu, mask, cpu_online_mask)
+		n++;
+
+	n = index % n;
+
+	for_each_cpu_and(cpu, mask, cpu_online_mask)
+		if (n-- == 0)
+			return cpu;
+
+	return cpumask_first(cpu_online_mask);
+}
+
+
+/* idle: sleep for usec, or until the doorbell rings (pfq_tx_wakeup) */
+
+static void
+pfq_tx_sleep(struct pfq_tx_queue_info *info, int usec)
+{
+	ktime_t t = ns_to_ktime((u64)usec * NSEC_PER_USEC);
+
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	if (!READ_ONCE(info->doorbell) && !kthread_should_stop())
+		schedule_hrtimeout_range(&t, (u64)usec * NSEC_PER_USEC / 4, HRTIMER_MODE_REL);
+
+	__set_current_state(TASK_RUNNING);
+}
+
+
+/* park the idle kernel thread, until the doorbell rings (or tx_park_timeout usec):
+ * user-space rings it when it finds the parked flag set, after publishing packets.
+ * With tx_park_timeout = 0 the thread just sleeps tx_idle_sleep usec at a time.
+ */
+
+static void
+pfq_tx_park(struct pfq_sock *so, size_t index)
+{
+	struct pfq_tx_queue_info *info = &so->tx_opt.queue[index];
+	struct pfq_tx_queue *txq = pfq_get_tx_queue(&so->tx_opt, index);
+
+	if (txq == NULL)
+		return;
+
+	WRITE_ONCE(info->doorbell, 0);
+
+	if (tx_park_timeout <= 0) {
+		pfq_tx_sleep(info, tx_idle_sleep);
+		return;
+	}
+
+	__atomic_store_n(&txq->parked, 1, __ATOMIC_SEQ_CST);
+
+	/* packets published before the flag was visible */
+
+	if (pfq_tx_idle(&so->tx_opt, index)) {
+		__sparse_inc(&pacing_stats.park, smp_processor_id());
+		pfq_tx_sleep(info, tx_park_timeout);
+	}
+
+	__atomic_store_n(&txq->parked, 0, __ATOMIC_RELAXED);
+}
+
+
 int
 pfq_tx_thread(void *_data)
 {
         struct pfq_thread_data *data = (struct pfq_thread_data *)_data;
         struct net_device *dev;
+	s64 idle_since = 0;
 	int cpu;
 
 	if (data == NULL) {
@@ -70,12 +162,21 @@ pfq_tx_thread(void *_data)
 
         for(;;)
         {
-                __pfq_queue_xmit(data->id, &data->so->tx_opt, dev, cpu, cpu_to_node(cpu));
+                if (__pfq_queue_xmit(data->id, &data->so->tx_opt, dev, cpu, cpu_to_node(cpu)) > 0 ||
+		    tx_idle_sleep <= 0)
+			idle_since = 0;
+		else if (idle_since == 0)
+			idle_since = ktime_to_ns(ktime_get());
 
                 if (kthread_should_stop())
                         break;
 
-		pfq_relax();
+		/* spin while the traffic flows, park once idle for tx_idle_spin usec */
+
+		if (idle_since && ktime_to_ns(ktime_get()) - idle_since > (s64)tx_idle_spin * NSEC_PER_USEC)
+			pfq_tx_park(data->so, data->id);
+		else
+			pfq_relax();
         }
 
         dev_put(dev);
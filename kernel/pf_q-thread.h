@@ -35,6 +35,7 @@
 
 extern int pfq_tx_thread(void *data);
 extern int pfq_tx_wakeup(struct pfq_sock *so, int index);
+extern int pfq_tx_thread_cpu(struct pfq_sock *so, size_t index);
 
 struct pfq_thread_data
 {
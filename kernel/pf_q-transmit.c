@@ -33,6 +33,19 @@
 
 #include <linux/skbuff.h>
 #include <linux/netdevice.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/hrtimer.h>
+#include <linux/delay.h>
+#include <linux/timex.h>
+#include <linux/if_ether.h>
+#include <linux/ip.h>
+#include <linux/tcp.h>
+#include <linux/udp.h>
+#include <linux/uaccess.h>
+#include <linux/hash.h>
+
+#include <net/checksum.h>
 
 #include <pf_q-thread.h>
 #include <pf_q-transmit.h>
@@ -41,12 +54,18 @@
 #include <pf_q-macro.h>
 #include <pf_q-global.h>
 #include <pf_q-GC.h>
+#include <pf_q-shmem.h>
+#include <pf_q-shared-queue.h>
 
 #include <pf_q-printk.h>
+#include <pf_q-skbuff-mpsc.h>
 
 static inline int
 __pfq_xmit(struct sk_buff *skb, struct net_device *dev, struct netdev_queue *txq, int xmit_more);
 
+static int
+tx_aggr_xmit(struct pfq_skbuff_batch *skbs, struct net_device *dev, int hw_queue, int cpu);
+
 
 static inline int
 __pfq_dev_cap_txqueue(struct net_device *dev, int hw_queue)
@@ -58,15 +77,53 @@ __pfq_dev_cap_txqueue(struct net_device *dev, int hw_queue)
 }
 
 
+/* the Tx queue of the XPS map of the current cpu, -1 if none */
+
+static int
+pfq_pick_tx_xps(struct net_device *dev, struct sk_buff *skb)
+{
+	int queue = -1;
+#if defined(CONFIG_XPS) && (LINUX_VERSION_CODE < KERNEL_VERSION(4,10,0))
+	struct xps_dev_maps *maps;
+	struct xps_map *map;
+
+	rcu_read_lock();
+
+	maps = rcu_dereference(dev->xps_maps);
+	if (maps) {
+		map = rcu_dereference(maps->cpu_map[raw_smp_processor_id()]);
+		if (map && map->len == 1)
+			queue = map->queues[0];
+		else if (map && map->len) {
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(3,14,0))
+			u32 hash = skb_get_rxhash(skb);
+#else
+			u32 hash = skb_get_hash(skb);
+#endif
+			queue = map->queues[((u64)hash * map->len) >> 32];
+		}
+	}
+
+	rcu_read_unlock();
+
+	if (queue >= (int)dev->real_num_tx_queues)
+		queue = -1;
+#endif
+	return queue;
+}
+
+
 #if (LINUX_VERSION_CODE > KERNEL_VERSION(3,13,0))
 static u16 __pfq_pick_tx_default(struct net_device *dev, struct sk_buff *skb)
 {
-	return 0;
+	int queue = pfq_pick_tx_xps(dev, skb);
+	return queue < 0 ? 0 : queue;
 }
 #endif
 
 
-/* select the right tx hw queue, and fix it (-1 means any queue) */
+/* select the right tx hw queue, and fix it (-1 means any queue: the driver
+ * selection or the XPS map of the cpu) */
 
 static struct netdev_queue *
 pfq_pick_tx(struct net_device *dev, struct sk_buff *skb, int *hw_queue)
@@ -83,7 +140,7 @@ pfq_pick_tx(struct net_device *dev, struct sk_buff *skb, int *hw_queue)
 #else
 			ops->ndo_select_queue(dev, skb, NULL, __pfq_pick_tx_default)
 #endif
-			: 0;
+			: max(pfq_pick_tx_xps(dev, skb), 0);
 	}
 
 	*hw_queue = __pfq_dev_cap_txqueue(dev, *hw_queue);
@@ -103,20 +160,33 @@ int giveup_tx(int cpu)
 }
 
 
+/* pool of a linear Tx skb: copybreak skbs are recycled apart from the full-size ones */
+
+static inline struct pfq_sk_buff_pool *
+tx_skb_pool(struct sk_buff const *skb, struct local_data *local)
+{
+	return pfq_skb_end_offset(skb) < (unsigned int)max_len ? &local->tx_small_pool : &local->tx_pool;
+}
+
+
 static int
-batch_xmit(struct pfq_skbuff_batch *skbs, struct local_data *local, struct net_device *dev, int hw_queue)
+batch_xmit(struct pfq_skbuff_batch *skbs, struct local_data *local, struct net_device *dev, int hw_queue, int cpu)
 {
 	struct sk_buff *skb;
 	int sent, i;
 
-	/* transmit the batch */
+	/* transmit the batch (or hand it over to the owner of the hw queue) */
 
-	sent = pfq_batch_xmit(skbs, dev, hw_queue);
+	sent = tx_aggr > 0 ? tx_aggr_xmit(skbs, dev, hw_queue, cpu)
+			   : pfq_batch_xmit(skbs, dev, hw_queue);
 
-	/* free the transmitted skb... */
+	/* free the transmitted skb (zero-copy ones are released by the completion ring)... */
 
 	for_each_skbuff_upto(sent, skbs, skb, i)
-		pfq_kfree_skb_pool(skb, &local->tx_pool);
+	{
+		if (!skb_is_nonlinear(skb))
+			pfq_kfree_skb_pool(skb, tx_skb_pool(skb, local));
+	}
 
 	/* ... and drop them from the batch */
 
@@ -131,28 +201,1230 @@ batch_xmit(struct pfq_skbuff_batch *skbs, struct local_data *local, struct net_d
 }
 
 
+/*
+ * timed Tx (pacing): packets whose timestamp falls within tx_pacing_window
+ * are launched in the same batch; kernel threads sleep on a hrtimer for gaps
+ * longer than tx_pacing_sleep, and spin on the TSC for the rest.
+ */
+
+static uint64_t tsc_mult;	/* cycles per nsec, 16.16 fixed point (0 = no TSC) */
+
+
+void
+pfq_tx_pacing_init(void)
+{
+	cycles_t c0, c1;
+	ktime_t t0, t1;
+	s64 ns;
+
+	t0 = ktime_get(); c0 = get_cycles();
+	mdelay(10);
+	t1 = ktime_get(); c1 = get_cycles();
+
+	ns = ktime_to_ns(ktime_sub(t1, t0));
+
+	tsc_mult = (ns > 0 && c1 > c0) ? div64_u64((uint64_t)(c1 - c0) << 16, ns) : 0;
+
+	printk(KERN_INFO "[PFQ] Tx pacing: %llu.%02llu cycles/nsec\n",
+	       tsc_mult >> 16, ((tsc_mult & 0xffff) * 100) >> 16);
+}
+
+
 static inline
 bool tx_batch_required(struct pfq_skbuff_batch *q, ktime_t now, uint64_t ts)
 {
 	size_t len = pfq_skbuff_batch_len(q);
-	return len == batch_len || ((len > 0) && (ts > ktime_to_ns(now)));
+	return len == batch_len || ((len > 0) && (ts > ktime_to_ns(now) + tx_pacing_window));
+}
+
+
+static inline
+bool tx_wait_required(ktime_t now, uint64_t ts)
+{
+	return ts > ktime_to_ns(now) + tx_pacing_window;
+}
+
+
+static ktime_t
+wait_until(uint64_t ts, int cpu)
+{
+	ktime_t now = ktime_get_real();
+	s64 gap = (s64)(ts - ktime_to_ns(now));
+
+	/* long gap: sleep on a hrtimer, waking up half the threshold ahead */
+
+	if (cpu != Q_NO_KTHREAD && tx_pacing_sleep > 0 && gap > tx_pacing_sleep * NSEC_PER_USEC) {
+
+		ktime_t expires = ns_to_ktime(ts - tx_pacing_sleep * NSEC_PER_USEC / 2);
+
+		__set_current_state(TASK_INTERRUPTIBLE);
+		schedule_hrtimeout_range_clock(&expires, 0, HRTIMER_MODE_ABS, CLOCK_REALTIME);
+
+		__sparse_inc(&pacing_stats.sleep, cpu);
+
+		now = ktime_get_real();
+		gap = (s64)(ts - ktime_to_ns(now));
+	}
+
+	/* spin on the TSC... */
+
+	if (tsc_mult && gap > 0) {
+
+		cycles_t end = get_cycles() + (cycles_t)(((uint64_t)gap * tsc_mult) >> 16);
+
+		while ((s64)(get_cycles() - end) < 0)
+		{
+			if (unlikely(giveup_tx(cpu)))
+				break;
+			pfq_relax();
+		}
+
+		return ktime_get_real();
+	}
+
+	/* ... or on the clock */
+
+	while (ktime_to_ns(now) < ts)
+	{
+		if (unlikely(giveup_tx(cpu)))
+			break;
+		pfq_relax();
+		now = ktime_get_real();
+	}
+
+	return now;
+}
+
+
+/* account the inter-departure error of a timed packet */
+
+static inline void
+tx_pacing_account(struct pfq_tx_queue_info *info, uint64_t ts, ktime_t now, int cpu)
+{
+	uint64_t dep = ktime_to_ns(now);
+
+	if (dep < ts)
+		__sparse_inc(&pacing_stats.early, cpu);
+
+	if (info->pace_ts && ts > info->pace_ts) {
+		s64 err = (s64)(dep - info->pace_dep) - (s64)(ts - info->pace_ts);
+		int n = fls64((err < 0 ? -err : err) >> 6);
+		__sparse_inc(&pacing_stats.hist[min(n, Q_TX_PACING_HIST-1)], cpu);
+	}
+
+	info->pace_ts  = ts;
+	info->pace_dep = dep;
+}
+
+
+/*
+ * zero-copy Tx: the first Q_TX_ZEROCOPY_HDR bytes of a packet are copied into
+ * a small (recycled) skb, the rest is attached as page fragments of the pinned
+ * hugepages. The skb is kept in a ring until the driver releases it; then the
+ * fragments are dropped, the skb goes back to the pool and the index of the
+ * last half (or the number of ring slots) completed is published in the Tx
+ * queue (done), for user-space to reuse the slots.
+ */
+
+static void
+zc_release_frags(struct sk_buff *skb)
+{
+	int i;
+
+	for (i = 0; i < skb_shinfo(skb)->nr_frags; i++)
+		__skb_frag_unref(&skb_shinfo(skb)->frags[i]);
+
+	skb_shinfo(skb)->nr_frags = 0;
+
+	skb->truesize -= skb->data_len;
+	skb->len      -= skb->data_len;
+	skb->data_len  = 0;
+}
+
+
+static void
+zc_reap(struct pfq_tx_zerocopy *zc, struct pfq_tx_queue *txq, struct pfq_sk_buff_pool *pool)
+{
+	unsigned int done;
+
+	while (zc->tail != zc->head)
+	{
+		struct sk_buff *skb = zc->ring[zc->tail & zc->mask].skb;
+
+		/* still owned by the driver */
+
+		if (atomic_read(&skb->users) > 1 || skb_cloned(skb))
+			break;
+
+		zc_release_frags(skb);
+		pfq_kfree_skb_pool(skb, pool);
+
+		zc->tail++;
+	}
+
+	/* completed up to the oldest skb in flight */
+
+	done = zc->tail != zc->head ? zc->ring[zc->tail & zc->mask].seq - 1 : zc->last;
+
+	__atomic_store_n(&txq->done, done, __ATOMIC_RELEASE);
+}
+
+
+static struct sk_buff *
+zc_alloc_skb(struct pfq_tx_zerocopy *zc, struct pfq_tx_queue *txq, const char *data,
+	     size_t len, unsigned int seq, struct pfq_sk_buff_pool *pool, int node)
+{
+	struct sk_buff *skb;
+	size_t off, left;
+	int n;
+
+	if ((len - Q_TX_ZEROCOPY_HDR) / PAGE_SIZE + 2 > MAX_SKB_FRAGS)
+		return NULL;
+
+	if (zc->head - zc->tail > zc->mask) {
+		zc_reap(zc, txq, pool);
+		if (zc->head - zc->tail > zc->mask)
+			return NULL;
+	}
+
+	skb = pfq_tx_alloc_small_skb(Q_TX_ZEROCOPY_COPYBREAK, GFP_KERNEL, node);
+	if (unlikely(skb == NULL))
+		return NULL;
+
+	skb_reset_tail_pointer(skb);
+	skb->len = 0;
+	__skb_put(skb, Q_TX_ZEROCOPY_HDR);
+
+	skb_copy_to_linear_data(skb, data, Q_TX_ZEROCOPY_HDR);
+
+	off  = data - zc->addr + Q_TX_ZEROCOPY_HDR;
+	left = len - Q_TX_ZEROCOPY_HDR;
+
+	for(n = 0; left; n++)
+	{
+		struct page *page = zc->pages[off >> PAGE_SHIFT];
+		size_t poff = off & (PAGE_SIZE-1);
+		size_t size = min_t(size_t, left, PAGE_SIZE - poff);
+
+		get_page(page);
+		skb_fill_page_desc(skb, n, page, poff, size);
+
+		skb->len      += size;
+		skb->data_len += size;
+		skb->truesize += size;
+
+		off  += size;
+		left -= size;
+	}
+
+	/* one reference for the driver, one for the completion ring */
+
+	skb_get(skb);
+
+	zc->ring[zc->head & zc->mask].skb = skb;
+	zc->ring[zc->head & zc->mask].seq = seq;
+	zc->head++;
+
+	return skb;
+}
+
+
+int
+pfq_tx_zerocopy_alloc(struct pfq_sock *so, int index)
+{
+	struct pfq_tx_queue *txq = pfq_get_tx_queue(&so->tx_opt, index);
+	struct pfq_tx_zerocopy *zc;
+	size_t n;
+
+	if (txq == NULL) {
+		printk(KERN_INFO "[PFQ|%d] Tx[%d] zero-copy: socket not enabled!\n", so->id.value, index);
+		return -EPERM;
+	}
+
+	if (so->shmem.kind != pfq_shmem_user) {
+		printk(KERN_INFO "[PFQ|%d] Tx[%d] zero-copy: hugepages required!\n", so->id.value, index);
+		return -EPERM;
+	}
+
+	if (so->tx_opt.queue[index].zc)
+		return 0;
+
+	/* user-space reuses a half (or a slot of the ring) once completed: at most two halves in flight */
+
+	n = roundup_pow_of_two(max(2 * (txq->size / Q_SPSC_QUEUE_SLOT_SIZE(Q_TX_ZEROCOPY_COPYBREAK) + 1),
+				   2 * so->tx_opt.queue_size));
+
+	zc = vzalloc(sizeof(struct pfq_tx_zerocopy) + n * sizeof(zc->ring[0]));
+	if (zc == NULL) {
+		printk(KERN_INFO "[PFQ|%d] Tx[%d] zero-copy: out of memory!\n", so->id.value, index);
+		return -ENOMEM;
+	}
+
+	zc->pages = so->shmem.hugepages;
+	zc->addr  = so->shmem.addr;
+	zc->mask  = n - 1;
+	zc->last  = txq->done;
+
+	so->tx_opt.queue[index].zc = zc;
+
+	pr_devel("[PFQ|%d] Tx[%d] zero-copy: %zu skbs in flight max.\n", so->id.value, index, n);
+	return 0;
+}
+
+
+void
+pfq_tx_zerocopy_free(struct pfq_tx_queue_info *info)
+{
+	struct pfq_tx_zerocopy *zc = info->zc;
+
+	if (zc == NULL)
+		return;
+
+	info->zc = NULL;
+
+	/* skbs still owned by the driver keep a reference to the pages */
+
+	for(; zc->tail != zc->head; zc->tail++)
+		kfree_skb(zc->ring[zc->tail & zc->mask].skb);
+
+	vfree(zc);
+}
+
+
+/* size of a Tx slot in the queue (packet or forward descriptor) */
+
+static inline size_t
+tx_slot_size(struct pfq_pkthdr_tx const *hdr)
+{
+	if (hdr->len & Q_TX_FWD)
+		return sizeof(struct pfq_pkthdr_tx) + sizeof(struct pfq_tx_fwd);
+
+	return sizeof(struct pfq_pkthdr_tx) + ALIGN(hdr->len, 8);
+}
+
+
+/* build the skb of a Tx slot: attached to a small skb (zero-copy) or copied */
+
+static struct sk_buff *
+tx_slot_skb(struct pfq_tx_opt *to, struct pfq_tx_zerocopy *zc, struct pfq_tx_queue *txq, struct pfq_pkthdr_tx *hdr,
+	    unsigned int seq, struct net_device *dev, int hw_queue, struct local_data *local, int node)
+{
+	const char *data = (const char *)(hdr+1);
+	size_t len = hdr->len;
+	struct sk_buff *skb;
+
+	/* forward descriptor: the packet is taken from the Rx queue of the socket */
+
+	if (len & Q_TX_FWD) {
+
+		struct pfq_sock *so = container_of(to, struct pfq_sock, tx_opt);
+		uint64_t off = ((struct pfq_tx_fwd *)(hdr+1))->offset;
+
+		len &= ~Q_TX_FWD;
+
+		if (unlikely(off > pfq_queue_mpsc_mem(so) || len > pfq_queue_mpsc_mem(so) - off)) {
+			if (printk_ratelimit())
+				printk(KERN_INFO "[PFQ|%d] Tx forward: bad offset %llu (len %zu)!\n",
+				       so->id.value, (unsigned long long)off, len);
+			return NULL;
+		}
+
+		data = (const char *)so->rx_opt.base_addr + off;
+	}
+
+	len = min_t(size_t, len, max_len);
+
+	skb = zc && len >= Q_TX_ZEROCOPY_COPYBREAK ?
+		zc_alloc_skb(zc, txq, data, len, seq, &local->tx_small_pool, node) : NULL;
+
+	if (skb == NULL) {
+
+		/* allocate a packet */
+
+		skb = zc && len < Q_TX_ZEROCOPY_COPYBREAK ?
+			pfq_tx_alloc_small_skb(Q_TX_ZEROCOPY_COPYBREAK, GFP_KERNEL, node) :
+			pfq_tx_alloc_skb(max_len, GFP_KERNEL, node);
+		if (unlikely(skb == NULL)) {
+			printk(KERN_INFO "[PFQ] Tx could not allocate an skb!\n");
+			return NULL;
+		}
+
+		/* fill the skb */
+
+		skb_reset_tail_pointer(skb);
+		skb->len = 0;
+		__skb_put(skb, len);
+
+		skb_get(skb);
+
+		/* copy bytes in the socket buffer */
+
+		skb_copy_to_linear_data(skb, data, len < 64 ? 64 : len);
+	}
+
+	skb->dev = dev;
+
+	skb_set_queue_mapping(skb, hw_queue);
+	return skb;
+}
+
+
+/* transmit the skbs left in the batch, and free the ones that could not be sent */
+
+static size_t
+tx_batch_flush(struct pfq_skbuff_batch *skbs, struct local_data *local, struct net_device *dev,
+	       int hw_queue, int cpu, size_t *disc)
+{
+	size_t tot_sent = 0;
+
+	while (pfq_skbuff_batch_len(skbs)) {
+
+		int sent = batch_xmit(skbs, local, dev, hw_queue, cpu);
+		tot_sent += sent;
+
+		/* break the loop when giveup is needed */
+		if (giveup_tx(cpu))
+			break;
+
+		if (sent == 0)
+			pfq_relax();
+
+	}
+
+	/* packet unsent from the last batch are freed */
+
+	*disc = pfq_skbuff_batch_len(skbs);
+	if (*disc) {
+		struct sk_buff *skb;
+		size_t n;
+		for_each_skbuff(skbs, skb, n) {
+
+			kfree_skb(skb); /* decrement use-count to 1 */
+
+			/* zero-copy skbs are released by the completion ring */
+
+			if (!skb_is_nonlinear(skb))
+				pfq_kfree_skb_pool(skb, tx_skb_pool(skb, local));
+		}
+	}
+
+	return tot_sent;
 }
 
 
-static inline
-ktime_t wait_until(uint64_t ts, int cpu)
-{
-	ktime_t now;
-	do
+/*
+ * streaming Tx ring (Q_SO_TX_RING): fixed-size slots, prod is the head
+ * (user-space), cons the tail (kernel) and done the number of slots whose
+ * packets have been released.
+ */
+
+static int
+__pfq_ring_xmit(size_t idx, struct pfq_tx_opt *to, struct net_device *dev, int cpu, int node)
+{
+	struct pfq_skbuff_short_batch skbs;
+	struct pfq_tx_zerocopy *zc;
+	struct pfq_tx_queue *soft_txq;
+	struct local_data *local;
+	size_t disc = 0, tot_sent = 0;
+	unsigned int head, tail, nslots;
+	int hw_queue;
+
+        ktime_t now; uint64_t last_ts;
+
+	soft_txq = pfq_get_tx_queue(to, idx);
+	hw_queue = to->queue[idx].hw_queue;
+	local	 = this_cpu_ptr(cpu_data);
+
+	zc = to->queue[idx].zc;
+	if (zc)
+		zc_reap(zc, soft_txq, &local->tx_small_pool);
+
+	nslots = 2 * to->queue_size;
+	tail   = soft_txq->cons;
+	head   = __atomic_load_n(&soft_txq->prod, __ATOMIC_ACQUIRE);
+
+	if (tail == head)
+		return 0;
+
+	if (unlikely(head - tail > nslots)) {
+		if (printk_ratelimit())
+			printk(KERN_INFO "[PFQ] Tx ring: bad head %u (tail %u)!\n", head, tail);
+		return 0;
+	}
+
+	/* initialize the batch */
+
+	pfq_skbuff_batch_init(SKBUFF_BATCH_ADDR(skbs));
+
+	now = ktime_get_real();
+
+	for(; tail != head; tail++)
+	{
+		struct pfq_pkthdr_tx *hdr = (struct pfq_pkthdr_tx *)
+			((char *)to->queue[idx].base_addr + (tail % nslots) * to->slot_size);
+		struct sk_buff *skb;
+
+		last_ts = hdr->nsec;
+
+		/* if the batch is full, transmit it (now) */
+	retry:
+		if (tx_batch_required(SKBUFF_BATCH_ADDR(skbs), now, last_ts)) {
+
+			int sent = batch_xmit(SKBUFF_BATCH_ADDR(skbs), local, dev, hw_queue, cpu);
+			tot_sent += sent;
+
+			if (giveup_tx(cpu))
+				break;
+
+			if (sent == 0) {
+				pfq_relax();
+				goto retry;
+			}
+
+			/* the slots of the packets sent are released to user-space */
+
+			__atomic_store_n(&soft_txq->cons, tail, __ATOMIC_RELEASE);
+		}
+
+		/* wait until the ts */
+
+		if (tx_wait_required(now, last_ts))
+			now = wait_until(last_ts, cpu);
+		else if (last_ts)
+			now = ktime_get_real();
+
+		if (last_ts)
+			tx_pacing_account(&to->queue[idx], last_ts, now, cpu);
+
+		skb = tx_slot_skb(to, zc, soft_txq, hdr, tail + 1, dev, hw_queue, local, node);
+		if (unlikely(skb == NULL))
+			break;
+
+		pfq_skbuff_short_batch_push(SKBUFF_BATCH_ADDR(skbs), skb);
+	}
+
+	tot_sent += tx_batch_flush(SKBUFF_BATCH_ADDR(skbs), local, dev, hw_queue, cpu, &disc);
+
+	/* slots not processed (giveup) are discarded */
+
+	disc += head - tail;
+
+	__atomic_store_n(&soft_txq->cons, head, __ATOMIC_RELEASE);
+
+	if (zc) {
+		zc->last = head;
+		zc_reap(zc, soft_txq, &local->tx_small_pool);
+	}
+	else
+		__atomic_store_n(&soft_txq->done, head, __ATOMIC_RELEASE);
+
+	/* update stats */
+
+	__sparse_add(&to->stats.disc, disc, cpu);
+	__sparse_add(&global_stats.disc, disc, cpu);
+
+	__sparse_add(&to->stats.sent, tot_sent, cpu);
+	__sparse_add(&global_stats.sent, tot_sent, cpu);
+
+	return tot_sent;
+}
+
+
+/*
+ * Tx replay (Q_SO_TX_REPLAY): the trace stored in the whole Tx queue region
+ * (both halves, pfq_pkthdr_tx with timestamps relative to the beginning of the
+ * trace) is transmitted in loop; done counts the loops completed.
+ */
+
+#define Q_TX_REPLAY_CHUNK	256
+
+
+static void
+tx_replay_rewrite_mac(unsigned char *addr, unsigned int loop)
+{
+	u32 low = ((u32)addr[3] << 16 | (u32)addr[4] << 8 | addr[5]) + loop;
+
+	addr[3] = low >> 16;
+	addr[4] = low >> 8;
+	addr[5] = low;
+}
+
+
+static void
+tx_replay_rewrite(struct sk_buff *skb, unsigned int flags, unsigned int loop)
+{
+	struct ethhdr *eth = (struct ethhdr *)skb->data;
+	struct iphdr *iph;
+
+	if (skb_headlen(skb) < ETH_HLEN)
+		return;
+
+	if (flags & Q_REPLAY_REWRITE_MAC) {
+		tx_replay_rewrite_mac(eth->h_source, loop);
+		tx_replay_rewrite_mac(eth->h_dest, loop);
+	}
+
+	if (!(flags & Q_REPLAY_REWRITE_IP) || eth->h_proto != htons(ETH_P_IP) ||
+	    skb_headlen(skb) < ETH_HLEN + sizeof(struct iphdr))
+		return;
+
+	iph = (struct iphdr *)(eth + 1);
+
+	{
+		__be32 saddr = htonl(ntohl(iph->saddr) + loop);
+		__be32 daddr = htonl(ntohl(iph->daddr) + loop);
+		size_t l4 = ETH_HLEN + iph->ihl * 4;
+
+		/* transport checksums cover the pseudo-header */
+
+		if (iph->protocol == IPPROTO_UDP && skb_headlen(skb) >= l4 + sizeof(struct udphdr)) {
+			struct udphdr *uh = (struct udphdr *)(skb->data + l4);
+			if (uh->check) {
+				csum_replace4(&uh->check, iph->saddr, saddr);
+				csum_replace4(&uh->check, iph->daddr, daddr);
+			}
+		}
+		else if (iph->protocol == IPPROTO_TCP && skb_headlen(skb) >= l4 + sizeof(struct tcphdr)) {
+			struct tcphdr *th = (struct tcphdr *)(skb->data + l4);
+			csum_replace4(&th->check, iph->saddr, saddr);
+			csum_replace4(&th->check, iph->daddr, daddr);
+		}
+
+		csum_replace4(&iph->check, iph->saddr, saddr);
+		csum_replace4(&iph->check, iph->daddr, daddr);
+
+		iph->saddr = saddr;
+		iph->daddr = daddr;
+	}
+}
+
+
+static inline uint64_t
+tx_replay_tstamp(struct pfq_tx_replay_state *rs, struct pfq_pkthdr_tx const *hdr)
+{
+	if (rs->opt.gap)
+		return rs->base + rs->count * rs->opt.gap;
+
+	if (rs->opt.speed)
+		return rs->base + div_u64(hdr->nsec * 1000, rs->opt.speed);
+
+	return 0; /* line rate */
+}
+
+
+static int
+__pfq_replay_xmit(size_t idx, struct pfq_tx_opt *to, struct net_device *dev, int cpu, int node)
+{
+	struct pfq_tx_replay_state *rs = to->queue[idx].replay;
+	struct pfq_skbuff_short_batch skbs;
+	struct pfq_tx_queue *soft_txq;
+	struct local_data *local;
+	size_t disc = 0, tot_sent = 0, n;
+	char *begin, *end;
+	int hw_queue;
+
+        ktime_t now; uint64_t last_ts;
+
+	if (READ_ONCE(rs->stop) || (rs->opt.loops > 0 && rs->loop >= rs->opt.loops))
+		return 0;
+
+	soft_txq = pfq_get_tx_queue(to, idx);
+	hw_queue = to->queue[idx].hw_queue;
+	local	 = this_cpu_ptr(cpu_data);
+
+	begin = to->queue[idx].base_addr;
+	end   = begin + 2 * soft_txq->size;
+
+	pfq_skbuff_batch_init(SKBUFF_BATCH_ADDR(skbs));
+
+	now = ktime_get_real();
+
+	if (rs->ptr == NULL) {
+		rs->ptr  = begin;
+		rs->base = ktime_to_ns(now);
+	}
+
+	for(n = 0; n < Q_TX_REPLAY_CHUNK && !READ_ONCE(to->queue[idx].gen_stop); n++)
+	{
+		struct pfq_pkthdr_tx *hdr = (struct pfq_pkthdr_tx *)rs->ptr;
+		struct sk_buff *skb;
+
+		/* end of the trace: next loop */
+
+		if (rs->ptr + sizeof(struct pfq_pkthdr_tx) > end || hdr->len == 0 ||
+		    (hdr->len & Q_TX_FWD) || rs->ptr + tx_slot_size(hdr) > end) {
+
+			if (rs->count == 0) { /* empty trace */
+				rs->stop = true;
+				break;
+			}
+
+			__atomic_store_n(&soft_txq->done, ++rs->loop, __ATOMIC_RELEASE);
+
+			if (rs->opt.loops > 0 && rs->loop >= rs->opt.loops)
+				break;
+
+			rs->ptr   = begin;
+			rs->count = 0;
+			rs->base  = ktime_to_ns(ktime_get_real());
+			continue;
+		}
+
+		last_ts = tx_replay_tstamp(rs, hdr);
+
+		/* if the batch is full, transmit it (now) */
+	retry:
+		if (tx_batch_required(SKBUFF_BATCH_ADDR(skbs), now, last_ts)) {
+
+			int sent = batch_xmit(SKBUFF_BATCH_ADDR(skbs), local, dev, hw_queue, cpu);
+			tot_sent += sent;
+
+			if (giveup_tx(cpu))
+				break;
+
+			if (sent == 0) {
+				pfq_relax();
+				goto retry;
+			}
+		}
+
+		/* wait until the ts */
+
+		if (tx_wait_required(now, last_ts))
+			now = wait_until(last_ts, cpu);
+		else if (last_ts)
+			now = ktime_get_real();
+
+		if (last_ts)
+			tx_pacing_account(&to->queue[idx], last_ts, now, cpu);
+
+		skb = tx_slot_skb(to, NULL, soft_txq, hdr, 0, dev, hw_queue, local, node);
+		if (unlikely(skb == NULL))
+			break;
+
+		if (rs->opt.flags && rs->loop)
+			tx_replay_rewrite(skb, rs->opt.flags, rs->loop);
+
+		pfq_skbuff_short_batch_push(SKBUFF_BATCH_ADDR(skbs), skb);
+
+		rs->ptr += tx_slot_size(hdr);
+		rs->count++;
+	}
+
+	tot_sent += tx_batch_flush(SKBUFF_BATCH_ADDR(skbs), local, dev, hw_queue, cpu, &disc);
+
+	/* update stats */
+
+	__sparse_add(&to->stats.disc, disc, cpu);
+	__sparse_add(&global_stats.disc, disc, cpu);
+
+	__sparse_add(&to->stats.sent, tot_sent, cpu);
+	__sparse_add(&global_stats.sent, tot_sent, cpu);
+
+	return tot_sent;
+}
+
+
+int
+pfq_tx_replay_start(struct pfq_sock *so, struct pfq_tx_replay const *opt)
+{
+	struct pfq_tx_queue *txq = pfq_get_tx_queue(&so->tx_opt, opt->queue);
+	struct pfq_tx_replay_state *rs;
+
+	if (txq == NULL) {
+		printk(KERN_INFO "[PFQ|%d] Tx[%d] replay: socket not enabled!\n", so->id.value, opt->queue);
+		return -EPERM;
+	}
+
+	rs = kzalloc(sizeof(struct pfq_tx_replay_state), GFP_KERNEL);
+	if (rs == NULL)
+		return -ENOMEM;
+
+	rs->opt = *opt;
+
+	pfq_tx_replay_free(&so->tx_opt.queue[opt->queue]);
+	pfq_tx_template_free(&so->tx_opt.queue[opt->queue]);
+
+	txq->done = 0;
+
+	so->tx_opt.queue[opt->queue].gen_stop = 0;
+	so->tx_opt.queue[opt->queue].replay = rs;
+
+	pr_devel("[PFQ|%d] Tx[%d] replay: loops=%d speed=%u gap=%llu flags=%x\n", so->id.value, opt->queue,
+		 opt->loops, opt->speed, (unsigned long long)opt->gap, opt->flags);
+	return 0;
+}
+
+
+void
+pfq_tx_replay_free(struct pfq_tx_queue_info *info)
+{
+	struct pfq_tx_replay_state *rs = info->replay;
+
+	WRITE_ONCE(info->replay, NULL);
+	kfree(rs);
+}
+
+
+/*
+ * Tx template generator (Q_SO_TX_TEMPLATE): packets are synthesized from the
+ * templates into the skbs of the pool; the rules mutate addresses and ports,
+ * checksums are updated incrementally. done counts the packets generated.
+ */
+
+#define Q_TX_TEMPLATE_CHUNK	256
+
+
+static inline uint32_t
+tx_template_rand(struct pfq_tx_template_state *ts)
+{
+	uint32_t x = ts->seed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	return ts->seed = x;
+}
+
+
+/* uniform in [0, range) */
+
+static inline uint32_t
+tx_template_scale(uint32_t x, uint32_t range)
+{
+	return (uint32_t)(((uint64_t)x * range) >> 32);
+}
+
+
+static uint32_t
+tx_template_value(struct pfq_tx_template_state *ts, int n)
+{
+	struct pfq_tx_template_rule const *r = &ts->rule[n];
+	uint32_t range = r->max - r->min + 1;  /* 0: the whole 32-bit range */
+	uint32_t v;
+
+	if (r->mode == Q_TEMPLATE_MODE_RANDOM)
+		return range ? r->min + tx_template_scale(tx_template_rand(ts), range) : tx_template_rand(ts);
+
+	v = ts->value[n];
+	ts->value[n] = v == r->max ? r->min : v + 1;
+	return v;
+}
+
+
+/* pick a template in proportion to its weight */
+
+static inline struct pfq_pkthdr_tx *
+tx_template_pick(struct pfq_tx_template_state *ts)
+{
+	uint32_t w;
+	int n;
+
+	if (ts->num_pkts == 1)
+		return ts->pkt[0];
+
+	w = tx_template_scale(tx_template_rand(ts), ts->weight[ts->num_pkts-1]);
+
+	for(n = 0; n < ts->num_pkts - 1; n++)
+		if (w < ts->weight[n])
+			break;
+
+	return ts->pkt[n];
+}
+
+
+static void
+tx_template_mutate(struct pfq_tx_template_state *ts, struct sk_buff *skb)
+{
+	struct ethhdr *eth = (struct ethhdr *)skb->data;
+	bool csum = ts->flags & Q_TEMPLATE_CSUM;
+	__sum16 *l4check = NULL;
+	__be16 *ports = NULL;
+	struct iphdr *iph;
+	bool udp = false;
+	size_t l4;
+	int n;
+
+	if (skb_headlen(skb) < ETH_HLEN + sizeof(struct iphdr) || eth->h_proto != htons(ETH_P_IP))
+		return;
+
+	iph = (struct iphdr *)(eth + 1);
+	l4  = ETH_HLEN + iph->ihl * 4;
+
+	if (iph->protocol == IPPROTO_UDP && skb_headlen(skb) >= l4 + sizeof(struct udphdr)) {
+		struct udphdr *uh = (struct udphdr *)(skb->data + l4);
+		ports = &uh->source;
+		if (uh->check)
+			l4check = &uh->check;
+		udp = true;
+	}
+	else if (iph->protocol == IPPROTO_TCP && skb_headlen(skb) >= l4 + sizeof(struct tcphdr)) {
+		struct tcphdr *th = (struct tcphdr *)(skb->data + l4);
+		ports = &th->source;
+		l4check = &th->check;
+	}
+
+	for(n = 0; n < ts->num_rules; n++)
+	{
+		uint32_t v = tx_template_value(ts, n);
+
+		switch(ts->rule[n].field)
+		{
+		case Q_TEMPLATE_FIELD_IP_SRC:
+		case Q_TEMPLATE_FIELD_IP_DST: {
+
+			__be32 *addr = ts->rule[n].field == Q_TEMPLATE_FIELD_IP_SRC ? &iph->saddr : &iph->daddr;
+			__be32 val = htonl(v);
+
+			if (csum) {
+				csum_replace4(&iph->check, *addr, val);
+				if (l4check)
+					csum_replace4(l4check, *addr, val);
+			}
+
+			*addr = val;
+		} break;
+
+		case Q_TEMPLATE_FIELD_PORT_SRC:
+		case Q_TEMPLATE_FIELD_PORT_DST: {
+
+			__be16 *port, val = htons((u16)v);
+
+			if (ports == NULL)
+				break;
+
+			port = ports + (ts->rule[n].field == Q_TEMPLATE_FIELD_PORT_DST);
+
+			if (csum && l4check)
+				csum_replace2(l4check, *port, val);
+
+			*port = val;
+		} break;
+		}
+	}
+
+	/* a zero UDP checksum means no checksum */
+
+	if (udp && l4check && *l4check == 0)
+		*l4check = CSUM_MANGLED_0;
+}
+
+
+/* set the lengths and the checksums of the template (Q_TEMPLATE_CSUM) */
+
+static void
+tx_template_fixup(char *data, size_t len)
+{
+	struct ethhdr *eth = (struct ethhdr *)data;
+	struct iphdr *iph = (struct iphdr *)(eth + 1);
+	size_t l4, l4len;
+
+	if (len < ETH_HLEN + sizeof(struct iphdr) || eth->h_proto != htons(ETH_P_IP) ||
+	    iph->ihl < 5 || len < ETH_HLEN + iph->ihl * 4)
+		return;
+
+	l4    = ETH_HLEN + iph->ihl * 4;
+	l4len = len - l4;
+
+	iph->tot_len = htons(len - ETH_HLEN);
+	iph->check = 0;
+	iph->check = ip_fast_csum((unsigned char *)iph, iph->ihl);
+
+	if (iph->protocol == IPPROTO_UDP && l4len >= sizeof(struct udphdr)) {
+		struct udphdr *uh = (struct udphdr *)(data + l4);
+
+		uh->len = htons(l4len);
+		uh->check = 0;
+		uh->check = csum_tcpudp_magic(iph->saddr, iph->daddr, l4len, IPPROTO_UDP,
+					      csum_partial(uh, l4len, 0));
+		if (uh->check == 0)
+			uh->check = CSUM_MANGLED_0;
+	}
+	else if (iph->protocol == IPPROTO_TCP && l4len >= sizeof(struct tcphdr)) {
+		struct tcphdr *th = (struct tcphdr *)(data + l4);
+
+		th->check = 0;
+		th->check = csum_tcpudp_magic(iph->saddr, iph->daddr, l4len, IPPROTO_TCP,
+					      csum_partial(th, l4len, 0));
+	}
+}
+
+
+static int
+__pfq_template_xmit(size_t idx, struct pfq_tx_opt *to, struct net_device *dev, int cpu, int node)
+{
+	struct pfq_tx_template_state *ts = to->queue[idx].tmpl;
+	struct pfq_skbuff_short_batch skbs;
+	struct pfq_tx_queue *soft_txq;
+	struct local_data *local;
+	size_t disc = 0, tot_sent = 0, n;
+	int hw_queue;
+
+        ktime_t now; uint64_t last_ts;
+
+	if (READ_ONCE(ts->stop) || (ts->count && ts->sent >= ts->count))
+		return 0;
+
+	soft_txq = pfq_get_tx_queue(to, idx);
+	hw_queue = to->queue[idx].hw_queue;
+	local	 = this_cpu_ptr(cpu_data);
+
+	pfq_skbuff_batch_init(SKBUFF_BATCH_ADDR(skbs));
+
+	now = ktime_get_real();
+
+	if (ts->base == 0)
+		ts->base = ktime_to_ns(now);
+
+	for(n = 0; n < Q_TX_TEMPLATE_CHUNK && !(ts->count && ts->sent >= ts->count) &&
+		   !READ_ONCE(to->queue[idx].gen_stop); n++)
+	{
+		struct pfq_pkthdr_tx *hdr = tx_template_pick(ts);
+		struct sk_buff *skb;
+
+		last_ts = ts->gap ? ts->base + ts->sent * ts->gap : 0;
+
+		/* if the batch is full, transmit it (now) */
+	retry:
+		if (tx_batch_required(SKBUFF_BATCH_ADDR(skbs), now, last_ts)) {
+
+			int sent = batch_xmit(SKBUFF_BATCH_ADDR(skbs), local, dev, hw_queue, cpu);
+			tot_sent += sent;
+
+			if (giveup_tx(cpu))
+				break;
+
+			if (sent == 0) {
+				pfq_relax();
+				goto retry;
+			}
+		}
+
+		/* wait until the ts */
+
+		if (tx_wait_required(now, last_ts))
+			now = wait_until(last_ts, cpu);
+		else if (last_ts)
+			now = ktime_get_real();
+
+		if (last_ts)
+			tx_pacing_account(&to->queue[idx], last_ts, now, cpu);
+
+		skb = tx_slot_skb(to, NULL, soft_txq, hdr, 0, dev, hw_queue, local, node);
+		if (unlikely(skb == NULL))
+			break;
+
+		if (ts->num_rules)
+			tx_template_mutate(ts, skb);
+
+		pfq_skbuff_short_batch_push(SKBUFF_BATCH_ADDR(skbs), skb);
+
+		ts->sent++;
+	}
+
+	tot_sent += tx_batch_flush(SKBUFF_BATCH_ADDR(skbs), local, dev, hw_queue, cpu, &disc);
+
+	__atomic_store_n(&soft_txq->done, (unsigned int)ts->sent, __ATOMIC_RELEASE);
+
+	/* update stats */
+
+	__sparse_add(&to->stats.disc, disc, cpu);
+	__sparse_add(&global_stats.disc, disc, cpu);
+
+	__sparse_add(&to->stats.sent, tot_sent, cpu);
+	__sparse_add(&global_stats.sent, tot_sent, cpu);
+
+	return tot_sent;
+}
+
+
+static void
+tx_template_state_free(struct pfq_tx_template_state *ts)
+{
+	int n;
+
+	if (ts == NULL)
+		return;
+
+	for(n = 0; n < Q_TX_TEMPLATE_MAX; n++)
+		kfree(ts->pkt[n]);
+
+	kfree(ts);
+}
+
+
+int
+pfq_tx_template_start(struct pfq_sock *so, struct pfq_tx_template const *opt)
+{
+	struct pfq_tx_queue *txq = pfq_get_tx_queue(&so->tx_opt, opt->queue);
+	struct pfq_tx_template_state *ts;
+	unsigned int weight = 0;
+	int n, err;
+
+	if (txq == NULL) {
+		printk(KERN_INFO "[PFQ|%d] Tx[%d] template: socket not enabled!\n", so->id.value, opt->queue);
+		return -EPERM;
+	}
+
+	ts = kzalloc(sizeof(struct pfq_tx_template_state), GFP_KERNEL);
+	if (ts == NULL)
+		return -ENOMEM;
+
+	/* templates */
+
+	for(n = 0; n < opt->num_pkts; n++)
+	{
+		size_t len = opt->pkt[n].len;
+
+		if (len < ETH_HLEN || len > max_len) {
+			printk(KERN_INFO "[PFQ|%d] Tx template: bad length %zu!\n", so->id.value, len);
+			err = -EINVAL;
+			goto error;
+		}
+
+		ts->pkt[n] = kmalloc(sizeof(struct pfq_pkthdr_tx) + len, GFP_KERNEL);
+		if (ts->pkt[n] == NULL) {
+			err = -ENOMEM;
+			goto error;
+		}
+
+		ts->pkt[n]->len  = len;
+		ts->pkt[n]->nsec = 0;
+
+		if (copy_from_user(ts->pkt[n] + 1, opt->pkt[n].data, len)) {
+			err = -EFAULT;
+			goto error;
+		}
+
+		if (opt->flags & Q_TEMPLATE_CSUM)
+			tx_template_fixup((char *)(ts->pkt[n] + 1), len);
+
+		/* capped, so that the cumulative weight does not overflow */
+
+		weight += clamp_t(unsigned int, opt->pkt[n].weight, 1, Q_TX_TEMPLATE_MAX_WEIGHT);
+		ts->weight[n] = weight;
+	}
+
+	ts->num_pkts = opt->num_pkts;
+
+	/* rules */
+
+	for(n = 0; n < opt->num_rules; n++)
+	{
+		struct pfq_tx_template_rule const *r = &opt->rule[n];
+
+		if (r->field > Q_TEMPLATE_FIELD_PORT_DST || r->mode > Q_TEMPLATE_MODE_RANDOM || r->min > r->max) {
+			printk(KERN_INFO "[PFQ|%d] Tx template: bad rule %d!\n", so->id.value, n);
+			err = -EINVAL;
+			goto error;
+		}
+
+		ts->rule[n]  = *r;
+		ts->value[n] = r->min;
+	}
+
+	ts->num_rules = opt->num_rules;
+	ts->flags = opt->flags;
+	ts->count = opt->count;
+	ts->gap   = opt->gap;
+	ts->seed  = (uint32_t)get_cycles() | 1;
+
+	pfq_tx_replay_free(&so->tx_opt.queue[opt->queue]);
+	pfq_tx_template_free(&so->tx_opt.queue[opt->queue]);
+
+	txq->done = 0;
+
+	so->tx_opt.queue[opt->queue].gen_stop = 0;
+	so->tx_opt.queue[opt->queue].tmpl = ts;
+
+	pr_devel("[PFQ|%d] Tx[%d] template: %d packets, %d rules, count=%llu gap=%llu flags=%x\n", so->id.value,
+		 opt->queue, opt->num_pkts, opt->num_rules, (unsigned long long)opt->count,
+		 (unsigned long long)opt->gap, opt->flags);
+	return 0;
+
+error:
+	tx_template_state_free(ts);
+	return err;
+}
+
+
+void
+pfq_tx_template_free(struct pfq_tx_queue_info *info)
+{
+	struct pfq_tx_template_state *ts = info->tmpl;
+
+	WRITE_ONCE(info->tmpl, NULL);
+	tx_template_state_free(ts);
+}
+
+
+/* the replay/template is stopped (by user-space) or completed */
+
+bool
+pfq_tx_gen_over(struct pfq_tx_queue_info *info)
+{
+	if (READ_ONCE(info->gen_stop))
+		return true;
+
+	if (info->replay)
+		return info->replay->stop ||
+			(info->replay->opt.loops > 0 && info->replay->loop >= info->replay->opt.loops);
+
+	if (info->tmpl)
+		return info->tmpl->stop || (info->tmpl->count && info->tmpl->sent >= info->tmpl->count);
+
+	return false;
+}
+
+
+/* release the replay/template state: the queue is back to the normal Tx */
+
+void
+pfq_tx_gen_release(struct pfq_tx_opt *to, size_t idx)
+{
+	struct pfq_tx_queue *txq = pfq_get_tx_queue(to, idx);
+	int i;
+
+	/* the trace stored in the halves is not to be transmitted */
+
+	if (to->queue[idx].replay && txq && !to->ring) {
+		for(i = 0; i < 2; i++)
+			((struct pfq_pkthdr_tx *)((char *)to->queue[idx].base_addr + i * txq->size))->len = 0;
+	}
+
+	pfq_tx_replay_free(&to->queue[idx]);
+	pfq_tx_template_free(&to->queue[idx]);
+}
+
+
+/* stop the replay/template of the queue: with the kernel thread running, wait
+ * until it has released the state */
+
+int
+pfq_tx_gen_stop(struct pfq_sock *so, int index)
+{
+	struct pfq_tx_queue_info *info = &so->tx_opt.queue[index];
+
+	if (info->replay == NULL && info->tmpl == NULL)
+		return 0;
+
+	WRITE_ONCE(info->gen_stop, 1);
+
+	while (READ_ONCE(info->replay) || READ_ONCE(info->tmpl))
 	{
-		now = ktime_get_real();
-		if (unlikely(giveup_tx(cpu)))
-			return now;
+		if (info->task == NULL) {
+			pfq_tx_gen_release(&so->tx_opt, index);
+			break;
+		}
+
+		pfq_tx_wakeup(so, index);
+
+		if (msleep_interruptible(1))
+			return -EINTR;
 	}
-	while (ktime_to_ns(now) < ts
-	       && (pfq_relax(), true));
 
-	return now;
+	return 0;
 }
 
 
@@ -160,16 +1432,31 @@ int
 __pfq_queue_xmit(size_t idx, struct pfq_tx_opt *to, struct net_device *dev, int cpu, int node)
 {
 	struct pfq_skbuff_short_batch skbs;
+	struct pfq_tx_zerocopy *zc;
 	struct pfq_tx_queue *soft_txq;
 	struct pfq_pkthdr_tx * hdr;
 	struct local_data *local;
-	size_t len, disc = 0, tot_sent = 0;
-	unsigned int index;
+	size_t disc = 0, tot_sent = 0;
+	unsigned int index, done;
 	int hw_queue;
 
 	char *ptr, *begin, *end;
         ktime_t now; uint64_t last_ts;
 
+	/* replay/template: once stopped or completed, the state is released */
+
+	if (to->queue[idx].replay || to->queue[idx].tmpl) {
+
+		if (!pfq_tx_gen_over(&to->queue[idx]))
+			return to->queue[idx].replay ? __pfq_replay_xmit(idx, to, dev, cpu, node)
+						     : __pfq_template_xmit(idx, to, dev, cpu, node);
+
+		pfq_tx_gen_release(to, idx);
+		return 0;
+	}
+
+	if (to->ring)
+		return __pfq_ring_xmit(idx, to, dev, cpu, node);
 
 	/* get the Tx queue */
 
@@ -179,27 +1466,35 @@ __pfq_queue_xmit(size_t idx, struct pfq_tx_opt *to, struct net_device *dev, int
 
 	hw_queue = to->queue[idx].hw_queue;
 
-	/* swap the soft Tx queue */
+	/* get local cpu data */
+
+	local = this_cpu_ptr(cpu_data);
+
+	/* zero-copy: release the skbs completed by the driver */
+
+	zc = to->queue[idx].zc;
+	if (zc)
+		zc_reap(zc, soft_txq, &local->tx_small_pool);
+
+	/* the kernel thread does not wait for user-space to acknowledge the swap
+	 * (the queue is idle meanwhile, see pfq_tx_idle): once acknowledged, the
+	 * half left by user-space is transmitted and the next swap is requested */
 
 	if (cpu != Q_NO_KTHREAD) {
-		index = __atomic_add_fetch(&soft_txq->cons, 1, __ATOMIC_RELAXED);
-		while (index != __atomic_load_n(&soft_txq->prod, __ATOMIC_RELAXED))
-		{
-			pfq_relax();
-			if (unlikely(giveup_tx(cpu)))
-				break;
-		}
+		index = __atomic_load_n(&soft_txq->cons, __ATOMIC_RELAXED);
+		if (index != __atomic_load_n(&soft_txq->prod, __ATOMIC_ACQUIRE))
+			return 0;
 	}
 	else {
 		index = __atomic_add_fetch(&soft_txq->cons, 1, __ATOMIC_RELAXED);
 		__atomic_store_n(&soft_txq->prod, 1, __ATOMIC_RELAXED);
 	}
 
-	index++;
+	/* the half being transmitted (as indexed by user-space) */
 
-	/* get local cpu data */
+	done = index - 1;
 
-	local = this_cpu_ptr(cpu_data);
+	index++;
 
         /* initialize pointer to the current transmit queue */
 
@@ -227,7 +1522,7 @@ __pfq_queue_xmit(size_t idx, struct pfq_tx_opt *to, struct net_device *dev, int
 	retry:
 		if (tx_batch_required(SKBUFF_BATCH_ADDR(skbs), now, last_ts)) {
 
-			int sent = batch_xmit(SKBUFF_BATCH_ADDR(skbs), local, dev, hw_queue);
+			int sent = batch_xmit(SKBUFF_BATCH_ADDR(skbs), local, dev, hw_queue, cpu);
 			tot_sent += sent;
 
 			if (giveup_tx(cpu))
@@ -241,33 +1536,19 @@ __pfq_queue_xmit(size_t idx, struct pfq_tx_opt *to, struct net_device *dev, int
 
 		/* wait until the ts */
 
-		if (last_ts > ktime_to_ns(now))
+		if (tx_wait_required(now, last_ts))
 			now = wait_until(last_ts, cpu);
+		else if (last_ts)
+			now = ktime_get_real();
 
-		/* allocate a packet */
-
-		skb = pfq_tx_alloc_skb(max_len, GFP_KERNEL, node);
-		if (unlikely(skb == NULL)) {
-			printk(KERN_INFO "[PFQ] Tx could not allocate an skb!\n");
-			break;
-		}
-
-		/* fill the skb */
-
-		len = min_t(size_t, hdr->len, max_len);
-
-		skb_reset_tail_pointer(skb);
-		skb->dev = dev;
-		skb->len = 0;
-		__skb_put(skb, len);
-
-		skb_get(skb);
-
-		skb_set_queue_mapping(skb, hw_queue);
+		if (last_ts)
+			tx_pacing_account(&to->queue[idx], last_ts, now, cpu);
 
-		/* copy bytes in the socket buffer */
+		/* allocate and fill the skb */
 
-		skb_copy_to_linear_data(skb, hdr+1, len < 64 ? 64 : len);
+		skb = tx_slot_skb(to, zc, soft_txq, hdr, done, dev, hw_queue, local, node);
+		if (unlikely(skb == NULL))
+			break;
 
 		/* push the packet into the batch */
 
@@ -275,44 +1556,18 @@ __pfq_queue_xmit(size_t idx, struct pfq_tx_opt *to, struct net_device *dev, int
 
 		/* move ptr to the next packet */
 
-		ptr += sizeof(struct pfq_pkthdr_tx) + ALIGN(hdr->len, 8);
+		ptr += tx_slot_size(hdr);
 	}
 
 	/* flush the current batch */
 
-	while (pfq_skbuff_batch_len(SKBUFF_BATCH_ADDR(skbs))) {
-
-		int sent = batch_xmit(SKBUFF_BATCH_ADDR(skbs), local, dev, hw_queue);
-		tot_sent += sent;
-
-		/* break the loop when giveup is needed */
-		if (giveup_tx(cpu))
-			break;
-
-		if (sent == 0)
-			pfq_relax();
-
-	}
-
-	/* packet unsent from the last batch are freed */
-
-	disc = pfq_skbuff_batch_len(SKBUFF_BATCH_ADDR(skbs));
-	if (disc) {
-		struct sk_buff *skb;
-		size_t n;
-		for_each_skbuff(SKBUFF_BATCH_ADDR(skbs), skb, n) {
-
-			kfree_skb(skb); /* decrement use-count to 1 */
-
-			pfq_kfree_skb_pool(skb, &local->tx_pool);
-		}
-	}
+	tot_sent += tx_batch_flush(SKBUFF_BATCH_ADDR(skbs), local, dev, hw_queue, cpu, &disc);
 
 	/* disc takes into account packets possibly left in the shared queue */
 
 	for(; ptr < end && hdr->len != 0; disc++, hdr = (struct pfq_pkthdr_tx *)ptr)
 	{
-		ptr += sizeof(struct pfq_pkthdr_tx) + ALIGN(hdr->len, 8);
+		ptr += tx_slot_size(hdr);
 	}
 
 	/* update stats */
@@ -328,6 +1583,20 @@ __pfq_queue_xmit(size_t idx, struct pfq_tx_opt *to, struct net_device *dev, int
 	hdr = (struct pfq_pkthdr_tx *)begin;
         hdr->len = 0;
 
+	/* publish the completion of this half: with zero-copy, once the driver has released its skbs */
+
+	if (zc) {
+		zc->last = done;
+		zc_reap(zc, soft_txq, &local->tx_small_pool);
+	}
+	else
+		__atomic_store_n(&soft_txq->done, done, __ATOMIC_RELEASE);
+
+	/* request the next swap */
+
+	if (cpu != Q_NO_KTHREAD)
+		__atomic_add_fetch(&soft_txq->cons, 1, __ATOMIC_RELEASE);
+
 	return tot_sent;
 }
 
@@ -336,13 +1605,41 @@ __pfq_queue_xmit(size_t idx, struct pfq_tx_opt *to, struct net_device *dev, int
  * flush the soft queue
  */
 
-int
-pfq_queue_flush(struct pfq_sock *so, int index)
+/* nothing to transmit (or to release) on the Tx queue: its kernel thread can park */
+
+bool
+pfq_tx_idle(struct pfq_tx_opt *to, size_t idx)
+{
+	struct pfq_tx_queue *txq = pfq_get_tx_queue(to, idx);
+	struct pfq_tx_queue_info *info = &to->queue[idx];
+
+	if (txq == NULL)
+		return true;
+
+	/* replay/template: running, or to be released */
+
+	if (info->replay || info->tmpl)
+		return false;
+
+	if (info->zc && info->zc->tail != info->zc->head)
+		return false;
+
+	/* ring: no slot produced; halves: the swap requested is not acknowledged yet */
+
+	return to->ring ? __atomic_load_n(&txq->prod, __ATOMIC_ACQUIRE) == txq->cons
+			: __atomic_load_n(&txq->prod, __ATOMIC_ACQUIRE) != txq->cons;
+}
+
+
+static int
+__pfq_queue_flush(struct pfq_sock *so, int index)
 {
 	struct net_device *dev;
 
+	/* the kernel thread transmits the queue: wake it up, if idle */
+
 	if (so->tx_opt.queue[index].task) {
-		return 0;
+		return pfq_tx_wakeup(so, index);
 	}
 
 	dev = dev_get_by_index(sock_net(&so->sk), so->tx_opt.queue[index].if_index);
@@ -358,6 +1655,36 @@ pfq_queue_flush(struct pfq_sock *so, int index)
 }
 
 
+int
+pfq_queue_flush(struct pfq_sock *so, int index)
+{
+	int ret;
+
+	/* zero-copy is being enabled or disabled */
+
+	if (!pfq_tx_busy_get(&so->tx_opt.queue[index]))
+		return -EBUSY;
+
+	ret = __pfq_queue_flush(so, index);
+
+	pfq_tx_busy_put(&so->tx_opt.queue[index]);
+	return ret;
+}
+
+
+static inline bool
+__pfq_xmit_ready(struct net_device *dev, struct netdev_queue *txq)
+{
+	if (!(dev->flags & IFF_UP))
+		return false;
+#if (LINUX_VERSION_CODE <= KERNEL_VERSION(3,2,0))
+	return !netif_tx_queue_stopped(txq);
+#else
+	return !netif_xmit_stopped(txq);
+#endif
+}
+
+
 static inline int
 __pfq_xmit(struct sk_buff *skb, struct net_device *dev, struct netdev_queue *txq, int xmit_more)
 {
@@ -375,18 +1702,10 @@ __pfq_xmit(struct sk_buff *skb, struct net_device *dev, struct netdev_queue *txq
 
 	skb_reset_mac_header(skb);
 
-	if (dev->flags & IFF_UP) {
-
-#if (LINUX_VERSION_CODE <= KERNEL_VERSION(3,2,0))
-		if (!netif_tx_queue_stopped(txq))
-#else
-		if (!netif_xmit_stopped(txq))
-#endif
-		{
-			rc = dev->netdev_ops->ndo_start_xmit(skb, dev);
-			if (dev_xmit_complete(rc))
-				goto out;
-		}
+	if (__pfq_xmit_ready(dev, txq)) {
+		rc = dev->netdev_ops->ndo_start_xmit(skb, dev);
+		if (dev_xmit_complete(rc))
+			goto out;
 	}
 
 	kfree_skb(skb);
@@ -421,47 +1740,300 @@ pfq_xmit(struct sk_buff *skb, struct net_device *dev, int hw_queue, int more)
 }
 
 
-int
-pfq_batch_xmit(struct pfq_skbuff_batch *skbs, struct net_device *dev, int hw_queue)
+/* transmit a batch, with the txq locked: more is the xmit_more of the last skb.
+ * The skbs following the one that failed are released. */
+
+static int
+__pfq_batch_xmit(struct pfq_skbuff_batch *skbs, struct net_device *dev, struct netdev_queue *txq,
+		 int hw_queue, int more)
 {
-	struct netdev_queue *txq;
 	struct sk_buff *skb;
 	int n, ret = 0;
 	size_t last;
 
-	/* get txq and fix the hw_queue for this batch.
-	 *
-	 * note: in case the hw_queue is set to any-queue (-1), the driver along the first skb
-	 * select the queue */
-
-	txq = pfq_pick_tx(dev, skbs->queue[0], &hw_queue);
-
 	last = pfq_skbuff_batch_len(skbs) - 1;
 
-	__netif_tx_lock_bh(txq);
-
 	for_each_skbuff(skbs, skb, n)
 	{
 		skb_set_queue_mapping(skb, hw_queue);
 
-		if (__pfq_xmit(skb, dev, txq, n != last) == NETDEV_TX_OK)
+		if (__pfq_xmit(skb, dev, txq, n != last || more) == NETDEV_TX_OK)
 			++ret;
 		else
 			goto intr;
 	}
 
-	__netif_tx_unlock_bh(txq);
 	return ret;
 
 intr:
 	for_each_skbuff_from(ret + 1, skbs, skb, n)
 		kfree_skb(skb);
 
+	return ret;
+}
+
+
+int
+pfq_batch_xmit(struct pfq_skbuff_batch *skbs, struct net_device *dev, int hw_queue)
+{
+	struct netdev_queue *txq;
+	int ret;
+
+	/* get txq and fix the hw_queue for this batch.
+	 *
+	 * note: in case the hw_queue is set to any-queue (-1), the driver along the first skb
+	 * select the queue */
+
+	txq = pfq_pick_tx(dev, skbs->queue[0], &hw_queue);
+
+	__netif_tx_lock_bh(txq);
+
+	ret = __pfq_batch_xmit(skbs, dev, txq, hw_queue, 0);
+
 	__netif_tx_unlock_bh(txq);
 	return ret;
 }
 
 
+/*
+ * Tx aggregation (tx_aggr): the sockets transmitting on the same hw queue of a
+ * device do not contend on its lock. The first one takes the ownership of the
+ * queue, the others hand their batches over (up to tx_aggr skbs in flight) and
+ * return. The owner transmits its batch and the ones handed over under a single
+ * lock acquisition, with xmit_more, until the queue is empty.
+ */
+
+#define Q_TX_AGGR_SLOTS		256
+#define Q_TX_AGGR_BUDGET	1024	/* skbs transmitted per lock acquisition */
+
+
+#define Q_TX_AGGR_CLOSING	(-(1 << 30))	/* users: the slot is being released */
+
+
+struct pfq_tx_aggr
+{
+	unsigned long	key;		/* struct netdev_queue * of the hw queue, 0 = free slot */
+	atomic_t	users;		/* senders in tx_aggr_xmit */
+	unsigned long	owner;		/* bit 0: the hw queue is owned */
+	atomic_t	pending;	/* skbs handed over, not transmitted yet */
+	mpsc_queue_t	queue;
+
+} ____cacheline_aligned_in_smp;
+
+
+static struct pfq_tx_aggr tx_aggr_table[Q_TX_AGGR_SLOTS];
+
+
+/* the aggregator of the hw queue (txq), or NULL on collision or while the slot
+ * is being released (the batch is transmitted directly). A slot is bound to a
+ * txq as long as it has users, so that no stale key survives the device. */
+
+static struct pfq_tx_aggr *
+tx_aggr_get(struct netdev_queue *txq)
+{
+	struct pfq_tx_aggr *ag = &tx_aggr_table[hash_ptr(txq, ilog2(Q_TX_AGGR_SLOTS))];
+	unsigned long key = (unsigned long)txq, cur;
+
+	if (unlikely(atomic_inc_return(&ag->users) <= 0))
+		goto out;
+
+	cur = READ_ONCE(ag->key);
+	if (likely(cur == key))
+		return ag;
+
+	if (cur == 0 && cmpxchg(&ag->key, 0UL, key) == 0)
+		return ag;
+out:
+	atomic_dec(&ag->users);
+	return NULL;
+}
+
+
+/* the last user releases the slot, once no skb is left in the aggregator */
+
+static void
+tx_aggr_put(struct pfq_tx_aggr *ag)
+{
+	if (!atomic_dec_and_test(&ag->users))
+		return;
+
+	if (atomic_cmpxchg(&ag->users, 0, Q_TX_AGGR_CLOSING) != 0)
+		return;
+
+	if (!test_bit(0, &ag->owner) && mpsc_queue_empty(&ag->queue) && atomic_read(&ag->pending) == 0)
+		WRITE_ONCE(ag->key, 0UL);
+
+	atomic_sub(Q_TX_AGGR_CLOSING, &ag->users);
+}
+
+
+/* transmit the skbs handed over, with the txq locked. Returns the number of
+ * skbs consumed (sent or discarded); the ones left when the queue is stopped
+ * are kept in *left */
+
+static size_t
+tx_aggr_drain(struct pfq_tx_aggr *ag, struct net_device *dev, struct netdev_queue *txq,
+	      int hw_queue, struct sk_buff **left, bool discard)
+{
+	struct sk_buff *skb = *left ? *left : mpsc_queue_pop_all(&ag->queue);
+	size_t done = 0, disc = 0;
+
+	while (skb)
+	{
+		struct sk_buff *next = skb->next;
+
+		if (!discard && !__pfq_xmit_ready(dev, txq)) {
+			*left = skb;
+			goto out;
+		}
+
+		/* take the next batches before this skb is sent: xmit_more is set
+		 * as long as the owner is going to transmit more */
+
+		if (next == NULL && done < Q_TX_AGGR_BUDGET)
+			next = mpsc_queue_pop_all(&ag->queue);
+
+		skb->next = NULL;
+
+		if (discard) {
+			kfree_skb(skb);
+			disc++;
+		}
+		else {
+			skb_set_queue_mapping(skb, hw_queue);
+			if (__pfq_xmit(skb, dev, txq, next != NULL) != NETDEV_TX_OK)
+				disc++;
+		}
+
+		done++;
+		skb = next;
+	}
+
+	*left = NULL;
+out:
+	if (disc)
+		sparse_add(&global_stats.disc, disc);
+
+	atomic_sub(done, &ag->pending);
+	return done;
+}
+
+
+/* owner of the hw queue: transmit the batch (if any) and the skbs handed over,
+ * until the queue is empty. Returns the number of skbs of the batch sent. */
+
+static int
+tx_aggr_own(struct pfq_tx_aggr *ag, struct pfq_skbuff_batch *skbs, struct net_device *dev,
+	    struct netdev_queue *txq, int hw_queue, int cpu)
+{
+	struct sk_buff *left = NULL;
+	int sent = 0;
+
+	for(;;)
+	{
+		bool discard = giveup_tx(cpu);
+
+		__netif_tx_lock_bh(txq);
+
+		if (skbs) {
+			sent = __pfq_batch_xmit(skbs, dev, txq, hw_queue, !mpsc_queue_empty(&ag->queue));
+			if (sent == pfq_skbuff_batch_len(skbs))
+				tx_aggr_drain(ag, dev, txq, hw_queue, &left, discard);
+			skbs = NULL;
+		}
+		else
+			tx_aggr_drain(ag, dev, txq, hw_queue, &left, discard);
+
+		__netif_tx_unlock_bh(txq);
+
+		if (left == NULL && mpsc_queue_empty(&ag->queue)) {
+
+			/* release the queue, and take it back if some skbs were
+			 * handed over in the meanwhile */
+
+			clear_bit_unlock(0, &ag->owner);
+			smp_mb();
+
+			if (mpsc_queue_empty(&ag->queue) || test_and_set_bit_lock(0, &ag->owner))
+				return sent;
+		}
+		else if (left)
+			pfq_relax();
+	}
+}
+
+
+static int
+tx_aggr_xmit(struct pfq_skbuff_batch *skbs, struct net_device *dev, int hw_queue, int cpu)
+{
+	struct netdev_queue *txq;
+	struct pfq_tx_aggr *ag;
+	struct sk_buff *skb;
+	size_t len = pfq_skbuff_batch_len(skbs);
+	int room, n, i;
+
+	txq = pfq_pick_tx(dev, skbs->queue[0], &hw_queue);
+
+	ag = tx_aggr_get(txq);
+	if (unlikely(ag == NULL)) {
+		__netif_tx_lock_bh(txq);
+		n = __pfq_batch_xmit(skbs, dev, txq, hw_queue, 0);
+		__netif_tx_unlock_bh(txq);
+		return n;
+	}
+
+	/* the hw queue is free: transmit the batch */
+
+	if (!test_and_set_bit_lock(0, &ag->owner)) {
+		n = tx_aggr_own(ag, skbs, dev, txq, hw_queue, cpu);
+		tx_aggr_put(ag);
+		return n;
+	}
+
+	/* hand over the batch to the owner (up to tx_aggr skbs in flight)... */
+
+	room = tx_aggr - atomic_read(&ag->pending);
+	n = room > 0 ? min_t(int, len, room) : 0;
+	if (n) {
+		atomic_add(n, &ag->pending);
+		mpsc_queue_push_batch(&ag->queue, skbs->queue, n);
+		sparse_add(&pacing_stats.aggr, n);
+
+		/* ...which may have released the queue in the meanwhile */
+
+		if (!test_and_set_bit_lock(0, &ag->owner))
+			tx_aggr_own(ag, NULL, dev, txq, hw_queue, cpu);
+	}
+
+	/* as in pfq_batch_xmit, the skbs not sent are released */
+
+	for_each_skbuff_from(n, skbs, skb, i)
+		kfree_skb(skb);
+
+	tx_aggr_put(ag);
+	return n;
+}
+
+
+/* free the skbs left in the aggregators (module unload) */
+
+size_t
+pfq_tx_aggr_free(void)
+{
+	size_t n, total = 0;
+
+	for(n = 0; n < Q_TX_AGGR_SLOTS; n++)
+	{
+		total += mpsc_queue_dtor(&tx_aggr_table[n].queue);
+		atomic_set(&tx_aggr_table[n].pending, 0);
+		atomic_set(&tx_aggr_table[n].users, 0);
+		tx_aggr_table[n].key = 0;
+	}
+
+	return total;
+}
+
+
 int
 pfq_batch_xmit_by_mask(struct pfq_skbuff_batch *skbs, unsigned long long mask, struct net_device *dev, int hw_queue)
 {
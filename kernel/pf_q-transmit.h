@@ -37,6 +37,12 @@
 #include <pf_q-GC.h>
 
 
+/* zero-copy Tx: packets shorter than the copybreak are copied, the header is always copied */
+
+#define Q_TX_ZEROCOPY_COPYBREAK		256
+#define Q_TX_ZEROCOPY_HDR		64
+
+
 struct lazy_fwd_targets
 {
 	struct net_device * dev[Q_GC_LOG_QUEUE_LEN];
@@ -56,6 +62,22 @@ pfq_queue_xmit(size_t index, struct pfq_tx_opt *to, struct net_device *dev)
 
 
 extern int pfq_queue_flush(struct pfq_sock *so, int index);
+extern bool pfq_tx_idle(struct pfq_tx_opt *to, size_t index);
+
+extern int  pfq_tx_zerocopy_alloc(struct pfq_sock *so, int index);
+extern void pfq_tx_zerocopy_free(struct pfq_tx_queue_info *info);
+
+extern void pfq_tx_pacing_init(void);
+
+extern int  pfq_tx_replay_start(struct pfq_sock *so, struct pfq_tx_replay const *opt);
+extern void pfq_tx_replay_free(struct pfq_tx_queue_info *info);
+
+extern int  pfq_tx_template_start(struct pfq_sock *so, struct pfq_tx_template const *opt);
+extern void pfq_tx_template_free(struct pfq_tx_queue_info *info);
+
+extern bool pfq_tx_gen_over(struct pfq_tx_queue_info *info);
+extern void pfq_tx_gen_release(struct pfq_tx_opt *to, size_t index);
+extern int  pfq_tx_gen_stop(struct pfq_sock *so, int index);
 
 
 extern int pfq_batch_xmit(struct pfq_skbuff_batch *skbs, struct net_device *dev, int queue_index);
@@ -70,5 +92,7 @@ extern int pfq_batch_lazy_xmit_by_mask(struct gc_queue_buff *queue, unsigned lon
 
 extern size_t pfq_lazy_xmit_exec(struct gc_data *gc, struct lazy_fwd_targets const *t);
 
+extern size_t pfq_tx_aggr_free(void);
+
 
 #endif /* PF_Q_TRANSMIT_H */
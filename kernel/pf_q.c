@@ -48,6 +48,7 @@
 #endif
 
 #include <linux/pf_q.h>
+#include <linux/pf_q-hash.h>
 
 #include <pf_q-shmem.h>
 #include <pf_q-proc.h>
@@ -71,6 +72,7 @@
 #include <pf_q-transmit.h>
 #include <pf_q-percpu.h>
 #include <pf_q-GC.h>
+#include <pf_q-elephant.h>
 
 static struct net_proto_family  pfq_family_ops;
 static struct packet_type       pfq_prot_hook;
@@ -78,6 +80,32 @@ static struct proto             pfq_proto;
 static struct proto_ops         pfq_ops;
 
 
+static int
+steer_hash_set(const char *val, const struct kernel_param *kp)
+{
+	int n, err;
+
+	err = kstrtoint(val, 0, &n);
+	if (err)
+		return err;
+
+	if (n < Q_HASH_XOR || n > Q_HASH_SKB) {
+		printk(KERN_INFO "[PFQ] steer_hash=%d not allowed: valid range [%d,%d]!\n",
+		       n, Q_HASH_XOR, Q_HASH_SKB);
+		return -EINVAL;
+	}
+
+	*(int *)kp->arg = n;
+	return 0;
+}
+
+static const struct kernel_param_ops steer_hash_ops =
+{
+	.set = steer_hash_set,
+	.get = param_get_int,
+};
+
+
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Nicola Bonelli <nicola@pfq.io>");
 
@@ -98,6 +126,19 @@ module_param(batch_len,       int, 0644);
 module_param(skb_pool_size,   int, 0644);
 module_param(vl_untag,        int, 0644);
 
+module_param_cb(steer_hash, &steer_hash_ops, &steer_hash, 0644);
+module_param(lang_profile,    int, 0644);
+module_param(lang_stats,      int, 0644);
+
+module_param(tx_pacing_window, int, 0644);
+module_param(tx_pacing_sleep,  int, 0644);
+
+module_param(tx_idle_spin,     int, 0644);
+module_param(tx_idle_sleep,    int, 0644);
+module_param(tx_park_timeout,  int, 0644);
+
+module_param(tx_aggr,          int, 0644);
+
 MODULE_PARM_DESC(direct_capture," Direct capture packets: (0 default)");
 
 MODULE_PARM_DESC(capture_incoming," Capture incoming packets: (1 default)");
@@ -113,6 +154,19 @@ MODULE_PARM_DESC(tx_max_retry,  " Transmission max retry (default=1024)");
 
 MODULE_PARM_DESC(vl_untag, " Enable vlan untagging (default=0)");
 
+MODULE_PARM_DESC(steer_hash, " Steering hash: 0=xor, 1=symmetric Toeplitz, 2=crc32c (default), 3=NIC rx hash");
+MODULE_PARM_DESC(lang_profile, " Profile and reorder and/or predicates every N evaluations (default=0, disabled)");
+MODULE_PARM_DESC(lang_stats, " Per-node counters of computations: calls, pass, drop and cycles (default=0)");
+
+MODULE_PARM_DESC(tx_pacing_window, " Timed Tx: launch packets up to N nsec ahead, batched (default=0)");
+MODULE_PARM_DESC(tx_pacing_sleep, " Timed Tx: kernel threads sleep for gaps longer than N usec, 0 = spin (default=100)");
+
+MODULE_PARM_DESC(tx_idle_spin, " Tx kernel threads poll an idle queue for N usec before parking (default=1000)");
+MODULE_PARM_DESC(tx_idle_sleep, " Tx kernel threads sleep for N usec when idle (not parked), 0 = always spin (default=200)");
+MODULE_PARM_DESC(tx_park_timeout, " Parked Tx kernel threads wake up at the doorbell or after N usec, 0 = no parking (default=10000)");
+
+MODULE_PARM_DESC(tx_aggr, " Tx aggregation: sockets sharing a hw queue hand up to N skbs over to its owner, 0 = disabled (default=1024)");
+
 #ifdef PFQ_USE_SKB_POOL
 MODULE_PARM_DESC(skb_pool_size, " Socket buffer pool size (default=1024)");
 #endif
@@ -400,6 +454,7 @@ pfq_receive(struct napi_struct *napi, struct sk_buff * skb, int direct)
 				monad.fanout.type       = fanout_copy;
 				monad.state		= 0;
 				monad.group		= this_group;
+				monad.tunnel.parsed	= 0;
 
 				/* run the functional program */
 
@@ -453,9 +508,35 @@ pfq_receive(struct napi_struct *napi, struct sk_buff * skb, int direct)
 					}
 
 					if (likely(local->sock_cnt)) {
-						unsigned int h = monad.fanout.hash ^ (monad.fanout.hash >> 8) ^
-							(monad.fanout.hash >> 16);
-						sock_mask |= local->sock_mask[pfq_fold(h, local->sock_cnt)];
+
+						int idx = -1;
+
+						/* adaptive steering: elephant flows are spread across the sockets */
+
+						if (this_group->steer_mode != Q_STEER_FLOW && local->sock_cnt > 1) {
+
+							struct pfq_elephant_cpu __percpu *el =
+								(struct pfq_elephant_cpu __percpu *)atomic_long_read(&this_group->elephant);
+							bool promoted;
+
+							if (el) {
+								idx = pfq_elephant_steer(per_cpu_ptr(el, cpu), this_group->steer_mode,
+											 this_group->elephant_bytes, this_group->flowlet_gap,
+											 monad.fanout.hash, buff.skb->len, local->sock_cnt, &promoted);
+								if (promoted)
+									__sparse_inc(&this_group->stats.elph, cpu);
+								if (idx >= 0)
+									__sparse_inc(&this_group->stats.sprd, cpu);
+							}
+						}
+
+						if (idx < 0) {
+							unsigned int h = monad.fanout.hash ^ (monad.fanout.hash >> 8) ^
+								(monad.fanout.hash >> 16);
+							idx = pfq_fold(h, local->sock_cnt);
+						}
+
+						sock_mask |= local->sock_mask[idx];
 					}
 				}
 				else {  /* clone or continue ... */
@@ -933,6 +1014,9 @@ static int __init pfq_init_module(void)
 	/* register pfq-lang default functions */
 	pfq_symtable_init();
 
+	/* calibrate the Tx pacing clock */
+	pfq_tx_pacing_init();
+
         /* finally register the basic device handler */
         register_device_handler();
 
@@ -981,6 +1065,9 @@ static void __exit pfq_exit_module(void)
         /* purge both GC and recycles queues */
         total += pfq_percpu_flush();
 
+        /* purge the Tx aggregators */
+        total += pfq_tx_aggr_free();
+
 #ifdef PFQ_USE_SKB_POOL
         total += pfq_skb_pool_purge();
 #endif
@@ -273,6 +273,20 @@ int main()
 	assert( pfq_signature_check(make_string_view("Action [a]")) );
 	assert( pfq_signature_check(make_string_view("Action SkBuff")) );
 
+	/* list of functions */
+
+	string_view_t sw = make_string_view("(SkBuff -> Word64) -> [Word64] -> [SkBuff -> Action SkBuff] -> (SkBuff -> Action SkBuff) -> SkBuff -> Action SkBuff");
+
+	assert( pfq_signature_arity(sw) == 5 );
+	assert( pfq_signature_check(sw) );
+	assert( count_outmost_brackets(make_string_view(" [SkBuff -> Action SkBuff]")) == 0 );
+	assert( pfq_signature_arity(make_string_view("[SkBuff -> Action SkBuff]")) == 0 );
+	assert( pfq_signature_equal(pfq_signature_arg(sw, 1), make_string_view("[Word64]")) );
+	assert( pfq_signature_equal(pfq_signature_arg(sw, 2), make_string_view("[SkBuff -> Action SkBuff]")) );
+	assert( pfq_signature_equal(pfq_signature_arg(sw, 3), make_string_view("SkBuff -> Action SkBuff")) );
+	assert( pfq_signature_equal(pfq_signature_bind(sw, 4), make_string_view("SkBuff -> Action SkBuff")) );
+	assert( pfq_signature_equal(pfq_signature_remove_extent(pfq_signature_arg(sw, 2)), make_string_view("SkBuff -> Action SkBuff")) );
+
 	printf("All test passed.\n");
 	return 0;
 }
@@ -0,0 +1,196 @@
+/***************************************************************
+ *
+ * (C) 2011-14 Nicola Bonelli <nicola@pfq.io>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * The full GNU General Public License is included in this distribution in
+ * the file called "COPYING".
+ *
+ ****************************************************************/
+
+#pragma once
+
+#include <linux/pf_q.h>
+#include <linux/pf_q-bloom.h>
+
+#include <arpa/inet.h>
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+namespace pfq {
+
+    //! Cache-line blocked bloom filter.
+    /*!
+     * User-space counterpart of the filters used by the bloom functions. It is
+     * built here and loaded into a group with socket::group_bloom_load; the
+     * kernel swaps it atomically with the running one.
+     */
+
+    class bloom_filter
+    {
+    public:
+
+        //! Constructor: m is the number of bits (rounded up to 512-bit blocks).
+
+        bloom_filter(int ipv, int prefix, size_t m)
+        : ipv_(ipv)
+        , prefix_(prefix)
+        , nblocks_(std::max<size_t>((m + Q_BLOOM_BLOCK_BITS - 1) / Q_BLOOM_BLOCK_BITS, 1))
+        , bits_(nblocks_ * Q_BLOOM_BLOCK_WORDS, 0)
+        {
+            if (ipv != 4 && ipv != 6)
+                throw std::runtime_error("pfq::bloom_filter: IPv4 or IPv6 only");
+
+            if (prefix < 0 || prefix > (ipv == 4 ? 32 : 128))
+                throw std::runtime_error("pfq::bloom_filter: bad prefix");
+
+            if (nblocks_ > Q_BLOOM_MAX_BLOCKS)
+                throw std::runtime_error("pfq::bloom_filter: too many bins");
+
+            for(int i = 0, p = prefix; i < 4; i++, p -= 32)
+            {
+                mask_[i] = p >= 32 ? 0xffffffff :
+                           p <=  0 ? 0 : htonl(~((1U << (32 - p)) - 1));
+            }
+        }
+
+        //! Insert an IPv4/IPv6 address (numeric form).
+
+        void
+        insert(const char *addr)
+        {
+            pfq_bloom_set(bits_.data(), nblocks_, hash(addr));
+        }
+
+        void
+        insert(std::string const &addr)
+        {
+            insert(addr.c_str());
+        }
+
+        //! Test an address (user-space lookup, useful to estimate false positives).
+
+        bool
+        contains(const char *addr) const
+        {
+            return pfq_bloom_test(const_cast<uint64_t *>(bits_.data()), nblocks_, hash(addr));
+        }
+
+        bool
+        contains(std::string const &addr) const
+        {
+            return contains(addr.c_str());
+        }
+
+        //! Insert/test an IPv4 address in network byte order.
+
+        void
+        insert(uint32_t addr)
+        {
+            pfq_bloom_set(bits_.data(), nblocks_, hash4(addr));
+        }
+
+        bool
+        contains(uint32_t addr) const
+        {
+            return pfq_bloom_test(const_cast<uint64_t *>(bits_.data()), nblocks_, hash4(addr));
+        }
+
+        //! Insert/test an IPv6 address (4 words in network byte order).
+
+        void
+        insert6(const uint32_t *addr)
+        {
+            pfq_bloom_set(bits_.data(), nblocks_, hash6(addr));
+        }
+
+        bool
+        contains6(const uint32_t *addr) const
+        {
+            return pfq_bloom_test(const_cast<uint64_t *>(bits_.data()), nblocks_, hash6(addr));
+        }
+
+        //! Reset the filter.
+
+        void
+        clear()
+        {
+            std::fill(bits_.begin(), bits_.end(), 0);
+        }
+
+        int
+        ipv() const
+        {
+            return ipv_;
+        }
+
+        int
+        prefix() const
+        {
+            return prefix_;
+        }
+
+        //! The bit array and its size in bytes.
+
+        const void *
+        data() const
+        {
+            return bits_.data();
+        }
+
+        size_t
+        size() const
+        {
+            return bits_.size() * sizeof(uint64_t);
+        }
+
+    private:
+
+        uint64_t
+        hash4(uint32_t addr) const
+        {
+            return pfq_bloom_hash4(addr & mask_[0]);
+        }
+
+        uint64_t
+        hash6(const uint32_t *addr) const
+        {
+            uint32_t a[4] = { addr[0] & mask_[0], addr[1] & mask_[1],
+                              addr[2] & mask_[2], addr[3] & mask_[3] };
+            return pfq_bloom_hash6(a);
+        }
+
+        uint64_t
+        hash(const char *addr) const
+        {
+            uint32_t a[4];
+            if (inet_pton(ipv_ == 4 ? AF_INET : AF_INET6, addr, a) <= 0)
+                throw std::runtime_error("pfq::bloom_filter: inet_pton");
+            return ipv_ == 4 ? hash4(a[0]) : hash6(a);
+        }
+
+        int ipv_;
+        int prefix_;
+        size_t nblocks_;
+        uint32_t mask_[4];
+        std::vector<uint64_t> bits_;
+    };
+
+} // namespace pfq
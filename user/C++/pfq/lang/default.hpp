@@ -31,6 +31,7 @@
 #include <type_traits>
 #include <vector>
 #include <string>
+#include <stdexcept>
 #include <cmath>
 
 #include <arpa/inet.h>
@@ -249,6 +250,33 @@ namespace lang
 
         auto has_dst_port   = [] (uint16_t port) { return predicate ("is_dst_port", port); };
 
+        //! Evaluate to \c true if the SkBuff has the source or destination port in the given set.
+        /*!
+         * The set is stored as a bitmap, the cost of the test does not depend on the number of ports.
+         * Non-first fragments have no port and evaluate to False. Example:
+         *
+         * has_port_in ({22, 53, 80, 443, 8080})
+         */
+
+        auto has_port_in     = [] (std::vector<uint16_t> const &ps) { return predicate ("has_port_in", ps); };
+
+        //! Evaluate to \c true if the SkBuff has the source port in the given set. \see has_port_in
+
+        auto has_src_port_in = [] (std::vector<uint16_t> const &ps) { return predicate ("has_src_port_in", ps); };
+
+        //! Evaluate to \c true if the SkBuff has the destination port in the given set. \see has_port_in
+
+        auto has_dst_port_in = [] (std::vector<uint16_t> const &ps) { return predicate ("has_dst_port_in", ps); };
+
+        //! Evaluate to \c true if the Layer4 protocol of the SkBuff (IPv4 or IPv6) is in the given set.
+        /*!
+         * Example:
+         *
+         * l4_proto_in ({IPPROTO_TCP, IPPROTO_UDP, IPPROTO_SCTP})
+         */
+
+        auto l4_proto_in     = [] (std::vector<uint8_t> const &ps) { return predicate ("l4_proto_in", ps); };
+
         //! Evaluate to \c true if the source or destination IP address matches the given network address. I.e.,
         /*!
          * Example:
@@ -299,6 +327,17 @@ namespace lang
 
         auto has_vid        = [] (int value) { return predicate ("has_vid", value); };
 
+        //! Evaluate to \c true if the packet matches an entry of the n-th exact-match table of the group.
+        /*!
+         * Tables are created and updated at run-time with socket::group_table_create/insert/remove.
+         * Address tables match either the source or the destination IP address, flow tables
+         * match the 5-tuple in both directions. Example:
+         *
+         * when (in_table(0)) (kernel)
+         */
+
+        auto in_table       = [] (int n) { return predicate ("in_table", n); };
+
         //! Predicate which evaluates to \c true when the packet has one of the
         /*!
          * vlan id specified by the list. Example:
@@ -315,6 +354,12 @@ namespace lang
         auto vlan_id_filter = [] (std::vector<int> const &vs) {
                                     return mfunction("vlan_id_filter", vs);
                               };
+
+        //! Evaluate to \c true if the vlan id of the SkBuff is in the given set (-1 means any vlan). \see vlan_id
+
+        auto vlan_in        = [] (std::vector<int> const &vs) {
+                                    return predicate("vlan_in", vs);
+                              };
         //
         // default properties:
         //
@@ -433,6 +478,18 @@ namespace lang
 
         auto steer_flow = mfunction("steer_flow");
 
+        //! Dispatch the packet across the sockets
+        /*!
+         * Like \c steer_flow, but the fragments of an IPv4 datagram are kept
+         * on the socket of the first fragment (per-cpu table), so that they can be
+         * reassembled locally. Fragments whose first one was not seen are steered
+         * on the addresses. Example:
+         *
+         * steer_flow_frag
+         */
+
+        auto steer_flow_frag = mfunction("steer_flow_frag");
+
         //! Dispatch the packet across the sockets
         /*!
          * Dispatch with a randomized algorithm that maintains the integrity
@@ -443,6 +500,16 @@ namespace lang
 
         auto steer_rtp  = mfunction("steer_rtp");
 
+        //! Dispatch the packet across the sockets
+        /*!
+         * Dispatch with the value of the matching entry of the n-th exact-match table
+         * of the group. Packets not in the table are dropped. Example:
+         *
+         * steer_table(0)
+         */
+
+        auto steer_table = [] (int n) { return mfunction("steer_table", n); };
+
         //! Dispatch the packet across the sockets
         /*!
          * Dispatch with a randomized algorithm that maintains the integrity
@@ -475,6 +542,40 @@ namespace lang
         auto steer_field = [] (int off_bytes, int size_bits) {
                                 return mfunction("steer_field", off_bytes, size_bits);
                            };
+
+        //
+        // sampling functions:
+        //
+
+        //! Evaluate to \c Pass SkBuff one packet every \c n (per CPU), \c Drop it otherwise.
+        /*!
+         * Deterministic sampling. Example:
+         *
+         * sample (100) >> steer_flow
+         */
+
+        auto sample      = [] (int n) { return mfunction("sample", n); };
+
+        //! Evaluate to \c Pass SkBuff for 1 flow every \c n, \c Drop it otherwise.
+        /*!
+         * Hash-based sampling: TCP/UDP flows are either entirely kept or dropped.
+         * Non TCP/UDP packets are dropped. Example:
+         *
+         * sample_flow (8) >> steer_flow
+         */
+
+        auto sample_flow = [] (int n) { return mfunction("sample_flow", n); };
+
+        //! Evaluate to \c Pass SkBuff until the flow has carried \c n bytes, \c Drop it afterwards.
+        /*!
+         * TCP/UDP flows (both directions) are tracked in a per-CPU table of bounded size,
+         * with idle entries recycled after 30 seconds. Other packets are passed.
+         * Table pressure is reported in /proc/net/pfq/memory. Example:
+         *
+         * cutoff (4096) >> steer_flow
+         */
+
+        auto cutoff      = [] (int n) { return mfunction("cutoff", n); };
         //
         // default filters:
         //
@@ -693,6 +794,31 @@ namespace lang
 
         auto dec            = [] (int value) { return mfunction("dec", value); };
 
+        //! Account the packet in the heavy-hitter sketch of the current group.
+        /*!
+         * The key is one of Q_HH_KEY_SRC, Q_HH_KEY_DST (IPv4 addresses) or Q_HH_KEY_FLOW (IPv4 5-tuple).
+         * The top-K keys are read with socket::group_heavy_hitters. Example:
+         *
+         * ip >> heavy_hitter (Q_HH_KEY_SRC)
+         */
+
+        auto heavy_hitter   = [] (int key) { return mfunction("heavy_hitter", key); };
+
+        //! Account the packet in the heavy-hitter sketch of the current group, using the given property as key.
+        /*!
+         * Example:
+         *
+         * heavy_hitter_by (tcp_dest)
+         */
+
+        template <typename Property>
+        auto heavy_hitter_by(Property p)
+            -> decltype(mfunction(nullptr, p))
+        {
+            static_assert(is_property<Property>::value, "heavy_hitter_by: argument 0: property expected");
+            return mfunction("heavy_hitter_by", p);
+        }
+
         //! Monadic version of \c is_l3_proto predicate.
         /*!
          * Predicates are used in conditional expressions, while monadic functions
@@ -737,6 +863,25 @@ namespace lang
 
         auto dst_port       = [] (uint16_t p) { return mfunction ("dst_port", p); };
 
+        //! Monadic version of \c has_port_in predicate.
+        /*!
+         * Example:
+         *
+         * port_in ({80, 443, 8080}) >> steer_flow
+         *
+         * \see has_port_in
+         */
+
+        auto port_in        = [] (std::vector<uint16_t> const &ps) { return mfunction ("port_in", ps); };
+
+        //! Monadic version of \c has_src_port_in predicate.  \see has_src_port_in
+
+        auto src_port_in    = [] (std::vector<uint16_t> const &ps) { return mfunction ("src_port_in", ps); };
+
+        //! Monadic version of \c has_dst_port_in predicate.  \see has_dst_port_in
+
+        auto dst_port_in    = [] (std::vector<uint16_t> const &ps) { return mfunction ("dst_port_in", ps); };
+
         //! Monadic version of \c has_addr predicate.
         /*!
          * Predicates are used in conditional expressions, while monadic functions
@@ -818,6 +963,30 @@ namespace lang
             return mfunction("conditional", p, f1, f2);
         }
 
+        //! Multi-way conditional execution of monadic NetFunctions.
+        /*!
+         * The function evaluates the property once, and jumps to the NetFunction associated
+         * with the resulting value; the last argument is evaluated when no key matches
+         * (or the property is not defined for the packet).
+         * The cost of the selection does not depend on the number of cases. Example:
+         *
+         * switch_ (tcp_dest, {22, 80, 443}, functions (kernel, steer_flow, forward ("eth1")), drop)
+         *
+         */
+
+        template <typename Property, typename ...Fs, typename Fun>
+        auto switch_(Property p, std::vector<uint64_t> keys, FunctionList<Fs...> cases, Fun f)
+            -> decltype(mfunction(nullptr, p, keys, cases, f))
+        {
+            static_assert(is_property<Property>::value,    "switch: argument 0: property expected");
+            static_assert(is_monadic_function<Fun>::value, "switch: argument 3: monadic function expected");
+
+            if (keys.size() != sizeof...(Fs))
+                throw std::logic_error("switch: the number of keys and functions differ");
+
+            return mfunction("switch", p, std::move(keys), std::move(cases), f);
+        }
+
         //! Function that inverts a monadic NetFunction.
         /*!
          * Useful to invert filters:
@@ -910,6 +1079,183 @@ namespace lang
                                     auto addrs = fmap(details::inet_addr, ips);
                                     return mfunction("bloom_dst_filter", m, std::move(addrs), prefix);
                                 };
+
+        //! IPv6 counterpart of \c bloom function. \see bloom
+        /*!
+         * Example:
+         *
+         * when (bloom6 (1024, {"2001:db8::1", "fe80::1"}, 128), log_packet ) >> kernel
+         */
+
+        auto bloom6     = [] (int m, std::vector<std::string> const &ips, int prefix) {
+                                return predicate("bloom6", m, details::inet6_words(ips), prefix);
+                          };
+
+        //! IPv6 counterpart of \c bloom_src function. \see bloom_src
+
+        auto bloom6_src = [] (int m, std::vector<std::string> const &ips, int prefix) {
+                                return predicate("bloom6_src", m, details::inet6_words(ips), prefix);
+                          };
+
+        //! IPv6 counterpart of \c bloom_dst function. \see bloom_dst
+
+        auto bloom6_dst = [] (int m, std::vector<std::string> const &ips, int prefix) {
+                                return predicate("bloom6_dst", m, details::inet6_words(ips), prefix);
+                          };
+
+        //! IPv6 counterpart of \c bloom_filter function. \see bloom_filter
+
+        auto bloom6_filter = [] (int m, std::vector<std::string> const &ips, int prefix) {
+                                return mfunction("bloom6_filter", m, details::inet6_words(ips), prefix);
+                          };
+
+        //! IPv6 counterpart of \c bloom_src_filter function. \see bloom_src_filter
+
+        auto bloom6_src_filter = [] (int m, std::vector<std::string> const &ips, int prefix) {
+                                return mfunction("bloom6_src_filter", m, details::inet6_words(ips), prefix);
+                          };
+
+        //! IPv6 counterpart of \c bloom_dst_filter function. \see bloom_dst_filter
+
+        auto bloom6_dst_filter = [] (int m, std::vector<std::string> const &ips, int prefix) {
+                                return mfunction("bloom6_dst_filter", m, details::inet6_words(ips), prefix);
+                          };
+
+        //! Predicate that evaluates to \c true when the source or the destination address
+        // of the packet matches the n-th bloom filter of the group.
+        /*!
+         * The filter is built in user-space (\see pfq::bloom_filter) and loaded
+         * with socket::group_bloom_load; it can be replaced while the computation is running.
+         * Example:
+         *
+         * when (in_bloom (0), kernel)
+         */
+
+        auto in_bloom     = [] (int n) { return predicate("in_bloom", n); };
+
+        //! Similarly to \c in_bloom, evaluates to \c true when the source address matches. \see in_bloom
+
+        auto in_bloom_src = [] (int n) { return predicate("in_bloom_src", n); };
+
+        //! Similarly to \c in_bloom, evaluates to \c true when the destination address matches. \see in_bloom
+
+        auto in_bloom_dst = [] (int n) { return predicate("in_bloom_dst", n); };
+
+        //
+        // longest-prefix match:
+        //
+
+        //! Predicate that evaluates to \c true when the source or the destination address
+        // of the packet belongs to one of the given networks.
+        /*!
+         * Networks are matched with a multibit trie built when the computation is loaded,
+         * the cost of a lookup does not depend on the number of prefixes. Example:
+         *
+         * when (in_prefixes ({"10.0.0.0/8", "192.168.1.0/24"}), kernel)
+         */
+
+        auto in_prefixes = [] (std::vector<std::string> const &nets) {
+                                    auto p = details::inet_prefixes(AF_INET, nets);
+                                    return predicate("in_prefixes", std::move(p.first), std::move(p.second));
+                                };
+
+        //! Similarly to \c in_prefixes, evaluates to \c true when the source address belongs to the networks. \see in_prefixes
+
+        auto in_src_prefixes = [] (std::vector<std::string> const &nets) {
+                                    auto p = details::inet_prefixes(AF_INET, nets);
+                                    return predicate("in_src_prefixes", std::move(p.first), std::move(p.second));
+                                };
+
+        //! Similarly to \c in_prefixes, evaluates to \c true when the destination address belongs to the networks. \see in_prefixes
+
+        auto in_dst_prefixes = [] (std::vector<std::string> const &nets) {
+                                    auto p = details::inet_prefixes(AF_INET, nets);
+                                    return predicate("in_dst_prefixes", std::move(p.first), std::move(p.second));
+                                };
+
+        //! Dispatch the packet across the sockets
+        /*!
+         * Dispatch by the longest matching prefix (of either address) among the given networks,
+         * so that all the packets of a network reach the same socket. Packets that do not match
+         * are dropped. Example:
+         *
+         * steer_prefixes ({"10.0.0.0/8", "10.1.0.0/16", "172.16.0.0/12"})
+         */
+
+        auto steer_prefixes = [] (std::vector<std::string> const &nets) {
+                                    auto p = details::inet_prefixes(AF_INET, nets);
+                                    return mfunction("steer_prefixes", std::move(p.first), std::move(p.second));
+                                };
+
+        //! IPv6 counterpart of \c in_prefixes (e.g. "2001:db8::/32"). \see in_prefixes
+
+        auto in_prefixes6 = [] (std::vector<std::string> const &nets) {
+                                    auto p = details::inet_prefixes(AF_INET6, nets);
+                                    return predicate("in_prefixes6", std::move(p.first), std::move(p.second));
+                                };
+
+        //! IPv6 counterpart of \c in_src_prefixes. \see in_src_prefixes
+
+        auto in_src_prefixes6 = [] (std::vector<std::string> const &nets) {
+                                    auto p = details::inet_prefixes(AF_INET6, nets);
+                                    return predicate("in_src_prefixes6", std::move(p.first), std::move(p.second));
+                                };
+
+        //! IPv6 counterpart of \c in_dst_prefixes. \see in_dst_prefixes
+
+        auto in_dst_prefixes6 = [] (std::vector<std::string> const &nets) {
+                                    auto p = details::inet_prefixes(AF_INET6, nets);
+                                    return predicate("in_dst_prefixes6", std::move(p.first), std::move(p.second));
+                                };
+
+        //! IPv6 counterpart of \c steer_prefixes. \see steer_prefixes
+
+        auto steer_prefixes6 = [] (std::vector<std::string> const &nets) {
+                                    auto p = details::inet_prefixes(AF_INET6, nets);
+                                    return mfunction("steer_prefixes6", std::move(p.first), std::move(p.second));
+                                };
+
+        //
+        // payload matching:
+        //
+
+        //! Predicate that evaluates to \c true when the L4 payload of the packet contains
+        // one of the given patterns.
+        /*!
+         * Patterns are compiled into a single automaton when the computation is loaded,
+         * the payload is scanned once regardless of the number of patterns. Example:
+         *
+         * when (payload_match ({"GET ", "POST ", "HTTP/1.1"}), steer_flow)
+         */
+
+        auto payload_match = [] (std::vector<std::string> const &pats) {
+                                    return predicate("payload_match", pats);
+                                };
+
+        //! Dispatch the packet across the sockets
+        /*!
+         * Dispatch by the index of the first pattern found in the L4 payload, so that packets
+         * carrying the same pattern reach the same socket. Packets that do not match
+         * are dropped. Example:
+         *
+         * steer_payload ({"BitTorrent", "SSH-", "\x16\x03\x01"})
+         */
+
+        auto steer_payload = [] (std::vector<std::string> const &pats) {
+                                    return mfunction("steer_payload", pats);
+                                };
+
+        //! Count the packets by the pattern found in the L4 payload.
+        /*!
+         * The group counter n+i is incremented when the i-th pattern is the first one found;
+         * packets that do not match are dropped. Example:
+         *
+         * payload_counter (4, {"GET ", "POST "}) >> kernel
+         */
+
+        auto payload_counter = [] (int n, std::vector<std::string> const &pats) {
+                                    return mfunction("payload_counter", n, pats);
+                                };
         //
         // bloom filter, utility functions:
         //
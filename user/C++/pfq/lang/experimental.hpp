@@ -181,6 +181,65 @@ namespace pfq { namespace lang { namespace experimental {
 
         auto is_gtp_up      = predicate("is_gtp_up");
 
+        //! Evaluate to \c true if the SkBuff is encapsulated (GTP, VXLAN, GRE or MPLS).
+        /*!
+         * The packet is decapsulated once: the parsed headers are shared by all the
+         * tunnel functions of the computation.
+         */
+
+        auto is_tunnel      = predicate("is_tunnel");
+
+        //! Evaluate to \c true if the SkBuff is a VXLAN packet.
+
+        auto is_vxlan       = predicate("is_vxlan");
+
+        //! Evaluate to \c true if the SkBuff is a GRE packet.
+
+        auto is_gre         = predicate("is_gre");
+
+        //! Evaluate to \c true if the SkBuff is a MPLS packet.
+
+        auto is_mpls        = predicate("is_mpls");
+
+        //! Evaluate to \c true if the SkBuff has stacked VLAN tags (QinQ).
+
+        auto is_qinq        = predicate("is_qinq");
+
+        //! Evaluate to \c Pass SkBuff if it is encapsulated (GTP, VXLAN, GRE or MPLS), \c Drop it otherwise.
+
+        auto tunnel         = mfunction("tunnel");
+
+        //! Evaluate to \c Pass SkBuff if it is a VXLAN packet, \c Drop it otherwise.
+
+        auto vxlan          = mfunction("vxlan");
+
+        //! Evaluate to \c Pass SkBuff if it is a GRE packet, \c Drop it otherwise.
+
+        auto gre            = mfunction("gre");
+
+        //! Evaluate to \c Pass SkBuff if it is a MPLS packet, \c Drop it otherwise.
+
+        auto mpls           = mfunction("mpls");
+
+        //! Evaluate to \c Pass SkBuff if it has stacked VLAN tags (QinQ), \c Drop it otherwise.
+
+        auto qinq           = mfunction("qinq");
+
+        //! Dispatch the packet across the sockets, on the innermost 5-tuple.
+        /*!
+         * GTP-U, VXLAN, GRE, MPLS and stacked VLANs are decapsulated, and the symmetric
+         * hash of the inner IPv4/IPv6 5-tuple is used. Plain IP packets are steered on their
+         * own 5-tuple, other packets are dropped. Example:
+         *
+         * steer_inner
+         */
+
+        auto steer_inner     = mfunction("steer_inner");
+
+        //! Dispatch the packet across the sockets, on the tunnel identifier (GTP TEID, VXLAN VNI, GRE key or MPLS label).
+
+        auto steer_tunnel_id = mfunction("steer_tunnel_id");
+
         //! Dispatch the packet across the sockets
         /*!
          * Dispatch with a randomized algorithm that maintains the integrity
@@ -140,6 +140,7 @@ namespace pfq { namespace lang
     //////// Function argument_type class:
 
     struct funptr_t { } funptr = {};
+    struct funvec_t { } funvec = {};
 
     struct argument_type
     {
@@ -203,6 +204,14 @@ namespace pfq { namespace lang
         , nelem(static_cast<std::size_t>(-1))
         { }
 
+        argument_type(funvec_t, std::vector<std::size_t> idx)
+        : ptr()
+        , size(static_cast<std::size_t>(-1))
+        , nelem(idx.size())
+        {
+            ptr = std::make_shared<StorableShow<std::vector<std::size_t>>>(std::move(idx));
+        }
+
         argument_type(std::shared_ptr<StorableShowBase> p, size_t s, size_t n)
         : ptr(std::move(p))
         , size(s)
@@ -229,6 +238,9 @@ namespace pfq { namespace lang
         if (!arg.ptr && arg.size == 0 && arg.nelem == 0)  {
             out << "null";
         }
+        else if (arg.size == static_cast<size_t>(-1)) {
+            out << "funvec " << arg.ptr->forall_show();
+        }
         else if (arg.ptr && arg.size != 0 && arg.nelem == static_cast<size_t>(-1))  {
             out << "data " << arg.ptr->forall_show();
         }
@@ -248,7 +260,9 @@ namespace pfq { namespace lang
     inline std::string
     pretty(const argument_type &arg)
     {
-        if (arg.ptr)
+        if (arg.size == static_cast<size_t>(-1))
+            return "arg#" + arg.ptr->forall_show();
+        else if (arg.ptr)
             return arg.ptr->forall_show();
         else if (arg.size)
             return "arg#" + std::to_string(arg.size) + "";
@@ -296,6 +310,43 @@ namespace pfq { namespace lang
         return argument_type(funptr, ser[0].index);
     }
 
+    //
+    // list of monadic functions (e.g. the cases of a switch):
+    //
+
+    template <typename ...Fs>
+    struct FunctionList
+    {
+        std::tuple<Fs...> funs_;
+    };
+
+    namespace details
+    {
+        struct function_roots
+        {
+            std::vector<std::size_t> &idx;
+            std::ptrdiff_t n;
+
+            template <typename F>
+            void operator()(F const &f)
+            {
+                idx.push_back(static_cast<std::size_t>(n));
+                n = serialize(f, n).second;
+            }
+        };
+    }
+
+    template <typename ...Fs>
+    argument_type make_argument(FunctionList<Fs...> const &fl, std::vector<FunctionDescr> const &ser)
+    {
+        std::vector<std::size_t> idx;
+
+        if (!ser.empty())
+            tuple_for_each(fl.funs_, details::function_roots{idx, ser[0].index});
+
+        return argument_type(funvec, std::move(idx));
+    }
+
     template <typename ...Ts, typename ...Ti>
     std::array<argument_type, 8>
     make_arguments(std::tuple<Ts...> const &args, std::tuple<Ti...> const &ref)
@@ -673,6 +724,82 @@ namespace pfq { namespace lang
         return { std::move(v1) + std::move(v2), n2 };
     }
 
+    //////// FunctionList:
+
+    template <typename ...Fs>
+    inline FunctionList<Fs...>
+    functions(Fs ...fs)
+    {
+        return FunctionList<Fs...>{ std::make_tuple(std::move(fs)...) };
+    }
+
+    namespace details
+    {
+        struct serialize_function
+        {
+            std::vector<FunctionDescr> &ret;
+            std::ptrdiff_t &n;
+
+            template <typename F>
+            void operator()(F const &f)
+            {
+                static_assert(is_monadic_function<F>::value, "functions: monadic function expected");
+
+                std::vector<FunctionDescr> v;
+                std::ptrdiff_t n1;
+
+                std::tie(v, n1) = serialize(f, n);
+
+                // every function of the list is a computation on its own
+                fix_computation(n, v);
+
+                ret = std::move(ret) + std::move(v);
+                n = n1;
+            }
+        };
+
+        struct pretty_function
+        {
+            std::string &ret;
+            bool verbose;
+
+            template <typename F>
+            void operator()(F const &f)
+            {
+                if (ret.size() > 1)
+                    ret += ", ";
+                ret += verbose ? show(f) : pretty(f);
+            }
+        };
+    }
+
+    template <typename ...Fs>
+    inline std::string
+    pretty(FunctionList<Fs...> const &fl)
+    {
+        std::string ret = "[";
+        tuple_for_each(fl.funs_, details::pretty_function{ret, false});
+        return ret + ']';
+    }
+
+    template <typename ...Fs>
+    inline std::string
+    show(FunctionList<Fs...> const &fl)
+    {
+        std::string ret = "[";
+        tuple_for_each(fl.funs_, details::pretty_function{ret, true});
+        return ret + ']';
+    }
+
+    template <typename ...Fs>
+    inline std::pair<std::vector<FunctionDescr>, std::ptrdiff_t>
+    serialize(FunctionList<Fs...> const &fl, std::ptrdiff_t n)
+    {
+        std::vector<FunctionDescr> ret;
+        tuple_for_each(fl.funs_, details::serialize_function{ret, n});
+        return { ret, n };
+    }
+
 } // namespace lang
 } // namespace pfq
 
@@ -126,6 +126,62 @@ namespace pfq { namespace lang
                 throw std::runtime_error("pfq::lang::inet_pton");
             return ret;
         }
+
+        //
+        // IPv6 addresses as 4 words in host byte order (MSW first), for each address.
+        //
+
+        inline std::vector<uint32_t>
+        inet6_words(std::vector<std::string> const &addrs)
+        {
+            std::vector<uint32_t> ret;
+            for(auto const &addr : addrs)
+            {
+                uint32_t a[4];
+                if (inet_pton(AF_INET6, addr.c_str(), a) <= 0)
+                    throw std::runtime_error("pfq::lang::inet_pton");
+                for(auto w : a)
+                    ret.push_back(ntohl(w));
+            }
+            return ret;
+        }
+
+        //
+        // parse a list of networks ("addr/prefix") into the addresses and the prefix lengths.
+        // IPv4 addresses are in network byte order, IPv6 ones are 4 words in host byte order (MSW first).
+        //
+
+        inline std::pair<std::vector<uint32_t>, std::vector<int>>
+        inet_prefixes(int af, std::vector<std::string> const &nets)
+        {
+            std::pair<std::vector<uint32_t>, std::vector<int>> ret;
+
+            for(auto const &net : nets)
+            {
+                auto slash = net.find('/');
+                auto addr  = net.substr(0, slash);
+                int  bits  = af == AF_INET ? 32 : 128;
+                int  len   = slash == std::string::npos ? bits : std::stoi(net.substr(slash+1));
+
+                if (len < 0 || len > bits)
+                    throw std::runtime_error("pfq::lang::inet_prefixes: " + net);
+
+                if (af == AF_INET) {
+                    ret.first.push_back(inet_addr(addr));
+                }
+                else {
+                    uint32_t a[4];
+                    if (inet_pton(AF_INET6, addr.c_str(), a) <= 0)
+                        throw std::runtime_error("pfq::lang::inet_pton");
+                    for(auto w : a)
+                        ret.first.push_back(ntohl(w));
+                }
+
+                ret.second.push_back(len);
+            }
+
+            return ret;
+        }
     }
 
 
@@ -34,6 +34,7 @@
 #include <arpa/inet.h>
 #include <net/if.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <poll.h>
 
@@ -46,6 +47,7 @@
 #include <chrono>
 
 #include <pfq/util.hpp>
+#include <pfq/bloom.hpp>
 #include <pfq/queue.hpp>
 #include <pfq/lang/lang.hpp>
 
@@ -134,6 +136,27 @@ namespace pfq {
 
     //////////////////////////////////////////////////////////////////////
 
+    //! Tx slot.
+    /*!
+     * A slot reserved in a Tx queue of the shared memory, where the packet
+     * is built in place (see socket::tx_reserve).
+     */
+
+    struct tx_slot
+    {
+        char *   data;      // packet buffer
+        size_t   len;       // packet length (can be reduced before commit)
+        uint64_t nsec;      // transmission timestamp (0 = immediate)
+        int      queue;     // Tx queue
+
+        explicit operator bool() const
+        {
+            return data != nullptr;
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////
+
     //! PFQ: the socket
     /*!
      * This class is the main interface to the PFQ kernel module.
@@ -167,6 +190,13 @@ namespace pfq {
 
             size_t tx_num_bind;
             size_t tx_num_async;
+
+            bool tx_ring;
+
+            unsigned int tx_fwd_mark[Q_MAX_TX_QUEUES];  // completion of the last packet forwarded
+            unsigned int tx_fwd_pending;
+
+            size_t tx_replay_len[Q_MAX_TX_QUEUES];      // bytes of the trace loaded
         };
 
         int fd_;
@@ -402,6 +432,131 @@ namespace pfq {
             throw pfq_error("PFQ: socket not open");
         }
 
+        tx_slot
+        tx_reserve_(size_t len, int tss)
+        {
+            auto tx = &static_cast<struct pfq_shared_queue *>(data_->shm_addr)->tx[tss];
+            struct pfq_pkthdr_tx *hdr;
+
+            if (data_->tx_ring)
+            {
+                // streaming ring: a slot per packet, published by commit
+
+                auto nslots = 2 * data_->tx_slots;
+                auto head = __atomic_load_n(&tx->prod, __ATOMIC_RELAXED);
+
+                if (head - __atomic_load_n(&tx->done, __ATOMIC_ACQUIRE) >= nslots)
+                    return tx_slot{nullptr, 0, 0, tss};
+
+                hdr = reinterpret_cast<struct pfq_pkthdr_tx *>(static_cast<char *>(data_->tx_queue_addr)
+                                + data_->tx_queue_size * 2 * tss + (head % nslots) * data_->tx_slot_size);
+
+                len = std::min(len, data_->tx_slot_size - sizeof(struct pfq_pkthdr_tx));
+            }
+            else
+            {
+                auto index = __atomic_load_n(&tx->cons, __ATOMIC_RELAXED);
+                if (index != __atomic_load_n(&tx->prod, __ATOMIC_RELAXED))
+                {
+                    __atomic_store_n(&tx->prod, index, __ATOMIC_SEQ_CST);
+                    tx_doorbell_(tx, tss);
+                }
+
+                void * base_addr = static_cast<char *>(data_->tx_queue_addr)
+                                    + data_->tx_queue_size * (2 * tss + (index & 1));
+
+                if (index != tx->index) {
+
+                    // the half is reused once the kernel has released its packets (zero-copy)
+
+                    if (static_cast<int>(__atomic_load_n(&tx->done, __ATOMIC_ACQUIRE) - index + 2) < 0)
+                        return tx_slot{nullptr, 0, 0, tss};
+
+                    tx->index = index;
+                    tx->ptr = base_addr;
+                }
+
+                // room for the packet and the terminating header
+
+                if ((static_cast<char *>(tx->ptr) - static_cast<char *>(base_addr)
+                     + 2 * sizeof(struct pfq_pkthdr_tx) + align<8>(len)) >= data_->tx_queue_size)
+                    return tx_slot{nullptr, 0, 0, tss};
+
+                hdr = static_cast<struct pfq_pkthdr_tx *>(tx->ptr);
+            }
+
+            return tx_slot{reinterpret_cast<char *>(hdr+1), len, 0, tss};
+        }
+
+        // the doorbell: wake up the kernel thread of the Tx queue, if parked
+        // (after publishing the packets, with a full barrier)
+
+        void
+        tx_doorbell_(struct pfq_tx_queue *tx, int tss)
+        {
+            if (__atomic_load_n(&tx->parked, __ATOMIC_RELAXED))
+                tx_queue_flush(tss);
+        }
+
+        void
+        tx_commit_(tx_slot const &slot, uint64_t len)
+        {
+            auto tx  = &static_cast<struct pfq_shared_queue *>(data_->shm_addr)->tx[slot.queue];
+            auto hdr = reinterpret_cast<struct pfq_pkthdr_tx *>(slot.data) - 1;
+
+            hdr->nsec = slot.nsec;
+
+            if (data_->tx_ring) {
+                hdr->len = len;
+                __atomic_add_fetch(&tx->prod, 1, __ATOMIC_SEQ_CST);
+                tx_doorbell_(tx, slot.queue);
+                return;
+            }
+
+            // terminate the queue first: the kernel stops at the first empty header
+
+            tx->ptr = slot.data + align<8>(slot.len);
+            static_cast<struct pfq_pkthdr_tx *>(tx->ptr)->len = 0;
+
+            hdr->len = len;
+        }
+
+        // wait for the packets forwarded from the Rx queue to be released
+        //
+
+        void
+        tx_fwd_wait_()
+        {
+            for(int n = 0; n < Q_MAX_TX_QUEUES; ++n)
+            {
+                auto tx = &static_cast<struct pfq_shared_queue *>(data_->shm_addr)->tx[n];
+
+                if (!(data_->tx_fwd_pending & (1U << n)))
+                    continue;
+
+                while (static_cast<int>(__atomic_load_n(&tx->done, __ATOMIC_ACQUIRE) - data_->tx_fwd_mark[n]) < 0)
+                {
+                    if (!data_->tx_ring)
+                    {
+                        // hand the current half to the kernel thread
+
+                        auto index = __atomic_load_n(&tx->cons, __ATOMIC_RELAXED);
+                        if (index != __atomic_load_n(&tx->prod, __ATOMIC_RELAXED))
+                            __atomic_store_n(&tx->prod, index, __ATOMIC_SEQ_CST);
+                    }
+
+                    if (data_->tx_num_bind != data_->tx_num_async)
+                        tx_queue_flush(n);
+                    else {
+                        tx_doorbell_(tx, n);
+                        std::this_thread::yield();
+                    }
+                }
+            }
+
+            data_->tx_fwd_pending = 0;
+        }
+
         void
         open(size_t caplen, size_t rx_slots, size_t tx_slots)
         {
@@ -428,7 +583,11 @@ namespace pfq {
                                         0,
                                         0,
                                         0,
-                                        0
+                                        0,
+                                        false,
+                                        {},
+                                        0,
+                                        {}
                                      });
 
             // get id
@@ -568,6 +727,7 @@ namespace pfq {
 
             data()->shm_addr = nullptr;
             data()->shm_size = 0;
+            data()->tx_fwd_pending = 0;
 
             if(::setsockopt(fd_, PF_Q, Q_SO_DISABLE, nullptr, 0) == -1)
                 throw pfq_error(errno, "PFQ: socket disable");
@@ -712,6 +872,35 @@ namespace pfq {
            return data()->tx_slots;
         }
 
+        //! Specify the number of Tx queues of the socket (default 4, up to Q_MAX_TX_QUEUES).
+        /*!
+         * Each Tx queue takes its share of the shared memory, hence the number
+         * must be specified before enabling the socket.
+         */
+
+        void
+        tx_queues(size_t value)
+        {
+            if (enabled())
+                throw pfq_error("PFQ: enabled (Tx queues could not be set)");
+
+            if (::setsockopt(fd_, PF_Q, Q_SO_SET_TX_QUEUES, &value, sizeof(value)) == -1)
+                throw pfq_error(errno, "PFQ: set Tx queues error");
+        }
+
+        //! Return the number of Tx queues of the socket.
+
+        size_t
+        tx_queues() const
+        {
+            size_t ret; socklen_t size = sizeof(ret);
+
+            if (::getsockopt(fd_, PF_Q, Q_SO_GET_TX_QUEUES, &ret, &size) == -1)
+                throw pfq_error(errno, "PFQ: get Tx queues error");
+
+            return ret;
+        }
+
 
         //! Bind the main group of the socket to the given device/queue.
         /*!
@@ -1078,6 +1267,11 @@ namespace pfq {
 
             unsigned int data, index;
 
+            // the half about to be refilled by the kernel holds the packets forwarded
+
+            if (data_->tx_fwd_pending)
+                tx_fwd_wait_();
+
             data = __atomic_load_n(&q->rx.data, __ATOMIC_RELAXED);
             index = Q_SHARED_QUEUE_INDEX(data);
 
@@ -1265,6 +1459,136 @@ namespace pfq {
             return std::vector<unsigned long>(std::begin(cs.counter), std::end(cs.counter));
         }
 
+        //! Return the heavy hitters of the given group, sorted by the estimated number of packets.
+
+        std::vector<pfq_heavy_hitter>
+        group_heavy_hitters(int gid) const
+        {
+            pfq_heavy_hitters hh;
+            hh.gid = gid;
+            socklen_t size = sizeof(struct pfq_heavy_hitters);
+            if (::getsockopt(fd_, PF_Q, Q_SO_GET_GROUP_HEAVY_HITTERS, &hh, &size) == -1)
+                throw pfq_error(errno, "PFQ: get group heavy hitters error");
+
+            return std::vector<pfq_heavy_hitter>(hh.entry, hh.entry + hh.size);
+        }
+
+        //! Return the per-node counters of the computation of the given group (see lang_stats).
+
+        std::vector<pfq_node_stats>
+        group_computation_stats(int gid) const
+        {
+            pfq_computation_stats cs;
+            cs.gid = gid;
+            socklen_t size = sizeof(struct pfq_computation_stats);
+            if (::getsockopt(fd_, PF_Q, Q_SO_GET_GROUP_COMPUTATION_STATS, &cs, &size) == -1)
+                throw pfq_error(errno, "PFQ: get group computation stats error");
+
+            return std::vector<pfq_node_stats>(cs.node, cs.node + cs.size);
+        }
+
+        //! Create the exact-match table n of the given group (Q_TABLE_KEY_ADDR or Q_TABLE_KEY_FLOW).
+
+        void
+        group_table_create(int gid, int n, int type, size_t size)
+        {
+            struct pfq_group_table tab = { gid, n, Q_TABLE_CREATE, type, size, nullptr };
+            if (::setsockopt(fd_, PF_Q, Q_SO_GROUP_TABLE, &tab, sizeof(tab)) == -1)
+                throw pfq_error(errno, "PFQ: group table create error");
+        }
+
+        //! Destroy the exact-match table n of the given group.
+
+        void
+        group_table_destroy(int gid, int n)
+        {
+            struct pfq_group_table tab = { gid, n, Q_TABLE_DESTROY, 0, 0, nullptr };
+            if (::setsockopt(fd_, PF_Q, Q_SO_GROUP_TABLE, &tab, sizeof(tab)) == -1)
+                throw pfq_error(errno, "PFQ: group table destroy error");
+        }
+
+        //! Insert (or update) entries into the table n of the given group.
+
+        void
+        group_table_insert(int gid, int n, std::vector<pfq_table_entry> const &entries)
+        {
+            struct pfq_group_table tab = { gid, n, Q_TABLE_INSERT, 0, entries.size(), const_cast<pfq_table_entry *>(entries.data()) };
+            if (::setsockopt(fd_, PF_Q, Q_SO_GROUP_TABLE, &tab, sizeof(tab)) == -1)
+                throw pfq_error(errno, "PFQ: group table insert error");
+        }
+
+        //! Remove entries from the table n of the given group.
+
+        void
+        group_table_remove(int gid, int n, std::vector<pfq_table_entry> const &entries)
+        {
+            struct pfq_group_table tab = { gid, n, Q_TABLE_DELETE, 0, entries.size(), const_cast<pfq_table_entry *>(entries.data()) };
+            if (::setsockopt(fd_, PF_Q, Q_SO_GROUP_TABLE, &tab, sizeof(tab)) == -1)
+                throw pfq_error(errno, "PFQ: group table remove error");
+        }
+
+        //! Remove all the entries of the table n of the given group.
+
+        void
+        group_table_flush(int gid, int n)
+        {
+            struct pfq_group_table tab = { gid, n, Q_TABLE_FLUSH, 0, 0, nullptr };
+            if (::setsockopt(fd_, PF_Q, Q_SO_GROUP_TABLE, &tab, sizeof(tab)) == -1)
+                throw pfq_error(errno, "PFQ: group table flush error");
+        }
+
+        //! Load the bloom filter n of the given group (used by in_bloom functions).
+        /*!
+         * The filter replaces the running one atomically: packets are never
+         * matched against a partially loaded filter.
+         */
+
+        void
+        group_bloom_load(int gid, int n, bloom_filter const &filter)
+        {
+            struct pfq_group_bloom bf = { gid, n, filter.ipv(), filter.prefix(), filter.size(), filter.data() };
+            if (::setsockopt(fd_, PF_Q, Q_SO_GROUP_BLOOM, &bf, sizeof(bf)) == -1)
+                throw pfq_error(errno, "PFQ: group bloom load error");
+        }
+
+        //! Remove the bloom filter n of the given group.
+
+        void
+        group_bloom_remove(int gid, int n)
+        {
+            struct pfq_group_bloom bf = { gid, n, 4, 0, 0, nullptr };
+            if (::setsockopt(fd_, PF_Q, Q_SO_GROUP_BLOOM, &bf, sizeof(bf)) == -1)
+                throw pfq_error(errno, "PFQ: group bloom remove error");
+        }
+
+        //! Set the steering mode of the given group.
+        /*!
+         * With Q_STEER_SPRAY or Q_STEER_FLOWLET the group tolerates reordering: flows
+         * above rate (Mbit/s) are spread across the sockets round-robin (per packet or per
+         * flowlet), while the others keep the flow affinity. Zero selects the defaults.
+         * Spraying reorders the packets of such flows, flowlets are moved between bursts.
+         */
+
+        void
+        group_steering(int gid, int mode, unsigned int rate = 0, unsigned int flowlet = 0)
+        {
+            struct pfq_group_steering st = { gid, mode, rate, flowlet, 0, 0 };
+            if (::setsockopt(fd_, PF_Q, Q_SO_GROUP_STEERING, &st, sizeof(st)) == -1)
+                throw pfq_error(errno, "PFQ: set group steering error");
+        }
+
+        //! Return the steering mode of the given group, with the number of flows promoted to elephant.
+
+        pfq_group_steering
+        group_steering(int gid) const
+        {
+            struct pfq_group_steering st = { gid, 0, 0, 0, 0, 0 };
+            socklen_t size = sizeof(st);
+            if (::getsockopt(fd_, PF_Q, Q_SO_GET_GROUP_STEERING, &st, &size) == -1)
+                throw pfq_error(errno, "PFQ: get group steering error");
+            return st;
+        }
+
         //! Return the memory size of the Rx queue.
 
         size_t
@@ -1355,41 +1679,274 @@ namespace pfq {
                 return fold(queue, data_->tx_num_bind);
             }();
 
-            auto tx = &static_cast<struct pfq_shared_queue *>(data_->shm_addr)->tx[tss];
+            auto slot = tx_reserve_(buf.second, tss);
+            if (!slot)
+                return false;
+
+            memcpy(slot.data, buf.first, slot.len);
+            slot.nsec = ts;
+
+            tx_commit(slot);
+            return true;
+        }
+
+        //! Schedule the packet gathered from an array of buffers.
+        /*!
+         * The pieces (e.g. headers and payload) are copied once, directly into the Tx queue.
+         * Same as inject otherwise.
+         */
+
+        bool
+        injectv(struct iovec const *iov, int iovcnt, uint64_t ts, int queue = any_queue)
+        {
+            if (!data_->shm_addr)
+                throw pfq_error("PFQ: injectv: socket not enabled");
+
+            size_t len = 0;
+            for(int n = 0; n < iovcnt; ++n)
+                len += iov[n].iov_len;
+
+            const int tss = [=]() -> size_t {
+                if (queue == any_queue)
+                {
+                    // the headers may span more than one piece
+
+                    char head[128] = { 0 };
+                    size_t hlen = 0;
+
+                    for(int n = 0; n < iovcnt && hlen < sizeof(head); ++n)
+                    {
+                        auto c = std::min(iov[n].iov_len, sizeof(head) - hlen);
+                        memcpy(head + hlen, iov[n].iov_base, c);
+                        hlen += c;
+                    }
+
+                    return fold(symmetric_hash(head), data_->tx_num_bind);
+                }
+                return fold(queue, data_->tx_num_bind);
+            }();
 
-            auto index = __atomic_load_n(&tx->cons, __ATOMIC_RELAXED);
-            if (index != __atomic_load_n(&tx->prod, __ATOMIC_RELAXED))
+            auto slot = tx_reserve_(len, tss);
+            if (!slot)
+                return false;
+
+            size_t off = 0;
+            for(int n = 0; n < iovcnt && off < slot.len; ++n)
             {
-                __atomic_store_n(&tx->prod, index, __ATOMIC_RELAXED);
+                auto c = std::min(iov[n].iov_len, slot.len - off);
+                memcpy(slot.data + off, iov[n].iov_base, c);
+                off += c;
             }
 
-	        void * base_addr = static_cast<char *>(data_->tx_queue_addr)
-	                            + data_->tx_queue_size * (2 * tss + (index & 1));
+            slot.nsec = ts;
 
-            if (index != tx->index) {
-                    tx->index = index;
-                    tx->ptr = base_addr;
-            }
+            tx_commit(slot);
+            return true;
+        }
 
-            auto len = buf.second;
-            auto slot_size = sizeof(struct pfq_pkthdr_tx) + align<8>(len);
+        //! Reserve a Tx slot for a packet of len bytes.
+        /*!
+         * The packet is built in place, in the shared memory, and scheduled for
+         * transmission by tx_commit. One slot per Tx queue can be reserved at a time.
+         * any_queue selects the first Tx queue (the packet is not known yet).
+         * The length of the slot can be less than len if the packet exceeds the max
+         * Tx length. The slot is empty (false) if the queue is full.
+         */
 
-            if ((static_cast<char *>(tx->ptr) - static_cast<char *>(base_addr)
-                 + slot_size + sizeof(struct pfq_pkthdr_tx)) < data_->tx_queue_size)
-            {
-                auto hdr = (struct pfq_pkthdr_tx *)tx->ptr;
-                hdr->len = len;
-                hdr->nsec = ts;
-                memcpy(hdr+1, buf.first, hdr->len);
+        tx_slot
+        tx_reserve(size_t len, int queue = any_queue)
+        {
+            if (!data_->shm_addr)
+                throw pfq_error("PFQ: Tx reserve: socket not enabled");
 
-                reinterpret_cast<char *&>(tx->ptr) += slot_size;
-                hdr = (struct pfq_pkthdr_tx *)tx->ptr;
-                hdr->len = 0;
+            return tx_reserve_(len, fold(queue == any_queue ? 0 : queue, data_->tx_num_bind));
+        }
 
-                return true;
-            }
+        //! Schedule the packet built in a reserved Tx slot.
+        /*!
+         * slot.len bytes of slot.data are transmitted at slot.nsec.
+         */
 
-            return false;
+        void
+        tx_commit(tx_slot const &slot)
+        {
+            tx_commit_(slot, slot.len);
+        }
+
+        //! Schedule the transmission of a packet received, without copy.
+        /*!
+         * The packet (caplen bytes) is transmitted from the Rx queue by reference.
+         * Before swapping the Rx queue again, read waits for the packets forwarded
+         * to be released (with zero-copy, by the driver).
+         * Return false if the Tx queue is full.
+         */
+
+        bool
+        forward(queue::const_iterator it, int queue = any_queue)
+        {
+            if (!data_->shm_addr)
+                throw pfq_error("PFQ: forward: socket not enabled");
+
+            auto pkt = static_cast<const char *>(it.data());
+
+            const int tss = [=]() -> size_t {
+                if (queue == any_queue)
+                    return fold(symmetric_hash(pkt), data_->tx_num_bind);
+                return fold(queue, data_->tx_num_bind);
+            }();
+
+            auto slot = tx_reserve_(sizeof(struct pfq_tx_fwd), tss);
+            if (!slot)
+                return false;
+
+            // the descriptor references the packet in the Rx queue
+
+            reinterpret_cast<struct pfq_tx_fwd *>(slot.data)->offset =
+                static_cast<uint64_t>(pkt - static_cast<const char *>(data_->rx_queue_addr));
+
+            tx_commit_(slot, it->caplen | Q_TX_FWD);
+
+            // the Rx slot is reused once the packet is released (see read)
+
+            auto tx = &static_cast<struct pfq_shared_queue *>(data_->shm_addr)->tx[tss];
+
+            data_->tx_fwd_mark[tss] = data_->tx_ring ? tx->prod : tx->index;
+            data_->tx_fwd_pending |= 1U << tss;
+            return true;
+        }
+
+        //! Append a packet to the trace of a Tx queue, for replay.
+        /*!
+         * The trace is stored in the whole Tx queue (both halves, in the shared memory);
+         * nsec is relative to the beginning of the trace. Return false if the queue is full.
+         * The queue is not to be used with inject while replaying.
+         */
+
+        bool
+        tx_replay_append(const_buffer buf, uint64_t nsec, int queue = 0)
+        {
+            if (!data_->shm_addr)
+                throw pfq_error("PFQ: Tx replay: socket not enabled");
+
+            const auto tss = fold(queue, data_->tx_num_bind);
+
+            // the trace takes the whole region of the queue (both halves)
+
+            auto base_addr = static_cast<char *>(data_->tx_queue_addr) + data_->tx_queue_size * 2 * tss;
+            auto slot_size = sizeof(struct pfq_pkthdr_tx) + align<8>(buf.second);
+
+            if (data_->tx_replay_len[tss] + slot_size + sizeof(struct pfq_pkthdr_tx) > 2 * data_->tx_queue_size)
+                return false;
+
+            auto hdr = reinterpret_cast<struct pfq_pkthdr_tx *>(base_addr + data_->tx_replay_len[tss]);
+            hdr->len = buf.second;
+            hdr->nsec = nsec;
+            memcpy(hdr+1, buf.first, buf.second);
+
+            data_->tx_replay_len[tss] += slot_size;
+
+            hdr = reinterpret_cast<struct pfq_pkthdr_tx *>(base_addr + data_->tx_replay_len[tss]);
+            hdr->len = 0;
+            return true;
+        }
+
+        //! Replay the trace of a Tx queue.
+        /*!
+         * The trace is transmitted loops times (0 = forever) by the kernel thread of the
+         * queue (or by tx_queue_flush), with the original timing scaled by speed/1000,
+         * at a fixed inter-packet gap (nsec) or at line rate (speed = 0, gap = 0).
+         * Flags: Q_REPLAY_REWRITE_IP, Q_REPLAY_REWRITE_MAC (the loop number is added to
+         * the addresses). Kernel threads must be stopped.
+         */
+
+        void
+        tx_replay(int queue, int loops = 0, unsigned int speed = 1000, uint64_t gap = 0, unsigned int flags = 0)
+        {
+            struct pfq_tx_replay opt { static_cast<int>(fold(queue, data()->tx_num_bind)), loops, speed, flags, gap };
+
+            if (::setsockopt(fd_, PF_Q, Q_SO_TX_REPLAY, &opt, sizeof(opt)) == -1)
+                throw pfq_error(errno, "PFQ: Tx replay");
+        }
+
+        //! Stop the replay of a Tx queue and discard its trace.
+
+        void
+        tx_replay_stop(int queue)
+        {
+            tx_replay(queue, -1, 0, 0, 0);
+            data_->tx_replay_len[fold(queue, data_->tx_num_bind)] = 0;
+        }
+
+        //! Return the number of loops of the trace completed.
+
+        unsigned int
+        tx_replay_loops(int queue) const
+        {
+            if (!data()->shm_addr)
+                throw pfq_error("PFQ: Tx replay: socket not enabled");
+
+            auto tx = &static_cast<struct pfq_shared_queue *>(data_->shm_addr)->tx[fold(queue, data_->tx_num_bind)];
+            return __atomic_load_n(&tx->done, __ATOMIC_ACQUIRE);
+        }
+
+        //! Start the in-kernel generator of a Tx queue.
+        /*!
+         * The kernel thread of the queue synthesizes count packets (0 = forever) from
+         * the templates, picked in proportion to their weight (e.g. IMIX), and applies the
+         * rules (counter or random range of IPv4 addresses and ports). With Q_TEMPLATE_CSUM
+         * lengths and checksums are fixed up. gap is the inter-packet gap in nsec (0 = line rate).
+         * Kernel threads must be stopped.
+         */
+
+        void
+        tx_template(int queue, std::vector<std::pair<const_buffer, unsigned int>> const &pkts,
+                    std::vector<pfq_tx_template_rule> const &rules = {},
+                    uint64_t count = 0, uint64_t gap = 0, unsigned int flags = Q_TEMPLATE_CSUM)
+        {
+            if (pkts.empty() || pkts.size() > Q_TX_TEMPLATE_MAX || rules.size() > Q_TX_TEMPLATE_MAX_RULES)
+                throw pfq_error("PFQ: Tx template: bad number of templates/rules");
+
+            struct pfq_tx_template opt {};
+
+            opt.queue     = static_cast<int>(fold(queue, data()->tx_num_bind));
+            opt.num_pkts  = static_cast<int>(pkts.size());
+            opt.num_rules = static_cast<int>(rules.size());
+            opt.flags     = flags;
+            opt.count     = count;
+            opt.gap       = gap;
+
+            for(size_t n = 0; n < pkts.size(); n++)
+                opt.pkt[n] = { pkts[n].first.first, pkts[n].first.second, pkts[n].second };
+
+            std::copy(rules.begin(), rules.end(), opt.rule);
+
+            if (::setsockopt(fd_, PF_Q, Q_SO_TX_TEMPLATE, &opt, sizeof(opt)) == -1)
+                throw pfq_error(errno, "PFQ: Tx template");
+        }
+
+        //! Stop the generator of a Tx queue and discard its templates.
+
+        void
+        tx_template_stop(int queue)
+        {
+            struct pfq_tx_template opt {};
+
+            opt.queue = static_cast<int>(fold(queue, data()->tx_num_bind));
+
+            if (::setsockopt(fd_, PF_Q, Q_SO_TX_TEMPLATE, &opt, sizeof(opt)) == -1)
+                throw pfq_error(errno, "PFQ: Tx template stop");
+        }
+
+        //! Return the number of packets generated (modulo 2^32).
+
+        unsigned int
+        tx_template_sent(int queue) const
+        {
+            if (!data()->shm_addr)
+                throw pfq_error("PFQ: Tx template: socket not enabled");
+
+            auto tx = &static_cast<struct pfq_shared_queue *>(data_->shm_addr)->tx[fold(queue, data_->tx_num_bind)];
+            return __atomic_load_n(&tx->done, __ATOMIC_ACQUIRE);
         }
 
         //! Flush the Tx queue(s).
@@ -1417,6 +1974,39 @@ namespace pfq {
                 throw pfq_error(errno, "PFQ: Tx async");
         }
 
+        //! Enable/Disable zero-copy transmission.
+        /*!
+         * Packets are transmitted from the shared memory without being copied
+         * (the socket must be enabled with hugepages, kernel threads stopped).
+         * A Tx slot is reused once the driver has released the packets previously
+         * stored in it: until then inject returns false, as if the queue were full.
+         */
+
+        void
+        tx_zerocopy(bool value)
+        {
+            int toggle = value;
+            if (::setsockopt(fd_, PF_Q, Q_SO_TX_ZEROCOPY, &toggle, sizeof(toggle)) == -1)
+                throw pfq_error(errno, "PFQ: Tx zero-copy");
+        }
+
+        //! Enable/Disable the streaming Tx ring.
+        /*!
+         * The Tx queues are used as rings of fixed-size slots: each packet injected
+         * is immediately visible to the kernel, which consumes the ring continuously
+         * instead of swapping the two halves of the queue (kernel threads stopped;
+         * to be enabled before zero-copy).
+         */
+
+        void
+        tx_ring(bool value)
+        {
+            int toggle = value;
+            if (::setsockopt(fd_, PF_Q, Q_SO_TX_RING, &toggle, sizeof(toggle)) == -1)
+                throw pfq_error(errno, "PFQ: Tx ring");
+            data_->tx_ring = value;
+        }
+
     };
 
 
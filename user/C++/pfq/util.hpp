@@ -35,9 +35,11 @@
 #include <algorithm>
 
 #include <linux/pf_q.h>
+#include <linux/pf_q-hash.h>
 #include <linux/if_ether.h>
 #include <linux/ip.h>
 #include <linux/udp.h>
+#include <netinet/ip6.h>
 
 #include <arpa/inet.h>
 #include <sys/ioctl.h>
@@ -209,26 +211,35 @@ namespace pfq {
         }
 
 
+        //! Symmetric hash of the packet, the same computed by the steering functions (see linux/pf_q-hash.h).
+
         inline uint32_t
-        symmetric_hash(const char *buf) noexcept
+        symmetric_hash(const char *buf, int type = Q_HASH_CRC32C) noexcept
         {
             const char *ptr = buf;
 
             auto eh = reinterpret_cast<const ethhdr *>(ptr);
-            if (eh->h_proto != htons(0x800))
-                return 0;
 
             ptr += sizeof(ethhdr);
 
+            if (eh->h_proto == htons(ETH_P_IPV6)) {
+                auto ih6 = reinterpret_cast<const ip6_hdr *>(ptr);
+                return pfq_sym_hash6(type, reinterpret_cast<const uint32_t *>(&ih6->ip6_src),
+                                           reinterpret_cast<const uint32_t *>(&ih6->ip6_dst), 0, 0);
+            }
+
+            if (eh->h_proto != htons(ETH_P_IP))
+                return 0;
+
             auto ih = reinterpret_cast<const iphdr *>(ptr);
             if (ih->protocol != IPPROTO_TCP &&
                 ih->protocol != IPPROTO_UDP)
-                return (ih->saddr ^ ih->daddr);
+                return pfq_sym_hash4(type, ih->saddr, ih->daddr, 0, 0);
 
-            ptr += sizeof(ih->ihl << 2);
+            ptr += ih->ihl << 2;
 
             auto uh = reinterpret_cast<const udphdr *>(ptr);
-            return (ih->saddr ^ ih->daddr ^ uh->source ^ uh->dest);
+            return pfq_sym_hash4(type, ih->saddr, ih->daddr, uh->source, uh->dest);
         }
 
 
@@ -23,6 +23,7 @@
 
 #include <linux/if_ether.h>
 #include <linux/pf_q.h>
+#include <linux/pf_q-bloom.h>
 
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -156,6 +157,13 @@ typedef struct pfq_data
 	size_t tx_num_bind;
 	size_t tx_num_async;
 
+	int tx_ring;
+
+	unsigned int tx_fwd_mark[Q_MAX_TX_QUEUES];	/* completion of the last packet forwarded */
+	unsigned int tx_fwd_pending;
+
+	size_t tx_replay_len[Q_MAX_TX_QUEUES];		/* bytes of the trace loaded */
+
 	const char * error;
 
 	int fd;
@@ -386,6 +394,7 @@ pfq_disable(pfq_t *q)
 
 	q->shm_addr = NULL;
 	q->shm_size = 0;
+	q->tx_fwd_pending = 0;
 
 	if(setsockopt(q->fd, PF_Q, Q_SO_DISABLE, NULL, 0) == -1) {
 		return Q_ERROR(q, "PFQ: socket disable");
@@ -556,6 +565,33 @@ pfq_get_tx_slots(pfq_t const *q)
 	return q->tx_slots;
 }
 
+int
+pfq_set_tx_queues(pfq_t *q, size_t value)
+{
+	int enabled = pfq_is_enabled(q);
+	if (enabled == 1) {
+		return Q_ERROR(q, "PFQ: enabled (Tx queues could not be set)");
+	}
+	if (setsockopt(q->fd, PF_Q, Q_SO_SET_TX_QUEUES, &value, sizeof(value)) == -1) {
+		return Q_ERROR(q, "PFQ: set Tx queues error");
+	}
+
+	return Q_OK(q);
+}
+
+
+ssize_t
+pfq_get_tx_queues(pfq_t const *q)
+{
+	size_t ret; socklen_t size = sizeof(ret);
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_TX_QUEUES, &ret, &size) == -1) {
+		return Q_ERROR(q, "PFQ: get Tx queues error");
+	}
+	return Q_VALUE(q, (ssize_t)ret);
+}
+
+
 size_t
 pfq_get_rx_slot_size(pfq_t const *q)
 {
@@ -869,6 +905,169 @@ pfq_get_group_counters(pfq_t const *q, int gid, struct pfq_counters *cs)
 }
 
 
+int
+pfq_get_group_heavy_hitters(pfq_t const *q, int gid, struct pfq_heavy_hitters *hh)
+{
+	socklen_t size = sizeof(struct pfq_heavy_hitters);
+
+	hh->gid = gid;
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_GROUP_HEAVY_HITTERS, hh, &size) == -1) {
+		return Q_ERROR(q, "PFQ: get group heavy hitters error");
+	}
+	return Q_OK(q);
+}
+
+
+int
+pfq_get_group_computation_stats(pfq_t const *q, int gid, struct pfq_computation_stats *cs)
+{
+	socklen_t size = sizeof(struct pfq_computation_stats);
+
+	cs->gid = gid;
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_GROUP_COMPUTATION_STATS, cs, &size) == -1) {
+		return Q_ERROR(q, "PFQ: get group computation stats error");
+	}
+	return Q_OK(q);
+}
+
+
+static int
+pfq_group_table(pfq_t *q, int gid, int n, int op, int type, struct pfq_table_entry const *entries, size_t size)
+{
+	struct pfq_group_table tab = { gid, n, op, type, size, (struct pfq_table_entry *)entries };
+
+	if (setsockopt(q->fd, PF_Q, Q_SO_GROUP_TABLE, &tab, sizeof(tab)) == -1) {
+		return Q_ERROR(q, "PFQ: group table error");
+	}
+	return Q_OK(q);
+}
+
+
+int
+pfq_group_table_create(pfq_t *q, int gid, int n, int type, size_t size)
+{
+	return pfq_group_table(q, gid, n, Q_TABLE_CREATE, type, NULL, size);
+}
+
+
+int
+pfq_group_table_destroy(pfq_t *q, int gid, int n)
+{
+	return pfq_group_table(q, gid, n, Q_TABLE_DESTROY, 0, NULL, 0);
+}
+
+
+int
+pfq_group_table_insert(pfq_t *q, int gid, int n, struct pfq_table_entry const *entries, size_t size)
+{
+	return pfq_group_table(q, gid, n, Q_TABLE_INSERT, 0, entries, size);
+}
+
+
+int
+pfq_group_table_delete(pfq_t *q, int gid, int n, struct pfq_table_entry const *entries, size_t size)
+{
+	return pfq_group_table(q, gid, n, Q_TABLE_DELETE, 0, entries, size);
+}
+
+
+int
+pfq_group_table_flush(pfq_t *q, int gid, int n)
+{
+	return pfq_group_table(q, gid, n, Q_TABLE_FLUSH, 0, NULL, 0);
+}
+
+
+int
+pfq_group_bloom_load(pfq_t *q, int gid, int n, int ipv, int prefix, const void *bits, size_t size)
+{
+	struct pfq_group_bloom bf = { gid, n, ipv, prefix, size, bits };
+
+	if (setsockopt(q->fd, PF_Q, Q_SO_GROUP_BLOOM, &bf, sizeof(bf)) == -1) {
+		return Q_ERROR(q, "PFQ: group bloom load error");
+	}
+	return Q_OK(q);
+}
+
+
+int
+pfq_group_bloom_load_addr(pfq_t *q, int gid, int n, int ipv, int prefix, size_t m, const uint32_t *addrs, size_t count)
+{
+	size_t nblocks = (m + Q_BLOOM_BLOCK_BITS - 1) / Q_BLOOM_BLOCK_BITS, i;
+	uint32_t mask[4];
+	uint64_t *bits;
+	int j, p, ret;
+
+	if (nblocks == 0)
+		nblocks = 1;
+
+	if ((ipv != 4 && ipv != 6) || nblocks > Q_BLOOM_MAX_BLOCKS) {
+		return Q_ERROR(q, "PFQ: group bloom: bad parameters");
+	}
+
+	bits = calloc(nblocks, Q_BLOOM_BLOCK_BITS/8);
+	if (bits == NULL) {
+		return Q_ERROR(q, "PFQ: group bloom: out of memory");
+	}
+
+	for(j = 0, p = prefix; j < 4; j++, p -= 32)
+		mask[j] = p >= 32 ? 0xffffffff : p <= 0 ? 0 : htonl(~((1U << (32 - p)) - 1));
+
+	for(i = 0; i < count; i++)
+	{
+		if (ipv == 4) {
+			pfq_bloom_set(bits, nblocks, pfq_bloom_hash4(addrs[i] & mask[0]));
+		}
+		else {
+			uint32_t a[4];
+			for(j = 0; j < 4; j++)
+				a[j] = htonl(addrs[i*4 + j]) & mask[j];
+			pfq_bloom_set(bits, nblocks, pfq_bloom_hash6(a));
+		}
+	}
+
+	ret = pfq_group_bloom_load(q, gid, n, ipv, prefix, bits, nblocks * Q_BLOOM_BLOCK_BITS/8);
+
+	free(bits);
+	return ret;
+}
+
+
+int
+pfq_group_bloom_remove(pfq_t *q, int gid, int n)
+{
+	return pfq_group_bloom_load(q, gid, n, 4, 0, NULL, 0);
+}
+
+
+int
+pfq_set_group_steering(pfq_t *q, int gid, int mode, unsigned int rate, unsigned int flowlet)
+{
+	struct pfq_group_steering st = { gid, mode, rate, flowlet, 0, 0 };
+
+	if (setsockopt(q->fd, PF_Q, Q_SO_GROUP_STEERING, &st, sizeof(st)) == -1) {
+		return Q_ERROR(q, "PFQ: set group steering error");
+	}
+	return Q_OK(q);
+}
+
+
+int
+pfq_get_group_steering(pfq_t const *q, int gid, struct pfq_group_steering *st)
+{
+	socklen_t size = sizeof(struct pfq_group_steering);
+
+	st->gid = gid;
+
+	if (getsockopt(q->fd, PF_Q, Q_SO_GET_GROUP_STEERING, st, &size) == -1) {
+		return Q_ERROR(q, "PFQ: get group steering error");
+	}
+	return Q_OK(q);
+}
+
+
 int
 pfq_vlan_filters_enable(pfq_t *q, int gid, int toggle)
 {
@@ -905,6 +1104,8 @@ int pfq_vlan_reset_filter(pfq_t *q, int gid, int vid)
 }
 
 
+static void pfq_tx_fwd_wait_(pfq_t *q);
+
 int
 pfq_read(pfq_t *q, struct pfq_net_queue *nq, long int microseconds)
 {
@@ -917,6 +1118,11 @@ pfq_read(pfq_t *q, struct pfq_net_queue *nq, long int microseconds)
 
 	qd = (struct pfq_shared_queue *)(q->shm_addr);
 
+	/* the half about to be refilled by the kernel holds the packets forwarded */
+
+	if (q->tx_fwd_pending)
+		pfq_tx_fwd_wait_(q);
+
 	data = __atomic_load_n(&qd->rx.data, __ATOMIC_RELAXED);
 	index = Q_SHARED_QUEUE_INDEX(data);
 
@@ -1034,60 +1240,275 @@ pfq_unbind_tx(pfq_t *q)
 	return Q_OK(q);
 }
 
-int
-pfq_inject(pfq_t *q, const void *buf, size_t len, uint64_t nsec, int queue)
+/* the doorbell: wake up the kernel thread of the Tx queue, if parked
+ * (after publishing the packets, with a full barrier) */
+
+static inline void
+pfq_tx_doorbell_(pfq_t *q, struct pfq_tx_queue *tx, int tss)
+{
+	if (__atomic_load_n(&tx->parked, __ATOMIC_RELAXED))
+		pfq_tx_queue_flush(q, tss);
+}
+
+
+static int
+pfq_tx_reserve_(pfq_t *q, size_t len, int tss, struct pfq_tx_slot *slot)
 {
         struct pfq_shared_queue *sh_queue = (struct pfq_shared_queue *)(q->shm_addr);
-        struct pfq_tx_queue *tx;
+        struct pfq_tx_queue *tx = (struct pfq_tx_queue *)&sh_queue->tx[tss];
+        struct pfq_pkthdr_tx *hdr;
         unsigned int index;
-        size_t slot_size;
-        int tss;
         void *base_addr;
 
+	if (q->tx_ring)
+	{
+		/* streaming ring: a slot per packet, published by commit */
+
+		size_t nslots = 2 * q->tx_slots;
+		unsigned int head = __atomic_load_n(&tx->prod, __ATOMIC_RELAXED);
+
+		if (head - __atomic_load_n(&tx->done, __ATOMIC_ACQUIRE) >= nslots)
+			return Q_VALUE(q, -1);
+
+		hdr = (struct pfq_pkthdr_tx *)(q->tx_queue_addr + q->tx_queue_size * 2 * tss +
+					       (head % nslots) * q->tx_slot_size);
+
+		if (len > q->tx_slot_size - sizeof(struct pfq_pkthdr_tx))
+			len = q->tx_slot_size - sizeof(struct pfq_pkthdr_tx);
+	}
+	else
+	{
+		index = __atomic_load_n(&tx->cons, __ATOMIC_RELAXED);
+		if (index != __atomic_load_n(&tx->prod, __ATOMIC_RELAXED))
+		{
+			__atomic_store_n(&tx->prod, index, __ATOMIC_SEQ_CST);
+			pfq_tx_doorbell_(q, tx, tss);
+		}
+
+		base_addr = q->tx_queue_addr + q->tx_queue_size * (2 * tss + (index & 1));
+
+		if (index != tx->index) {
+
+			/* the half is reused once the kernel has released its packets (zero-copy) */
+
+			if ((int)(__atomic_load_n(&tx->done, __ATOMIC_ACQUIRE) - index + 2) < 0)
+				return Q_VALUE(q, -1);
+
+			tx->index = index;
+			tx->ptr = base_addr;
+		}
+
+		/* room for the packet and the terminating header */
+
+		if ((tx->ptr - base_addr + 2 * sizeof(struct pfq_pkthdr_tx) + ALIGN(len, 8)) >= q->tx_queue_size)
+			return Q_VALUE(q, -1);
+
+		hdr = (struct pfq_pkthdr_tx *)tx->ptr;
+	}
+
+	slot->data  = hdr + 1;
+	slot->len   = len;
+	slot->nsec  = 0;
+	slot->queue = tss;
+
+	return Q_OK(q);
+}
+
+
+int
+pfq_tx_reserve(pfq_t *q, size_t len, int queue, struct pfq_tx_slot *slot)
+{
 	if (q->shm_addr == NULL)
-		return Q_ERROR(q, "PFQ: inject: socket not enabled");
+		return Q_ERROR(q, "PFQ: Tx reserve: socket not enabled");
+
+	/* the packet is not known yet: any_queue is the first one */
+
+	return pfq_tx_reserve_(q, len, pfq_fold(queue == Q_ANY_QUEUE ? 0 : queue, q->tx_num_bind), slot);
+}
+
+
+static void
+pfq_tx_commit_(pfq_t *q, struct pfq_tx_slot const *slot, uint64_t len)
+{
+        struct pfq_shared_queue *sh_queue = (struct pfq_shared_queue *)(q->shm_addr);
+        struct pfq_tx_queue *tx = (struct pfq_tx_queue *)&sh_queue->tx[slot->queue];
+        struct pfq_pkthdr_tx *hdr = (struct pfq_pkthdr_tx *)slot->data - 1;
+
+	hdr->nsec = slot->nsec;
+
+	if (q->tx_ring) {
+		hdr->len = len;
+		__atomic_add_fetch(&tx->prod, 1, __ATOMIC_SEQ_CST);
+		pfq_tx_doorbell_(q, tx, slot->queue);
+		return;
+	}
+
+	/* terminate the queue first: the kernel stops at the first empty header */
+
+	tx->ptr = (char *)slot->data + ALIGN(slot->len, 8);
+	((struct pfq_pkthdr_tx *)tx->ptr)->len = 0;
+
+	hdr->len = len;
+}
+
+
+int
+pfq_tx_commit(pfq_t *q, struct pfq_tx_slot const *slot)
+{
+	pfq_tx_commit_(q, slot, slot->len);
+	return Q_VALUE(q, slot->len);
+}
+
+
+int
+pfq_forward(pfq_t *q, pfq_iterator_t it, int queue)
+{
+        struct pfq_shared_queue *sh_queue = (struct pfq_shared_queue *)(q->shm_addr);
+	const struct pfq_pkthdr *h = pfq_iterator_header(it);
+	struct pfq_tx_slot slot;
+	struct pfq_tx_fwd *fwd;
+	int tss;
+
+	if (q->shm_addr == NULL)
+		return Q_ERROR(q, "PFQ: forward: socket not enabled");
 
 	if (queue == Q_ANY_QUEUE) {
-		tss = pfq_fold(pfq_symmetric_hash(buf), q->tx_num_bind);
+		tss = pfq_fold(pfq_symmetric_hash(pfq_iterator_data(it)), q->tx_num_bind);
 	}
 	else {
 		tss = pfq_fold(queue,q->tx_num_bind);
 	}
 
-        tx = (struct pfq_tx_queue *)&sh_queue->tx[tss];
+	if (pfq_tx_reserve_(q, sizeof(struct pfq_tx_fwd), tss, &slot) < 0)
+		return Q_VALUE(q, -1);
+
+	/* the descriptor references the packet in the Rx queue */
+
+	fwd = (struct pfq_tx_fwd *)slot.data;
+	fwd->offset = pfq_iterator_data(it) - (const char *)q->rx_queue_addr;
+
+	pfq_tx_commit_(q, &slot, h->caplen | Q_TX_FWD);
+
+	/* the Rx slot is reused once the packet is released (see pfq_read) */
+
+	q->tx_fwd_mark[tss] = q->tx_ring ? sh_queue->tx[tss].prod : sh_queue->tx[tss].index;
+	q->tx_fwd_pending |= 1U << tss;
+
+	return Q_VALUE(q, h->caplen);
+}
+
+
+/* wait for the packets forwarded from the Rx queue to be released */
 
-	index = __atomic_load_n(&tx->cons, __ATOMIC_RELAXED);
-	if (index != __atomic_load_n(&tx->prod, __ATOMIC_RELAXED))
+static void
+pfq_tx_fwd_wait_(pfq_t *q)
+{
+        struct pfq_shared_queue *sh_queue = (struct pfq_shared_queue *)(q->shm_addr);
+	int n;
+
+	for(n = 0; n < Q_MAX_TX_QUEUES; n++)
 	{
-		__atomic_store_n(&tx->prod, index, __ATOMIC_RELAXED);
+		struct pfq_tx_queue *tx = &sh_queue->tx[n];
+
+		if (!(q->tx_fwd_pending & (1U << n)))
+			continue;
+
+		while ((int)(__atomic_load_n(&tx->done, __ATOMIC_ACQUIRE) - q->tx_fwd_mark[n]) < 0)
+		{
+			if (!q->tx_ring) {
+
+				/* hand the current half to the kernel thread */
+
+				unsigned int index = __atomic_load_n(&tx->cons, __ATOMIC_RELAXED);
+				if (index != __atomic_load_n(&tx->prod, __ATOMIC_RELAXED))
+					__atomic_store_n(&tx->prod, index, __ATOMIC_SEQ_CST);
+			}
+
+			if (q->tx_num_bind != q->tx_num_async)
+				pfq_tx_queue_flush(q, n);
+			else {
+				pfq_tx_doorbell_(q, tx, n);
+				sched_yield();
+			}
+		}
 	}
 
-	base_addr = q->tx_queue_addr + q->tx_queue_size * (2 * tss + (index & 1));
+	q->tx_fwd_pending = 0;
+}
+
+
+int
+pfq_inject(pfq_t *q, const void *buf, size_t len, uint64_t nsec, int queue)
+{
+	struct pfq_tx_slot slot;
+	int tss;
+
+	if (q->shm_addr == NULL)
+		return Q_ERROR(q, "PFQ: inject: socket not enabled");
 
-	if (index != tx->index) {
-		tx->index = index;
-		tx->ptr = base_addr;
+	if (queue == Q_ANY_QUEUE) {
+		tss = pfq_fold(pfq_symmetric_hash(buf), q->tx_num_bind);
+	}
+	else {
+		tss = pfq_fold(queue,q->tx_num_bind);
 	}
 
-	slot_size = sizeof(struct pfq_pkthdr_tx) + ALIGN(len, 8);
+	if (pfq_tx_reserve_(q, len, tss, &slot) < 0)
+		return Q_VALUE(q, -1);
 
-	if ((tx->ptr - base_addr + slot_size + sizeof(struct pfq_pkthdr_tx)) < q->tx_queue_size)
-	{
-		struct pfq_pkthdr_tx *hdr;
+	memcpy(slot.data, buf, slot.len);
+	slot.nsec = nsec;
 
-		hdr = (struct pfq_pkthdr_tx *)tx->ptr;
-		hdr->len = len;
-		hdr->nsec = nsec;
-		memcpy(hdr+1, buf, hdr->len);
+	return pfq_tx_commit(q, &slot);
+}
 
-		tx->ptr += slot_size;
-		hdr = (struct pfq_pkthdr_tx *)tx->ptr;
-		hdr->len = 0;
 
-		return Q_VALUE(q, len);
+int
+pfq_injectv(pfq_t *q, const struct iovec *iov, int iovcnt, uint64_t nsec, int queue)
+{
+	struct pfq_tx_slot slot;
+	size_t len = 0, off = 0;
+	int n, tss;
+
+	if (q->shm_addr == NULL)
+		return Q_ERROR(q, "PFQ: injectv: socket not enabled");
+
+	for(n = 0; n < iovcnt; n++)
+		len += iov[n].iov_len;
+
+	if (queue == Q_ANY_QUEUE) {
+
+		/* the headers may span more than one piece */
+
+		char head[128] = { 0 };
+		size_t hlen = 0;
+
+		for(n = 0; n < iovcnt && hlen < sizeof(head); n++)
+		{
+			size_t c = iov[n].iov_len < sizeof(head) - hlen ? iov[n].iov_len : sizeof(head) - hlen;
+			memcpy(head + hlen, iov[n].iov_base, c);
+			hlen += c;
+		}
+
+		tss = pfq_fold(pfq_symmetric_hash(head), q->tx_num_bind);
+	}
+	else {
+		tss = pfq_fold(queue,q->tx_num_bind);
+	}
+
+	if (pfq_tx_reserve_(q, len, tss, &slot) < 0)
+		return Q_VALUE(q, -1);
+
+	for(n = 0; n < iovcnt && off < slot.len; n++)
+	{
+		size_t c = iov[n].iov_len < slot.len - off ? iov[n].iov_len : slot.len - off;
+		memcpy((char *)slot.data + off, iov[n].iov_base, c);
+		off += c;
 	}
 
-	return Q_VALUE(q, -1);
+	slot.nsec = nsec;
+
+	return pfq_tx_commit(q, &slot);
 }
 
 
@@ -1111,6 +1532,138 @@ pfq_tx_async(pfq_t *q, int toggle)
 }
 
 
+int
+pfq_tx_zerocopy(pfq_t *q, int toggle)
+{
+        if (setsockopt(q->fd, PF_Q, Q_SO_TX_ZEROCOPY, &toggle, sizeof(toggle)) == -1)
+		return Q_ERROR(q, "PFQ: Tx zero-copy");
+
+        return Q_OK(q);
+}
+
+
+int
+pfq_tx_ring(pfq_t *q, int toggle)
+{
+        if (setsockopt(q->fd, PF_Q, Q_SO_TX_RING, &toggle, sizeof(toggle)) == -1)
+		return Q_ERROR(q, "PFQ: Tx ring");
+
+	q->tx_ring = toggle != 0;
+        return Q_OK(q);
+}
+
+
+int
+pfq_tx_replay_append(pfq_t *q, int queue, const void *buf, size_t len, uint64_t nsec)
+{
+	int tss = pfq_fold(queue, q->tx_num_bind);
+	struct pfq_pkthdr_tx *hdr;
+	size_t slot_size;
+	char *base_addr;
+
+	if (q->shm_addr == NULL)
+		return Q_ERROR(q, "PFQ: Tx replay: socket not enabled");
+
+	/* the trace takes the whole region of the queue (both halves) */
+
+	base_addr = (char *)q->tx_queue_addr + q->tx_queue_size * 2 * tss;
+	slot_size = sizeof(struct pfq_pkthdr_tx) + ALIGN(len, 8);
+
+	if (q->tx_replay_len[tss] + slot_size + sizeof(struct pfq_pkthdr_tx) > 2 * q->tx_queue_size)
+		return Q_VALUE(q, -1);
+
+	hdr = (struct pfq_pkthdr_tx *)(base_addr + q->tx_replay_len[tss]);
+	hdr->len = len;
+	hdr->nsec = nsec;
+	memcpy(hdr+1, buf, len);
+
+	q->tx_replay_len[tss] += slot_size;
+
+	hdr = (struct pfq_pkthdr_tx *)(base_addr + q->tx_replay_len[tss]);
+	hdr->len = 0;
+
+	return Q_VALUE(q, len);
+}
+
+
+int
+pfq_tx_replay(pfq_t *q, int queue, int loops, unsigned int speed, uint64_t gap, unsigned int flags)
+{
+	struct pfq_tx_replay opt = { pfq_fold(queue, q->tx_num_bind), loops, speed, flags, gap };
+
+        if (setsockopt(q->fd, PF_Q, Q_SO_TX_REPLAY, &opt, sizeof(opt)) == -1)
+		return Q_ERROR(q, "PFQ: Tx replay");
+
+        return Q_OK(q);
+}
+
+
+int
+pfq_tx_replay_stop(pfq_t *q, int queue)
+{
+	int tss = pfq_fold(queue, q->tx_num_bind);
+
+	if (pfq_tx_replay(q, queue, -1, 0, 0, 0) < 0)
+		return -1;
+
+	q->tx_replay_len[tss] = 0;
+        return Q_OK(q);
+}
+
+
+int
+pfq_tx_replay_loops(pfq_t *q, int queue)
+{
+        struct pfq_shared_queue *sh_queue = (struct pfq_shared_queue *)(q->shm_addr);
+
+	if (q->shm_addr == NULL)
+		return Q_ERROR(q, "PFQ: Tx replay: socket not enabled");
+
+	return Q_VALUE(q, (int)__atomic_load_n(&sh_queue->tx[pfq_fold(queue, q->tx_num_bind)].done, __ATOMIC_ACQUIRE));
+}
+
+
+int
+pfq_tx_template(pfq_t *q, struct pfq_tx_template const *tmpl)
+{
+	struct pfq_tx_template opt = *tmpl;
+
+	opt.queue = pfq_fold(tmpl->queue, q->tx_num_bind);
+
+        if (setsockopt(q->fd, PF_Q, Q_SO_TX_TEMPLATE, &opt, sizeof(opt)) == -1)
+		return Q_ERROR(q, "PFQ: Tx template");
+
+        return Q_OK(q);
+}
+
+
+int
+pfq_tx_template_stop(pfq_t *q, int queue)
+{
+	struct pfq_tx_template opt;
+
+	memset(&opt, 0, sizeof(opt));
+	opt.queue = pfq_fold(queue, q->tx_num_bind);
+
+        if (setsockopt(q->fd, PF_Q, Q_SO_TX_TEMPLATE, &opt, sizeof(opt)) == -1)
+		return Q_ERROR(q, "PFQ: Tx template stop");
+
+        return Q_OK(q);
+}
+
+
+unsigned int
+pfq_tx_template_sent(pfq_t *q, int queue)
+{
+        struct pfq_shared_queue *sh_queue = (struct pfq_shared_queue *)(q->shm_addr);
+
+	if (q->shm_addr == NULL)
+		return 0;
+
+	return __atomic_load_n(&sh_queue->tx[pfq_fold(queue, q->tx_num_bind)].done, __ATOMIC_ACQUIRE);
+}
+
+
 int
 pfq_send(pfq_t *q, const void *ptr, size_t len)
 {
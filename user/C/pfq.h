@@ -25,11 +25,14 @@
 #define PFQ_H
 
 #include <stddef.h>
+#include <sys/uio.h>
 
 #include <linux/pf_q.h>
+#include <linux/pf_q-hash.h>
 #include <linux/if_ether.h>
 #include <linux/ip.h>
 #include <linux/udp.h>
+#include <netinet/ip6.h>
 #include <arpa/inet.h>
 
 #ifdef _REENTRANT
@@ -57,6 +60,17 @@ struct pfq_net_queue
 };
 
 
+/*! pfq_tx_slot is a Tx slot reserved in the shared memory (see pfq_tx_reserve). */
+
+struct pfq_tx_slot
+{
+	void	      *data;		/* packet buffer */
+	size_t         len;		/* packet length (can be reduced before commit) */
+	uint64_t       nsec;		/* transmission timestamp (0 = immediate) */
+	int            queue;		/* Tx queue */
+};
+
+
 /*! Return an iterator to the first slot of a non-empty queue. */
 
 static inline
@@ -143,29 +157,46 @@ pfq_yield()
 typedef void (*pfq_handler_t)(char *user, const struct pfq_pkthdr *h, const char *data);
 
 
-/*! Symmetric hashx */
+/*! Symmetric hash of the given type (Q_HASH_XOR, Q_HASH_TOEPLITZ, Q_HASH_CRC32C...) */
+/*!
+ * The same hash computed by the steering functions (see linux/pf_q-hash.h).
+ */
 
 static inline
-unsigned int pfq_symmetric_hash(const char *buf)
+unsigned int pfq_symmetric_hash_type(const char *buf, int type)
 {
         const char *ptr = buf;
 
         struct ethhdr const *eh = (struct ethhdr const *)(ptr);
-        if (eh->h_proto != htons(0x800))
-            return 0;
 
         ptr += sizeof(struct ethhdr);
 
+        if (eh->h_proto == htons(ETH_P_IPV6)) {
+            struct ip6_hdr const *ih6 = (struct ip6_hdr const *)(ptr);
+            return pfq_sym_hash6(type, (uint32_t const *)&ih6->ip6_src, (uint32_t const *)&ih6->ip6_dst, 0, 0);
+        }
+
+        if (eh->h_proto != htons(ETH_P_IP))
+            return 0;
+
         struct iphdr const *ih = (struct iphdr const *)(ptr);
         if (ih->protocol != IPPROTO_TCP &&
             ih->protocol != IPPROTO_UDP)
-            return (ih->saddr ^ ih->daddr);
+            return pfq_sym_hash4(type, ih->saddr, ih->daddr, 0, 0);
 
-        ptr += sizeof(ih->ihl << 2);
+        ptr += ih->ihl << 2;
 
         struct udphdr const *uh = (struct udphdr const *)(ptr);
-        return (ih->saddr ^ ih->daddr ^ uh->source ^ uh->dest);
+        return pfq_sym_hash4(type, ih->saddr, ih->daddr, uh->source, uh->dest);
+}
+
 
+/*! Symmetric hash (default steering hash, crc32c) */
+
+static inline
+unsigned int pfq_symmetric_hash(const char *buf)
+{
+        return pfq_symmetric_hash_type(buf, Q_HASH_CRC32C);
 }
 
 
@@ -364,6 +395,20 @@ extern int pfq_set_tx_slots(pfq_t *q, size_t value);
 extern size_t pfq_get_tx_slots(pfq_t const *q);
 
 
+/*! Specify the number of Tx queues of the socket (default 4, up to Q_MAX_TX_QUEUES). */
+/*!
+ * Each Tx queue takes its share of the shared memory, hence the number
+ * must be specified before enabling the socket.
+ */
+
+extern int pfq_set_tx_queues(pfq_t *q, size_t value);
+
+
+/*! Return the number of Tx queues of the socket. */
+
+extern ssize_t pfq_get_tx_queues(pfq_t const *q);
+
+
 /*! Bind the main group of the socket to the given device/queue. */
 /*!
  * The first argument is the name of the device;
@@ -558,9 +603,110 @@ extern int pfq_get_group_stats(pfq_t const *q, int gid, struct pfq_stats *stats)
 extern int pfq_get_group_counters(pfq_t const *q, int gid, struct pfq_counters *cs);
 
 
+/*! Return the heavy hitters of the given group. */
+/*!
+ * The top-K keys accounted by the heavy_hitter function of the group computation,
+ * sorted by the estimated number of packets (per-cpu count-min sketches merged on read).
+ */
+
+extern int pfq_get_group_heavy_hitters(pfq_t const *q, int gid, struct pfq_heavy_hitters *hh);
+
+
+/*! Return the per-node counters of the computation of the given group. */
+/*!
+ * Calls, passed and dropped packets and cumulative cycles of each node
+ * (per-cpu counters merged on read). Counters are updated only when the
+ * lang_stats module parameter is enabled.
+ */
+
+extern int pfq_get_group_computation_stats(pfq_t const *q, int gid, struct pfq_computation_stats *cs);
+
+
+/*! Create the exact-match table n of the given group. */
+/*!
+ * The key type is either Q_TABLE_KEY_ADDR (IPv4 address, matched against
+ * source and destination) or Q_TABLE_KEY_FLOW (5-tuple, matched in both directions).
+ * Size is a hint on the number of entries: the table holds up to twice as many
+ * (size rounded up to a power of two, at least 1024), further insertions fail
+ * with ENOSPC. Tables are used by the in_table and steer_table functions and can
+ * be updated while the computation is running.
+ */
+
+extern int pfq_group_table_create(pfq_t *q, int gid, int n, int type, size_t size);
+
+
+/*! Destroy the exact-match table n of the given group. */
+
+extern int pfq_group_table_destroy(pfq_t *q, int gid, int n);
+
+
+/*! Insert (or update) entries into the table n of the given group. */
+/*!
+ * Addresses and ports are in network byte order; value is the steering hash
+ * used by steer_table.
+ */
+
+extern int pfq_group_table_insert(pfq_t *q, int gid, int n, struct pfq_table_entry const *entries, size_t size);
+
+
+/*! Remove entries from the table n of the given group. */
+
+extern int pfq_group_table_delete(pfq_t *q, int gid, int n, struct pfq_table_entry const *entries, size_t size);
+
+
+/*! Remove all the entries of the table n of the given group. */
+
+extern int pfq_group_table_flush(pfq_t *q, int gid, int n);
+
+
+/*! Load the bloom filter n of the given group, from a bit array built in user-space. */
+/*!
+ * The bit array is built with the helpers in <linux/pf_q-bloom.h>: size is in bytes
+ * and must be a multiple of 64. The running filter is replaced atomically.
+ * The filter is used by the in_bloom, in_bloom_src and in_bloom_dst functions.
+ */
+
+extern int pfq_group_bloom_load(pfq_t *q, int gid, int n, int ipv, int prefix, const void *bits, size_t size);
+
+
+/*! Build (m bins) and load the bloom filter n of the given group with a list of addresses. */
+/*!
+ * IPv4 addresses are in network byte order; IPv6 addresses take 4 words
+ * each, in host byte order (most significant word first).
+ */
+
+extern int pfq_group_bloom_load_addr(pfq_t *q, int gid, int n, int ipv, int prefix, size_t m, const uint32_t *addrs, size_t count);
+
+
+/*! Remove the bloom filter n of the given group. */
+
+extern int pfq_group_bloom_remove(pfq_t *q, int gid, int n);
+
+
+/*! Set the steering mode of the given group. */
+/*!
+ * With Q_STEER_SPRAY or Q_STEER_FLOWLET the group declares to tolerate reordering:
+ * flows above rate (Mbit/s) are spread across the sockets round-robin (per packet or
+ * per flowlet, that is when idle for more than flowlet usec), while the others
+ * keep the flow affinity. Zero selects the default rate/flowlet gap.
+ * Q_STEER_SPRAY reorders the packets of such flows; Q_STEER_FLOWLET moves a flow
+ * only between two bursts, so that its packets are not reordered.
+ * Q_STEER_FLOW (default) restores the strict flow affinity.
+ */
+
+extern int pfq_set_group_steering(pfq_t *q, int gid, int mode, unsigned int rate, unsigned int flowlet);
+
+
+/*! Return the steering mode of the given group, with the number of flows promoted to elephant. */
+
+extern int pfq_get_group_steering(pfq_t const *q, int gid, struct pfq_group_steering *st);
+
+
 /*! Flush the Tx queue(s). */
 /*!
- * Transmit the packets in the Tx queues of the socket.
+ * Transmit the packets in the Tx queues of the socket. For queues bound to
+ * a kernel thread, wake up the thread if parked (the doorbell rung by the
+ * send functions).
  */
 
 extern int pfq_tx_queue_flush(pfq_t *q, int queue);
@@ -574,6 +720,29 @@ extern int pfq_tx_queue_flush(pfq_t *q, int queue);
 extern int pfq_tx_async(pfq_t *q, int toggle);
 
 
+/*! Enable/Disable zero-copy transmission. */
+/*!
+ * Packets are transmitted from the shared memory without being copied
+ * (the socket must be enabled with hugepages, kernel threads stopped and no
+ * flush in progress, EBUSY otherwise).
+ * A Tx slot is reused once the driver has released the packets previously
+ * stored in it: until then pfq_inject fails as if the queue were full.
+ */
+
+extern int pfq_tx_zerocopy(pfq_t *q, int toggle);
+
+
+/*! Enable/Disable the streaming Tx ring. */
+/*!
+ * The Tx queues are used as rings of fixed-size slots: each packet injected
+ * is immediately visible to the kernel, which consumes the ring continuously
+ * instead of swapping the two halves of the queue (kernel threads stopped;
+ * to be enabled before zero-copy).
+ */
+
+extern int pfq_tx_ring(pfq_t *q, int toggle);
+
+
 /*! Schedule the packet for transmission. */
 /*!
  * The packet is copied into a Tx queue (using a TSS symmetric hash if any_queue is specified)
@@ -584,6 +753,101 @@ extern int pfq_tx_async(pfq_t *q, int toggle);
 extern int pfq_inject(pfq_t *q, const void *ptr, size_t len, uint64_t nsec, int queue);
 
 
+/*! Reserve a Tx slot for a packet of len bytes. */
+/*!
+ * The packet is built in place, in the shared memory, and scheduled for
+ * transmission by pfq_tx_commit. One slot per Tx queue can be reserved at a time.
+ * Q_ANY_QUEUE selects the first Tx queue (the packet is not known yet).
+ * The length of the slot can be less than len if the packet exceeds the max
+ * Tx length. Return -1 if the queue is full.
+ */
+
+extern int pfq_tx_reserve(pfq_t *q, size_t len, int queue, struct pfq_tx_slot *slot);
+
+
+/*! Schedule the packet built in a reserved Tx slot. */
+/*!
+ * slot->len bytes of slot->data are transmitted at slot->nsec.
+ */
+
+extern int pfq_tx_commit(pfq_t *q, struct pfq_tx_slot const *slot);
+
+
+/*! Schedule the packet gathered from an array of buffers. */
+/*!
+ * The pieces (e.g. headers and payload) are copied once, directly into the Tx queue.
+ * Same as pfq_inject otherwise.
+ */
+
+extern int pfq_injectv(pfq_t *q, const struct iovec *iov, int iovcnt, uint64_t nsec, int queue);
+
+
+/*! Schedule the transmission of a packet received, without copy. */
+/*!
+ * The packet (caplen bytes) is transmitted from the Rx queue by reference,
+ * as returned by pfq_read. Before swapping the Rx queue again, pfq_read waits
+ * for the packets forwarded to be released (with zero-copy, by the driver).
+ * Return -1 if the Tx queue is full.
+ */
+
+extern int pfq_forward(pfq_t *q, pfq_iterator_t it, int queue);
+
+
+/*! Append a packet to the trace of a Tx queue, for replay. */
+/*!
+ * The trace is stored in the whole Tx queue (both halves, in the shared memory);
+ * nsec is relative to the beginning of the trace. Return -1 if the queue is full.
+ * The queue is not to be used with pfq_inject while replaying.
+ */
+
+extern int pfq_tx_replay_append(pfq_t *q, int queue, const void *buf, size_t len, uint64_t nsec);
+
+
+/*! Replay the trace of a Tx queue. */
+/*!
+ * The trace is transmitted loops times (0 = forever) by the kernel thread of the
+ * queue (or by pfq_tx_queue_flush), with the original timing scaled by speed/1000,
+ * at a fixed inter-packet gap (nsec) or at line rate (speed = 0, gap = 0).
+ * Flags: Q_REPLAY_REWRITE_IP, Q_REPLAY_REWRITE_MAC (the loop number is added to
+ * the addresses). Kernel threads must be stopped.
+ */
+
+extern int pfq_tx_replay(pfq_t *q, int queue, int loops, unsigned int speed, uint64_t gap, unsigned int flags);
+
+
+/*! Stop the replay of a Tx queue and discard its trace. */
+
+extern int pfq_tx_replay_stop(pfq_t *q, int queue);
+
+
+/*! Return the number of loops of the trace completed. */
+
+extern int pfq_tx_replay_loops(pfq_t *q, int queue);
+
+
+/*! Start the in-kernel generator of a Tx queue. */
+/*!
+ * The kernel thread of the queue synthesizes tmpl->count packets (0 = forever) from
+ * the templates, picked in proportion to their weight (e.g. IMIX, each one capped at
+ * Q_TX_TEMPLATE_MAX_WEIGHT), applies the rules
+ * (counter or random range of IPv4 addresses and ports) and, with Q_TEMPLATE_CSUM,
+ * fixes up lengths and checksums. tmpl->gap sets the inter-packet gap (0 = line rate).
+ * The queue index is folded to the Tx queues bound. Kernel threads must be stopped.
+ */
+
+extern int pfq_tx_template(pfq_t *q, struct pfq_tx_template const *tmpl);
+
+
+/*! Stop the generator of a Tx queue and discard its templates. */
+
+extern int pfq_tx_template_stop(pfq_t *q, int queue);
+
+
+/*! Return the number of packets generated (modulo 2^32). */
+
+extern unsigned int pfq_tx_template_sent(pfq_t *q, int queue);
+
+
 /*! Store the packet and transmit the packets in the queue. */
 /*!
  * The queue is flushed (if required) and the transmission takes place.
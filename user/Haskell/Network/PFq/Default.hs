@@ -55,6 +55,11 @@ module Network.PFq.Default
         has_src_port,
         has_dst_port,
 
+        has_port_in,
+        has_src_port_in,
+        has_dst_port_in,
+        l4_proto_in,
+
         has_addr,
         has_src_addr,
         has_dst_addr,
@@ -63,6 +68,8 @@ module Network.PFq.Default
         has_vlan,
         has_vid,
         vlan_id,
+        vlan_in,
+        in_table,
 
         -- * Properties
 
@@ -110,6 +117,7 @@ module Network.PFq.Default
         conditional ,
         when'       ,
         unless'     ,
+        switch      ,
 
         -- * Filters
         -- | A collection of monadic NetFunctions.
@@ -137,6 +145,9 @@ module Network.PFq.Default
         port       ,
         src_port   ,
         dst_port   ,
+        port_in    ,
+        src_port_in,
+        dst_port_in,
 
         addr       ,
         src_addr   ,
@@ -151,10 +162,19 @@ module Network.PFq.Default
         steer_ip   ,
         steer_ip6  ,
         steer_flow ,
+        steer_flow_frag ,
         steer_rtp  ,
         steer_net  ,
+        steer_table,
         steer_field,
 
+        -- * Sampling functions
+        -- | Monadic functions that evaluate to /Pass SkBuff/ for a fraction of packets, /Drop/ otherwise.
+
+        sample     ,
+        sample_flow,
+        cutoff     ,
+
         -- * Forwarders
 
         kernel     ,
@@ -184,10 +204,40 @@ module Network.PFq.Default
         bloom_src_filter,
         bloom_dst_filter,
 
+        bloom6      ,
+        bloom6_src  ,
+        bloom6_dst  ,
+
+        bloom6_filter,
+        bloom6_src_filter,
+        bloom6_dst_filter,
+
+        in_bloom    ,
+        in_bloom_src,
+        in_bloom_dst,
+
         bloomCalcN  ,
         bloomCalcM  ,
         bloomCalcP  ,
 
+        -- * Longest-prefix match
+
+        in_prefixes     ,
+        in_src_prefixes ,
+        in_dst_prefixes ,
+        steer_prefixes  ,
+
+        in_prefixes6    ,
+        in_src_prefixes6,
+        in_dst_prefixes6,
+        steer_prefixes6 ,
+
+        -- * Payload matching
+
+        payload_match   ,
+        steer_payload   ,
+        payload_counter ,
+
         -- * Miscellaneous
 
         unit       ,
@@ -195,6 +245,12 @@ module Network.PFq.Default
         dec        ,
         mark       ,
 
+        heavy_hitter    ,
+        heavy_hitter_by ,
+        hh_key_src      ,
+        hh_key_dst      ,
+        hh_key_flow     ,
+
     ) where
 
 
@@ -205,6 +261,7 @@ import           Data.Word
 
 import           Network.Socket
 import           System.IO.Unsafe
+import           Control.Monad (forM)
 
 import           Foreign.C.Types
 import           Foreign.Storable.Tuple ()
@@ -321,6 +378,13 @@ is_more_frag = Predicate "is_more_frag" () () () () () () () ()
 has_vid :: CInt -> NetPredicate
 has_vid x = Predicate "has_vid" x () () () () () () ()
 
+-- | Evaluate to /True/ if the SkBuff matches an entry of the n-th exact-match table of the group.
+-- Tables are created and updated at run-time (see 'Network.PFq.groupTableCreate').
+--
+-- > when (in_table 0) kernel
+in_table :: CInt -> NetPredicate
+in_table n = Predicate "in_table" n () () () () () () ()
+
 -- | Evaluate to /True/ if the SkBuff has the given mark, set by 'mark' function.
 --
 -- > has_mark 11
@@ -355,6 +419,27 @@ has_src_port x = Predicate "has_src_port" x () () () () () () ()
 -- If the transport protocol is not present or has no port, the predicate evaluates to False.
 has_dst_port x = Predicate "has_dst_port" x () () () () () () ()
 
+has_port_in, has_src_port_in, has_dst_port_in :: [Word16] -> NetPredicate
+
+-- | Evaluate to /True/ if the SkBuff has the source or destination port in the given set.
+--
+-- The set is stored as a bitmap, the cost of the test does not depend on the number of ports.
+--
+-- > has_port_in [22, 53, 80, 443, 8080]
+has_port_in xs = Predicate "has_port_in" xs () () () () () () ()
+
+-- | Evaluate to /True/ if the SkBuff has the source port in the given set.
+has_src_port_in xs = Predicate "has_src_port_in" xs () () () () () () ()
+
+-- | Evaluate to /True/ if the SkBuff has the destination port in the given set.
+has_dst_port_in xs = Predicate "has_dst_port_in" xs () () () () () () ()
+
+-- | Evaluate to /True/ if the Layer4 protocol of the SkBuff (IPv4 or IPv6) is in the given set.
+--
+-- > l4_proto_in [6, 17, 132]
+l4_proto_in :: [Word8] -> NetPredicate
+l4_proto_in xs = Predicate "l4_proto_in" xs () () () () () () ()
+
 -- | Evaluate to /True/ if the source or destination IP address matches the given network address. I.e.,
 --
 -- > has_addr "192.168.0.0" 24
@@ -450,6 +535,13 @@ steer_ip6 = MFunction "steer_ip6" () () () () () () () () :: NetFunction
 -- > steer_flow >-> log_msg "Steering a flow"
 steer_flow = MFunction "steer_flow" () () () () () () () () :: NetFunction
 
+-- | Dispatch the packet across the sockets like 'steer_flow', keeping the
+-- fragments of an IPv4 datagram on the socket of the first fragment (per-cpu table),
+-- so that they can be reassembled locally.
+--
+-- > steer_flow_frag
+steer_flow_frag = MFunction "steer_flow_frag" () () () () () () () () :: NetFunction
+
 -- | Dispatch the packet across the sockets
 -- with a randomized algorithm that maintains the integrity of
 -- RTP/RTCP flows.
@@ -457,6 +549,14 @@ steer_flow = MFunction "steer_flow" () () () () () () () () :: NetFunction
 -- > steer_rtp
 steer_rtp = MFunction "steer_rtp" () () () () () () () () :: NetFunction
 
+-- | Dispatch the packet across the sockets
+-- with the value of the matching entry of the n-th exact-match table
+-- of the group. Packets not in the table are dropped.
+--
+-- > steer_table 0
+steer_table :: CInt -> NetFunction
+steer_table n = MFunction "steer_table" n () () () () () () ()
+
 -- | Dispatch the packet across the sockets
 -- with a randomized algorithm that maintains the integrity of
 -- sub networks.
@@ -473,6 +573,29 @@ steer_field :: CInt -- ^ offset from the beginning of the packet, in bytes
             -> NetFunction
 steer_field off size = MFunction "steer_field" off size () () () () () ()
 
+-- Sampling functions:
+
+-- | Evaluate to /Pass SkBuff/ one packet every /n/ (per CPU), /Drop/ otherwise.
+--
+-- > sample 100 >-> steer_flow
+sample :: CInt -> NetFunction
+sample n = MFunction "sample" n () () () () () () ()
+
+-- | Evaluate to /Pass SkBuff/ for one flow every /n/, /Drop/ otherwise.
+-- The decision is hash-based, so TCP/UDP flows are either entirely kept or dropped.
+--
+-- > sample_flow 8 >-> steer_flow
+sample_flow :: CInt -> NetFunction
+sample_flow n = MFunction "sample_flow" n () () () () () () ()
+
+-- | Evaluate to /Pass SkBuff/ until the flow has carried /n/ bytes, /Drop/ afterwards.
+-- TCP/UDP flows (both directions) are tracked in a per-CPU table of bounded size,
+-- with idle entries recycled after 30 seconds. Other packets are passed.
+--
+-- > cutoff 4096 >-> steer_flow
+cutoff :: CInt -> NetFunction
+cutoff n = MFunction "cutoff" n () () () () () () ()
+
 -- Predefined filters:
 
 -- | Transform the given predicate in its counterpart monadic version.
@@ -619,6 +742,25 @@ inc n = MFunction "inc" n () () () () () () ()
 dec :: CInt -> NetFunction
 dec n = MFunction "dec" n () () () () () () ()
 
+-- | Keys of the heavy-hitter sketch: IPv4 source, IPv4 destination and IPv4 5-tuple.
+hh_key_src, hh_key_dst, hh_key_flow :: CInt
+hh_key_src  = 0
+hh_key_dst  = 1
+hh_key_flow = 2
+
+-- | Account the packet in the heavy-hitter sketch of the current group
+-- (per-cpu count-min sketch with top-K). The heavy hitters are read with 'getGroupHeavyHitters'.
+--
+-- > ip >-> heavy_hitter hh_key_src
+heavy_hitter :: CInt -> NetFunction
+heavy_hitter k = MFunction "heavy_hitter" k () () () () () () ()
+
+-- | Account the packet in the heavy-hitter sketch of the current group, using the given property as key.
+--
+-- > heavy_hitter_by tcp_dest
+heavy_hitter_by :: NetProperty -> NetFunction
+heavy_hitter_by p = MFunction "heavy_hitter_by" p () () () () () () ()
+
 -- | Mark the packet with the given value.
 --
 -- > mark 42
@@ -660,6 +802,20 @@ src_port p = MFunction "src_port" p () () () () () () ()
 dst_port :: Int16 -> NetFunction
 dst_port a = MFunction "dst_port" a () () () () () () ()
 
+-- | Monadic version of 'has_port_in' predicate.
+--
+-- > port_in [80, 443, 8080] >-> steer_flow
+port_in :: [Word16] -> NetFunction
+port_in xs = MFunction "port_in" xs () () () () () () ()
+
+-- | Monadic version of 'has_src_port_in' predicate.
+src_port_in :: [Word16] -> NetFunction
+src_port_in xs = MFunction "src_port_in" xs () () () () () () ()
+
+-- | Monadic version of 'has_dst_port_in' predicate.
+dst_port_in :: [Word16] -> NetFunction
+dst_port_in xs = MFunction "dst_port_in" xs () () () () () () ()
+
 -- | Monadic version of 'has_addr' predicate.
 --
 -- predicates are used in conditional expressions, while monadic functions
@@ -701,6 +857,18 @@ unless' p c = MFunction "unless" p c () () () () () ()
 conditional :: NetPredicate -> NetFunction -> NetFunction -> NetFunction
 conditional p c1 c2 = MFunction "conditional" p c1 c2 () () () () ()
 
+-- | Multi-way conditional execution of monadic netfunctions.
+--
+-- The property is evaluated once and the function associated with its value is
+-- selected by means of a jump table; the last argument is evaluated when no key matches.
+-- The cost does not depend on the number of cases. Example:
+--
+-- > switch tcp_dest [22, 80, 443] [kernel, steer_flow, forward "eth1"] drop'
+switch :: NetProperty -> [Word64] -> [NetFunction] -> NetFunction -> NetFunction
+switch p ks fs d
+    | length ks /= length fs = error "switch: the number of keys and functions differ"
+    | otherwise              = MFunction "switch" p ks fs d () () () ()
+
 -- | Function that inverts a monadic NetFunction. Useful to invert filters:
 --
 -- > inv ip >-> log_msg "This is not an IPv4 Packet"
@@ -726,6 +894,10 @@ vlan_id ids = Predicate "vlan_id" ids () () () () () () ()
 vlan_id_filter :: [CInt] -> NetFunction
 vlan_id_filter ids = MFunction "vlan_id_filter" ids () () () () () () ()
 
+-- | Evaluate to /True/ if the vlan id of the packet is in the given set (-1 means any vlan).
+vlan_in :: [CInt] -> NetPredicate
+vlan_in ids = Predicate "vlan_in" ids () () () () () () ()
+
 -- | Predicate that evaluates to /True/ when the source or the destination address
 -- of the packet matches the ones specified by the bloom list.
 --
@@ -768,6 +940,56 @@ bloom_filter m hs p     = let ips = unsafePerformIO (mapM inet_addr hs) in MFunc
 bloom_src_filter m hs p = let ips = unsafePerformIO (mapM inet_addr hs) in MFunction "bloom_src_filter" m ips p () () () () ()
 bloom_dst_filter m hs p = let ips = unsafePerformIO (mapM inet_addr hs) in MFunction "bloom_dst_filter" m ips p () () () () ()
 
+-- | IPv6 counterpart of 'bloom'.
+--
+-- > when' (bloom6 1024 ["2001:db8::1", "fe80::1"] 128) log_packet >-> kernel
+{-# NOINLINE bloom6 #-}
+bloom6 :: CInt -> [HostName] -> CInt -> NetPredicate
+
+-- | IPv6 counterpart of 'bloom_src'.
+{-# NOINLINE bloom6_src #-}
+bloom6_src :: CInt -> [HostName] -> CInt -> NetPredicate
+
+-- | IPv6 counterpart of 'bloom_dst'.
+{-# NOINLINE bloom6_dst #-}
+bloom6_dst :: CInt -> [HostName] -> CInt -> NetPredicate
+
+-- | IPv6 counterpart of 'bloom_filter'.
+{-# NOINLINE bloom6_filter #-}
+bloom6_filter :: CInt -> [HostName] -> CInt -> NetFunction
+
+-- | IPv6 counterpart of 'bloom_src_filter'.
+{-# NOINLINE bloom6_src_filter #-}
+bloom6_src_filter :: CInt -> [HostName] -> CInt -> NetFunction
+
+-- | IPv6 counterpart of 'bloom_dst_filter'.
+{-# NOINLINE bloom6_dst_filter #-}
+bloom6_dst_filter :: CInt -> [HostName] -> CInt -> NetFunction
+
+bloom6 m hs p     = let ips = unsafePerformIO (concat `fmap` mapM inet6Words hs) in Predicate "bloom6" m ips p () () () () ()
+bloom6_src m hs p = let ips = unsafePerformIO (concat `fmap` mapM inet6Words hs) in Predicate "bloom6_src" m ips p () () () () ()
+bloom6_dst m hs p = let ips = unsafePerformIO (concat `fmap` mapM inet6Words hs) in Predicate "bloom6_dst" m ips p () () () () ()
+
+bloom6_filter m hs p     = let ips = unsafePerformIO (concat `fmap` mapM inet6Words hs) in MFunction "bloom6_filter" m ips p () () () () ()
+bloom6_src_filter m hs p = let ips = unsafePerformIO (concat `fmap` mapM inet6Words hs) in MFunction "bloom6_src_filter" m ips p () () () () ()
+bloom6_dst_filter m hs p = let ips = unsafePerformIO (concat `fmap` mapM inet6Words hs) in MFunction "bloom6_dst_filter" m ips p () () () () ()
+
+-- | Predicate that evaluates to /True/ when the source or the destination address
+-- of the packet matches the n-th bloom filter of the group. The filter is built in user-space
+-- and loaded with 'Network.PFq.groupBloomLoad': it can be replaced while the computation is running.
+--
+-- > when' (in_bloom 0) kernel
+in_bloom :: CInt -> NetPredicate
+in_bloom n = Predicate "in_bloom" n () () () () () () ()
+
+-- | Similarly to 'in_bloom', evaluates to /True/ when the source address matches.
+in_bloom_src :: CInt -> NetPredicate
+in_bloom_src n = Predicate "in_bloom_src" n () () () () () () ()
+
+-- | Similarly to 'in_bloom', evaluates to /True/ when the destination address matches.
+in_bloom_dst :: CInt -> NetPredicate
+in_bloom_dst n = Predicate "in_bloom_dst" n () () () () () () ()
+
 -- bloom filter, utility functions:
 
 bloomK = 4
@@ -786,3 +1008,104 @@ bloomCalcN m p = ceiling $ fromIntegral (-m) * log(1 - p ** (1 / fromIntegral bl
 bloomCalcP :: Int -> Int -> Double
 bloomCalcP n m = (1 - (1 - 1 / fromIntegral m) ** fromIntegral (n * bloomK))^bloomK
 
+
+-- | Predicate that evaluates to /True/ when the source or the destination address
+-- of the packet belongs to one of the given networks.
+--
+-- Networks are matched with a multibit trie built when the computation is loaded:
+-- the cost of a lookup does not depend on the number of prefixes. Example:
+--
+-- > when' (in_prefixes ["10.0.0.0/8", "192.168.1.0/24"]) kernel
+{-# NOINLINE in_prefixes #-}
+in_prefixes :: [String] -> NetPredicate
+
+-- | Similarly to 'in_prefixes', evaluates to /True/ when the source address belongs to the networks.
+{-# NOINLINE in_src_prefixes #-}
+in_src_prefixes :: [String] -> NetPredicate
+
+-- | Similarly to 'in_prefixes', evaluates to /True/ when the destination address belongs to the networks.
+{-# NOINLINE in_dst_prefixes #-}
+in_dst_prefixes :: [String] -> NetPredicate
+
+-- | Dispatch the packet across the sockets by the longest matching prefix
+-- (of either address), so that all the packets of a network reach the same socket.
+-- Packets that do not match are dropped.
+--
+-- > steer_prefixes ["10.0.0.0/8", "10.1.0.0/16", "172.16.0.0/12"]
+{-# NOINLINE steer_prefixes #-}
+steer_prefixes :: [String] -> NetFunction
+
+-- | IPv6 counterpart of 'in_prefixes'.
+--
+-- > in_prefixes6 ["2001:db8::/32"]
+{-# NOINLINE in_prefixes6 #-}
+in_prefixes6 :: [String] -> NetPredicate
+
+-- | IPv6 counterpart of 'in_src_prefixes'.
+{-# NOINLINE in_src_prefixes6 #-}
+in_src_prefixes6 :: [String] -> NetPredicate
+
+-- | IPv6 counterpart of 'in_dst_prefixes'.
+{-# NOINLINE in_dst_prefixes6 #-}
+in_dst_prefixes6 :: [String] -> NetPredicate
+
+-- | IPv6 counterpart of 'steer_prefixes'.
+{-# NOINLINE steer_prefixes6 #-}
+steer_prefixes6 :: [String] -> NetFunction
+
+in_prefixes ns      = let (as, ls) = unsafePerformIO (inetPrefixes AF_INET ns)  in Predicate "in_prefixes" as ls () () () () () ()
+in_src_prefixes ns  = let (as, ls) = unsafePerformIO (inetPrefixes AF_INET ns)  in Predicate "in_src_prefixes" as ls () () () () () ()
+in_dst_prefixes ns  = let (as, ls) = unsafePerformIO (inetPrefixes AF_INET ns)  in Predicate "in_dst_prefixes" as ls () () () () () ()
+steer_prefixes ns   = let (as, ls) = unsafePerformIO (inetPrefixes AF_INET ns)  in MFunction "steer_prefixes" as ls () () () () () ()
+
+in_prefixes6 ns     = let (as, ls) = unsafePerformIO (inetPrefixes AF_INET6 ns) in Predicate "in_prefixes6" as ls () () () () () ()
+in_src_prefixes6 ns = let (as, ls) = unsafePerformIO (inetPrefixes AF_INET6 ns) in Predicate "in_src_prefixes6" as ls () () () () () ()
+in_dst_prefixes6 ns = let (as, ls) = unsafePerformIO (inetPrefixes AF_INET6 ns) in Predicate "in_dst_prefixes6" as ls () () () () () ()
+steer_prefixes6 ns  = let (as, ls) = unsafePerformIO (inetPrefixes AF_INET6 ns) in MFunction "steer_prefixes6" as ls () () () () () ()
+
+
+-- | Evaluate to /True/ when the L4 payload of the packet contains one of the given patterns.
+-- Patterns are compiled into a single automaton when the computation is loaded.
+--
+-- > when (payload_match ["GET ", "POST "]) steer_flow
+payload_match :: [String] -> NetPredicate
+payload_match xs = Predicate "payload_match" xs () () () () () () ()
+
+-- | Dispatch the packet across the sockets by the index of the first pattern found
+-- in the L4 payload. Packets that do not match are dropped.
+--
+-- > steer_payload ["BitTorrent", "SSH-"]
+steer_payload :: [String] -> NetFunction
+steer_payload xs = MFunction "steer_payload" xs () () () () () () ()
+
+-- | Count the packets by pattern: the group counter /n+i/ is incremented when the
+-- /i/-th pattern is the first one found. Packets that do not match are dropped.
+--
+-- > payload_counter 4 ["GET ", "POST "] >-> kernel
+payload_counter :: CInt -> [String] -> NetFunction
+payload_counter n xs = MFunction "payload_counter" n xs () () () () () ()
+
+
+-- longest-prefix match, utility function:
+-- IPv4 addresses are in network byte order, IPv6 ones are 4 words in host byte order (MSW first).
+
+inetPrefixes :: Family -> [String] -> IO ([Word32], [CInt])
+inetPrefixes fam ns = do
+    xs <- forM ns $ \n -> do
+        let (addr, len) = break (== '/') n
+            bits = if fam == AF_INET then 32 else 128
+            plen = if null len then bits else read (tail len)
+        ws <- if fam == AF_INET
+                then fmap (:[]) (inet_addr addr)
+                else inet6Words addr
+        return (ws, plen)
+    return (concatMap fst xs, map snd xs)
+
+
+inet6Words :: HostName -> IO [Word32]
+inet6Words addr = do
+    ai <- getAddrInfo (Just defaultHints { addrFlags = [AI_NUMERICHOST], addrFamily = AF_INET6 }) (Just addr) Nothing
+    case map addrAddress ai of
+        (SockAddrInet6 _ _ (a,b,c,d) _ : _) -> return [a,b,c,d]
+        _ -> ioError (userError $ "inet6Words: " ++ addr)
+
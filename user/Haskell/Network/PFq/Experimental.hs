@@ -57,7 +57,20 @@ module Network.PFq.Experimental
         gtp_up,
         is_gtp,
         is_gtp_cp,
-        is_gtp_up
+        is_gtp_up,
+
+        is_tunnel,
+        is_vxlan,
+        is_gre,
+        is_mpls,
+        is_qinq,
+        tunnel,
+        vxlan,
+        gre,
+        mpls,
+        qinq,
+        steer_inner,
+        steer_tunnel_id
 
     ) where
 
@@ -141,4 +154,43 @@ is_gtp_cp = Predicate "is_gtp_cp" () () () () () () () () :: NetPredicate
 -- | Evaluate to /True/ if the SkBuff is a GTP User-Plane packet.
 is_gtp_up = Predicate "is_gtp_up" () () () () () () () () :: NetPredicate
 
+-- | Evaluate to /True/ if the SkBuff is encapsulated (GTP, VXLAN, GRE or MPLS).
+-- The packet is decapsulated once: the parsed headers are shared by all the tunnel functions.
+is_tunnel = Predicate "is_tunnel" () () () () () () () () :: NetPredicate
 
+-- | Evaluate to /True/ if the SkBuff is a VXLAN packet.
+is_vxlan = Predicate "is_vxlan" () () () () () () () () :: NetPredicate
+
+-- | Evaluate to /True/ if the SkBuff is a GRE packet.
+is_gre = Predicate "is_gre" () () () () () () () () :: NetPredicate
+
+-- | Evaluate to /True/ if the SkBuff is a MPLS packet.
+is_mpls = Predicate "is_mpls" () () () () () () () () :: NetPredicate
+
+-- | Evaluate to /True/ if the SkBuff has stacked VLAN tags (QinQ).
+is_qinq = Predicate "is_qinq" () () () () () () () () :: NetPredicate
+
+-- | Evaluate to /Pass SkBuff/ in case of encapsulated packet (GTP, VXLAN, GRE or MPLS), /Drop/ it otherwise.
+tunnel  = MFunction "tunnel" () () () () () () () () :: NetFunction
+
+-- | Evaluate to /Pass SkBuff/ in case of VXLAN packet, /Drop/ it otherwise.
+vxlan   = MFunction "vxlan" () () () () () () () () :: NetFunction
+
+-- | Evaluate to /Pass SkBuff/ in case of GRE packet, /Drop/ it otherwise.
+gre     = MFunction "gre" () () () () () () () () :: NetFunction
+
+-- | Evaluate to /Pass SkBuff/ in case of MPLS packet, /Drop/ it otherwise.
+mpls    = MFunction "mpls" () () () () () () () () :: NetFunction
+
+-- | Evaluate to /Pass SkBuff/ in case of stacked VLAN tags (QinQ), /Drop/ it otherwise.
+qinq    = MFunction "qinq" () () () () () () () () :: NetFunction
+
+-- | Dispatch the packet across the sockets on the innermost 5-tuple:
+-- GTP-U, VXLAN, GRE, MPLS and stacked VLANs are decapsulated.
+--
+-- > steer_inner
+steer_inner = MFunction "steer_inner" () () () () () () () () :: NetFunction
+
+-- | Dispatch the packet across the sockets on the tunnel identifier
+-- (GTP TEID, VXLAN VNI, GRE key or MPLS label).
+steer_tunnel_id = MFunction "steer_tunnel_id" () () () () () () () () :: NetFunction
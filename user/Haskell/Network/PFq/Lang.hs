@@ -127,11 +127,13 @@ data Argument = forall a. (Show a, Storable a) => ArgData a     |
                 ArgString String                                |
                 ArgSVector [String]                             |
                 ArgFunPtr Int                                   |
+                ArgFunPtrs [Int]                                |
                 ArgNull
 
 instance Show Argument where
     show (ArgNull)       = "()"
     show (ArgFunPtr n)   = show (FunPtr n)
+    show (ArgFunPtrs ns) = show (map FunPtr ns)
     show (ArgString xs)  = xs
     show (ArgData x)     = show x
     show (ArgVector xs)  = show xs
@@ -143,6 +145,11 @@ instance Show Argument where
 class (Show a, Pretty a) => Argumentable a where
     argument :: a -> Argument
 
+    -- | Build the argument, given the serialized form of the argument itself.
+    argumentOf :: a -> [FunctionDescr] -> Argument
+    argumentOf x [] = argument x
+    argumentOf _ xs = argument (FunPtr (functionIndex (head xs)))
+
 instance Argumentable String where
     argument = ArgString
 
@@ -161,10 +168,16 @@ instance Argumentable FunPtr where
 instance Argumentable () where
     argument () = ArgNull
 
+-- a list of functions is passed by the indexes of their entry points.
+
+instance Argumentable [NetFunction] where
+    argument _ = ArgFunPtrs []
+    argumentOf _ [] = ArgFunPtrs []
+    argumentOf fs (x:_) = ArgFunPtrs $ init $ scanl (\n f -> snd (serialize f n)) (functionIndex x) fs
+
 
 mkArgument :: (Argumentable a) => a -> [FunctionDescr] -> Argument
-mkArgument x [] = argument x
-mkArgument _ xs = argument (FunPtr (functionIndex (head xs)))
+mkArgument = argumentOf
 
 
 -- | Function descriptor.
@@ -404,6 +417,10 @@ instance Serializable NetProperty where
     serialize _ _ = undefined
 
 
+instance Serializable [NetFunction] where
+    serialize fs n = foldl (\(xs, i) f -> let (s, i') = serialize f i in (xs ++ fixComputation i s, i')) ([], n) fs
+
+
 instance Serializable a where
     serialize _ n = ([], n)
 
@@ -2,18 +2,149 @@
 #include <string>
 #include <stdexcept>
 #include <chrono>
+#include <random>
+#include <vector>
+#include <cstring>
 
 #include <pfq/pfq.hpp>
+#include <pfq/bloom.hpp>
 #include <pfq/lang/lang.hpp>
 #include <pfq/lang/default.hpp>
 
 using namespace pfq::lang;
 
+
+//
+// classic (unblocked) bloom filter with the same memory and k, for comparison
+//
+
+struct classic_bloom
+{
+    classic_bloom(size_t m)
+    : mask(m-1), bits((m+63)/64, 0)
+    {}
+
+    void insert(uint32_t addr)
+    {
+        uint64_t h = pfq_bloom_hash4(addr);
+        for(int i = 0; i < Q_BLOOM_K; i++) {
+            auto x = (h + i * pfq_bloom_mix(h)) & mask;
+            bits[x >> 6] |= 1ULL << (x & 63);
+        }
+    }
+
+    bool test(uint32_t addr) const
+    {
+        uint64_t h = pfq_bloom_hash4(addr);
+        for(int i = 0; i < Q_BLOOM_K; i++) {
+            auto x = (h + i * pfq_bloom_mix(h)) & mask;
+            if (!(bits[x >> 6] & (1ULL << (x & 63))))
+                return false;
+        }
+        return true;
+    }
+
+    uint64_t mask;
+    std::vector<uint64_t> bits;
+};
+
+
+template <typename Fun>
+void run(const char *name, size_t lookups, Fun fun)
+{
+    auto begin = std::chrono::system_clock::now();
+    size_t pos = fun();
+    auto end = std::chrono::system_clock::now();
+
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+
+    printf("%-10s false positives: %.5f%%, %.1f Mlookups/sec\n", name,
+           100.0 * pos / lookups, static_cast<double>(lookups) / std::max<double>(us, 1));
+}
+
+
+int
+bench(size_t n, size_t m)
+{
+    const size_t lookups = 10000000;
+
+    std::mt19937 gen(42);
+
+    // inserted keys and probes are disjoint (msb), every positive is false
+    //
+
+    std::vector<uint32_t> set(n), probe(lookups);
+    for(auto &a : set)
+        a = gen() & 0x7fffffff;
+    for(auto &a : probe)
+        a = gen() | 0x80000000;
+
+    m = 1UL << (64 - __builtin_clzl(m - 1));
+
+    pfq::bloom_filter blocked(4, 32, m);
+    classic_bloom classic(m);
+
+    for(auto a : set) {
+        blocked.insert(a);
+        classic.insert(a);
+    }
+
+    printf("bloom filter: n = %zu, m = %zu bits (%zu bytes), k = %d, expected (classic) p = %.5f%%\n",
+           n, m, m/8, Q_BLOOM_K, 100.0 * bloom_calc_p(n, m));
+
+    run("classic", lookups, [&] {
+        size_t pos = 0;
+        for(auto a : probe)
+            pos += classic.test(a);
+        return pos;
+    });
+
+    run("blocked", lookups, [&] {
+        size_t pos = 0;
+        for(auto a : probe)
+            pos += blocked.contains(a);
+        return pos;
+    });
+
+    // IPv6
+    //
+
+    pfq::bloom_filter blocked6(6, 128, m);
+
+    std::vector<uint32_t> set6(n * 4), probe6(lookups * 4);
+    for(auto &w : set6)
+        w = gen();
+    for(auto &w : probe6)
+        w = gen();
+
+    for(size_t i = 0; i < n; i++)
+        set6[i*4] &= 0x7fffffff;
+    for(size_t i = 0; i < lookups; i++)
+        probe6[i*4] |= 0x80000000;
+
+    for(size_t i = 0; i < n; i++)
+        blocked6.insert6(&set6[i*4]);
+
+    run("blocked6", lookups, [&] {
+        size_t pos = 0;
+        for(size_t i = 0; i < lookups; i++)
+            pos += blocked6.contains6(&probe6[i*4]);
+        return pos;
+    });
+
+    return 0;
+}
+
+
 int
 main(int argc, char *argv[])
 {
     if (argc < 2)
-        throw std::runtime_error(std::string("usage: ").append(argv[0]).append(" dev"));
+        throw std::runtime_error(std::string("usage: ").append(argv[0]).append(" dev | --bench [n] [m]"));
+
+    if (strcmp(argv[1], "--bench") == 0)
+        return bench(argc > 2 ? std::stoul(argv[2]) : 1000000,
+                     argc > 3 ? std::stoul(argv[3]) : 1UL << 25);
 
     pfq::socket q(128);
 
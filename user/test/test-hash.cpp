@@ -0,0 +1,164 @@
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include <random>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+
+#include <x86intrin.h>
+#include <arpa/inet.h>
+
+#include <linux/pf_q-hash.h>
+
+
+//
+// benchmark of the symmetric steering hashes (see linux/pf_q-hash.h):
+// cycles per hash, symmetry and load distribution over the sockets of a group.
+//
+
+struct flow
+{
+    uint32_t saddr;
+    uint32_t daddr;
+    uint16_t sport;
+    uint16_t dport;
+};
+
+
+// the folding performed by pfq_receive on the steering hash
+//
+
+static unsigned int
+clp2(unsigned int x)
+{
+    x = x - 1;
+    x = x | (x >> 1);
+    x = x | (x >> 2);
+    x = x | (x >> 4);
+    x = x | (x >> 8);
+    x = x | (x >> 16);
+    return x + 1;
+}
+
+static unsigned int
+pfq_fold(unsigned int a, unsigned int b)
+{
+    if (b == 1)
+        return 0;
+    unsigned int c = b - 1;
+    if ((b & c) == 0)
+        return a & c;
+    const unsigned int p = clp2(b);
+    const unsigned int r = a & (p-1);
+    return r < b ? r : a % b;
+}
+
+static unsigned int
+select_socket(uint32_t h, unsigned int n)
+{
+    return pfq_fold(h ^ (h >> 8) ^ (h >> 16), n);
+}
+
+
+std::vector<flow>
+random_flows(size_t n, std::mt19937 &gen)
+{
+    std::vector<flow> ret(n);
+    for(auto &f : ret)
+    {
+        f.saddr = gen();
+        f.daddr = gen();
+        f.sport = static_cast<uint16_t>(gen());
+        f.dport = static_cast<uint16_t>(gen());
+    }
+    return ret;
+}
+
+
+// NAT-like traffic: a few address pairs, many ports toward a handful of services
+//
+
+std::vector<flow>
+nat_flows(size_t n, std::mt19937 &gen)
+{
+    const uint32_t pub[] = { htonl(0x5db8d822), htonl(0x5db8d823) };
+    const uint32_t srv[] = { htonl(0x08080808), htonl(0xac10fe01), htonl(0xc0a80101) };
+    const uint16_t svc[] = { htons(80), htons(443), htons(53) };
+
+    std::vector<flow> ret(n);
+    for(auto &f : ret)
+    {
+        f.saddr = pub[gen() % 2];
+        f.daddr = srv[gen() % 3];
+        f.sport = htons(static_cast<uint16_t>(1024 + gen() % 64512));
+        f.dport = svc[gen() % 3];
+    }
+    return ret;
+}
+
+
+void
+run(const char *name, std::vector<flow> const &flows)
+{
+    const char *hname[] = { "xor", "toeplitz", "crc32c" };
+    const unsigned int sockets[] = { 3, 8, 12, 16 };
+
+    std::cout << "--- " << name << " (" << flows.size() << " flows)" << std::endl;
+
+    for(int type = Q_HASH_XOR; type <= Q_HASH_CRC32C; type++)
+    {
+        uint32_t sink = 0;
+
+        auto t0 = __rdtsc();
+        for(auto const &f : flows)
+            sink += pfq_sym_hash4(type, f.saddr, f.daddr, f.sport, f.dport);
+        auto t1 = __rdtsc();
+
+        size_t asym = 0;
+        for(auto const &f : flows)
+        {
+            if (pfq_sym_hash4(type, f.saddr, f.daddr, f.sport, f.dport) !=
+                pfq_sym_hash4(type, f.daddr, f.saddr, f.dport, f.sport))
+                asym++;
+        }
+
+        std::cout << "    " << hname[type] << ": " << static_cast<double>(t1 - t0)/flows.size()
+                  << " cycles/hash, asymmetric: " << asym << " (" << (sink & 1) << ")" << std::endl;
+
+        for(auto n : sockets)
+        {
+            std::vector<size_t> load(n, 0);
+            for(auto const &f : flows)
+                load[select_socket(pfq_sym_hash4(type, f.saddr, f.daddr, f.sport, f.dport), n)]++;
+
+            const double avg = static_cast<double>(flows.size())/n;
+            double chi2 = 0; size_t max = 0;
+            for(auto l : load)
+            {
+                chi2 += (l - avg) * (l - avg) / avg;
+                max = std::max(max, l);
+            }
+
+            std::cout << "        " << n << " sockets: max/avg = " << max/avg
+                      << ", chi2 = " << chi2 << " (dof " << n-1 << ")" << std::endl;
+        }
+    }
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    size_t n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    std::mt19937 gen(42);
+
+    std::cout << "crc32c: " << (pfq_crc32c_hw_available() ? "sse4.2" : "software") << std::endl;
+
+    run("random", random_flows(n, gen));
+    run("nat", nat_flows(n, gen));
+
+    return 0;
+}
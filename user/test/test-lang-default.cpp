@@ -37,6 +37,22 @@ main()
     check_computation(q, when   (has_vid(1), ip >> steer_ip) );
     check_computation(q, unless (is_ip, ip >> steer_ip) );
     check_computation(q, conditional (is_ip, steer_ip, drop  ) );
+    check_computation(q, switch_ (tcp_dest, {22, 80, 443}, functions (kernel, steer_flow, ip >> steer_ip), drop) );
+    check_computation(q, when (has_port_in({22, 53, 80, 443, 8080}) & l4_proto_in({IPPROTO_TCP, IPPROTO_UDP}), steer_flow) );
+    check_computation(q, dst_port_in({80, 443}) >> when (vlan_in({-1}), kernel) );
+    check_computation(q, ip >> heavy_hitter (Q_HH_KEY_FLOW) );
+    check_computation(q, heavy_hitter_by (ip_ttl) );
+    check_computation(q, sample (100) >> steer_flow );
+    check_computation(q, sample_flow (8) >> steer_flow );
+    check_computation(q, cutoff (4096) >> steer_flow );
+    check_computation(q, ip >> steer_flow_frag );
+    check_computation(q, when (in_table(0), steer_table(0)) );
+    check_computation(q, when (in_prefixes({"10.0.0.0/8", "192.168.1.0/24"}), steer_prefixes({"10.0.0.0/8", "10.1.0.0/16"})) );
+    check_computation(q, when (in_src_prefixes6({"2001:db8::/32", "fe80::/10"}), steer_prefixes6({"2001:db8::/32"})) );
+    check_computation(q, when (payload_match({"GET ", "POST "}), steer_payload({"GET ", "POST "})) );
+    check_computation(q, payload_counter(4, {"SSH-", "HTTP/1."}) >> kernel );
+    check_computation(q, when (bloom6(1024, {"2001:db8::1", "fe80::1"}, 64), kernel) );
+    check_computation(q, bloom6_src_filter(1024, {"2001:db8::1"}, 128) >> when (in_bloom(0), kernel) );
 
     return 0;
 }
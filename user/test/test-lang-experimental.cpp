@@ -33,6 +33,14 @@ main()
     check_computation( q, par7 (ip, ip, ip, ip, ip, ip, ip) );
     check_computation( q, par8 (ip, ip, ip, ip, ip, ip, ip, ip) );
 
+    // tunnels:
+
+    check_computation( q, conditional (is_gtp_cp, broadcast, gtp_up >> steer_inner) );
+    check_computation( q, steer_gtp_usr ("10.0.0.0", 8) );
+    check_computation( q, when (is_tunnel, steer_inner) >> steer_flow );
+    check_computation( q, par3 (vxlan, gre, mpls) >> steer_tunnel_id );
+    check_computation( q, unless (is_qinq, drop) );
+
     return 0;
 }
 
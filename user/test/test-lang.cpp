@@ -48,6 +48,8 @@ main()
 
     auto cond  = [] (auto p, auto c1, auto c2) { return mfunction("cond", p, c1, c2); };
 
+    auto sw    = [] (auto p, std::vector<uint64_t> ks, auto cs, auto d) { return mfunction("switch", p, ks, cs, d); };
+
     auto integers = mfunction("int", std::vector<int>{1, 2, 3});
     auto strings  = mfunction("str", std::vector<std::string>{"one", "two", "tree"});
 
@@ -72,6 +74,8 @@ main()
 
     show_comp (fun0 >> fun1(1) >> fun2 ("test"));
 
+    show_comp (sw(prop1(4), {1, 2, 3}, functions(fun0, cond(pred0, fun0, fun1(3)) >> fun1(2), fun2("x")), fun1(5)) >> fun0);
+
     show_comp (integers);
     show_comp (strings);
 
@@ -87,8 +87,19 @@ namespace opt
 
     bool   rand_ip = false;
     bool   active_ts = false;
+    bool   exact_rate = false;
     double rate    = 0;
 
+    bool   tmpl      = false;
+    bool   imix      = false;
+    bool   rand_port = false;
+
+    bool     replay  = false;
+    int      loops   = 1;
+    double   speed   = 1.0;
+    uint64_t gap     = 0;
+    unsigned int rewrite = 0;
+
     std::vector< std::vector<int> > kcore;
 
     std::string file;
@@ -120,10 +131,17 @@ namespace thread
 
             auto q = pfq::socket(param::list, param::tx_slots{opt::slots});
 
+            q.tx_queues(m_bind.queue.size());
+
             std::cout << "thread     : " << id << " -> "  << show_binding(m_bind) << " kcore { ";
 
             for(auto x : kcpu)
-                std::cout << x  << ' ';
+            {
+                if (x == Q_ANY_CPU)
+                    std::cout << "any ";
+                else
+                    std::cout << x  << ' ';
+            }
 
             std::cout << "}" << std::endl;
 
@@ -134,6 +152,23 @@ namespace thread
 
             q.enable();
 
+            if (opt::tmpl)
+            {
+                for(unsigned int n = 0; n < m_bind.queue.size(); n++)
+                    start_template(q, static_cast<int>(n));
+            }
+
+#ifdef HAVE_PCAP_H
+            if (opt::replay)
+            {
+                for(unsigned int n = 0; n < m_bind.queue.size(); n++)
+                {
+                    load_trace(q, static_cast<int>(n));
+                    q.tx_replay(static_cast<int>(n), opt::loops, static_cast<unsigned int>(opt::speed * 1000), opt::gap, opt::rewrite);
+                }
+            }
+#endif
+
             if (std::any_of(std::begin(kcpu), std::end(kcpu), [](int cpu) { return cpu != -1; }))
             {
                     q.tx_async(true);
@@ -151,12 +186,19 @@ namespace thread
         void operator()()
         {
             if (opt::file.empty()) {
-                if (opt::active_ts)
+                if (opt::tmpl)
+                    template_wait();
+                else if (opt::exact_rate)
+                    exact_generator();
+                else if (opt::active_ts)
                     active_generator();
                 else
                     generator();
             }
 #ifdef HAVE_PCAP_H
+            else if (opt::replay) {
+                replay_wait();
+            }
             else {
                 pcap_generator();
             }
@@ -254,6 +296,118 @@ namespace thread
         }
 
 
+        //
+        // exact rate: the launch time of the n-th packet is computed from the start
+        // (no accumulated rounding), the kernel threads pace the transmission.
+        //
+
+        void exact_generator()
+        {
+            auto ip = reinterpret_cast<iphdr *>(m_packet.get() + 14);
+
+            const double period = 1000/opt::rate;   // nsec
+
+            auto start = std::chrono::system_clock::now() + std::chrono::milliseconds(1);
+
+            auto len = opt::len;
+
+            for(size_t n = 0; n < opt::npackets;)
+            {
+                auto ts = start + std::chrono::nanoseconds(static_cast<uint64_t>(n * period + 0.5));
+
+                if (!m_pfq.send_at(pfq::const_buffer(reinterpret_cast<const char *>(m_packet.get()), len), ts))
+                {
+                    m_fail->fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+
+                m_sent->fetch_add(1, std::memory_order_relaxed);
+                m_band->fetch_add(len, std::memory_order_relaxed);
+
+                if (opt::rand_ip)
+                {
+                    ip->saddr = static_cast<uint32_t>(m_gen());
+                    ip->daddr = static_cast<uint32_t>(m_gen());
+                }
+
+                n++;
+            }
+        }
+
+        //
+        // template: the packets are synthesized by the kernel threads, from the
+        // template(s) (IMIX 7:4:1 of 64, 576 and 1500 bytes) and the rules.
+        //
+
+        void start_template(pfq::socket &q, int queue)
+        {
+            std::vector<std::unique_ptr<char[]>> bufs;
+            std::vector<std::pair<pfq::const_buffer, unsigned int>> pkts;
+            std::vector<pfq_tx_template_rule> rules;
+
+            auto add = [&](size_t len, unsigned int weight)
+            {
+                bufs.emplace_back(make_packet(len));
+
+                // ports are mutated in UDP packets only...
+
+                if (opt::rand_port && len >= 14 + 20 + 8)
+                {
+                    auto ip = reinterpret_cast<iphdr *>(bufs.back().get() + 14);
+                    auto udp = reinterpret_cast<udphdr *>(bufs.back().get() + 14 + 20);
+                    ip->protocol = IPPROTO_UDP;
+                    udp->source = htons(1024);
+                    udp->dest = htons(80);
+                }
+
+                pkts.emplace_back(pfq::const_buffer(bufs.back().get(), len), weight);
+            };
+
+            if (opt::imix)
+            {
+                add(64, 7); add(576, 4); add(1500, 1);
+            }
+            else
+                add(opt::len, 1);
+
+            if (opt::rand_ip)
+            {
+                rules.push_back({Q_TEMPLATE_FIELD_IP_SRC, Q_TEMPLATE_MODE_RANDOM, 0, std::numeric_limits<uint32_t>::max()});
+                rules.push_back({Q_TEMPLATE_FIELD_IP_DST, Q_TEMPLATE_MODE_RANDOM, 0, std::numeric_limits<uint32_t>::max()});
+            }
+
+            if (opt::rand_port)
+            {
+                rules.push_back({Q_TEMPLATE_FIELD_PORT_SRC, Q_TEMPLATE_MODE_RANDOM, 1024, 65535});
+                rules.push_back({Q_TEMPLATE_FIELD_PORT_DST, Q_TEMPLATE_MODE_COUNTER, 1, 1024});
+            }
+
+            auto count = opt::npackets == std::numeric_limits<size_t>::max() ? 0 : opt::npackets;
+            auto gap   = opt::rate != 0.0 ? static_cast<uint64_t>(1000/opt::rate) : 0;
+
+            q.tx_template(queue, pkts, rules, count, gap);
+        }
+
+        void template_wait()
+        {
+            auto count = opt::npackets == std::numeric_limits<size_t>::max() ? 0 : opt::npackets;
+
+            for(;;)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+                if (count == 0)
+                    continue;
+
+                uint64_t sent = std::numeric_limits<uint64_t>::max();
+                for(unsigned int n = 0; n < m_bind.queue.size(); n++)
+                    sent = std::min<uint64_t>(sent, m_pfq.tx_template_sent(static_cast<int>(n)));
+
+                if (sent >= std::min<uint64_t>(count, std::numeric_limits<unsigned int>::max()))
+                    break;
+            }
+        }
+
 #ifdef HAVE_PCAP_H
         void pcap_generator()
         {
@@ -309,6 +463,61 @@ namespace thread
                 i++;
             }
         }
+
+        //
+        // replay: the trace is loaded in the Tx queue and transmitted by the kernel threads,
+        // with the timing of the pcap file (relative to the first packet).
+        //
+
+        void load_trace(pfq::socket &q, int queue)
+        {
+            struct pcap_pkthdr *hdr;
+            u_char *data;
+
+            auto p = pcap_open_offline(opt::file.c_str(), opt::errbuf);
+            if (p == nullptr)
+                throw std::runtime_error("pcap_open_offline:" + std::string(opt::errbuf));
+
+            uint64_t first = 0;
+            size_t n = 0;
+
+            for(; n < opt::npackets && pcap_next_ex(p, &hdr, (u_char const **)&data) == 1; n++)
+            {
+                auto ts = static_cast<uint64_t>(hdr->ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(hdr->ts.tv_usec) * 1000;
+                if (n == 0)
+                    first = ts;
+
+                auto plen = std::min<size_t>(hdr->caplen, opt::len);
+
+                if (!q.tx_replay_append(pfq::const_buffer(reinterpret_cast<const char *>(data), plen), ts - first, queue))
+                {
+                    std::cout << vt100::BOLD << "*** replay: Tx queue full, trace truncated to " << n << " packets (consider -s option) ***" << vt100::RESET << std::endl;
+                    break;
+                }
+            }
+
+            pcap_close(p);
+
+            std::cout << "replay     : " << n << " packets loaded in Tx queue " << queue << std::endl;
+        }
+
+        void replay_wait()
+        {
+            for(;;)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+                if (opt::loops == 0)
+                    continue;
+
+                unsigned int done = std::numeric_limits<unsigned int>::max();
+                for(unsigned int n = 0; n < m_bind.queue.size(); n++)
+                    done = std::min(done, m_pfq.tx_replay_loops(static_cast<int>(n)));
+
+                if (done >= static_cast<unsigned int>(opt::loops))
+                    break;
+            }
+        }
 #endif
 
         int m_id;
@@ -393,13 +602,23 @@ void usage(std::string name)
         " -l --len INT                  Set packet length\n"
         " -n --packets INT              Number of packets\n"
         " -s --queue-slots INT          Set Tx queue length\n"
-        " -k --kcore IDX,IDX...         Async with kernel threads\n"
+        " -k --kcore IDX,IDX...         Async with kernel threads (any = a cpu close to the device)\n"
 #ifdef HAVE_PCAP_H
         " -r --read FILE                Read pcap trace file to send\n"
+        "    --replay                   Replay the trace from the Tx queue, in kernel (requires -r and -k)\n"
+        "    --loops INT                Number of loops of the replay (0 = forever, default 1)\n"
+        "    --speed DOUBLE             Speed factor of the replay (0 = line rate, default 1.0)\n"
+        "    --gap INT                  Fixed inter-packet gap of the replay, in nsec\n"
+        "    --rewrite-ip               Replay: add the loop number to the IP addresses\n"
+        "    --rewrite-mac              Replay: add the loop number to the MAC addresses\n"
 #endif
         " -R --rand-ip                  Randomize IP addresses\n"
         "    --rate DOUBLE              Packet rate in Mpps\n"
         " -a --active-tstamp            Use active timestamp as rate control\n"
+        " -x --exact-rate               Exact rate, paced by kernel threads (requires --rate and -k)\n"
+        " -T --template                 Generate the packets in kernel, from templates (requires -k)\n"
+        "    --imix                     Template: IMIX 7:4:1 of 64, 576 and 1500 bytes\n"
+        "    --rand-port                Template: UDP packets with randomized ports\n"
         " -f --flush INT                Set flush length, used in sync Tx\n"
         " -t --thread BINDING\n\n"
         "      BINDING = " + pfq::binding_format
@@ -432,6 +651,57 @@ try
             opt::file = argv[i];
             continue;
         }
+
+        if ( any_strcmp(argv[i], "--replay") )
+        {
+            opt::replay = true;
+            continue;
+        }
+
+        if ( any_strcmp(argv[i], "--loops") )
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("loops missing");
+            }
+
+            opt::loops = std::atoi(argv[i]);
+            continue;
+        }
+
+        if ( any_strcmp(argv[i], "--speed") )
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("speed missing");
+            }
+
+            opt::speed = atof(argv[i]);
+            continue;
+        }
+
+        if ( any_strcmp(argv[i], "--gap") )
+        {
+            if (++i == argc)
+            {
+                throw std::runtime_error("gap missing");
+            }
+
+            opt::gap = static_cast<uint64_t>(std::atoll(argv[i]));
+            continue;
+        }
+
+        if ( any_strcmp(argv[i], "--rewrite-ip") )
+        {
+            opt::rewrite |= Q_REPLAY_REWRITE_IP;
+            continue;
+        }
+
+        if ( any_strcmp(argv[i], "--rewrite-mac") )
+        {
+            opt::rewrite |= Q_REPLAY_REWRITE_MAC;
+            continue;
+        }
 #endif
 
         if ( any_strcmp(argv[i], "-f", "--flush") )
@@ -487,7 +757,7 @@ try
 
             auto vec = pfq::split(argv[i], ",");
 
-            auto cores = pfq::fmap([](const std::string &val) -> int { return std::stoi(val); }, vec);
+            auto cores = pfq::fmap([](const std::string &val) -> int { return val == "any" ? Q_ANY_CPU : std::stoi(val); }, vec);
 
             opt::kcore.push_back(std::move(cores));
             continue;
@@ -505,6 +775,30 @@ try
             continue;
         }
 
+        if ( any_strcmp(argv[i], "-x", "--exact-rate") )
+        {
+            opt::exact_rate = true;
+            continue;
+        }
+
+        if ( any_strcmp(argv[i], "-T", "--template") )
+        {
+            opt::tmpl = true;
+            continue;
+        }
+
+        if ( any_strcmp(argv[i], "--imix") )
+        {
+            opt::imix = true;
+            continue;
+        }
+
+        if ( any_strcmp(argv[i], "--rand-port") )
+        {
+            opt::rand_port = true;
+            continue;
+        }
+
         if ( any_strcmp(argv[i], "-t", "--thread") )
         {
             if (++i == argc)
@@ -546,6 +840,43 @@ try
     if (opt::active_ts)
         std::cout << "timestamp  : active!" << std::endl;
 
+    if (opt::exact_rate)
+    {
+        if (opt::rate == 0.0)
+            throw std::runtime_error("exact rate: --rate missing");
+
+        if (opt::kcore.empty())
+            throw std::runtime_error("exact rate: kernel threads required (-k)");
+
+        std::cout << "timestamp  : exact rate (see /proc/net/pfq/tx_pacing)" << std::endl;
+    }
+
+    if (opt::tmpl)
+    {
+        if (!opt::file.empty())
+            throw std::runtime_error("template: pcap file not supported");
+
+        if (opt::kcore.empty())
+            throw std::runtime_error("template: kernel threads required (-k)");
+
+        std::cout << "template   : " << (opt::imix ? "imix" : std::to_string(opt::len) + " bytes")
+                  << (opt::rand_port ? ", rand-port" : "") << std::endl;
+    }
+
+    if (opt::replay)
+    {
+        if (opt::file.empty())
+            throw std::runtime_error("replay: pcap file missing (-r)");
+
+        if (opt::kcore.empty())
+            throw std::runtime_error("replay: kernel threads required (-k)");
+
+        if (opt::loops < 0 || opt::speed < 0)
+            throw std::runtime_error("replay: bad loops/speed");
+
+        std::cout << "replay     : loops " << opt::loops << ", speed " << opt::speed << ", gap " << opt::gap << " nsec" << std::endl;
+    }
+
     //
     // process binding:
     //
@@ -556,7 +887,7 @@ try
 
         std::cout << "device     : " << binding[i].dev.at(0) << ", " << num_queues << " queues detected." << std::endl;
 
-        num_queues = std::min<size_t>(4, num_queues);
+        num_queues = std::min<size_t>(Q_MAX_TX_QUEUES, num_queues);
 
         while (binding[i].queue.size() < num_queues)
         {
@@ -593,8 +924,12 @@ try
 
         for(auto & v : opt::kcore)
         {
-            while(v.size() < std::min<size_t>(4,binding[n].queue.size()))
-                v.push_back(-1);
+            // a trailing 'any' extends to the remaining queues
+
+            auto pad = !v.empty() && v.back() == Q_ANY_CPU ? Q_ANY_CPU : -1;
+
+            while(v.size() < std::min<size_t>(Q_MAX_TX_QUEUES,binding[n].queue.size()))
+                v.push_back(pad);
         }
     }
 
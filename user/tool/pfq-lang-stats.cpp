@@ -0,0 +1,246 @@
+/***************************************************************
+ *
+ * (C) 2011-15 Nicola Bonelli <nicola@pfq.io>
+ *
+ ****************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include <thread>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <vector>
+#include <map>
+#include <limits>
+#include <cerrno>
+
+#include <pfq/pfq.hpp>
+
+#include <vt100.hpp>
+
+using namespace pfq;
+
+
+//
+// per-node counters of the computation of a group (lang_stats module parameter):
+// calls, passed and dropped packets, cycles per call and share of the cycles of the computation.
+//
+
+namespace opt
+{
+    int    gid     = 0;
+    size_t seconds = std::numeric_limits<size_t>::max();
+    size_t interval = 1;
+    bool   once    = false;
+}
+
+
+// node symbols, as printed in /proc/net/pfq/computations:
+//
+// group=G computation size=N entry_point=...
+//    I@0x...: symbol+0x.../0x... { args } -> next:...
+//
+
+std::map<size_t, std::string>
+node_symbols(int gid)
+{
+    std::ifstream proc("/proc/net/pfq/computations");
+    std::map<size_t, std::string> ret;
+    std::string line;
+    int group = -1;
+
+    while (std::getline(proc, line))
+    {
+        if (line.compare(0, 6, "group=") == 0)
+        {
+            group = std::atoi(line.c_str() + 6);
+            continue;
+        }
+
+        if (group != gid)
+            continue;
+
+        auto at = line.find('@');
+        auto colon = line.find(": ");
+        if (at == std::string::npos || colon == std::string::npos || colon < at)
+            continue;
+
+        std::istringstream idx(line.substr(0, at));
+        size_t n;
+        if (!(idx >> n))
+            continue;
+
+        std::string sym = line.substr(colon + 2);
+        sym = sym.substr(0, sym.find_first_of("+ "));
+
+        ret[n] = sym;
+    }
+
+    return ret;
+}
+
+
+void
+print_stats(std::vector<pfq_node_stats> const &cur, std::vector<pfq_node_stats> const &old,
+            std::map<size_t, std::string> const &sym, double secs)
+{
+    uint64_t total = 0;
+
+    for(size_t n = 0; n < cur.size(); ++n)
+        total += cur[n].cycles - (n < old.size() ? old[n].cycles : 0);
+
+    std::cout << vt100::BOLD
+              << std::setw(5)  << "node" << ' '
+              << std::setw(24) << std::left << "function" << std::right
+              << std::setw(14) << "calls/sec"
+              << std::setw(14) << "pass/sec"
+              << std::setw(14) << "drop/sec"
+              << std::setw(12) << "tsc/call"
+              << std::setw(9)  << "cycles%"
+              << vt100::RESET << std::endl;
+
+    for(size_t n = 0; n < cur.size(); ++n)
+    {
+        pfq_node_stats d = cur[n];
+
+        if (n < old.size())
+        {
+            d.calls  -= old[n].calls;
+            d.pass   -= old[n].pass;
+            d.drop   -= old[n].drop;
+            d.cycles -= old[n].cycles;
+        }
+
+        if (d.calls == 0)
+            continue;
+
+        auto it = sym.find(n);
+
+        std::cout << std::setw(5)  << n << ' '
+                  << std::setw(24) << std::left << (it != sym.end() ? it->second : "?") << std::right
+                  << std::setw(14) << static_cast<uint64_t>(d.calls/secs)
+                  << std::setw(14) << static_cast<uint64_t>(d.pass/secs)
+                  << std::setw(14) << static_cast<uint64_t>(d.drop/secs)
+                  << std::setw(12) << d.cycles/d.calls
+                  << std::setw(8)  << std::fixed << std::setprecision(1)
+                  << (total ? 100.0 * d.cycles / total : 0.0) << '%' << std::endl;
+    }
+}
+
+
+std::vector<pfq_node_stats>
+computation_stats(pfq::socket &q, int gid)
+try
+{
+    return q.group_computation_stats(gid);
+}
+catch(pfq_error &e)
+{
+    if (e.code().value() == EACCES)
+        throw std::runtime_error("group " + std::to_string(gid) + ": permission denied "
+                                 "(private or restricted group, only shared ones can be inspected)");
+    throw;
+}
+
+
+void usage(std::string name)
+{
+    throw std::runtime_error
+    (
+        "usage: " + std::move(name) + " [OPTIONS]\n\n"
+        " -h --help                     Display this help\n"
+        " -g --group INT                Group id (default 0)\n"
+        " -i --interval INT             Refresh interval in seconds (default 1)\n"
+        "    --seconds INT              Terminate after INT seconds\n"
+        " -1 --once                     Print the cumulative counters and exit\n\n"
+        "      counters are updated when the module is loaded with lang_stats=1\n"
+        "      (or: echo 1 > /sys/module/pfq/parameters/lang_stats)\n"
+        "      only shared groups can be inspected: the counters of private and\n"
+        "      restricted groups are readable by their owner only"
+    );
+}
+
+
+int
+main(int argc, char *argv[])
+try
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-g") == 0 || strcmp(argv[i], "--group") == 0)
+        {
+            if (++i == argc)
+                throw std::runtime_error("group id missing");
+
+            opt::gid = std::atoi(argv[i]);
+            continue;
+        }
+
+        if (strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "--interval") == 0)
+        {
+            if (++i == argc)
+                throw std::runtime_error("interval missing");
+
+            opt::interval = std::max(1, std::atoi(argv[i]));
+            continue;
+        }
+
+        if (strcmp(argv[i], "--seconds") == 0)
+        {
+            if (++i == argc)
+                throw std::runtime_error("seconds missing");
+
+            opt::seconds = static_cast<size_t>(std::atoi(argv[i]));
+            continue;
+        }
+
+        if (strcmp(argv[i], "-1") == 0 || strcmp(argv[i], "--once") == 0)
+        {
+            opt::once = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
+            usage(argv[0]);
+
+        throw std::runtime_error(std::string(argv[i]) + " unknown option!");
+    }
+
+    pfq::socket q(group_policy::undefined, 64);
+
+    auto old = computation_stats(q, opt::gid);
+
+    if (opt::once)
+    {
+        print_stats(old, {}, node_symbols(opt::gid), 1.0);
+        return 0;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+
+    for(size_t y = 0; y < opt::seconds; y += opt::interval)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(opt::interval));
+
+        auto cur = computation_stats(q, opt::gid);
+        auto end = std::chrono::steady_clock::now();
+
+        auto secs = std::chrono::duration<double>(end - begin).count();
+
+        std::cout << vt100::CLEAR << vt100::HOME;
+        std::cout << "group " << opt::gid << ": " << cur.size() << " nodes" << std::endl;
+
+        print_stats(cur, old, node_symbols(opt::gid), secs);
+
+        old = std::move(cur), begin = end;
+    }
+}
+catch(std::exception &e)
+{
+    std::cerr << e.what() << std::endl;
+    return 1;
+}